@@ -1,7 +1,6 @@
 #include "main.h"
 #include "camera.h"
 #include "script.h"
-#include "keyboard.h"
 #include "natives.h"
 #include "utils.h"
 #include <string>
@@ -150,3 +149,25 @@ void adjustCamera(std::string cmd)
 	// 	CAM::SET_CAM_ROT(cameraHandle, currentRotation.x, currentRotation.y, currentRotation.z, 2);
 	// }
 }
+
+CameraPose getCameraPose()
+{
+	Vector3 pos = CAM::GET_CAM_COORD(cameraHandle);
+	Vector3 rot = CAM::GET_CAM_ROT(cameraHandle, 2);
+	CameraPose pose;
+	pose.x = pos.x;
+	pose.y = pos.y;
+	pose.z = pos.z;
+	pose.pitch = rot.x;
+	pose.roll = rot.y;
+	pose.yaw = rot.z;
+	pose.fov = CAM::GET_CAM_FOV(cameraHandle);
+	return pose;
+}
+
+void setCameraPose(const CameraPose& pose)
+{
+	CAM::SET_CAM_COORD(cameraHandle, pose.x, pose.y, pose.z);
+	CAM::SET_CAM_ROT(cameraHandle, pose.pitch, pose.roll, pose.yaw, 2);
+	CAM::SET_CAM_FOV(cameraHandle, pose.fov);
+}
@@ -4,6 +4,7 @@
 #include "types.h"
 #include "enums.h"
 #include "main.h"
+#include "pose.h"
 #include <cmath>
 #include <string>
 
@@ -16,6 +17,11 @@ extern int adjustCameraFinished;
 
 void startNewCamera();
 void adjustCamera(std::string cmd);
+
+// Script thread only: read or apply the whole pose in one tick.
+CameraPose getCameraPose();
+void setCameraPose(const CameraPose& pose);
+
 void StopCamera(int foldNo = 0);
 
 bool showCamera();
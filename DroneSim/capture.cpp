@@ -0,0 +1,98 @@
+#include "capture.h"
+#include "latency.h"
+#include "metrics.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+catchState cmdToCatch = catchStop;
+std::string g_rgbCapturedFilePath;
+std::string g_depthCapturedFilePath;
+std::string g_stencilCapturedFilePath;
+std::string g_matrixCapturedFilePath = "data\\matrix.txt";
+
+void makeCmdStop()
+{
+	cmdToCatch = catchStop;
+}
+
+static bool writeFile(const char* path, const void* data, int size)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == nullptr) return false;
+	fwrite(data, 1, size, f);
+	fclose(f);
+	return true;
+}
+
+static std::vector<unsigned char> readFile(const char* path)
+{
+	std::vector<unsigned char> data;
+	FILE* f = fopen(path, "rb");
+	if (f == nullptr) return data;
+	unsigned char chunk[65536];
+	for (size_t n; (n = fread(chunk, 1, sizeof(chunk), f)) > 0;) data.insert(data.end(), chunk, chunk + n);
+	fclose(f);
+	return data;
+}
+
+void completeCapture(wchar_t* imgPath, const char* stencilPath, const char* depthPath, FILE* log)
+{
+	static MetricHistogram& completeMetric = metricHistogram("capture.complete_us");
+	static MetricCounter& failedMetric = metricCounter("capture.failed");
+	auto start = std::chrono::steady_clock::now();
+	long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	void* stencil_buf;
+	void* depth_buf;
+	int sizeStencil = export_get_stencil_buffer(&stencil_buf);
+	int sizeDepth = export_get_depth_buffer(&depth_buf);
+
+	char imgPathNarrow[256] = { 0 };
+	wcstombs(imgPathNarrow, imgPath, sizeof(imgPathNarrow) - 1);
+	int screenCapResult = export_get_screen_buffer(imgPath);
+	g_rgbCapturedFilePath = imgPathNarrow;
+	fprintf(log, "[%lld] : export screen %s %s.\n", ms, imgPathNarrow, screenCapResult == 1 ? "success" : "failed");
+
+	if (sizeStencil > 0 && writeFile(stencilPath, stencil_buf, sizeStencil)) {
+		fprintf(log, "[%lld] : write stencil %s into file.\n", ms, stencilPath);
+		g_stencilCapturedFilePath = stencilPath;
+	}
+	if (sizeDepth > 0 && writeFile(depthPath, depth_buf, sizeDepth)) {
+		fprintf(log, "[%lld] : write depth %s into file.\n", ms, depthPath);
+		g_depthCapturedFilePath = depthPath;
+	}
+
+	auto frame = std::make_shared<CapturedFrame>();
+	frame->timestamp = ms;
+	// kept with the frame so CAPTURE replies with the screenshot of the same
+	// capture as its depth and derived channels
+	if (screenCapResult == 1) frame->screen = readFile(imgPathNarrow);
+	if (export_get_depth_dimensions(&frame->width, &frame->height) == 1 && sizeDepth > 0) {
+		frame->depth.resize(sizeDepth / sizeof(float));
+		memcpy(frame->depth.data(), depth_buf, sizeDepth);
+		if (sizeStencil > 0) frame->stencil.assign((unsigned char*)stencil_buf, (unsigned char*)stencil_buf + sizeStencil);
+		if (export_get_constant_buffer(&frame->matrices) == -1) {
+			frame->matrices.M = frame->matrices.MV = frame->matrices.MVP = frame->matrices.Vinv = Eigen::Matrix4f::Identity();
+		}
+		try {
+			void* color_buf;
+			int sizeColor = export_get_color_buffer(&color_buf);
+			if (sizeColor > 0 && export_get_color_dimensions(&frame->colorWidth, &frame->colorHeight) == 1) {
+				frame->color.assign((unsigned char*)color_buf, (unsigned char*)color_buf + sizeColor);
+			}
+		}
+		catch (const std::exception& e) {
+			fprintf(log, "[%lld] : color copy failed: %s\n", ms, e.what());
+		}
+		markCaptureStage(stageUnpackDone);
+		publishCapturedFrame(frame);
+	}
+	else {
+		failedMetric.add();
+	}
+
+	makeCmdStop();
+	completeMetric.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
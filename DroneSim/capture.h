@@ -0,0 +1,59 @@
+#pragma once
+#include "frame.h"
+#include "latency.h"
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#define EXPORT_API __declspec(dllexport)
+#else
+#define EXPORT_API
+#endif
+
+// Read-back of the last rendered frame. The plugin implements these over the
+// hooked D3D resources (export.cpp); the headless harness over its synthetic
+// renderer. Sizes are in bytes, -1 when nothing has been rendered yet.
+extern "C" {
+	EXPORT_API int export_get_depth_buffer(void** buf);
+	EXPORT_API int export_get_color_buffer(void** buf);
+	EXPORT_API int export_get_stencil_buffer(void** buf);
+	EXPORT_API int export_get_constant_buffer(rage_matrices* buf);
+	EXPORT_API int export_get_screen_buffer(wchar_t* pictureName);
+	EXPORT_API int export_get_depth_dimensions(int* width, int* height);
+	EXPORT_API int export_get_color_dimensions(int* width, int* height);
+}
+
+#ifdef DRONESIM_SCRIPTHOOK
+// The SDK's main.h declares catchState and makeCmdStart for the plugin code.
+#include "main.h"
+#else
+enum catchState
+{
+	catchStop,
+	catchStart,
+	catchScreen
+};
+#endif
+
+// Capture request shared by the script thread, the renderer and the server.
+extern catchState cmdToCatch;
+void makeCmdStop();
+
+inline void makeCmdStart()
+{
+	markCaptureStage(stageCaptureArmed);
+	cmdToCatch = catchStart;
+}
+
+// Files written by the last capture. CAPTURE replies from the published
+// frame, which carries the same screenshot and depth.
+extern std::string g_rgbCapturedFilePath;
+extern std::string g_depthCapturedFilePath;
+extern std::string g_stencilCapturedFilePath;
+extern std::string g_matrixCapturedFilePath;
+
+// Called by the renderer once the buffers of a requested capture are ready:
+// saves the screenshot, stencil and depth files, publishes the frame (with
+// the screenshot's bytes) and clears the request. log receives one line per
+// file.
+void completeCapture(wchar_t* imgPath, const char* stencilPath, const char* depthPath, FILE* log);
@@ -0,0 +1,115 @@
+#include "channels.h"
+#include "derived.h"
+#include "flow.h"
+#include "frame.h"
+#include "instances.h"
+#include "semantic.h"
+#include <algorithm>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+bool appendRequestedChannels(const string& command, const std::shared_ptr<const CapturedFrame>& frame,
+	vector<unsigned char>& out, string& error)
+{
+	std::istringstream ss(command);
+	string name;
+	ss >> name;
+	vector<string> options;
+	for (string tok; ss >> tok;) options.push_back(tok);
+	if (options.empty()) return true;
+
+	if (!frame) {
+		error = "no captured frame";
+		return false;
+	}
+
+	PositionPlanes pos;
+	bool haveGeometry = false;
+	auto geometry = [&]() -> const PositionPlanes& {
+		if (!haveGeometry) unprojectDepth(*frame, pos);
+		haveGeometry = true;
+		return pos;
+	};
+
+	for (const string& opt : options) {
+		string key = opt.substr(0, opt.find(':'));
+		string arg = opt.find(':') == string::npos ? "" : opt.substr(opt.find(':') + 1);
+		if (key == "NORMALS") {
+			vector<float> normals;
+			computeNormals(geometry(), normals);
+			appendFrameChannel(out, "NRML", frame->width, frame->height, normals.data(), normals.size() * sizeof(float));
+		}
+		else if (key == "EDGES") {
+			float threshold = 0.05f;
+			try {
+				if (!arg.empty()) threshold = std::stof(arg);
+			}
+			catch (const std::exception&) {
+				error = "bad EDGES threshold '" + arg + "'";
+				return false;
+			}
+			vector<unsigned char> edges;
+			computeDepthEdges(geometry(), edges, threshold);
+			appendFrameChannel(out, "EDGE", frame->width, frame->height, edges.data(), edges.size());
+		}
+		else if (key == "FLOW") {
+			float tolerance = 0.02f;
+			try {
+				if (!arg.empty()) tolerance = std::stof(arg);
+			}
+			catch (const std::exception&) {
+				error = "bad FLOW tolerance '" + arg + "'";
+				return false;
+			}
+			// the capture before frame, even if newer ones have been published since
+			auto frames = recentCapturedFrames(capturedFrameHistory);
+			auto at = std::find(frames.begin(), frames.end(), frame);
+			if (at == frames.end() || at + 1 == frames.end()) {
+				error = "FLOW needs two captures";
+				return false;
+			}
+			const CapturedFrame& previous = **(at + 1);
+			vector<float> flow;
+			vector<unsigned char> valid;
+			computeEgoFlow(previous, *frame, flow, valid, tolerance);
+			appendFrameChannel(out, "FLOW", previous.width, previous.height, flow.data(), flow.size() * sizeof(float));
+			appendFrameChannel(out, "FVAL", previous.width, previous.height, valid.data(), valid.size());
+		}
+		else if (key == "STENCIL") {
+			appendFrameChannel(out, "STEN", frame->width, frame->height, frame->stencil.data(), frame->stencil.size());
+		}
+		else if (key == "SEMANTIC") {
+			vector<unsigned char> labels;
+			vector<SemanticClassStats> classes;
+			labelStencil(frame->stencil, frame->width, frame->height, currentSemanticLut(), labels, classes);
+			string json = semanticClassesJson(classes, frame->width, frame->height);
+			appendFrameChannel(out, "SEMA", frame->width, frame->height, labels.data(), labels.size());
+			appendFrameChannel(out, "SCLS", frame->width, frame->height, json.data(), json.size());
+		}
+		else if (key == "INSTANCES") {
+			float tolerance = 0.05f;
+			try {
+				if (!arg.empty()) tolerance = std::stof(arg);
+			}
+			catch (const std::exception&) {
+				error = "bad INSTANCES tolerance '" + arg + "'";
+				return false;
+			}
+			vector<unsigned char> labels;
+			applySemanticLut(frame->stencil, currentSemanticLut(), labels);
+			const PositionPlanes& p = geometry();
+			vector<float> depth(p.z.size());
+			for (size_t i = 0; i < depth.size(); ++i) depth[i] = -p.z[i];
+			vector<InstanceRecord> instances;
+			labelInstances(labels, depth, frame->width, frame->height, instances, nullptr, tolerance);
+			appendFrameChannel(out, "INST", frame->width, frame->height, instances.data(), instances.size() * sizeof(InstanceRecord));
+		}
+		else {
+			error = "unknown channel '" + opt + "'";
+			return false;
+		}
+	}
+	return true;
+}
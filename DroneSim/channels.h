@@ -0,0 +1,22 @@
+#pragma once
+#include "frame.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Optional per-frame channels a client can ask for after CAPTURE, e.g.
+// "CAPTURE NORMALS EDGES:0.1". Each one is computed from frame, the capture
+// the rest of the reply comes from, and appended with appendFrameChannel.
+//
+//   NORMALS        "NRML"  float32 x3 camera-space normal per pixel
+//   EDGES[:ratio]  "EDGE"  uint8 depth-discontinuity mask
+//   FLOW[:tol]     "FLOW"  float32 x2 ego-motion flow from the capture
+//                          before frame into it, per previous-frame pixel
+//                  "FVAL"  uint8 flow validity mask
+//   STENCIL        "STEN"  uint8 raw stencil plane
+//   SEMANTIC       "SEMA"  uint8 class label per pixel (see SEMANTIC_MAP)
+//                  "SCLS"  JSON per-class pixel counts and COCO RLE masks
+//   INSTANCES[:tol] "INST" InstanceRecord array: per-object boxes, areas
+//                          and median depth from the semantic mask
+bool appendRequestedChannels(const std::string& command, const std::shared_ptr<const CapturedFrame>& frame,
+	std::vector<unsigned char>& out, std::string& error);
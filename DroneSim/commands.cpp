@@ -0,0 +1,166 @@
+#include "commands.h"
+#include "latency.h"
+#include "metrics.h"
+#include <cmath>
+#include <sstream>
+
+CommandQueue g_cmdQueue;
+
+static MetricGauge& queueDepthMetric = metricGauge("commands.queue_depth");
+
+void CommandQueue::push(std::string command)
+{
+	std::lock_guard<std::mutex> lk(mtx_);
+	queue_.push_back(std::move(command));
+	queueDepthMetric.set((int64_t)queue_.size());
+}
+
+size_t CommandQueue::drain(std::deque<std::string>& out)
+{
+	std::lock_guard<std::mutex> lk(mtx_);
+	size_t n = queue_.size();
+	for (auto& cmd : queue_) out.push_back(std::move(cmd));
+	queue_.clear();
+	queueDepthMetric.set(0);
+	return n;
+}
+
+size_t CommandQueue::size() const
+{
+	std::lock_guard<std::mutex> lk(mtx_);
+	return queue_.size();
+}
+
+static const float DEG2RAD = 0.01745329f;
+static const float MOVE_STEP = 5.0f;	// STEPSIZE * cameraSpeedFactor in camera.h
+static const float ROTATE_STEP = 45.0f;
+
+bool isMoveCommand(const std::string& cmd)
+{
+	return cmd == "FORWARD" || cmd == "BACKWARD" || cmd == "LEFT" || cmd == "RIGHT"
+		|| cmd == "UP" || cmd == "DOWN" || cmd == "LEFTROTATE" || cmd == "RIGHTROTATE";
+}
+
+bool foldMoveCommand(const std::string& cmd, Eigen::Vector3f& position, float pitch, float& yaw)
+{
+	// MathUtils::rotationToDirection, and side = direction x up
+	float cp = std::fabs(std::cos(pitch * DEG2RAD));
+	Eigen::Vector3f direction(-std::sin(yaw * DEG2RAD) * cp, std::cos(yaw * DEG2RAD) * cp, std::sin(pitch * DEG2RAD));
+	Eigen::Vector3f side(direction.y(), -direction.x(), 0.0f);
+	if (cmd == "FORWARD") position += direction * MOVE_STEP;
+	else if (cmd == "BACKWARD") position -= direction * MOVE_STEP;
+	else if (cmd == "LEFT") position -= side * MOVE_STEP;
+	else if (cmd == "RIGHT") position += side * MOVE_STEP;
+	else if (cmd == "UP") position.z() += MOVE_STEP;
+	else if (cmd == "DOWN") position.z() -= MOVE_STEP;
+	else if (cmd == "LEFTROTATE") yaw += ROTATE_STEP;
+	else if (cmd == "RIGHTROTATE") yaw -= ROTATE_STEP;
+	else return false;
+	return true;
+}
+
+bool isBarrierCommand(const std::string& cmd)
+{
+	return cmd == "REQUEST" || cmd.rfind("STEP ", 0) == 0 || cmd == "RIG_CAPTURE";
+}
+
+void drainCommandQueue(std::deque<std::string>& pending, const CommandSink& sink,
+	std::chrono::steady_clock::time_point deadline, CommandTick& tick)
+{
+	CameraPose pose;
+	bool folding = false;
+	// timed: the pose is the one the REQUEST being dequeued captures
+	auto flush = [&](bool timed) {
+		if (!folding) return;
+		sink.writePose(pose);
+		if (timed) markCaptureStage(stagePoseApplied);
+		tick.poseWrites++;
+		folding = false;
+	};
+
+	while (!pending.empty()) {
+		if (std::chrono::steady_clock::now() > deadline) {
+			tick.overBudget = true;
+			break;
+		}
+		std::string cmd = std::move(pending.front());
+		pending.pop_front();
+		tick.commands++;
+
+		if (isMoveCommand(cmd) || cmd.rfind("SET_POSE", 0) == 0) {
+			if (!folding) {
+				pose = sink.readPose();
+				folding = true;
+			}
+			if (isMoveCommand(cmd)) {
+				Eigen::Vector3f position(pose.x, pose.y, pose.z);
+				foldMoveCommand(cmd, position, pose.pitch, pose.yaw);
+				pose.x = position.x();
+				pose.y = position.y();
+				pose.z = position.z();
+				tick.poseCommands++;
+				continue;
+			}
+			bool hasFov = false;
+			CameraPose parsed = pose;
+			if (parseSetPose(cmd, parsed, hasFov)) {
+				pose = parsed;
+				tick.poseCommands++;
+			}
+			else {
+				sink.malformed(cmd);
+			}
+			continue;
+		}
+
+		const bool request = cmd == "REQUEST";
+		if (request) markCaptureStage(stageDequeued);
+		flush(request);
+		if (isBarrierCommand(cmd)) {
+			if (sink.barrier(cmd)) {
+				tick.barrier = true;
+				break;
+			}
+			continue;
+		}
+		sink.run(cmd);
+	}
+	flush(false);
+}
+
+static std::mutex stats_mtx;
+static CommandStats stats;
+
+void recordCommandTick(const CommandTick& tick)
+{
+	std::lock_guard<std::mutex> lk(stats_mtx);
+	stats.backlog = tick.backlog;
+	if (tick.commands == 0) return;
+	stats.ticks++;
+	stats.commands += tick.commands;
+	stats.poseCommands += tick.poseCommands;
+	stats.poseWrites += tick.poseWrites;
+	stats.barriers += tick.barrier;
+	stats.budgetStops += tick.overBudget;
+	stats.lastPerTick = tick.commands;
+	if (tick.commands > stats.maxPerTick) stats.maxPerTick = tick.commands;
+	stats.meanTickMs += (tick.milliseconds - stats.meanTickMs) / stats.ticks;
+}
+
+CommandStats commandStats()
+{
+	std::lock_guard<std::mutex> lk(stats_mtx);
+	return stats;
+}
+
+std::string commandStatsJson(const CommandStats& s)
+{
+	std::ostringstream ss;
+	ss << "{\"ticks\":" << s.ticks << ",\"commands\":" << s.commands
+		<< ",\"commands_per_tick\":" << (s.ticks ? (double)s.commands / s.ticks : 0.0)
+		<< ",\"max_per_tick\":" << s.maxPerTick << ",\"last_per_tick\":" << s.lastPerTick
+		<< ",\"pose_commands\":" << s.poseCommands << ",\"pose_writes\":" << s.poseWrites
+		<< ",\"barriers\":" << s.barriers << ",\"budget_stops\":" << s.budgetStops
+		<< ",\"backlog\":" << s.backlog << ",\"mean_tick_ms\":" << s.meanTickMs << "}";
+	return ss.str();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "pose.h"
+#include <Eigen/Core>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Text commands queued by the server thread for the script thread.
+class CommandQueue {
+public:
+	void push(std::string command);
+	// Moves every pending command to the back of out, in arrival order.
+	size_t drain(std::deque<std::string>& out);
+	size_t size() const;
+
+private:
+	mutable std::mutex mtx_;
+	std::deque<std::string> queue_;
+};
+
+extern CommandQueue g_cmdQueue;
+
+// The eight discrete camera moves (FORWARD ... RIGHTROTATE).
+bool isMoveCommand(const std::string& cmd);
+// Applies one discrete move to a pose held in software, exactly as
+// adjustCamera would with the natives: FORWARD/BACKWARD along the view
+// direction, LEFT/RIGHT along its horizontal side vector, UP/DOWN along
+// world z and the rotations by 45 degrees of yaw. Runs of moves folded this
+// way are written to the camera once.
+bool foldMoveCommand(const std::string& cmd, Eigen::Vector3f& position, float pitch, float& yaw);
+
+// What one script tick did with the queue.
+struct CommandTick {
+	size_t commands = 0;
+	size_t poseCommands = 0;	// moves and SET_POSE folded into pose writes
+	size_t poseWrites = 0;		// camera writes they were folded into
+	bool barrier = false;		// stopped at a capture
+	bool overBudget = false;	// stopped at the time budget
+	size_t backlog = 0;			// commands left for later ticks
+	double milliseconds = 0.0;
+};
+
+// The game side of a drain: drainCommandQueue decides what is folded and
+// where the drain stops, these touch the camera and run everything else.
+struct CommandSink {
+	std::function<CameraPose()> readPose;
+	std::function<void(const CameraPose&)> writePose;
+	// REQUEST, STEP and RIG_CAPTURE: true if the command started a capture,
+	// which ends the drain until it is done.
+	std::function<bool(const std::string&)> barrier;
+	std::function<void(const std::string&)> run;
+	std::function<void(const std::string&)> malformed;	// a SET_POSE that did not parse
+};
+
+bool isBarrierCommand(const std::string& cmd);
+
+// Runs pending commands from the front until a barrier starts a capture, the
+// deadline passes or none are left; the rest stay in pending. Runs of moves
+// and SET_POSE are folded into one pose, read once and written once before
+// the next other command. A REQUEST is stamped dequeued, and the pose written
+// just before it pose_applied.
+void drainCommandQueue(std::deque<std::string>& pending, const CommandSink& sink,
+	std::chrono::steady_clock::time_point deadline, CommandTick& tick);
+
+struct CommandStats {
+	uint64_t ticks = 0;			// ticks that ran at least one command
+	uint64_t commands = 0;
+	uint64_t poseCommands = 0;
+	uint64_t poseWrites = 0;
+	uint64_t barriers = 0;
+	uint64_t budgetStops = 0;
+	size_t maxPerTick = 0;
+	size_t lastPerTick = 0;
+	size_t backlog = 0;
+	double meanTickMs = 0.0;
+};
+
+void recordCommandTick(const CommandTick& tick);
+CommandStats commandStats();
+std::string commandStatsJson(const CommandStats& stats);
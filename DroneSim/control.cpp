@@ -0,0 +1,119 @@
+#include "control.h"
+#include "metrics.h"
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+static const float DEG2RAD = 0.01745329f;
+
+static std::mutex control_mtx;
+static ControlSetpoint latest;
+static bool sessionOpen = false;
+static bool sequenced = false;		// latest came from the client
+static unsigned int sessions = 0;
+static uint32_t lastApplied = 0;
+static MetricCounter& droppedMetric = metricCounter("control.dropped");
+static ControlStats stats;
+
+bool decodeControlSetpoint(const unsigned char* data, ControlSetpoint& setpoint)
+{
+	ControlSetpointMsg msg;
+	memcpy(&msg, data, sizeof(msg));
+	bool ok = memcmp(msg.magic, "CTRL", 4) == 0 && msg.frame <= controlHeading
+		&& std::isfinite(msg.velocity[0]) && std::isfinite(msg.velocity[1]) && std::isfinite(msg.velocity[2])
+		&& std::isfinite(msg.yawRate);
+	if (!ok) {
+		std::lock_guard<std::mutex> lk(control_mtx);
+		stats.dropped++;
+		droppedMetric.add();
+		return false;
+	}
+	setpoint.velocity = Eigen::Vector3f(msg.velocity[0], msg.velocity[1], msg.velocity[2]);
+	setpoint.yawRate = msg.yawRate;
+	setpoint.frame = (ControlFrame)msg.frame;
+	setpoint.sequence = msg.sequence;
+	setpoint.received = std::chrono::steady_clock::now();
+	return true;
+}
+
+unsigned int beginControlSession()
+{
+	std::lock_guard<std::mutex> lk(control_mtx);
+	latest = ControlSetpoint();
+	latest.received = std::chrono::steady_clock::now();
+	lastApplied = 0;
+	sequenced = false;
+	sessionOpen = true;
+	stats = ControlStats();
+	stats.active = true;
+	return ++sessions;
+}
+
+void publishControlSetpoint(unsigned int session, const ControlSetpoint& setpoint)
+{
+	std::lock_guard<std::mutex> lk(control_mtx);
+	if (session != sessions || !sessionOpen) return;
+	stats.received++;
+	// sequence numbers are compared with wrap-around
+	if (sequenced && (int32_t)(setpoint.sequence - latest.sequence) <= 0) {
+		stats.dropped++;
+		droppedMetric.add();
+		return;
+	}
+	latest = setpoint;
+	sequenced = true;
+}
+
+void endControlSession(unsigned int session)
+{
+	std::lock_guard<std::mutex> lk(control_mtx);
+	if (session != sessions) return;
+	sessionOpen = false;
+	stats.active = false;
+}
+
+bool currentControlSetpoint(ControlSetpoint& setpoint)
+{
+	std::lock_guard<std::mutex> lk(control_mtx);
+	if (!sessionOpen) return false;
+	setpoint = latest;
+	float age = std::chrono::duration<float>(std::chrono::steady_clock::now() - latest.received).count();
+	if (age > controlTimeout) {
+		setpoint.velocity.setZero();
+		setpoint.yawRate = 0.0f;
+	}
+	return true;
+}
+
+void markControlApplied(const ControlSetpoint& setpoint)
+{
+	std::lock_guard<std::mutex> lk(control_mtx);
+	if (setpoint.sequence == 0 || setpoint.sequence == lastApplied) return;
+	lastApplied = setpoint.sequence;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setpoint.received).count();
+	stats.applied++;
+	stats.lastLatencyMs = ms;
+	stats.meanLatencyMs += (ms - stats.meanLatencyMs) / stats.applied;
+}
+
+ControlStats controlStats()
+{
+	std::lock_guard<std::mutex> lk(control_mtx);
+	return stats;
+}
+
+Eigen::Vector3f controlWorldVelocity(const ControlSetpoint& setpoint, float yaw)
+{
+	if (setpoint.frame == controlWorld) return setpoint.velocity;
+	// yaw 0 looks along +y; the right vector is (cos, sin) of the yaw
+	float c = std::cos(yaw * DEG2RAD), s = std::sin(yaw * DEG2RAD);
+	const Eigen::Vector3f& v = setpoint.velocity;
+	return Eigen::Vector3f(c * v.x() - s * v.y(), s * v.x() + c * v.y(), v.z());
+}
+
+void integrateControl(const ControlSetpoint& setpoint, float dt, Eigen::Vector3f& position, float& yaw)
+{
+	position += controlWorldVelocity(setpoint, yaw) * dt;
+	yaw += setpoint.yawRate * dt;
+	yaw = std::fmod(yaw + 540.0f, 360.0f) - 180.0f;
+}
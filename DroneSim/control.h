@@ -0,0 +1,66 @@
+#pragma once
+#include <Eigen/Core>
+#include <chrono>
+#include <cstdint>
+
+// Continuous velocity / yaw-rate control. A client opens a persistent
+// connection with the text command CONTROL and then streams fixed-size
+// ControlSetpointMsg structs; the newest sequence number wins and older or
+// repeated ones are dropped. The script thread applies the current setpoint
+// every tick, scaled by that tick's time delta.
+#pragma pack(push, 1)
+struct ControlSetpointMsg {
+	char magic[4];		// "CTRL"
+	uint32_t sequence;
+	float velocity[3];	// m/s
+	float yawRate;		// deg/s, positive turns left (counter-clockwise seen from above)
+	uint8_t frame;		// ControlFrame
+	uint8_t reserved[3];
+};
+#pragma pack(pop)
+
+enum ControlFrame : uint8_t {
+	controlWorld = 0,	// velocity in world axes
+	controlHeading = 1,	// x right, y forward along the current yaw, z up
+};
+
+struct ControlSetpoint {
+	Eigen::Vector3f velocity = Eigen::Vector3f::Zero();
+	float yawRate = 0.0f;
+	ControlFrame frame = controlWorld;
+	uint32_t sequence = 0;
+	std::chrono::steady_clock::time_point received;
+};
+
+// Setpoints older than this are treated as zero velocity, so a stalled
+// client cannot leave the camera drifting.
+const float controlTimeout = 0.5f;
+
+// Server side. Only the most recently opened session drives the camera;
+// setpoints from a superseded session are ignored.
+bool decodeControlSetpoint(const unsigned char* data, ControlSetpoint& setpoint);
+unsigned int beginControlSession();
+void publishControlSetpoint(unsigned int session, const ControlSetpoint& setpoint);
+void endControlSession(unsigned int session);
+
+// Script side. False when no control session is open; a timed-out setpoint
+// comes back with zero velocity and yaw rate.
+bool currentControlSetpoint(ControlSetpoint& setpoint);
+// Records that the setpoint with this sequence reached the camera.
+void markControlApplied(const ControlSetpoint& setpoint);
+
+struct ControlStats {
+	bool active = false;
+	uint64_t received = 0;
+	uint64_t dropped = 0;		// malformed or out of order
+	uint64_t applied = 0;		// distinct setpoints that reached the camera
+	double lastLatencyMs = 0.0;	// receive -> first tick that applied it
+	double meanLatencyMs = 0.0;
+};
+ControlStats controlStats();
+
+// Kinematic camera update for one tick: moves the position by the setpoint
+// velocity and turns the yaw (degrees) by the yaw rate.
+void integrateControl(const ControlSetpoint& setpoint, float dt, Eigen::Vector3f& position, float& yaw);
+// World-frame velocity of the setpoint at the given yaw (degrees).
+Eigen::Vector3f controlWorldVelocity(const ControlSetpoint& setpoint, float yaw);
@@ -0,0 +1,471 @@
+#include "dataset.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+static const char fileMagic[8] = { 'D', 'S', 'I', 'M', 'S', 'E', 'Q', 0 };
+static const char indexMagic[8] = { 'D', 'S', 'I', 'M', 'I', 'D', 'X', 0 };
+static const char endMagic[8] = { 'D', 'S', 'I', 'M', 'E', 'N', 'D', 0 };
+static const uint32_t datasetVersion = 1;
+static const size_t headerSize = 64;
+static const size_t alignment = 64;
+static const size_t trailerSize = 16;
+// Shorter runs cost more as a token than as literals.
+static const size_t minRun = 12;
+
+static size_t padding(uint64_t offset)
+{
+	return (size_t)((alignment - offset % alignment) % alignment);
+}
+
+static bool sameTag(const char* a, const char* b)
+{
+	return memcmp(a, b, 4) == 0;
+}
+
+template<typename T>
+static void appendPod(std::vector<unsigned char>& out, const T* data, size_t count)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	out.insert(out.end(), p, p + sizeof(T) * count);
+}
+
+void encodeDatasetRle(const unsigned char* data, size_t bytes, int elemSize, std::vector<unsigned char>& out)
+{
+	// byte planes, each delta coded
+	const size_t planeSize = bytes / elemSize;
+	std::vector<unsigned char> planes(bytes);
+	for (int p = 0; p < elemSize; ++p) {
+		unsigned char prev = 0;
+		unsigned char* dst = &planes[p * planeSize];
+		for (size_t i = 0; i < planeSize; ++i) {
+			unsigned char v = data[i * elemSize + p];
+			dst[i] = (unsigned char)(v - prev);
+			prev = v;
+		}
+	}
+
+	std::vector<uint32_t> literalLength, runLength;
+	std::vector<unsigned char> runValue, literals;
+	size_t literalStart = 0;
+	size_t i = 0;
+	while (i < bytes) {
+		size_t j = i + 1;
+		while (j < bytes && planes[j] == planes[i]) ++j;
+		if (j - i >= minRun) {
+			literalLength.push_back((uint32_t)(i - literalStart));
+			runLength.push_back((uint32_t)(j - i));
+			runValue.push_back(planes[i]);
+			literals.insert(literals.end(), planes.begin() + literalStart, planes.begin() + i);
+			literalStart = j;
+		}
+		i = j;
+	}
+	if (literalStart < bytes || literalLength.empty()) {
+		literalLength.push_back((uint32_t)(bytes - literalStart));
+		runLength.push_back(0);
+		runValue.push_back(0);
+		literals.insert(literals.end(), planes.begin() + literalStart, planes.end());
+	}
+
+	uint32_t counts[2] = { (uint32_t)literalLength.size(), (uint32_t)literals.size() };
+	out.clear();
+	out.reserve(8 + 9 * literalLength.size() + 3 + literals.size());
+	appendPod(out, counts, 2);
+	appendPod(out, literalLength.data(), literalLength.size());
+	appendPod(out, runLength.data(), runLength.size());
+	appendPod(out, runValue.data(), runValue.size());
+	out.resize((out.size() + 3) & ~(size_t)3, 0);
+	out.insert(out.end(), literals.begin(), literals.end());
+}
+
+bool decodeDatasetRle(const unsigned char* data, size_t bytes, int elemSize, unsigned char* out, size_t rawSize)
+{
+	if (bytes < 8 || elemSize <= 0 || rawSize % elemSize != 0) return false;
+	uint32_t counts[2];
+	memcpy(counts, data, sizeof(counts));
+	const uint64_t tokens = counts[0];
+	const uint64_t tables = (8 + 9 * tokens + 3) & ~(uint64_t)3;
+	if (tables + counts[1] > bytes) return false;
+	const unsigned char* literalLength = data + 8;
+	const unsigned char* runLength = literalLength + 4 * tokens;
+	const unsigned char* runValue = runLength + 4 * tokens;
+	const unsigned char* literals = data + tables;
+	const unsigned char* literalsEnd = literals + counts[1];
+
+	std::vector<unsigned char> planes(rawSize);
+	size_t at = 0;
+	for (uint64_t t = 0; t < tokens; ++t) {
+		uint32_t lit, run;
+		memcpy(&lit, literalLength + 4 * t, 4);
+		memcpy(&run, runLength + 4 * t, 4);
+		if (lit > rawSize - at || lit > (size_t)(literalsEnd - literals)) return false;
+		memcpy(&planes[at], literals, lit);
+		literals += lit;
+		at += lit;
+		if (run > rawSize - at) return false;
+		memset(&planes[at], runValue[t], run);
+		at += run;
+	}
+	if (at != rawSize) return false;
+
+	const size_t planeSize = rawSize / elemSize;
+	for (int p = 0; p < elemSize; ++p) {
+		unsigned char v = 0;
+		const unsigned char* src = &planes[p * planeSize];
+		for (size_t i = 0; i < planeSize; ++i) {
+			v = (unsigned char)(v + src[i]);
+			out[i * elemSize + p] = v;
+		}
+	}
+	return true;
+}
+
+DatasetWriter::~DatasetWriter()
+{
+	std::string ignored;
+	close(ignored);
+}
+
+bool DatasetWriter::open(const std::string& path, bool append, std::string& error)
+{
+	std::string ignored;
+	close(ignored);
+	frames_.clear();
+	chunks_.clear();
+	offset_ = 0;
+
+	std::error_code ec;
+	if (append && std::filesystem::exists(path, ec)) {
+		{
+			DatasetReader existing;
+			if (!existing.open(path, error)) return false;
+			frames_ = existing.frames();
+			chunks_ = existing.chunks();
+			offset_ = existing.dataEnd();
+		}
+		// drop the old index (or a torn last frame); it is rewritten on close
+		std::filesystem::resize_file(path, offset_, ec);
+		if (ec) {
+			error = "cannot truncate " + path + ": " + ec.message();
+			return false;
+		}
+		file_ = fopen(path.c_str(), "ab");
+	}
+	else {
+		file_ = fopen(path.c_str(), "wb");
+	}
+	if (file_ == nullptr) {
+		error = "cannot open " + path + " for writing";
+		return false;
+	}
+	setvbuf(file_, nullptr, _IOFBF, bufferSize_);
+	path_ = path;
+
+	if (offset_ == 0) {
+		unsigned char header[headerSize] = {};
+		memcpy(header, fileMagic, 8);
+		memcpy(header + 8, &datasetVersion, 4);
+		uint32_t size = headerSize;
+		memcpy(header + 12, &size, 4);
+		if (!write(header, headerSize, error)) return false;
+	}
+	return true;
+}
+
+void DatasetWriter::reserve(uint64_t bytes)
+{
+#ifdef __linux__
+	if (file_ != nullptr) fallocate(fileno(file_), FALLOC_FL_KEEP_SIZE, (off_t)offset_, (off_t)bytes);
+#else
+	(void)bytes;
+#endif
+}
+
+bool DatasetWriter::write(const void* data, size_t bytes, std::string& error)
+{
+	if (bytes > 0 && fwrite(data, 1, bytes, file_) != bytes) {
+		error = "write to " + path_ + " failed";
+		return false;
+	}
+	offset_ += bytes;
+	return true;
+}
+
+bool DatasetWriter::writeChunk(const char* tag, const CapturedFrame& frame, int width, int height, uint16_t elemSize,
+	const void* data, size_t bytes, DatasetCodec codec, std::string& error)
+{
+	const void* payload = data;
+	size_t stored = bytes;
+	if (codec == datasetRle && bytes > 0 && bytes % elemSize == 0) {
+		encodeDatasetRle((const unsigned char*)data, bytes, elemSize, scratch_);
+		if (scratch_.size() < bytes) {
+			payload = scratch_.data();
+			stored = scratch_.size();
+		}
+		else {
+			codec = datasetRaw;
+		}
+	}
+
+	DatasetChunkHeader header = {};
+	memcpy(header.magic, "DSCH", 4);
+	memcpy(header.tag, tag, 4);
+	header.frame = (uint32_t)frames_.size();
+	header.frameId = frame.id;
+	header.timestamp = frame.timestamp;
+	header.codec = codec;
+	header.elemSize = elemSize;
+	header.width = width;
+	header.height = height;
+	header.rawSize = bytes;
+	header.storedSize = stored;
+
+	DatasetChunkEntry entry = {};
+	memcpy(entry.tag, tag, 4);
+	entry.codec = codec;
+	entry.elemSize = elemSize;
+	entry.width = width;
+	entry.height = height;
+	entry.offset = offset_ + sizeof(header);
+	entry.storedSize = stored;
+	entry.rawSize = bytes;
+
+	static const unsigned char zeros[alignment] = {};
+	if (!write(&header, sizeof(header), error) || !write(payload, stored, error)
+		|| !write(zeros, padding(offset_), error)) return false;
+	chunks_.push_back(entry);
+	return true;
+}
+
+bool DatasetWriter::append(const CapturedFrame& f, std::string& error)
+{
+	if (file_ == nullptr) {
+		error = "dataset is not open";
+		return false;
+	}
+	DatasetFrameEntry entry = {};
+	entry.firstChunk = (uint32_t)chunks_.size();
+	entry.frameId = f.id;
+	entry.timestamp = f.timestamp;
+	std::string meta = frameMetaJson(f);
+	bool ok = writeChunk("META", f, 0, 0, 1, meta.data(), meta.size(), datasetRaw, error)
+		&& writeChunk("RGBA", f, f.colorWidth, f.colorHeight, 4, f.color.data(), f.color.size(), codec_, error)
+		&& writeChunk("DPTH", f, f.width, f.height, sizeof(float), f.depth.data(), f.depth.size() * sizeof(float), codec_, error)
+		&& writeChunk("STCL", f, f.width, f.height, 1, f.stencil.data(), f.stencil.size(), codec_, error)
+		&& writeChunk("MATX", f, 4, 16, sizeof(float), &f.matrices, sizeof(rage_matrices), datasetRaw, error);
+	if (!ok) return false;
+	entry.chunkCount = (uint32_t)chunks_.size() - entry.firstChunk;
+	frames_.push_back(entry);
+	return true;
+}
+
+bool DatasetWriter::close(std::string& error)
+{
+	if (file_ == nullptr) return true;
+	uint64_t indexOffset = offset_;
+	uint32_t counts[2] = { (uint32_t)frames_.size(), (uint32_t)chunks_.size() };
+	bool ok = write(indexMagic, 8, error) && write(counts, sizeof(counts), error)
+		&& write(frames_.data(), frames_.size() * sizeof(DatasetFrameEntry), error)
+		&& write(chunks_.data(), chunks_.size() * sizeof(DatasetChunkEntry), error)
+		&& write(&indexOffset, 8, error) && write(endMagic, 8, error);
+	if (fclose(file_) != 0 && ok) {
+		error = "closing " + path_ + " failed";
+		ok = false;
+	}
+	file_ = nullptr;
+	offset_ = indexOffset;
+	return ok;
+}
+
+bool DatasetReader::open(const std::string& path, std::string& error)
+{
+	namespace bip = boost::interprocess;
+	frames_.clear();
+	chunks_.clear();
+	recovered_ = false;
+	try {
+		bip::file_mapping file(path.c_str(), bip::read_only);
+		bip::mapped_region region(file, bip::read_only);
+		file_.swap(file);
+		region_.swap(region);
+	}
+	catch (const bip::interprocess_exception& e) {
+		error = "cannot map " + path + ": " + e.what();
+		return false;
+	}
+	data_ = static_cast<const unsigned char*>(region_.get_address());
+	size_ = region_.get_size();
+	if (size_ < headerSize || memcmp(data_, fileMagic, 8) != 0) {
+		error = path + " is not a DroneSim dataset";
+		return false;
+	}
+	uint32_t version;
+	memcpy(&version, data_ + 8, 4);
+	if (version != datasetVersion) {
+		error = path + ": unsupported dataset version " + std::to_string(version);
+		return false;
+	}
+	if (loadIndex(error)) return true;
+	// a rejected index may have filled the tables already
+	frames_.clear();
+	chunks_.clear();
+	recovered_ = true;
+	return scanChunks(error);
+}
+
+bool DatasetReader::loadIndex(std::string& error)
+{
+	if (size_ < headerSize + trailerSize || memcmp(data_ + size_ - 8, endMagic, 8) != 0) {
+		error = "no index";
+		return false;
+	}
+	uint64_t indexOffset;
+	memcpy(&indexOffset, data_ + size_ - trailerSize, 8);
+	if (indexOffset < headerSize || indexOffset + 16 > size_ - trailerSize
+		|| memcmp(data_ + indexOffset, indexMagic, 8) != 0) {
+		error = "bad index offset";
+		return false;
+	}
+	uint32_t counts[2];
+	memcpy(counts, data_ + indexOffset + 8, sizeof(counts));
+	const uint64_t tables = (uint64_t)counts[0] * sizeof(DatasetFrameEntry) + (uint64_t)counts[1] * sizeof(DatasetChunkEntry);
+	if (indexOffset + 16 + tables != size_ - trailerSize) {
+		error = "index size mismatch";
+		return false;
+	}
+	frames_.resize(counts[0]);
+	chunks_.resize(counts[1]);
+	const unsigned char* p = data_ + indexOffset + 16;
+	if (counts[0]) memcpy(frames_.data(), p, frames_.size() * sizeof(DatasetFrameEntry));
+	p += frames_.size() * sizeof(DatasetFrameEntry);
+	if (counts[1]) memcpy(chunks_.data(), p, chunks_.size() * sizeof(DatasetChunkEntry));
+	for (const auto& f : frames_) {
+		if ((uint64_t)f.firstChunk + f.chunkCount > chunks_.size()) {
+			error = "frame table out of range";
+			return false;
+		}
+	}
+	for (const auto& c : chunks_) {
+		if (c.offset + c.storedSize > indexOffset) {
+			error = "chunk table out of range";
+			return false;
+		}
+		// raw payloads are used in place for rawSize bytes
+		if (c.codec == datasetRaw && c.rawSize != c.storedSize) {
+			error = "raw chunk size mismatch";
+			return false;
+		}
+	}
+	dataEnd_ = indexOffset;
+	return true;
+}
+
+bool DatasetReader::scanChunks(std::string& error)
+{
+	// Keeps whole frames only: a frame is complete when its MATX chunk, the
+	// last one written, is intact.
+	uint64_t at = headerSize;
+	dataEnd_ = headerSize;
+	std::vector<DatasetChunkEntry> pending;
+	DatasetFrameEntry frame = {};
+	while (at + sizeof(DatasetChunkHeader) <= size_) {
+		DatasetChunkHeader h;
+		memcpy(&h, data_ + at, sizeof(h));
+		if (!sameTag(h.magic, "DSCH") || h.frame != frames_.size()) break;
+		uint64_t payload = at + sizeof(h);
+		if (h.storedSize > size_ - payload) break;
+		if (h.codec == datasetRaw && h.rawSize != h.storedSize) break;
+		if (pending.empty()) {
+			frame.firstChunk = (uint32_t)chunks_.size();
+			frame.frameId = h.frameId;
+			frame.timestamp = h.timestamp;
+		}
+		DatasetChunkEntry entry = {};
+		memcpy(entry.tag, h.tag, 4);
+		entry.codec = h.codec;
+		entry.elemSize = h.elemSize;
+		entry.width = h.width;
+		entry.height = h.height;
+		entry.offset = payload;
+		entry.storedSize = h.storedSize;
+		entry.rawSize = h.rawSize;
+		pending.push_back(entry);
+		at = payload + h.storedSize;
+		at += padding(at);
+		if (sameTag(h.tag, "MATX")) {
+			frame.chunkCount = (uint32_t)pending.size();
+			chunks_.insert(chunks_.end(), pending.begin(), pending.end());
+			frames_.push_back(frame);
+			pending.clear();
+			dataEnd_ = std::min<uint64_t>(at, size_);
+		}
+	}
+	error.clear();
+	return true;
+}
+
+bool DatasetReader::channel(size_t frame, const char* tag, DatasetChannel& out, std::string& error) const
+{
+	if (frame >= frames_.size()) {
+		error = "frame " + std::to_string(frame) + " out of range";
+		return false;
+	}
+	const DatasetFrameEntry& f = frames_[frame];
+	for (uint32_t i = f.firstChunk; i < f.firstChunk + f.chunkCount; ++i) {
+		const DatasetChunkEntry& c = chunks_[i];
+		if (!sameTag(c.tag, tag)) continue;
+		out.width = c.width;
+		out.height = c.height;
+		out.elemSize = c.elemSize;
+		out.size = (size_t)c.rawSize;
+		if (c.codec == datasetRaw) {
+			out.data = data_ + c.offset;
+			return true;
+		}
+		if (c.codec != datasetRle) {
+			error = "unknown codec " + std::to_string(c.codec);
+			return false;
+		}
+		out.decoded.resize(out.size);
+		if (!decodeDatasetRle(data_ + c.offset, (size_t)c.storedSize, c.elemSize, out.decoded.data(), out.size)) {
+			error = std::string(tag, 4) + " chunk of frame " + std::to_string(frame) + " is corrupt";
+			return false;
+		}
+		out.data = out.decoded.data();
+		return true;
+	}
+	error = "frame " + std::to_string(frame) + " has no " + std::string(tag, 4) + " channel";
+	return false;
+}
+
+bool DatasetReader::readFrame(size_t frame, CapturedFrame& out, std::string& error) const
+{
+	DatasetChannel meta, color, depth, stencil, matrices;
+	if (!channel(frame, "META", meta, error) || !channel(frame, "RGBA", color, error)
+		|| !channel(frame, "DPTH", depth, error) || !channel(frame, "STCL", stencil, error)
+		|| !channel(frame, "MATX", matrices, error)) return false;
+	if (matrices.size != sizeof(rage_matrices)) {
+		error = "MATX chunk of frame " + std::to_string(frame) + " has the wrong size";
+		return false;
+	}
+	out.id = frames_[frame].frameId;
+	out.timestamp = frames_[frame].timestamp;
+	std::string json((const char*)meta.data, meta.size);
+	out.metadata = json.size() >= 2 ? json.substr(1, json.size() - 2) : std::string();
+	out.colorWidth = color.width;
+	out.colorHeight = color.height;
+	out.color.assign(color.data, color.data + color.size);
+	out.width = depth.width;
+	out.height = depth.height;
+	out.depth.resize(depth.size / sizeof(float));
+	if (depth.size) memcpy(out.depth.data(), depth.data, depth.size);
+	out.stencil.assign(stencil.data, stencil.data + stencil.size);
+	out.matrices = matricesFromFloats((const float*)matrices.data);
+	out.P = projectionFromMatrices(out.matrices);
+	out.V = viewFromMatrices(out.matrices);
+	return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "frame.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Append-only container for captured sequences (.dsq): one file holding
+// every channel of every frame, with an index at the end for O(1) access to
+// any frame's channels.
+//
+//	header    64 bytes: "DSIMSEQ\0", u32 version, u32 header size
+//	chunks    per frame META, RGBA, DPTH, STCL, MATX; each a 64-byte chunk
+//	          header then the payload, padded so every payload starts on a
+//	          64-byte boundary and raw payloads can be used in place from a
+//	          memory mapping
+//	index     "DSIMIDX\0", u32 frames, u32 chunks, frame and chunk tables
+//	trailer   u64 index offset, "DSIMEND\0"
+//
+// All fields are little endian. A file whose writer died before writing the
+// index is still readable: the chunk headers are scanned instead.
+//
+// Compressed (rle) payloads are split into elemSize byte planes, each plane
+// delta coded byte by byte, then run-length coded as
+//	u32 tokens, u32 literal bytes, u32 literalLength[tokens],
+//	u32 runLength[tokens], u8 runValue[tokens], zero padding to 4 bytes,
+//	the literal bytes
+// where each token is literalLength literal bytes then runLength copies of
+// runValue.
+enum DatasetCodec : uint16_t {
+	datasetRaw = 0,
+	datasetRle = 1,
+};
+
+#pragma pack(push, 1)
+struct DatasetChunkHeader {
+	char magic[4];		// "DSCH"
+	char tag[4];		// META, RGBA, DPTH, STCL or MATX
+	uint32_t frame;		// position of the frame in the file
+	uint32_t frameId;	// CapturedFrame::id
+	int64_t timestamp;
+	uint16_t codec;
+	uint16_t elemSize;	// bytes per element, the rle plane count
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved0;
+	uint64_t rawSize;
+	uint64_t storedSize;
+	uint8_t reserved[8];
+};
+
+struct DatasetFrameEntry {
+	uint32_t firstChunk;
+	uint32_t chunkCount;
+	uint32_t frameId;
+	uint32_t reserved;
+	int64_t timestamp;
+};
+
+struct DatasetChunkEntry {
+	char tag[4];
+	uint16_t codec;
+	uint16_t elemSize;
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;	// of the payload
+	uint64_t storedSize;
+	uint64_t rawSize;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(DatasetChunkHeader) == 64, "chunk header is 64 bytes");
+
+class DatasetWriter {
+public:
+	~DatasetWriter();
+	// Creates the file, or with append continues an existing dataset (one
+	// left without an index is recovered first).
+	bool open(const std::string& path, bool append, std::string& error);
+	// Codec for RGBA, DPTH and STCL; META and MATX are always raw. A chunk
+	// that would not shrink is stored raw.
+	void setCodec(DatasetCodec codec) { codec_ = codec; }
+	// stdio buffer for the next open; larger buffers mean fewer, larger writes
+	void setBufferSize(size_t bytes) { bufferSize_ = bytes; }
+	// Allocates disk space for the next bytes ahead of the writes without
+	// growing the file, so long recordings do not fragment. Linux only; a
+	// no-op elsewhere.
+	void reserve(uint64_t bytes);
+	bool append(const CapturedFrame& frame, std::string& error);
+	// Writes the index and trailer; the file can be reopened for appending.
+	bool close(std::string& error);
+	bool isOpen() const { return file_ != nullptr; }
+	size_t frameCount() const { return frames_.size(); }
+	uint64_t bytesWritten() const { return offset_; }
+
+private:
+	bool writeChunk(const char* tag, const CapturedFrame& frame, int width, int height, uint16_t elemSize,
+		const void* data, size_t bytes, DatasetCodec codec, std::string& error);
+	bool write(const void* data, size_t bytes, std::string& error);
+
+	FILE* file_ = nullptr;
+	std::string path_;
+	DatasetCodec codec_ = datasetRaw;
+	size_t bufferSize_ = 1 << 20;
+	uint64_t offset_ = 0;
+	std::vector<DatasetFrameEntry> frames_;
+	std::vector<DatasetChunkEntry> chunks_;
+	std::vector<unsigned char> scratch_;
+};
+
+// One channel of a frame. data points into the reader's mapping for raw
+// chunks and into decoded for compressed ones; both stay valid while the
+// reader is open and the channel is not reused.
+struct DatasetChannel {
+	int width = 0;
+	int height = 0;
+	int elemSize = 1;
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	std::vector<unsigned char> decoded;
+};
+
+class DatasetReader {
+public:
+	bool open(const std::string& path, std::string& error);
+	size_t frameCount() const { return frames_.size(); }
+	const DatasetFrameEntry& frame(size_t i) const { return frames_[i]; }
+	// True when the file had no index and the chunks were scanned.
+	bool recovered() const { return recovered_; }
+	bool channel(size_t frame, const char* tag, DatasetChannel& out, std::string& error) const;
+	// Rebuilds a CapturedFrame: id, timestamp, buffers, matrices, P and V.
+	// metadata is set to the members of the stored META object.
+	bool readFrame(size_t frame, CapturedFrame& out, std::string& error) const;
+	// Where the index starts, or the end of the last whole frame when
+	// recovered: appending continues from here.
+	uint64_t dataEnd() const { return dataEnd_; }
+	const std::vector<DatasetChunkEntry>& chunks() const { return chunks_; }
+	const std::vector<DatasetFrameEntry>& frames() const { return frames_; }
+
+private:
+	bool loadIndex(std::string& error);
+	bool scanChunks(std::string& error);
+
+	boost::interprocess::file_mapping file_;
+	boost::interprocess::mapped_region region_;
+	const unsigned char* data_ = nullptr;
+	size_t size_ = 0;
+	bool recovered_ = false;
+	uint64_t dataEnd_ = 0;
+	std::vector<DatasetFrameEntry> frames_;
+	std::vector<DatasetChunkEntry> chunks_;
+};
+
+// The rle codec on its own, for elemSize byte planes.
+void encodeDatasetRle(const unsigned char* data, size_t bytes, int elemSize, std::vector<unsigned char>& out);
+bool decodeDatasetRle(const unsigned char* data, size_t bytes, int elemSize, unsigned char* out, size_t rawSize);
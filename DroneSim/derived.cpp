@@ -0,0 +1,144 @@
+#include "derived.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DERIVED_USE_SSE2 1
+#endif
+
+using Eigen::Matrix4f;
+using Eigen::Vector4f;
+using std::vector;
+
+static void unprojectRow(const Matrix4f& Pinv, const float* depth, int width, float ny, float sx,
+	float* ox, float* oy, float* oz)
+{
+	const Vector4f base = Pinv.col(1) * ny + Pinv.col(3);
+	const Vector4f c0 = Pinv.col(0);
+	const Vector4f c2 = Pinv.col(2);
+	int i = 0;
+#ifdef DERIVED_USE_SSE2
+	const __m128 bx = _mm_set1_ps(base.x()), by = _mm_set1_ps(base.y()), bz = _mm_set1_ps(base.z()), bw = _mm_set1_ps(base.w());
+	const __m128 ax = _mm_set1_ps(c0.x()), ay = _mm_set1_ps(c0.y()), az = _mm_set1_ps(c0.z()), aw = _mm_set1_ps(c0.w());
+	const __m128 dx = _mm_set1_ps(c2.x()), dy = _mm_set1_ps(c2.y()), dz = _mm_set1_ps(c2.z()), dw = _mm_set1_ps(c2.w());
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 step = _mm_set1_ps(4.0f * sx);
+	__m128 nx = _mm_sub_ps(_mm_mul_ps(_mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f), _mm_set1_ps(sx)), one);
+	for (; i + 4 <= width; i += 4) {
+		__m128 d = _mm_loadu_ps(depth + i);
+		__m128 valid = _mm_cmpgt_ps(d, zero);
+		__m128 vx = _mm_add_ps(_mm_add_ps(bx, _mm_mul_ps(ax, nx)), _mm_mul_ps(dx, d));
+		__m128 vy = _mm_add_ps(_mm_add_ps(by, _mm_mul_ps(ay, nx)), _mm_mul_ps(dy, d));
+		__m128 vz = _mm_add_ps(_mm_add_ps(bz, _mm_mul_ps(az, nx)), _mm_mul_ps(dz, d));
+		__m128 vw = _mm_add_ps(_mm_add_ps(bw, _mm_mul_ps(aw, nx)), _mm_mul_ps(dw, d));
+		// sky pixels give w == 0; blend them to zero instead of dividing
+		__m128 inv = _mm_and_ps(valid, _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, vw), _mm_andnot_ps(valid, one))));
+		_mm_storeu_ps(ox + i, _mm_mul_ps(vx, inv));
+		_mm_storeu_ps(oy + i, _mm_mul_ps(vy, inv));
+		_mm_storeu_ps(oz + i, _mm_mul_ps(vz, inv));
+		nx = _mm_add_ps(nx, step);
+	}
+#endif
+	for (; i < width; ++i) {
+		float d = depth[i];
+		if (!(d > 0.0f)) {
+			ox[i] = oy[i] = oz[i] = 0.0f;
+			continue;
+		}
+		float nx = (i + 0.5f) * sx - 1.0f;
+		Vector4f v = base + c0 * nx + c2 * d;
+		ox[i] = v.x() / v.w();
+		oy[i] = v.y() / v.w();
+		oz[i] = v.z() / v.w();
+	}
+}
+
+void unprojectDepth(const CapturedFrame& frame, PositionPlanes& out)
+{
+	const int w = frame.width, h = frame.height;
+	const size_t n = (size_t)w * h;
+	out.width = w;
+	out.height = h;
+	out.x.resize(n);
+	out.y.resize(n);
+	out.z.resize(n);
+	if (frame.depth.size() != n) return;
+	const Matrix4f Pinv = frame.P.inverse();
+	const float sx = 2.0f / w, sy = 2.0f / h;
+	parallelFor(0, h, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			size_t row = (size_t)y * w;
+			unprojectRow(Pinv, &frame.depth[row], w, 1.0f - (y + 0.5f) * sy, sx,
+				&out.x[row], &out.y[row], &out.z[row]);
+		}
+	});
+}
+
+void computeNormals(const PositionPlanes& pos, vector<float>& normals)
+{
+	const int w = pos.width, h = pos.height;
+	normals.assign((size_t)w * h * 3, 0.0f);
+	const float* X = pos.x.data();
+	const float* Y = pos.y.data();
+	const float* Z = pos.z.data();
+	parallelFor(0, h, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			for (int x = 0; x < w; ++x) {
+				size_t i = (size_t)y * w + x;
+				if (Z[i] == 0.0f) continue;
+				// one-sided differences towards the neighbour with the smaller
+				// depth step, so normals do not bleed across occlusion edges
+				size_t l = x > 0 ? i - 1 : i, r = x + 1 < w ? i + 1 : i;
+				size_t u = y > 0 ? i - w : i, d = y + 1 < h ? i + w : i;
+				if (Z[l] == 0.0f) l = i;
+				if (Z[r] == 0.0f) r = i;
+				if (Z[u] == 0.0f) u = i;
+				if (Z[d] == 0.0f) d = i;
+				bool useRight = r != i && (l == i || std::fabs(Z[r] - Z[i]) < std::fabs(Z[i] - Z[l]));
+				bool useDown = d != i && (u == i || std::fabs(Z[d] - Z[i]) < std::fabs(Z[i] - Z[u]));
+				size_t a0 = useRight ? i : l, a1 = useRight ? r : i;
+				size_t b0 = useDown ? i : u, b1 = useDown ? d : i;
+				if (a0 == a1 || b0 == b1) continue;
+				float ax = X[a1] - X[a0], ay = Y[a1] - Y[a0], az = Z[a1] - Z[a0];
+				float bx = X[b1] - X[b0], by = Y[b1] - Y[b0], bz = Z[b1] - Z[b0];
+				float nx = ay * bz - az * by;
+				float ny = az * bx - ax * bz;
+				float nz = ax * by - ay * bx;
+				float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+				if (len == 0.0f) continue;
+				if (nx * X[i] + ny * Y[i] + nz * Z[i] > 0.0f) len = -len;
+				normals[i * 3 + 0] = nx / len;
+				normals[i * 3 + 1] = ny / len;
+				normals[i * 3 + 2] = nz / len;
+			}
+		}
+	});
+}
+
+void computeDepthEdges(const PositionPlanes& pos, vector<unsigned char>& edges, float relThreshold)
+{
+	const int w = pos.width, h = pos.height;
+	edges.assign((size_t)w * h, 0);
+	const float* Z = pos.z.data();
+	parallelFor(0, h, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			const float* row = Z + (size_t)y * w;
+			const float* up = y > 0 ? row - w : row;
+			const float* down = y + 1 < h ? row + w : row;
+			unsigned char* out = &edges[(size_t)y * w];
+			for (int x = 0; x < w; ++x) {
+				float z = -row[x];
+				if (!(z > 0.0f)) continue;
+				float n[4] = { -row[x > 0 ? x - 1 : x], -row[x + 1 < w ? x + 1 : x], -up[x], -down[x] };
+				unsigned char edge = 0;
+				for (float zn : n) {
+					float nearer = std::min(z, zn);
+					edge |= !(zn > 0.0f) || std::fabs(z - zn) > relThreshold * nearer;
+				}
+				out[x] = edge;
+			}
+		}
+	});
+}
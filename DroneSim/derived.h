@@ -0,0 +1,23 @@
+#pragma once
+#include "frame.h"
+#include <vector>
+
+// Channels derived from a captured depth buffer and its projection matrix.
+// Pixels cleared to the far plane (sky) have no position, a zero normal and
+// are never marked as edges themselves.
+
+// Camera-space position of every pixel as three planes (x, y, z).
+struct PositionPlanes {
+	int width = 0;
+	int height = 0;
+	std::vector<float> x, y, z;
+};
+
+void unprojectDepth(const CapturedFrame& frame, PositionPlanes& out);
+
+// Camera-space unit normals, interleaved xyz per pixel, facing the camera.
+void computeNormals(const PositionPlanes& pos, std::vector<float>& normals);
+
+// 1 where the linear depth jumps by more than relThreshold (relative to the
+// nearer side) to a 4-neighbour, or where geometry borders sky; 0 elsewhere.
+void computeDepthEdges(const PositionPlanes& pos, std::vector<unsigned char>& edges, float relThreshold = 0.05f);
@@ -0,0 +1,240 @@
+#include "environment.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+
+static const char* weatherTypes[] = {
+	"EXTRASUNNY", "CLEAR", "CLOUDS", "SMOG", "FOGGY", "OVERCAST", "RAIN", "THUNDER",
+	"CLEARING", "NEUTRAL", "SNOW", "BLIZZARD", "SNOWLIGHT", "XMAS", "HALLOWEEN"
+};
+
+static std::vector<std::string> splitList(const std::string& value)
+{
+	std::vector<std::string> items;
+	std::istringstream ss(value);
+	for (std::string item; std::getline(ss, item, ',');) items.push_back(item);
+	return items;
+}
+
+static bool parseClock(const std::string& text, int& hour, int& minute)
+{
+	char colon = 0, extra = 0;
+	minute = 0;
+	int n = sscanf(text.c_str(), "%d%c%d%c", &hour, &colon, &minute, &extra);
+	if (n != 1 && (n != 3 || colon != ':')) return false;
+	return hour >= 0 && hour < 24 && minute >= 0 && minute < 60;
+}
+
+bool parseEnvironmentCommand(const std::string& command, bool& enable, EnvironmentSweepConfig& cfg)
+{
+	std::istringstream ss(command);
+	std::string name, tok;
+	if (!(ss >> name) || name != "ENV_SWEEP") return false;
+	std::vector<std::string> weathers;
+	std::vector<std::pair<int, int>> times;
+	bool first = true;
+	while (ss >> tok) {
+		if (first && tok == "OFF") {
+			enable = false;
+			return !(ss >> tok);
+		}
+		first = false;
+		size_t eq = tok.find('=');
+		if (eq == std::string::npos) return false;
+		std::string key = tok.substr(0, eq), value = tok.substr(eq + 1);
+		if (key == "weather") {
+			weathers = splitList(value);
+			for (const auto& w : weathers) {
+				if (std::find(std::begin(weatherTypes), std::end(weatherTypes), w) == std::end(weatherTypes)) return false;
+			}
+		}
+		else if (key == "time") {
+			times.clear();
+			for (const auto& t : splitList(value)) {
+				int hour, minute;
+				if (!parseClock(t, hour, minute)) return false;
+				times.emplace_back(hour, minute);
+			}
+		}
+		else if (key == "settle" || key == "weather_settle") {
+			int v;
+			try {
+				v = std::stoi(value);
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+			if (v < 0) return false;
+			(key == "settle" ? cfg.settleFrames : cfg.weatherSettleFrames) = v;
+		}
+		else {
+			return false;
+		}
+	}
+	if (weathers.empty() && times.empty()) return false;
+	if (weathers.empty()) weathers.push_back("");
+	if (times.empty()) times.emplace_back(-1, 0);
+	// weather outermost: a weather change costs more settle frames than a
+	// clock change, so it should happen as rarely as possible
+	cfg.settings.clear();
+	for (const auto& w : weathers) {
+		for (const auto& t : times) {
+			EnvironmentSetting s;
+			s.weather = w;
+			s.hour = t.first;
+			s.minute = t.second;
+			cfg.settings.push_back(s);
+		}
+	}
+	enable = true;
+	return true;
+}
+
+std::string environmentMetadata(const EnvironmentSetting& s)
+{
+	std::string out;
+	if (!s.weather.empty()) out += "\"weather\":\"" + s.weather + "\"";
+	if (s.hour >= 0) {
+		char clock[8];
+		snprintf(clock, sizeof(clock), "%02d:%02d", s.hour, s.minute);
+		out += std::string(out.empty() ? "" : ",") + "\"clock\":\"" + clock + "\"";
+	}
+	return out;
+}
+
+void EnvironmentSweep::configure(const EnvironmentSweepConfig& cfg)
+{
+	cfg_ = cfg;
+	active_ = false;
+	applied_ = -1;
+	reverse_ = false;
+}
+
+void EnvironmentSweep::start(const std::string& poseMetadata, unsigned int poseRigId, unsigned int round, int frameCount)
+{
+	poseMetadata_ = poseMetadata;
+	poseRigId_ = poseRigId;
+	round_ = round;
+	index_ = 0;
+	// continue from whichever end of the list the world is already at
+	if (applied_ >= 0) reverse_ = applied_ != 0 && (size_t)applied_ + 1 == cfg_.settings.size();
+	frameMark_ = frameCount;
+	state_ = Next;
+	active_ = !cfg_.settings.empty();
+	started_ = std::chrono::steady_clock::now();
+}
+
+int EnvironmentSweep::current() const
+{
+	return (int)(reverse_ ? cfg_.settings.size() - 1 - index_ : index_);
+}
+
+EnvironmentSweep::Action EnvironmentSweep::tick(int frameCount, bool captureIdle, EnvironmentSetting& setting, std::string& metadata)
+{
+	if (!active_) return Idle;
+	switch (state_) {
+	case Wait:
+		if (!captureIdle) return Idle;
+		++index_;
+		state_ = Next;
+		// fall through
+	case Next: {
+		if (index_ >= cfg_.settings.size()) {
+			active_ = false;
+			finishEnvironmentRound(round_, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_).count());
+			return Finished;
+		}
+		int next = current();
+		state_ = Settle;
+		frameMark_ = frameCount;
+		if (next == applied_) {
+			settleFrames_ = 0;
+			return tick(frameCount, captureIdle, setting, metadata);
+		}
+		const EnvironmentSetting& from = applied_ >= 0 ? cfg_.settings[applied_] : EnvironmentSetting();
+		setting = cfg_.settings[next];
+		settleFrames_ = applied_ < 0 || from.weather != setting.weather ? cfg_.weatherSettleFrames : cfg_.settleFrames;
+		applied_ = next;
+		recordEnvironmentChange(settleFrames_);
+		return Apply;
+	}
+	case Settle: {
+		if (frameCount - frameMark_ < settleFrames_ || !captureIdle) return Idle;
+		const EnvironmentSetting& s = cfg_.settings[current()];
+		metadata = poseMetadata_ + (poseMetadata_.empty() ? "" : ",")
+			+ "\"env_round\":" + std::to_string(round_)
+			+ ",\"env_index\":" + std::to_string(current())
+			+ ",\"env_count\":" + std::to_string(cfg_.settings.size());
+		std::string env = environmentMetadata(s);
+		if (!env.empty()) metadata += "," + env;
+		state_ = Wait;
+		recordEnvironmentCapture();
+		return Capture;
+	}
+	}
+	return Idle;
+}
+
+static std::mutex environment_mtx;
+static EnvironmentStats stats;
+static unsigned int rounds = 0;
+static unsigned int finishedRound = 0;
+
+unsigned int nextEnvironmentRound()
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	return ++rounds;
+}
+
+void finishEnvironmentRound(unsigned int round, double milliseconds)
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	finishedRound = round;
+	stats.rounds++;
+	stats.lastRoundMs = milliseconds;
+	stats.meanRoundMs += (milliseconds - stats.meanRoundMs) / stats.rounds;
+}
+
+unsigned int lastFinishedEnvironmentRound()
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	return finishedRound;
+}
+
+void setEnvironmentSweepEnabled(bool enabled, size_t settings)
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	stats.enabled = enabled;
+	stats.settings = enabled ? settings : 0;
+}
+
+void recordEnvironmentChange(int settleFrames)
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	stats.changes++;
+	stats.settleFrames += settleFrames;
+}
+
+void recordEnvironmentCapture()
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	stats.captures++;
+}
+
+EnvironmentStats environmentStats()
+{
+	std::lock_guard<std::mutex> lk(environment_mtx);
+	return stats;
+}
+
+std::string environmentStatsJson(const EnvironmentStats& s)
+{
+	std::ostringstream ss;
+	ss << "{\"enabled\":" << (s.enabled ? "true" : "false") << ",\"settings\":" << s.settings
+		<< ",\"rounds\":" << s.rounds << ",\"captures\":" << s.captures << ",\"changes\":" << s.changes
+		<< ",\"settle_frames\":" << s.settleFrames << ",\"last_round_ms\":" << s.lastRoundMs
+		<< ",\"mean_round_ms\":" << s.meanRoundMs << "}";
+	return ss.str();
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+// One weather / time-of-day combination. An empty weather or a negative
+// hour leaves that part of the environment as it is.
+struct EnvironmentSetting {
+	std::string weather;
+	int hour = -1;
+	int minute = 0;
+};
+
+// Environment sweep: every capture taken while the sweep is on is repeated
+// once per setting at the same pose. Changing only the clock re-lights the
+// scene in a frame or two; a weather change also swaps particles, wet
+// surfaces and sky, so it waits longer.
+struct EnvironmentSweepConfig {
+	std::vector<EnvironmentSetting> settings;
+	int settleFrames = 2;			// rendered frames after a clock change
+	int weatherSettleFrames = 6;	// rendered frames after a weather change
+};
+
+// "ENV_SWEEP weather=CLEAR,RAIN,... [time=hh:mm,...] [settle=n] [weather_settle=n]"
+// sweeps every weather at every time; "ENV_SWEEP OFF" ends the sweep. The
+// script thread refuses sweeps of more than capturedFrameHistory settings.
+// Weather names are the game's weather types (EXTRASUNNY, CLEAR, CLOUDS,
+// SMOG, FOGGY, OVERCAST, RAIN, THUNDER, CLEARING, NEUTRAL, SNOW, BLIZZARD,
+// SNOWLIGHT, XMAS, HALLOWEEN).
+bool parseEnvironmentCommand(const std::string& command, bool& enable, EnvironmentSweepConfig& cfg);
+
+// Capture metadata members describing a setting: weather and clock.
+std::string environmentMetadata(const EnvironmentSetting& setting);
+
+// Runs the settings at one pose on the script thread: apply a setting, let it
+// settle, capture, wait for the capture, next. The settings are visited in
+// alternating direction from one pose to the next, so the setting left in
+// place by the previous pose is captured first without changing anything.
+class EnvironmentSweep {
+public:
+	enum Action { Idle, Apply, Capture, Finished };
+
+	// Also forgets which setting the world is in. The world only leaves the
+	// sweep's settings while the sweep is off (ENV_SWEEP OFF clears the
+	// weather override and lets the clock run), and turning it back on
+	// configures it anew.
+	void configure(const EnvironmentSweepConfig& cfg);
+	const EnvironmentSweepConfig& config() const { return cfg_; }
+	// poseMetadata and poseRigId are what the capture would have been tagged
+	// with.
+	void start(const std::string& poseMetadata, unsigned int poseRigId, unsigned int round, int frameCount);
+	bool active() const { return active_; }
+	void cancel() { active_ = false; }
+	// frameCount is the game's rendered frame counter. On Apply, setting is
+	// to be written to the world; on Capture, metadata tags the frame.
+	Action tick(int frameCount, bool captureIdle, EnvironmentSetting& setting, std::string& metadata);
+	unsigned int round() const { return round_; }
+	unsigned int rigId() const { return poseRigId_; }
+
+private:
+	enum State { Next, Settle, Wait };
+	int current() const;
+
+	EnvironmentSweepConfig cfg_;
+	std::string poseMetadata_;
+	unsigned int poseRigId_ = 0;
+	unsigned int round_ = 0;
+	size_t index_ = 0;
+	bool reverse_ = false;
+	int applied_ = -1;	// setting the world is in, -1 unknown
+	int frameMark_ = 0;
+	int settleFrames_ = 0;
+	State state_ = Next;
+	bool active_ = false;
+	std::chrono::steady_clock::time_point started_;
+};
+
+struct EnvironmentStats {
+	bool enabled = false;
+	size_t settings = 0;
+	unsigned long long rounds = 0;
+	unsigned long long captures = 0;
+	unsigned long long changes = 0;			// settings applied to the world
+	unsigned long long settleFrames = 0;	// rendered frames spent settling
+	double lastRoundMs = 0.0;
+	double meanRoundMs = 0.0;
+};
+
+// Id of the next sweep round and of the last one that finished.
+unsigned int nextEnvironmentRound();
+void finishEnvironmentRound(unsigned int round, double milliseconds);
+unsigned int lastFinishedEnvironmentRound();
+void setEnvironmentSweepEnabled(bool enabled, size_t settings);
+void recordEnvironmentChange(int settleFrames);
+void recordEnvironmentCapture();
+EnvironmentStats environmentStats();
+std::string environmentStatsJson(const EnvironmentStats& stats);
@@ -1,4 +1,6 @@
 #include "export.h"
+#include "pixels.h"
+#include "latency.h"
 #include "nativeCaller.h"
 #include "natives.h"
 #include <d3d11.h>
@@ -41,10 +43,15 @@ static vector<unsigned char> depthBuf;
 static vector<unsigned char> colorBuf;
 static vector<unsigned char> stencilBuf;
 static rage_matrices constants;
+static int depthWidth = 0;
+static int depthHeight = 0;
+static int colorWidth = 0;
+static int colorHeight = 0;
 static bool request_copy = false;
 static mutex copy_mtx;
 static condition_variable copy_cv;
 static HRESULT screenHr;
+static int64_t last_depth_copy_us = 0;	// latencyMicros() of the last depth CopyResource
 static time_point<high_resolution_clock> last_depth_time;
 static time_point<high_resolution_clock> last_color_time;
 static time_point<high_resolution_clock> last_constant_time;
@@ -76,19 +83,14 @@ static void unpack_depth(ID3D11Device* dev, ID3D11DeviceContext* ctx, ID3D11Reso
 	D3D11_MAPPED_SUBRESOURCE src_map = { 0 };
 	hr = ctx->Map(src, 0, D3D11_MAP_READ, 0, &src_map);
 	if (hr != S_OK) throw std::system_error(hr, std::system_category());
+	markCaptureStage(stageCopyIssued, last_depth_copy_us);
+	markCaptureStage(stageMapComplete);
 	if (dst.size() != src_desc.Height * src_desc.Width * 4) dst = vector<unsigned char>(src_desc.Height * src_desc.Width * 4);
 	if (stencil.size() != src_desc.Height * src_desc.Width) stencil = vector<unsigned char>(src_desc.Height * src_desc.Width);
-	for (int x = 0; x < src_desc.Width; ++x)
-	{
-		for (int y = 0; y < src_desc.Height; ++y)
-		{
-			const float* src_f = (const float*)((const char*)src_map.pData + src_map.RowPitch*y + (x * 8));
-			unsigned char* dst_p = &dst[src_desc.Width * 4 * y + (x * 4)];
-			unsigned char* stencil_p = &stencil[src_desc.Width * y + x];
-			memmove(dst_p, src_f, 4);
-			memmove(stencil_p, src_f + 1, 1);
-		}
-	}
+	depthWidth = src_desc.Width;
+	depthHeight = src_desc.Height;
+	splitDepthStencil((const unsigned char*)src_map.pData, src_map.RowPitch, src_desc.Width, src_desc.Height,
+		(float*)dst.data(), stencil.data());
 	ctx->Unmap(src, 0);
 }
 static ComPtr<ID3D11Texture2D> CreateTexHelper(ID3D11Device* dev, DXGI_FORMAT fmt, int width, int height, int samples)
@@ -170,19 +172,9 @@ void copyTexToVector(ID3D11Device* dev, ID3D11DeviceContext* ctx, ID3D11Resource
 	hr = ctx->Map(tex_copy.Get(), 0, D3D11_MAP_READ, 0, &map);
 	if (hr != S_OK) throw std::system_error(hr, std::system_category());
 	if (buffer.size() != desc.Height * desc.Width * bpp) buffer = vector<unsigned char>(desc.Height * desc.Width * bpp);
-	for(int y = 0; y < desc.Height; ++y)
-	{
-		for (int x = 0; x < desc.Width; ++x) {
-			unsigned char* p = &buffer[y * desc.Width * bpp + (x*4)];
-			unsigned char* b = (unsigned char*)map.pData + map.RowPitch*y + (x*4);
-			p[0] = b[2];
-			p[1] = b[1];
-			p[2] = b[0];
-			p[3] = b[3];
-			//memmove(p, b, desc.Width * bpp);
-		}
-
-	}
+	colorWidth = desc.Width;
+	colorHeight = desc.Height;
+	swizzleBgraToRgba((const unsigned char*)map.pData, map.RowPitch, desc.Width, desc.Height, buffer.data());
 	ctx->Unmap(tex_copy.Get(), 0);
 	
 }
@@ -206,6 +198,7 @@ void ExtractDepthBuffer(ID3D11Device* dev, ID3D11DeviceContext* ctx, ID3D11Resou
 	CreateTextureIfNeeded(dev, res, &depthRes);
 	ctx->CopyResource(depthRes.Get(), res);
 	last_depth_time = std::chrono::high_resolution_clock::now();
+	last_depth_copy_us = latencyMicros();
 	//unpack_depth(dev, ctx, res, depthBuf, stencilBuf, screenBuf);
 }
 
@@ -292,6 +285,20 @@ extern "C" {
 		}
 		else return 2;
 	}
+	__declspec(dllexport) int export_get_depth_dimensions(int* width, int* height)
+	{
+		if (depthWidth == 0 || depthHeight == 0) return -1;
+		*width = depthWidth;
+		*height = depthHeight;
+		return 1;
+	}
+	__declspec(dllexport) int export_get_color_dimensions(int* width, int* height)
+	{
+		if (colorWidth == 0 || colorHeight == 0) return -1;
+		*width = colorWidth;
+		*height = colorHeight;
+		return 1;
+	}
 
 	__declspec(dllexport) long long int export_get_last_depth_time() {
 		return duration_cast<milliseconds>(last_depth_time.time_since_epoch()).count();
@@ -0,0 +1,48 @@
+#include "flow.h"
+#include "parallel.h"
+#include <cmath>
+
+using Eigen::Matrix4f;
+using std::vector;
+
+void computeEgoFlow(const CapturedFrame& from, const CapturedFrame& to,
+	vector<float>& flow, vector<unsigned char>& valid, float occlusionTolerance)
+{
+	const int w = from.width, h = from.height;
+	const int tw = to.width, th = to.height;
+	flow.assign((size_t)w * h * 2, 0.0f);
+	valid.assign((size_t)w * h, 0);
+
+	PositionPlanes src, dst;
+	unprojectDepth(from, src);
+	unprojectDepth(to, dst);
+	if (src.z.size() != (size_t)w * h || dst.z.size() != (size_t)tw * th) return;
+
+	// camera(from) -> camera(to), then to clip space
+	const Matrix4f T = to.V * from.matrices.Vinv;
+	const Matrix4f M = to.P * T;
+	const float halfW = 0.5f * tw, halfH = 0.5f * th;
+
+	parallelFor(0, h, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			for (int x = 0; x < w; ++x) {
+				size_t i = (size_t)y * w + x;
+				float px = src.x[i], py = src.y[i], pz = src.z[i];
+				if (pz == 0.0f) continue;
+				float cx = M(0, 0) * px + M(0, 1) * py + M(0, 2) * pz + M(0, 3);
+				float cy = M(1, 0) * px + M(1, 1) * py + M(1, 2) * pz + M(1, 3);
+				float cw = M(3, 0) * px + M(3, 1) * py + M(3, 2) * pz + M(3, 3);
+				if (!(cw > 0.0f)) continue;
+				float u = (cx / cw + 1.0f) * halfW;
+				float v = (1.0f - cy / cw) * halfH;
+				flow[i * 2 + 0] = u - (x + 0.5f);
+				flow[i * 2 + 1] = v - (y + 0.5f);
+				if (!(u >= 0.0f && u < tw && v >= 0.0f && v < th)) continue;
+				float expected = -(T(2, 0) * px + T(2, 1) * py + T(2, 2) * pz + T(2, 3));
+				float seen = -dst.z[(size_t)(int)v * tw + (int)u];
+				if (!(seen > 0.0f)) continue;
+				valid[i] = std::fabs(expected - seen) <= occlusionTolerance * seen;
+			}
+		}
+	});
+}
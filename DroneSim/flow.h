@@ -0,0 +1,14 @@
+#pragma once
+#include "derived.h"
+#include "frame.h"
+#include <vector>
+
+// Rigid-scene (ego-motion) optical flow between two captures. Every pixel of
+// `from` is lifted to camera space with its depth, moved into `to` with both
+// view matrices and reprojected with to's projection. flow holds the (dx, dy)
+// pixel displacement interleaved per pixel of `from`; valid is 1 where the
+// point lands inside `to`, in front of the camera, and agrees with to's depth
+// within occlusionTolerance (relative), 0 otherwise. Moving objects are not
+// modelled and show up as valid but wrong flow.
+void computeEgoFlow(const CapturedFrame& from, const CapturedFrame& to,
+	std::vector<float>& flow, std::vector<unsigned char>& valid, float occlusionTolerance = 0.02f);
@@ -0,0 +1,128 @@
+#include "frame.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "survey.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+using Eigen::Vector4f;
+using std::shared_ptr;
+using std::vector;
+
+static std::mutex frame_mtx;
+static std::deque<shared_ptr<const CapturedFrame>> frameHistory;
+static unsigned int nextFrameId = 1;
+static std::string pendingMetadata;
+static unsigned int pendingRigId = 0;
+static unsigned int pendingEnvRound = 0;
+
+rage_matrices matricesFromFloats(const float* data)
+{
+	rage_matrices m;
+	m.M = Eigen::Map<const Matrix4f>(data);
+	m.MV = Eigen::Map<const Matrix4f>(data + 16);
+	m.MVP = Eigen::Map<const Matrix4f>(data + 32);
+	m.Vinv = Eigen::Map<const Matrix4f>(data + 48);
+	return m;
+}
+
+Matrix4f projectionFromMatrices(const rage_matrices& m)
+{
+	return m.MVP * m.MV.inverse();
+}
+
+Matrix4f viewFromMatrices(const rage_matrices& m)
+{
+	return m.Vinv.inverse();
+}
+
+Unprojector::Unprojector(const Matrix4f& P, int width, int height)
+	: Pinv_(P.inverse()), sx_(2.0f / width), sy_(2.0f / height)
+{
+}
+
+Vector3f Unprojector::at(float px, float py, float depth) const
+{
+	Vector4f ndc(px * sx_ - 1.0f, 1.0f - py * sy_, depth, 1.0f);
+	Vector4f v = Pinv_ * ndc;
+	return v.head<3>() / v.w();
+}
+
+void publishCapturedFrame(shared_ptr<CapturedFrame> frame)
+{
+	frame->P = projectionFromMatrices(frame->matrices);
+	frame->V = viewFromMatrices(frame->matrices);
+	CaptureTimeline timeline = takeCaptureTimeline();
+	if (captureTimelineJson(frame->timeline).empty()) frame->timeline = timeline;
+	recordCaptureStages(frame->timeline);
+	static MetricCounter& framesMetric = metricCounter("capture.frames");
+	framesMetric.add();
+	shared_ptr<const CapturedFrame> published;
+	{
+		std::lock_guard<std::mutex> lk(frame_mtx);
+		frame->id = nextFrameId++;
+		if (frame->metadata.empty()) frame->metadata.swap(pendingMetadata);
+		if (frame->rigId == 0) frame->rigId = pendingRigId;
+		if (frame->envRound == 0) frame->envRound = pendingEnvRound;
+		pendingMetadata.clear();
+		pendingRigId = pendingEnvRound = 0;
+		published = std::move(frame);
+		frameHistory.push_front(published);
+		if (frameHistory.size() > capturedFrameHistory) frameHistory.pop_back();
+	}
+	offerSurveyFrame(published);
+	recordFrame(published);
+}
+
+void setNextCaptureMetadata(const std::string& metadata, unsigned int rigId, unsigned int envRound)
+{
+	std::lock_guard<std::mutex> lk(frame_mtx);
+	pendingMetadata = metadata;
+	pendingRigId = rigId;
+	pendingEnvRound = envRound;
+}
+
+shared_ptr<const CapturedFrame> lastCapturedFrame()
+{
+	std::lock_guard<std::mutex> lk(frame_mtx);
+	if (frameHistory.empty()) return nullptr;
+	return frameHistory.front();
+}
+
+vector<shared_ptr<const CapturedFrame>> recentCapturedFrames(size_t count)
+{
+	std::lock_guard<std::mutex> lk(frame_mtx);
+	count = std::min(count, frameHistory.size());
+	return vector<shared_ptr<const CapturedFrame>>(frameHistory.begin(), frameHistory.begin() + count);
+}
+
+void appendFrameChannel(vector<unsigned char>& out, const char* tag, int width, int height, const void* data, size_t bytes)
+{
+	uint32_t fields[3] = { (uint32_t)width, (uint32_t)height, (uint32_t)bytes };
+	size_t at = out.size();
+	out.resize(at + 4 + sizeof(fields) + bytes);
+	memcpy(&out[at], tag, 4);
+	memcpy(&out[at + 4], fields, sizeof(fields));
+	if (bytes) memcpy(&out[at + 4 + sizeof(fields)], data, bytes);
+}
+
+std::string frameMetaJson(const CapturedFrame& f)
+{
+	std::string stages = captureTimelineJson(f.timeline);
+	return "{\"id\":" + std::to_string(f.id) + ",\"timestamp\":" + std::to_string(f.timestamp)
+		+ (f.metadata.empty() ? "" : "," + f.metadata)
+		+ (stages.empty() ? "" : ",\"stages_us\":" + stages) + "}";
+}
+
+void appendFrameChannels(vector<unsigned char>& out, const CapturedFrame& f)
+{
+	std::string meta = frameMetaJson(f);
+	appendFrameChannel(out, "META", 0, 0, meta.data(), meta.size());
+	appendFrameChannel(out, "RGBA", f.colorWidth, f.colorHeight, f.color.data(), f.color.size());
+	appendFrameChannel(out, "DPTH", f.width, f.height, f.depth.data(), f.depth.size() * sizeof(float));
+}
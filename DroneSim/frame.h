@@ -0,0 +1,85 @@
+#pragma once
+#include "latency.h"
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct rage_matrices {
+	Eigen::Matrix4f M;
+	Eigen::Matrix4f MV;
+	Eigen::Matrix4f MVP;
+	Eigen::Matrix4f Vinv;
+};
+
+// One capture as produced by the depth/stencil hook. depth holds the raw
+// reversed-z buffer values (0 = far plane), row-major, width * height floats.
+// color is the back buffer as RGBA8, colorWidth * colorHeight pixels.
+struct CapturedFrame {
+	unsigned int id = 0;
+	long long timestamp = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<float> depth;
+	std::vector<unsigned char> stencil;
+	int colorWidth = 0;
+	int colorHeight = 0;
+	std::vector<unsigned char> color;
+	// the screenshot file export_get_screen_buffer wrote (BMP), which CAPTURE
+	// sends as its image
+	std::vector<unsigned char> screen;
+	// JSON object members ("key":value,...) describing why the frame was
+	// taken, set by whoever armed the capture
+	std::string metadata;
+	// the rig round and environment sweep round the frame was captured for,
+	// 0 for none; RIG_FRAMES and ENV_FRAMES select frames by these
+	unsigned int rigId = 0;
+	unsigned int envRound = 0;
+	// stage timestamps up to publishing; replies stamp their own copy
+	CaptureTimeline timeline;
+	rage_matrices matrices;
+	Eigen::Matrix4f P;	// projection, MVP * MV^-1
+	Eigen::Matrix4f V;	// world -> camera, Vinv^-1
+};
+
+// The matrices from 64 floats in member order, each column-major, as MATX
+// chunks store them. data need not be aligned.
+rage_matrices matricesFromFloats(const float* data);
+Eigen::Matrix4f projectionFromMatrices(const rage_matrices& m);
+Eigen::Matrix4f viewFromMatrices(const rage_matrices& m);
+
+// Maps a pixel position and raw depth value back to camera space through P^-1.
+class Unprojector {
+public:
+	Unprojector(const Eigen::Matrix4f& P, int width, int height);
+	Eigen::Vector3f at(float px, float py, float depth) const;
+
+private:
+	Eigen::Matrix4f Pinv_;
+	float sx_, sy_;
+};
+
+// Fills P and V from the matrices, assigns an id and keeps the frame in a
+// short history so consumers on other threads can pick it up.
+// Frames without metadata of their own take the pending metadata set by
+// setNextCaptureMetadata, which is consumed by that publish; likewise the
+// pending rig id and environment round.
+// Likewise the capture's stage timeline (takeCaptureTimeline), which is
+// recorded into the latency histograms. While recording, the frame is also
+// queued for the recorder's writers.
+void publishCapturedFrame(std::shared_ptr<CapturedFrame> frame);
+void setNextCaptureMetadata(const std::string& metadata, unsigned int rigId = 0, unsigned int envRound = 0);
+std::shared_ptr<const CapturedFrame> lastCapturedFrame();
+// Newest first, at most count frames; at most capturedFrameHistory are kept.
+static const size_t capturedFrameHistory = 16;
+std::vector<std::shared_ptr<const CapturedFrame>> recentCapturedFrames(size_t count);
+
+// Appends a tagged channel to a reply payload: 4-byte tag, u32 width,
+// u32 height, u32 byte count, then the raw data.
+void appendFrameChannel(std::vector<unsigned char>& out, const char* tag, int width, int height, const void* data, size_t bytes);
+// The frame's META object: id, timestamp, its metadata members and
+// "stages_us", its stage timeline.
+std::string frameMetaJson(const CapturedFrame& frame);
+// Appends META (frameMetaJson), RGBA and DPTH channels for a whole frame.
+void appendFrameChannels(std::vector<unsigned char>& out, const CapturedFrame& frame);
@@ -0,0 +1,130 @@
+#include "instances.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using std::vector;
+
+static uint32_t findRoot(vector<uint32_t>& parent, uint32_t i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// Roots are always the smaller index, so every component's root is its
+// first pixel in raster order.
+static void unite(vector<uint32_t>& parent, uint32_t a, uint32_t b)
+{
+	a = findRoot(parent, a);
+	b = findRoot(parent, b);
+	if (a < b) parent[b] = a;
+	else if (b < a) parent[a] = b;
+}
+
+static inline bool connected(const unsigned char* labels, const float* depth, size_t a, size_t b, float tol)
+{
+	if (labels[a] != labels[b]) return false;
+	float za = depth[a], zb = depth[b];
+	return std::fabs(za - zb) <= tol * std::min(za, zb);
+}
+
+void labelInstances(const vector<unsigned char>& labels, const vector<float>& depth, int width, int height,
+	vector<InstanceRecord>& instances, vector<uint32_t>* instanceIds, float depthTolerance, uint32_t minArea)
+{
+	instances.clear();
+	const size_t n = (size_t)width * height;
+	if (labels.size() != n || depth.size() != n || n == 0) return;
+	const unsigned char* L = labels.data();
+	const float* Z = depth.data();
+
+	vector<uint32_t> parent(n);
+	// Pass 1: union-find inside horizontal strips, one strip per worker.
+	// Unions never leave the strip, so the strips share no state.
+	int workers = (int)std::max(1u, std::thread::hardware_concurrency());
+	int stripRows = std::max(1, (height + workers - 1) / workers);
+	vector<int> stripStarts;
+	for (int y = 0; y < height; y += stripRows) stripStarts.push_back(y);
+	parallelFor(0, (int)stripStarts.size(), [&](int s0, int s1) {
+		for (int s = s0; s < s1; ++s) {
+			int yBegin = stripStarts[s], yEnd = std::min(height, yBegin + stripRows);
+			for (int y = yBegin; y < yEnd; ++y) {
+				for (int x = 0; x < width; ++x) {
+					size_t i = (size_t)y * width + x;
+					parent[i] = (uint32_t)i;
+					if (L[i] == 0 || !(Z[i] > 0.0f)) continue;
+					if (x > 0 && connected(L, Z, i, i - 1, depthTolerance)) unite(parent, (uint32_t)i, (uint32_t)(i - 1));
+					if (y > yBegin && connected(L, Z, i, i - width, depthTolerance)) unite(parent, (uint32_t)i, (uint32_t)(i - width));
+				}
+			}
+		}
+	}, 1);
+	// Pass 2: stitch the strip borders.
+	for (size_t s = 1; s < stripStarts.size(); ++s) {
+		size_t row = (size_t)stripStarts[s] * width;
+		for (int x = 0; x < width; ++x) {
+			size_t i = row + x;
+			if (L[i] == 0 || !(Z[i] > 0.0f)) continue;
+			if (connected(L, Z, i, i - width, depthTolerance)) unite(parent, (uint32_t)i, (uint32_t)(i - width));
+		}
+	}
+	// Pass 3: resolve roots; after pass 2 the forest is read-only.
+	vector<uint32_t> root(n);
+	parallelFor(0, height, [&](int y0, int y1) {
+		for (size_t i = (size_t)y0 * width; i < (size_t)y1 * width; ++i) {
+			uint32_t r = parent[i];
+			while (parent[r] != r) r = parent[r];
+			root[i] = r;
+		}
+	});
+
+	// Pass 4: statistics per root. Roots are first pixels in raster order,
+	// so numbering them in index order keeps ids stable and sorted.
+	vector<uint32_t> slot(n, 0);
+	vector<InstanceRecord> all;
+	vector<vector<float>> depths;
+	for (size_t i = 0; i < n; ++i) {
+		if (L[i] == 0 || !(Z[i] > 0.0f)) continue;
+		uint32_t r = root[i];
+		if (r == i) {
+			InstanceRecord rec = {};
+			rec.classId = L[i];
+			rec.x0 = rec.x1 = (uint16_t)(i % width);
+			rec.y0 = rec.y1 = (uint16_t)(i / width);
+			all.push_back(rec);
+			depths.emplace_back();
+			slot[i] = (uint32_t)all.size();
+		}
+		uint32_t k = slot[r] - 1;
+		InstanceRecord& rec = all[k];
+		uint16_t x = (uint16_t)(i % width), y = (uint16_t)(i / width);
+		rec.x0 = std::min(rec.x0, x);
+		rec.x1 = std::max(rec.x1, x);
+		rec.y1 = y;
+		rec.area++;
+		depths[k].push_back(Z[i]);
+	}
+
+	vector<uint32_t> finalId(all.size(), 0);
+	for (size_t k = 0; k < all.size(); ++k) {
+		if (all[k].area < minArea) continue;
+		auto& d = depths[k];
+		std::nth_element(d.begin(), d.begin() + d.size() / 2, d.end());
+		all[k].medianDepth = d[d.size() / 2];
+		all[k].id = (uint32_t)instances.size() + 1;
+		finalId[k] = all[k].id;
+		instances.push_back(all[k]);
+	}
+	if (instanceIds) {
+		instanceIds->assign(n, 0);
+		parallelFor(0, height, [&](int y0, int y1) {
+			for (size_t i = (size_t)y0 * width; i < (size_t)y1 * width; ++i) {
+				if (L[i] == 0 || !(Z[i] > 0.0f)) continue;
+				(*instanceIds)[i] = finalId[slot[root[i]] - 1];
+			}
+		});
+	}
+}
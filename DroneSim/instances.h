@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Object instances from a semantic label image: 4-connected components of
+// equal, non-zero class, cut wherever linear depth jumps by more than
+// depthTolerance (relative to the nearer pixel). Components smaller than
+// minArea pixels are dropped.
+#pragma pack(push, 1)
+struct InstanceRecord {
+	uint32_t id;			// 1-based, in raster order of the first pixel
+	uint8_t classId;
+	uint8_t reserved[3];
+	uint16_t x0, y0;		// inclusive bounding box
+	uint16_t x1, y1;
+	uint32_t area;			// pixels
+	float medianDepth;		// metres along the view axis
+};
+#pragma pack(pop)
+
+// labels and depth (positive linear depth, 0 for sky) are width * height,
+// row-major. If instanceIds is non-null it receives the record id of each
+// pixel, 0 where no instance was kept.
+void labelInstances(const std::vector<unsigned char>& labels, const std::vector<float>& depth, int width, int height,
+	std::vector<InstanceRecord>& instances, std::vector<uint32_t>* instanceIds = nullptr,
+	float depthTolerance = 0.05f, uint32_t minArea = 16);
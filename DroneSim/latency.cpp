@@ -0,0 +1,144 @@
+#include "latency.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+static const char* stageNames[captureStageCount] = {
+	"command_received", "dequeued", "pose_applied", "capture_armed", "copy_issued",
+	"map_complete", "unpack_done", "encode_done", "first_byte_sent", "last_byte_sent",
+};
+
+int64_t latencyMicros()
+{
+	static const auto epoch = std::chrono::steady_clock::now();
+	// never 0, which marks a stage not reached
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+const char* captureStageName(CaptureStage stage)
+{
+	return stage >= 0 && stage < captureStageCount ? stageNames[stage] : "unknown";
+}
+
+static std::mutex timeline_mtx;
+static CaptureTimeline nextCapture;
+static CaptureTimeline inFlight;
+
+void markCaptureStage(CaptureStage stage, int64_t us)
+{
+	if (stage < 0 || stage >= captureStageCount) return;
+	if (us == 0) us = latencyMicros();
+	std::lock_guard<std::mutex> lk(timeline_mtx);
+	if (stage < stageCaptureArmed) {
+		nextCapture.us[stage] = us;
+		return;
+	}
+	if (stage == stageCaptureArmed) {
+		inFlight = nextCapture;
+		nextCapture = CaptureTimeline();
+	}
+	inFlight.us[stage] = us;
+}
+
+CaptureTimeline takeCaptureTimeline()
+{
+	std::lock_guard<std::mutex> lk(timeline_mtx);
+	CaptureTimeline timeline = inFlight;
+	inFlight = CaptureTimeline();
+	return timeline;
+}
+
+static int64_t firstStage(const CaptureTimeline& timeline)
+{
+	for (int s = 0; s < captureStageCount; ++s) {
+		if (timeline.us[s] != 0) return timeline.us[s];
+	}
+	return 0;
+}
+
+std::string captureTimelineJson(const CaptureTimeline& timeline)
+{
+	int64_t origin = firstStage(timeline);
+	if (origin == 0) return "";
+	std::string json = "{";
+	for (int s = 0; s < captureStageCount; ++s) {
+		if (timeline.us[s] == 0) continue;
+		if (json.size() > 1) json += ",";
+		json += "\"" + std::string(stageNames[s]) + "\":" + std::to_string(timeline.us[s] - origin);
+	}
+	return json + "}";
+}
+
+// The stage histograms live in the metrics registry as latency.<stage>_us and
+// latency.end_to_end_us, so STATS and LATENCY_STATS report the same numbers.
+namespace {
+	struct LatencyMetrics {
+		MetricHistogram* stages[captureStageCount] = {};	// none for command_received, the origin
+		MetricHistogram& endToEnd = metricHistogram("latency.end_to_end_us");
+
+		LatencyMetrics()
+		{
+			for (int s = 1; s < captureStageCount; ++s) stages[s] = &metricHistogram(std::string("latency.") + stageNames[s] + "_us");
+		}
+	};
+}
+
+static LatencyMetrics& latencyMetrics()
+{
+	static LatencyMetrics metrics;
+	return metrics;
+}
+
+static std::mutex last_mtx;
+static CaptureTimeline lastDelivered;
+
+// Each reached stage in [from, to) against the nearest reached stage before it.
+static void recordDeltas(const CaptureTimeline& timeline, int from, int to)
+{
+	LatencyMetrics& m = latencyMetrics();
+	for (int s = std::max(from, 1); s < to; ++s) {
+		if (timeline.us[s] == 0) continue;
+		for (int p = s - 1; p >= 0; --p) {
+			if (timeline.us[p] == 0) continue;
+			m.stages[s]->record(timeline.us[s] - timeline.us[p]);
+			break;
+		}
+	}
+}
+
+void recordCaptureStages(const CaptureTimeline& timeline)
+{
+	recordDeltas(timeline, 0, stageEncodeDone);
+}
+
+void recordReplyStages(CaptureTimeline timeline, int64_t requestUs)
+{
+	LatencyMetrics& m = latencyMetrics();
+	if (requestUs != 0 && timeline.us[stageEncodeDone] != 0) {
+		m.stages[stageEncodeDone]->record(timeline.us[stageEncodeDone] - requestUs);
+	}
+	recordDeltas(timeline, stageFirstByteSent, captureStageCount);
+	int64_t origin = firstStage(timeline);
+	if (origin != 0 && timeline.us[stageLastByteSent] != 0) {
+		m.endToEnd.record(timeline.us[stageLastByteSent] - origin);
+	}
+	std::lock_guard<std::mutex> lk(last_mtx);
+	lastDelivered = timeline;
+}
+
+std::string latencyStatsJson()
+{
+	LatencyMetrics& m = latencyMetrics();
+	std::string json = "{\"stages\":{";
+	for (int s = 1; s < captureStageCount; ++s) {
+		if (s > 1) json += ",";
+		json += "\"" + std::string(stageNames[s]) + "\":" + metricHistogramJson(*m.stages[s]);
+	}
+	std::string last;
+	{
+		std::lock_guard<std::mutex> lk(last_mtx);
+		last = captureTimelineJson(lastDelivered);
+	}
+	return json + "},\"end_to_end\":" + metricHistogramJson(m.endToEnd) + ",\"last\":" + (last.empty() ? "null" : last) + "}";
+}
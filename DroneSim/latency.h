@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Stage timestamps of one capture, from the command that asked for it to the
+// last byte of the reply that delivered it, in microseconds on a monotonic
+// clock (latencyMicros). 0 marks a stage the capture did not go through:
+// captures armed by a trajectory, rig or sweep have no command, and frames
+// not yet sent have no reply stages.
+enum CaptureStage {
+	stageCommandReceived,	// server read REQUEST
+	stageDequeued,			// script thread took it off the queue
+	stagePoseApplied,		// SET_POSE/MOVE folded in ahead of the REQUEST written
+	stageCaptureArmed,		// capture requested from the renderer
+	stageCopyIssued,		// depth copied to the staging texture
+	stageMapComplete,		// staging texture mapped for read-back
+	stageUnpackDone,		// buffers unpacked, frame about to be published
+	stageEncodeDone,		// reply payload built
+	stageFirstByteSent,		// reply length header written
+	stageLastByteSent,		// reply payload written
+	captureStageCount
+};
+
+struct CaptureTimeline {
+	int64_t us[captureStageCount] = {};
+};
+
+int64_t latencyMicros();
+const char* captureStageName(CaptureStage stage);
+
+// Stamps the capture being prepared. Stages before stageCaptureArmed belong
+// to the next capture; arming moves them to the capture in flight, which the
+// renderer stages stamp and publishCapturedFrame takes.
+void markCaptureStage(CaptureStage stage, int64_t us = 0);
+CaptureTimeline takeCaptureTimeline();
+
+// {"command_received":0,"dequeued":850,...}: offsets in microseconds from the
+// first stage reached, reached stages only. Empty when none was.
+std::string captureTimelineJson(const CaptureTimeline& timeline);
+
+// Histograms of the time taken to reach each stage from the previous stage
+// reached. Capture stages are recorded when the frame is published; the
+// reply stages when a reply carrying it has been written, with encoding
+// timed from the reply command's arrival (requestUs), plus end to end from
+// the first stage reached to the last byte.
+void recordCaptureStages(const CaptureTimeline& timeline);
+void recordReplyStages(CaptureTimeline timeline, int64_t requestUs);
+
+// {"stages":{"dequeued":{..},...},"end_to_end":{..},"last":{..}}, each
+// histogram in metricHistogramJson's form. They are the latency.<stage>_us
+// and latency.end_to_end_us histograms STATS also reports.
+std::string latencyStatsJson();
@@ -0,0 +1,182 @@
+#include "lidar.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+using Eigen::Matrix3f;
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+using std::shared_ptr;
+using std::vector;
+
+static const float DEG2RAD = 0.01745329f;
+
+bool parseLidarCommand(const std::string& command, LidarConfig& cfg)
+{
+	std::istringstream ss(command);
+	std::string name;
+	ss >> name;
+	if (name != "LIDAR") return false;
+	float values[7] = { (float)cfg.channels, cfg.verticalFovUp, cfg.verticalFovDown,
+		cfg.azimuthResolution, cfg.rangeNoise, cfg.maxRange, (float)cfg.frames };
+	for (int i = 0; i < 7; ++i) {
+		std::string tok;
+		if (!(ss >> tok)) break;
+		try {
+			values[i] = std::stof(tok);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	}
+	cfg.channels = (int)values[0];
+	cfg.verticalFovUp = values[1];
+	cfg.verticalFovDown = values[2];
+	cfg.azimuthResolution = values[3];
+	cfg.rangeNoise = values[4];
+	cfg.maxRange = values[5];
+	cfg.frames = (int)values[6];
+	return cfg.channels > 0 && cfg.channels <= 65535
+		&& cfg.verticalFovUp >= cfg.verticalFovDown
+		&& cfg.azimuthResolution > 0.0f && 360.0f / cfg.azimuthResolution <= 65535.0f
+		&& cfg.rangeNoise >= 0.0f && cfg.maxRange > 0.0f && cfg.frames > 0;
+}
+
+// Per-capture terms of the beam -> clip space mapping. clip = K * w for a
+// world-aligned beam direction w, since P * (R * w, 0) drops the translation.
+struct LidarView {
+	const CapturedFrame* frame;
+	Eigen::Matrix<float, 4, 3> K;
+	Vector3f offset;	// capture camera position relative to the scan origin
+};
+
+LidarScan simulateLidarScan(const vector<shared_ptr<const CapturedFrame>>& frames, const LidarConfig& cfg)
+{
+	LidarScan scan;
+	scan.azimuthSteps = (int)std::lround(360.0f / cfg.azimuthResolution);
+	if (frames.empty()) return scan;
+
+	scan.frameId = frames[0]->id;
+	scan.timestamp = frames[0]->timestamp;
+	scan.origin = frames[0]->matrices.Vinv.block<3, 1>(0, 3);
+
+	vector<LidarView> views;
+	for (const auto& f : frames) {
+		if (f->width <= 0 || f->height <= 0 || f->depth.size() != (size_t)f->width * f->height) continue;
+		LidarView v;
+		v.frame = f.get();
+		Matrix3f R = f->V.topLeftCorner<3, 3>();
+		v.K = f->P.topLeftCorner<4, 3>() * R;
+		v.offset = Vector3f(f->matrices.Vinv.block<3, 1>(0, 3)) - scan.origin;
+		views.push_back(v);
+	}
+	if (views.empty()) return scan;
+
+	const int steps = scan.azimuthSteps;
+	vector<float> cosAz(steps), sinAz(steps);
+	for (int k = 0; k < steps; ++k) {
+		float az = k * cfg.azimuthResolution * DEG2RAD;
+		cosAz[k] = std::cos(az);
+		sinAz[k] = std::sin(az);
+	}
+
+	// Structure-of-arrays scratch so the projection loop below vectorizes.
+	vector<float> bestScore(steps), bestU(steps), bestV(steps);
+	vector<int> bestView(steps);
+	vector<float> u(steps), v(steps), score(steps);
+
+	vector<Unprojector> unprojectors;
+	for (const auto& view : views)
+		unprojectors.emplace_back(view.frame->P, view.frame->width, view.frame->height);
+
+	// a fresh stream per capture: scans of different captures get independent
+	// noise, a scan of the same capture repeats exactly
+	std::seed_seq seq{ cfg.seed, scan.frameId };
+	std::mt19937 rng(seq);
+	std::normal_distribution<float> noise(0.0f, cfg.rangeNoise > 0.0f ? cfg.rangeNoise : 1.0f);
+
+	const float elevStep = cfg.channels > 1 ? (cfg.verticalFovUp - cfg.verticalFovDown) / (cfg.channels - 1) : 0.0f;
+	for (int ring = 0; ring < cfg.channels; ++ring) {
+		const float elev = (cfg.verticalFovDown + ring * elevStep) * DEG2RAD;
+		const float ce = std::cos(elev), se = std::sin(elev);
+
+		std::fill(bestScore.begin(), bestScore.end(), 2.0f);
+		for (size_t vi = 0; vi < views.size(); ++vi) {
+			const auto& K = views[vi].K;
+			const float x0 = K(0, 0) * ce, x1 = K(0, 1) * ce, x2 = K(0, 2) * se;
+			const float y0 = K(1, 0) * ce, y1 = K(1, 1) * ce, y2 = K(1, 2) * se;
+			const float w0 = K(3, 0) * ce, w1 = K(3, 1) * ce, w2 = K(3, 2) * se;
+			const float halfW = 0.5f * views[vi].frame->width, halfH = 0.5f * views[vi].frame->height;
+			const float* ca = cosAz.data();
+			const float* sa = sinAz.data();
+			float* pu = u.data();
+			float* pv = v.data();
+			float* ps = score.data();
+			for (int k = 0; k < steps; ++k) {
+				float cx = x0 * ca[k] + x1 * sa[k] + x2;
+				float cy = y0 * ca[k] + y1 * sa[k] + y2;
+				float cw = w0 * ca[k] + w1 * sa[k] + w2;
+				float inv = 1.0f / (cw > 1e-6f ? cw : 1e-6f);
+				float nx = cx * inv, ny = cy * inv;
+				pu[k] = (nx + 1.0f) * halfW;
+				pv[k] = (1.0f - ny) * halfH;
+				float s = std::max(std::fabs(nx), std::fabs(ny));
+				ps[k] = cw > 1e-6f ? s : 2.0f;
+			}
+			for (int k = 0; k < steps; ++k) {
+				bool better = score[k] < bestScore[k];
+				bestScore[k] = better ? score[k] : bestScore[k];
+				bestU[k] = better ? u[k] : bestU[k];
+				bestV[k] = better ? v[k] : bestV[k];
+				bestView[k] = better ? (int)vi : bestView[k];
+			}
+		}
+
+		for (int k = 0; k < steps; ++k) {
+			if (bestScore[k] >= 1.0f) continue;
+			const LidarView& view = views[bestView[k]];
+			const CapturedFrame& f = *view.frame;
+			int ix = std::min(std::max((int)bestU[k], 0), f.width - 1);
+			int iy = std::min(std::max((int)bestV[k], 0), f.height - 1);
+			float d = f.depth[(size_t)iy * f.width + ix];
+			if (!(d > 0.0f)) continue;	// cleared to the far plane: sky, no return
+			float range = unprojectors[bestView[k]].at(ix + 0.5f, iy + 0.5f, d).norm();
+			if (cfg.rangeNoise > 0.0f) range += noise(rng);
+			if (!(range > 0.0f) || range > cfg.maxRange) continue;
+			LidarPoint p;
+			p.x = view.offset.x() + range * ce * cosAz[k];
+			p.y = view.offset.y() + range * ce * sinAz[k];
+			p.z = view.offset.z() + range * se;
+			p.ring = (uint16_t)ring;
+			p.azimuth = (uint16_t)k;
+			scan.points.push_back(p);
+		}
+	}
+	return scan;
+}
+
+vector<unsigned char> serializeLidarScan(const LidarScan& scan, const LidarConfig& cfg)
+{
+	LidarScanHeader header;
+	memcpy(header.magic, "LIDR", 4);
+	header.version = 1;
+	header.pointCount = (uint32_t)scan.points.size();
+	header.channels = (uint16_t)cfg.channels;
+	header.azimuthSteps = (uint16_t)scan.azimuthSteps;
+	header.verticalFovUp = cfg.verticalFovUp;
+	header.verticalFovDown = cfg.verticalFovDown;
+	header.azimuthResolution = cfg.azimuthResolution;
+	header.origin[0] = scan.origin.x();
+	header.origin[1] = scan.origin.y();
+	header.origin[2] = scan.origin.z();
+	header.frameId = scan.frameId;
+	header.timestamp = scan.timestamp;
+
+	vector<unsigned char> out(sizeof(header) + scan.points.size() * sizeof(LidarPoint));
+	memcpy(out.data(), &header, sizeof(header));
+	if (!scan.points.empty())
+		memcpy(out.data() + sizeof(header), scan.points.data(), scan.points.size() * sizeof(LidarPoint));
+	return out;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "frame.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Spinning LiDAR resampled from captured depth. Beams are laid out in a
+// world-aligned frame (z up, azimuth counter-clockwise from +x) centred on
+// the camera of the newest capture; each beam is looked up in whichever
+// capture sees it closest to the image centre, so several yaw-rotated
+// captures taken at one spot stitch into a full 360 degree sweep.
+struct LidarConfig {
+	int channels = 32;
+	float verticalFovUp = 15.0f;		// degrees above the horizon
+	float verticalFovDown = -25.0f;		// degrees, negative is below
+	float azimuthResolution = 0.2f;		// degrees between firings
+	float maxRange = 200.0f;			// metres
+	float rangeNoise = 0.0f;			// gaussian sigma, metres
+	unsigned int seed = 0;				// mixed with the newest capture's id
+	int frames = 1;						// how many recent captures to stitch
+};
+
+struct LidarPoint {
+	float x, y, z;		// metres, relative to the scan origin
+	uint16_t ring;		// channel index, 0 = lowest beam
+	uint16_t azimuth;	// firing index, azimuth = index * resolution
+};
+
+struct LidarScan {
+	unsigned int frameId = 0;
+	long long timestamp = 0;
+	Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+	int azimuthSteps = 0;
+	std::vector<LidarPoint> points;
+};
+
+// Binary reply layout: LidarScanHeader followed by pointCount LidarPoints,
+// all little-endian.
+#pragma pack(push, 1)
+struct LidarScanHeader {
+	char magic[4];		// "LIDR"
+	uint32_t version;
+	uint32_t pointCount;
+	uint16_t channels;
+	uint16_t azimuthSteps;
+	float verticalFovUp;
+	float verticalFovDown;
+	float azimuthResolution;
+	float origin[3];
+	uint32_t frameId;
+	int64_t timestamp;
+};
+#pragma pack(pop)
+
+// Parses "LIDAR [channels] [fovUp] [fovDown] [azRes] [noise] [maxRange] [frames]".
+// Missing trailing fields keep their defaults; returns false on a malformed field.
+bool parseLidarCommand(const std::string& command, LidarConfig& cfg);
+
+LidarScan simulateLidarScan(const std::vector<std::shared_ptr<const CapturedFrame>>& frames, const LidarConfig& cfg);
+std::vector<unsigned char> serializeLidarScan(const LidarScan& scan, const LidarConfig& cfg);
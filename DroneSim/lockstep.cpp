@@ -0,0 +1,108 @@
+#include "lockstep.h"
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+bool parseLockstepCommand(const std::string& command, bool& enable, LockstepConfig& cfg)
+{
+	std::istringstream ss(command);
+	std::string name, mode;
+	if (!(ss >> name >> mode) || name != "LOCKSTEP") return false;
+	if (mode == "OFF") {
+		enable = false;
+		std::string extra;
+		return !(ss >> extra);
+	}
+	if (mode != "ON") return false;
+	enable = true;
+	for (std::string tok; ss >> tok;) {
+		size_t eq = tok.find('=');
+		if (eq == std::string::npos) return false;
+		std::string key = tok.substr(0, eq);
+		int v;
+		try {
+			v = std::stoi(tok.substr(eq + 1));
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		if (key == "settle") cfg.settleFrames = v;
+		else if (key == "advance") cfg.advanceFrames = v;
+		else return false;
+	}
+	return cfg.settleFrames >= 0 && cfg.advanceFrames >= 0;
+}
+
+void LockstepRunner::begin(int frameCount)
+{
+	state_ = Settle;
+	frameMark_ = frameCount;
+	++step_;
+	started_ = std::chrono::steady_clock::now();
+}
+
+LockstepRunner::Action LockstepRunner::tick(int frameCount, bool captureIdle)
+{
+	using ms = std::chrono::duration<double, std::milli>;
+	switch (state_) {
+	case Settle:
+		if (frameCount - frameMark_ < cfg_.settleFrames || !captureIdle) return Idle;
+		captured_ = std::chrono::steady_clock::now();
+		state_ = Wait;
+		return Capture;
+	case Wait:
+		if (!captureIdle) return Idle;
+		if (cfg_.advanceFrames > 0) {
+			frameMark_ = frameCount;
+			state_ = Advance;
+			return Unfreeze;
+		}
+		break;
+	case Advance:
+		if (frameCount - frameMark_ < cfg_.advanceFrames) return Idle;
+		break;
+	default:
+		return Idle;
+	}
+	// capture done and the world advanced (or not): freeze and finish the step
+	auto now = std::chrono::steady_clock::now();
+	recordLockstepStep(ms(captured_ - started_).count(), ms(now - captured_).count(), ms(now - started_).count());
+	state_ = Ready;
+	return cfg_.advanceFrames > 0 ? Freeze : StepDone;
+}
+
+static std::mutex lockstep_mtx;
+static LockstepStats stats;
+
+void setLockstepEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lk(lockstep_mtx);
+	stats.enabled = enabled;
+}
+
+void recordLockstepStep(double settleMs, double captureMs, double totalMs)
+{
+	std::lock_guard<std::mutex> lk(lockstep_mtx);
+	stats.steps++;
+	stats.lastSettleMs = settleMs;
+	stats.lastCaptureMs = captureMs;
+	stats.lastMs = totalMs;
+	stats.maxMs = std::max(stats.maxMs, totalMs);
+	stats.meanMs += (totalMs - stats.meanMs) / stats.steps;
+}
+
+LockstepStats lockstepStats()
+{
+	std::lock_guard<std::mutex> lk(lockstep_mtx);
+	return stats;
+}
+
+std::string lockstepStatsJson(const LockstepStats& s)
+{
+	std::ostringstream ss;
+	ss << "{\"enabled\":" << (s.enabled ? "true" : "false") << ",\"steps\":" << s.steps
+		<< ",\"last_ms\":" << s.lastMs << ",\"mean_ms\":" << s.meanMs << ",\"max_ms\":" << s.maxMs
+		<< ",\"last_settle_ms\":" << s.lastSettleMs << ",\"last_capture_ms\":" << s.lastCaptureMs
+		<< ",\"steps_per_minute\":" << (s.meanMs > 0.0 ? 60000.0 / s.meanMs : 0.0) << "}";
+	return ss.str();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+// Lockstep capture: with the mode on the world is frozen between steps. A
+// step applies its pose, waits settleFrames rendered frames for the
+// buffers (TAA history, streaming, shadows) to catch up, captures, waits for
+// the capture, then lets the world run for advanceFrames frames and freezes
+// it again before the next step may start.
+struct LockstepConfig {
+	int settleFrames = 3;
+	int advanceFrames = 0;	// 0 keeps the world frozen across steps
+};
+
+// "LOCKSTEP ON [settle=n] [advance=n]" or "LOCKSTEP OFF"
+bool parseLockstepCommand(const std::string& command, bool& enable, LockstepConfig& cfg);
+
+class LockstepRunner {
+public:
+	enum Action { Idle, Capture, Freeze, Unfreeze, StepDone };
+
+	void configure(const LockstepConfig& cfg) { cfg_ = cfg; }
+	const LockstepConfig& config() const { return cfg_; }
+	// The caller has applied the step's pose (if any) this tick.
+	void begin(int frameCount);
+	bool busy() const { return state_ != Ready; }
+	void cancel() { state_ = Ready; }
+	// frameCount is the game's rendered frame counter.
+	Action tick(int frameCount, bool captureIdle);
+	unsigned int step() const { return step_; }
+
+private:
+	enum State { Ready, Settle, Wait, Advance };
+	LockstepConfig cfg_;
+	State state_ = Ready;
+	int frameMark_ = 0;
+	unsigned int step_ = 0;
+	std::chrono::steady_clock::time_point started_, captured_;
+};
+
+struct LockstepStats {
+	bool enabled = false;
+	unsigned long long steps = 0;
+	double lastMs = 0.0;		// step start -> world frozen again
+	double meanMs = 0.0;
+	double maxMs = 0.0;
+	double lastSettleMs = 0.0;	// step start -> capture armed
+	double lastCaptureMs = 0.0;	// capture armed -> capture done
+};
+
+void setLockstepEnabled(bool enabled);
+void recordLockstepStep(double settleMs, double captureMs, double totalMs);
+LockstepStats lockstepStats();
+std::string lockstepStatsJson(const LockstepStats& stats);
@@ -0,0 +1,21 @@
+#include "logging.h"
+#include <cstdio>
+
+void log_to_pedTxt(std::string text, const char* file)
+{
+#ifdef _WIN32
+	FILE* fp;
+	fopen_s(&fp, file, "a");
+#else
+	std::string path(file);
+	for (char& c : path) {
+		if (c == '\\') c = '/';
+	}
+	FILE* fp = fopen(path.c_str(), "a");
+#endif
+	if (fp == NULL) {
+		return;
+	}
+	fprintf(fp, "%s\n", text.c_str());
+	fclose(fp);
+}
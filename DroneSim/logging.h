@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Appends one line to a plugin log file. Paths use the game's Windows
+// separators ("logs\\server.log"); other platforms map them to '/'.
+void log_to_pedTxt(std::string text, const char* file);
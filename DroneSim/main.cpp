@@ -13,6 +13,9 @@
 #include <cassert>
 #include <chrono>
 #include "export.h"
+#include "capture.h"
+#include "frame.h"
+#include "metrics.h"
 #include "script.h"
 #include <d3d11shader.h>
 #include <queue>
@@ -37,6 +40,16 @@ using Eigen::Vector4f;
 typedef void(*draw_indexed_hook_t)(ID3D11DeviceContext*, UINT, UINT, INT);
 void presentCallback(void* chain);
 
+// Hook overhead, excluding the original D3D call.
+static MetricCounter& drawIndexedMetric = metricCounter("hook.draw_indexed_calls");
+static MetricHistogram& clearDepthMetric = metricHistogram("hook.clear_depth_us");
+static MetricHistogram& presentMetric = metricHistogram("hook.present_us");
+
+static int64_t microsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 // void scriptMain();
 
 //void draw_indexed_hook(ID3D11DeviceContext3* self, UINT IndexStart, UINT StartIndexLocation, INT BaseVertexLocation);
@@ -65,31 +78,11 @@ static bool hooked = false;
 static int draw_indexed_count = 0;
 
 const size_t fileLength = 256;
-catchState cmdToCatch = catchStop;	
 static WCHAR imgPath[fileLength] = L"data\\screen.bmp";
 static char rawPath[fileLength] = "data\\stencil.raw";
 static char depthPath[fileLength] = "data\\depth.raw";
 static char matrixPath[fileLength] = "data\\matrix.txt";
 static bool onlyScreen = false, forceSave = false;
-std::string g_rgbCapturedFilePath;
-std::string g_depthCapturedFilePath;
-std::string g_stencilCapturedFilePath;
-std::string g_matrixCapturedFilePath = matrixPath;
-std::queue<std::string> g_cmdQueue;
-
-
-inline void makeCmdStart()
-{
-	cmdToCatch = catchStart;
-}
-inline void makeCmdStop()
-{
-	cmdToCatch = catchStop;
-}
-inline void cmdCatchScreen()
-{
-	cmdToCatch = catchScreen;
-}
 
 void catchCurveAndScreen(WCHAR *_imgPath, char *_rawPath, bool _forceSave, bool _onlyScreen)
 {
@@ -243,6 +236,7 @@ void draw_indexed_hook(ID3D11DeviceContext* self, UINT indexCount, UINT startLoc
 	}
 
 	draw_indexed_count += 1;
+	drawIndexedMetric.add();
 	origMethod(self, indexCount, startLoc, baseLoc);
 }
 void clear_render_target_view_hook(ID3D11DeviceContext* self, ID3D11RenderTargetView* rtv, float color[4])
@@ -268,25 +262,10 @@ void clear_render_target_view_hook(ID3D11DeviceContext* self, ID3D11RenderTarget
 	origMethod(self, rtv, color);
 }
 
-auto screenShot = [](FILE* f) {
-	int screenCapResult = export_get_screen_buffer(imgPath);
-	std::chrono::milliseconds ms = std::chrono::duration_cast< std::chrono::milliseconds >(
-				std::chrono::system_clock::now().time_since_epoch()
-				);
-	char currentImgPathNarrow[fileLength];
-	sprintf(currentImgPathNarrow, "data\\screen.bmp");
-	g_rgbCapturedFilePath = currentImgPathNarrow;
-	if (screenCapResult != 1) {
-		fprintf(f, "[%I64d] : export screen %ls failed.\n", ms, imgPath);
-	}
-	else {
-		fprintf(f, "[%I64d] : export screen %ls success.\n", ms, imgPath);
-	}
-};
-
 void clear_depth_stencil_view_hook(ID3D11DeviceContext* self, ID3D11DepthStencilView* dsv, UINT8 flags, float depth, UINT8 stencil)
 {
 	auto origMethod = reinterpret_cast<decltype(&clear_depth_stencil_view_hook)>(orig<53, ID3D11DeviceContext>);
+	auto start = std::chrono::steady_clock::now();
 	ComPtr<ID3D11DepthStencilView> curDSV;
 	self->OMGetRenderTargets(1, nullptr, &curDSV);
 	ComPtr<ID3D11Device> dev;
@@ -314,35 +293,19 @@ void clear_depth_stencil_view_hook(ID3D11DeviceContext* self, ID3D11DepthStencil
 			last_capture_depth = system_clock::now();
 
 			if (cmdToCatch == catchStart) {
-				void *stencil_buf;
-				void *depth_buf;
-				int sizeStencil = export_get_stencil_buffer(&stencil_buf);
-				int sizeDepth = export_get_depth_buffer(&depth_buf);
-				screenShot(f);
-
-				auto raw = fopen(rawPath, "wb");
-				fwrite(stencil_buf, 1, sizeStencil, raw);
-				fclose(raw);
-				fprintf(f, "[%I64d] : write stencil %s into file.\n", ms, rawPath);
-				g_stencilCapturedFilePath = rawPath;
-
-				auto depth_raw = fopen(depthPath, "wb");
-				fwrite(depth_buf, 1, sizeDepth, depth_raw);
-				fclose(depth_raw);
-				fprintf(f, "[%I64d] : write depth %s into file.\n", ms, depthPath);
-				g_depthCapturedFilePath = depthPath;
-
-				makeCmdStop();
+				completeCapture(imgPath, rawPath, depthPath, f);
 			}
 			fclose(f);
 		}
 	}
+	clearDepthMetric.record(microsSince(start));
 	origMethod(self, dsv, flags, depth, stencil);
 }
 
 
 void presentCallback(void* chain)
 {	
+	auto start = std::chrono::steady_clock::now();
 	FILE* f = fopen(logFilePath, "a");
 	std::chrono::milliseconds ms = std::chrono::duration_cast< std::chrono::milliseconds >(
 		std::chrono::system_clock::now().time_since_epoch()
@@ -389,4 +352,5 @@ void presentCallback(void* chain)
 		);
 
 	fclose(f);
+	presentMetric.record(microsSince(start));
 }
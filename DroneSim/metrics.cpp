@@ -0,0 +1,190 @@
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+// Metrics are never removed, so references handed out stay valid. Built on
+// first use, so metrics may be looked up from other files' static
+// initializers.
+struct Registry {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::mutex mtx;
+	std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+	std::map<std::string, std::unique_ptr<MetricGauge>> gauges;
+	std::map<std::string, std::unique_ptr<MetricHistogram>> histograms;
+};
+
+static Registry& registry()
+{
+	static Registry r;
+	return r;
+}
+
+static void raiseMax(std::atomic<int64_t>& max, int64_t v)
+{
+	int64_t seen = max.load(std::memory_order_relaxed);
+	while (v > seen && !max.compare_exchange_weak(seen, v, std::memory_order_relaxed)) {
+	}
+}
+
+void MetricGauge::set(int64_t v)
+{
+	value_.store(v, std::memory_order_relaxed);
+	raiseMax(max_, v);
+}
+
+void MetricGauge::add(int64_t n)
+{
+	raiseMax(max_, value_.fetch_add(n, std::memory_order_relaxed) + n);
+}
+
+int MetricHistogram::bucketOf(int64_t v)
+{
+	if (v < (1 << subBits)) return v < 0 ? 0 : (int)v;
+	int exponent = subBits;
+	while (exponent < 62 && (v >> (exponent + 1)) != 0) ++exponent;
+	if (exponent > maxExponent) return bucketCount - 1;
+	int sub = (int)(v >> (exponent - subBits)) & ((1 << subBits) - 1);
+	return ((exponent - subBits + 1) << subBits) + sub;
+}
+
+int64_t MetricHistogram::bucketLow(int bucket)
+{
+	if (bucket < (1 << subBits)) return bucket;
+	int exponent = (bucket >> subBits) + subBits - 1;
+	int sub = bucket & ((1 << subBits) - 1);
+	return (int64_t)((1 << subBits) + sub) << (exponent - subBits);
+}
+
+void MetricHistogram::record(int64_t v)
+{
+	if (v < 0) v = 0;
+	buckets_[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(v, std::memory_order_relaxed);
+	raiseMax(max_, v);
+	count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+double MetricHistogram::mean() const
+{
+	uint64_t n = count();
+	return n > 0 ? (double)sum_.load(std::memory_order_relaxed) / n : 0.0;
+}
+
+double MetricHistogram::quantile(double q) const
+{
+	// Buckets are read one by one while other threads record, so their sum
+	// may differ slightly from count_; rank against the sum.
+	uint64_t total = 0;
+	for (const auto& b : buckets_) total += b.load(std::memory_order_relaxed);
+	if (total == 0) return 0.0;
+	uint64_t rank = (uint64_t)(q * total);
+	if (rank >= total) rank = total - 1;
+	uint64_t seen = 0;
+	for (int b = 0; b < bucketCount; ++b) {
+		uint64_t n = buckets_[b].load(std::memory_order_relaxed);
+		if (seen + n > rank) {
+			// midpoint of the bucket, but never past the largest value seen
+			int64_t lo = bucketLow(b);
+			int64_t hi = b + 1 < bucketCount ? bucketLow(b + 1) : lo + 1;
+			double v = lo + (hi - lo - 1) * 0.5;
+			return std::min(v, (double)max());
+		}
+		seen += n;
+	}
+	return (double)max();
+}
+
+template<typename T>
+static T& lookup(std::map<std::string, std::unique_ptr<T>>& metrics, const std::string& name)
+{
+	std::lock_guard<std::mutex> lk(registry().mtx);
+	auto& slot = metrics[name];
+	if (!slot) slot.reset(new T());
+	return *slot;
+}
+
+MetricCounter& metricCounter(const std::string& name)
+{
+	return lookup(registry().counters, name);
+}
+
+MetricGauge& metricGauge(const std::string& name)
+{
+	return lookup(registry().gauges, name);
+}
+
+MetricHistogram& metricHistogram(const std::string& name)
+{
+	return lookup(registry().histograms, name);
+}
+
+std::string metricHistogramJson(const MetricHistogram& h)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1);
+	ss << "{\"count\":" << h.count() << ",\"mean\":" << h.mean() << ",\"p50\":" << h.quantile(0.5)
+		<< ",\"p90\":" << h.quantile(0.9) << ",\"p99\":" << h.quantile(0.99) << ",\"p999\":" << h.quantile(0.999)
+		<< ",\"max\":" << h.max() << "}";
+	return ss.str();
+}
+
+std::string metricsJson()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lk(r.mtx);
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1);
+	ss << "{\"uptime_s\":" << std::chrono::duration<double>(std::chrono::steady_clock::now() - r.start).count();
+	ss << ",\"counters\":{";
+	const char* sep = "";
+	for (const auto& m : r.counters) {
+		ss << sep << "\"" << m.first << "\":" << m.second->value();
+		sep = ",";
+	}
+	ss << "},\"gauges\":{";
+	sep = "";
+	for (const auto& m : r.gauges) {
+		ss << sep << "\"" << m.first << "\":{\"value\":" << m.second->value() << ",\"max\":" << m.second->max() << "}";
+		sep = ",";
+	}
+	ss << "},\"histograms\":{";
+	sep = "";
+	for (const auto& m : r.histograms) {
+		ss << sep << "\"" << m.first << "\":" << metricHistogramJson(*m.second);
+		sep = ",";
+	}
+	ss << "}}";
+	return ss.str();
+}
+
+bool parseStatsLogCommand(const std::string& command, std::string& path, double& intervalSeconds)
+{
+	std::istringstream ss(command);
+	std::string name;
+	if (!(ss >> name >> path) || name != "STATS_LOG") return false;
+	if (path == "OFF") {
+		path.clear();
+		std::string extra;
+		return !(ss >> extra);
+	}
+	intervalSeconds = 10.0;
+	for (std::string tok; ss >> tok;) {
+		size_t eq = tok.find('=');
+		if (eq == std::string::npos || tok.substr(0, eq) != "interval") return false;
+		size_t used = 0;
+		try {
+			intervalSeconds = std::stod(tok.substr(eq + 1), &used);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		if (used != tok.size() - eq - 1) return false;
+	}
+	return intervalSeconds > 0.0 && std::isfinite(intervalSeconds);
+}
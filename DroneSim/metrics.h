@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Process-wide metrics for long unattended runs: named counters, gauges and
+// latency histograms updated lock-free from the server, script and render
+// threads. Look a metric up once and keep the reference; lookups take a
+// lock, updates do not:
+//
+//	static MetricCounter& sent = metricCounter("server.bytes_sent");
+//	sent.add(n);
+class MetricCounter {
+public:
+	void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value_{ 0 };
+};
+
+class MetricGauge {
+public:
+	void set(int64_t v);
+	void add(int64_t n);
+	int64_t value() const { return value_.load(std::memory_order_relaxed); }
+	int64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> value_{ 0 };
+	std::atomic<int64_t> max_{ 0 };
+};
+
+// HDR-style histogram of non-negative integer values (microseconds by
+// convention): values below 2^subBits are exact, larger ones fall into
+// 2^subBits linear sub-buckets per power of two, so every bucket is within
+// 1 / 2^subBits of its values. Values past 2^maxExponent are clamped.
+class MetricHistogram {
+public:
+	static const int subBits = 3;
+	static const int maxExponent = 40;	// 2^40 us is about 12 days
+	static const int bucketCount = (maxExponent - subBits + 2) << subBits;
+
+	void record(int64_t v);
+	uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+	int64_t max() const { return max_.load(std::memory_order_relaxed); }
+	double mean() const;
+	// Value below which a fraction q of the recorded values lie, at bucket
+	// resolution.
+	double quantile(double q) const;
+
+	static int bucketOf(int64_t v);
+	static int64_t bucketLow(int bucket);
+
+private:
+	std::atomic<uint64_t> count_{ 0 };
+	std::atomic<int64_t> sum_{ 0 };
+	std::atomic<int64_t> max_{ 0 };
+	std::atomic<uint64_t> buckets_[bucketCount] = {};
+};
+
+MetricCounter& metricCounter(const std::string& name);
+MetricGauge& metricGauge(const std::string& name);
+MetricHistogram& metricHistogram(const std::string& name);
+
+// {"count":n,"mean":..,"p50":..,"p90":..,"p99":..,"p999":..,"max":..}
+std::string metricHistogramJson(const MetricHistogram& h);
+
+// {"uptime_s":..,"counters":{"name":n,..},"gauges":{"name":{"value":v,"max":m},..},
+// "histograms":{"name":metricHistogramJson,..}} with names sorted.
+std::string metricsJson();
+
+// "STATS_LOG <path> [interval=s]" or "STATS_LOG OFF". With a path set the
+// server appends one metricsJson() line to it every interval seconds.
+bool parseStatsLogCommand(const std::string& command, std::string& path, double& intervalSeconds);
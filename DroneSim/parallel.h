@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Splits [begin, end) into contiguous blocks, one per hardware thread, and
+// runs fn(blockBegin, blockEnd) on each, the last block on the calling thread.
+// Ranges shorter than two minBlock are run inline.
+template<typename Fn>
+void parallelFor(int begin, int end, Fn fn, int minBlock = 16)
+{
+	int count = end - begin;
+	if (count <= 0) return;
+	int workers = (int)std::max(1u, std::thread::hardware_concurrency());
+	workers = std::min(workers, std::max(1, count / std::max(1, minBlock)));
+	if (workers == 1) {
+		fn(begin, end);
+		return;
+	}
+	std::vector<std::thread> threads;
+	threads.reserve(workers - 1);
+	int block = (count + workers - 1) / workers;
+	for (int b = begin; b < end; b += block) {
+		int e = std::min(end, b + block);
+		if (e == end) fn(b, e);
+		else threads.emplace_back(fn, b, e);
+	}
+	for (auto& t : threads) t.join();
+}
+
+// For items of uneven cost (files, frames): each of the workers starts on its
+// own contiguous share of [begin, end) and takes items from the front of it;
+// a worker that runs out steals the back half of the largest remaining share.
+// Runs fn(item, worker) with worker in [0, workers), so callers can keep
+// per-worker scratch. workers <= 0 means one per hardware thread.
+template<typename Fn>
+void parallelForStealing(int begin, int end, Fn fn, int workers = 0)
+{
+	int count = end - begin;
+	if (count <= 0) return;
+	if (workers <= 0) workers = (int)std::max(1u, std::thread::hardware_concurrency());
+	workers = std::min(workers, count);
+	struct Share {
+		std::mutex mtx;
+		int next = 0;
+		int end = 0;
+	};
+	std::unique_ptr<Share[]> shares(new Share[workers]);
+	for (int w = 0; w < workers; ++w) {
+		shares[w].next = begin + (int)((long long)count * w / workers);
+		shares[w].end = begin + (int)((long long)count * (w + 1) / workers);
+	}
+	auto run = [&](int w) {
+		Share& own = shares[w];
+		while (true) {
+			int item = -1;
+			{
+				std::lock_guard<std::mutex> lk(own.mtx);
+				if (own.next < own.end) item = own.next++;
+			}
+			if (item >= 0) {
+				fn(item, w);
+				continue;
+			}
+			// steal from whoever has the most left
+			int victim = -1, most = 0;
+			for (int v = 0; v < workers; ++v) {
+				if (v == w) continue;
+				std::lock_guard<std::mutex> lk(shares[v].mtx);
+				if (shares[v].end - shares[v].next > most) {
+					most = shares[v].end - shares[v].next;
+					victim = v;
+				}
+			}
+			if (victim < 0) return;
+			int from, to;
+			{
+				std::lock_guard<std::mutex> lk(shares[victim].mtx);
+				int left = shares[victim].end - shares[victim].next;
+				if (left <= 0) continue;
+				to = shares[victim].end;
+				from = to - (left + 1) / 2;
+				shares[victim].end = from;
+			}
+			std::lock_guard<std::mutex> lk(own.mtx);
+			own.next = from;
+			own.end = to;
+		}
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(workers - 1);
+	for (int w = 1; w < workers; ++w) threads.emplace_back(run, w);
+	run(0);
+	for (auto& t : threads) t.join();
+}
@@ -0,0 +1,37 @@
+#include "pixels.h"
+#include "parallel.h"
+#include <cstdint>
+#include <cstring>
+
+void splitDepthStencil(const unsigned char* src, size_t rowPitch, int width, int height,
+	float* depth, unsigned char* stencil)
+{
+	parallelFor(0, height, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			const unsigned char* row = src + rowPitch * y;
+			float* d = depth + (size_t)width * y;
+			unsigned char* s = stencil + (size_t)width * y;
+			for (int x = 0; x < width; ++x) {
+				memcpy(&d[x], row + x * 8, 4);
+				s[x] = row[x * 8 + 4];
+			}
+		}
+	}, 64);
+}
+
+void swizzleBgraToRgba(const unsigned char* src, size_t rowPitch, int width, int height, unsigned char* rgba)
+{
+	parallelFor(0, height, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			const unsigned char* row = src + rowPitch * y;
+			unsigned char* out = rgba + (size_t)width * 4 * y;
+			for (int x = 0; x < width; ++x) {
+				// swap the B and R bytes of the little-endian texel
+				uint32_t v;
+				memcpy(&v, row + x * 4, 4);
+				v = (v & 0xFF00FF00u) | ((v >> 16) & 0xFFu) | ((v & 0xFFu) << 16);
+				memcpy(out + x * 4, &v, 4);
+			}
+		}
+	}, 64);
+}
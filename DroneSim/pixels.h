@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+// CPU-side conversion of the mapped D3D read-back textures into the layouts
+// CapturedFrame keeps. Source rows are rowPitch bytes apart (the driver pads
+// them); destinations are tightly packed, row-major.
+
+// DXGI_FORMAT_R32G8X24 depth/stencil, 8 bytes per texel: the float depth
+// followed by the stencil byte. Splits it into a depth and a stencil plane.
+void splitDepthStencil(const unsigned char* src, size_t rowPitch, int width, int height,
+	float* depth, unsigned char* stencil);
+
+// DXGI_FORMAT_B8G8R8A8 back buffer to RGBA8.
+void swizzleBgraToRgba(const unsigned char* src, size_t rowPitch, int width, int height, unsigned char* rgba);
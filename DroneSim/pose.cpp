@@ -0,0 +1,77 @@
+#include "pose.h"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+
+bool parseSetPose(const std::string& cmd, CameraPose& pose, bool& hasFov)
+{
+	std::istringstream ss(cmd);
+	std::string name;
+	ss >> name;
+	if (name != "SET_POSE") return false;
+	float v[7];
+	int n = 0;
+	std::string tok;
+	while (n < 7 && ss >> tok) {
+		size_t used = 0;
+		try {
+			v[n] = std::stof(tok, &used);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		if (used != tok.size() || !std::isfinite(v[n++])) return false;
+	}
+	if (n < 6 || ss >> tok) return false;
+	pose.x = v[0];
+	pose.y = v[1];
+	pose.z = v[2];
+	pose.pitch = v[3];
+	pose.roll = v[4];
+	pose.yaw = v[5];
+	hasFov = n == 7;
+	if (hasFov) pose.fov = v[6];
+	return true;
+}
+
+std::string formatCameraPose(const CameraPose& pose)
+{
+	char buf[160];
+	snprintf(buf, sizeof(buf), "%.4f %.4f %.4f %.4f %.4f %.4f %.4f",
+		pose.x, pose.y, pose.z, pose.pitch, pose.roll, pose.yaw, pose.fov);
+	return buf;
+}
+
+static std::mutex pose_mtx;
+static std::condition_variable pose_cv;
+static unsigned int poseTickets = 0;
+static unsigned int posesPublished = 0;
+static CameraPose publishedPose;
+
+unsigned int requestCameraPoseTicket()
+{
+	std::lock_guard<std::mutex> lk(pose_mtx);
+	return ++poseTickets;
+}
+
+void publishCameraPose(const CameraPose& pose)
+{
+	{
+		std::lock_guard<std::mutex> lk(pose_mtx);
+		publishedPose = pose;
+		++posesPublished;
+	}
+	pose_cv.notify_all();
+}
+
+bool waitCameraPose(unsigned int ticket, CameraPose& pose, int timeoutMs)
+{
+	std::unique_lock<std::mutex> lk(pose_mtx);
+	if (!pose_cv.wait_for(lk, std::chrono::milliseconds(timeoutMs), [&] { return posesPublished >= ticket; }))
+		return false;
+	pose = publishedPose;
+	return true;
+}
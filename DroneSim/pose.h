@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+// Absolute scripted-camera pose as the game reports it: position in world
+// metres, rotation in degrees (rotation order 2), vertical fov in degrees.
+struct CameraPose {
+	float x, y, z;
+	float pitch, roll, yaw;
+	float fov;
+};
+
+// "SET_POSE x y z pitch roll yaw [fov]"; fov keeps its current value when omitted.
+// Values must be finite numbers.
+bool parseSetPose(const std::string& cmd, CameraPose& pose, bool& hasFov);
+std::string formatCameraPose(const CameraPose& pose);
+
+// GET_POSE hand-off between the server thread and the script thread. The
+// server takes a ticket before queueing GET_POSE; the script thread publishes
+// the pose when it reaches that command, in queue order. A zero timeout only
+// checks, for callers that cannot block.
+unsigned int requestCameraPoseTicket();
+void publishCameraPose(const CameraPose& pose);
+bool waitCameraPose(unsigned int ticket, CameraPose& pose, int timeoutMs);
@@ -0,0 +1,400 @@
+#include "poseindex.h"
+#include "dataset.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+using Eigen::Map;
+using Eigen::Matrix3f;
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+
+static const float DEG2RAD = 0.01745329f;
+static const float RAD2DEG = 57.2957795f;
+static const char indexMagic[8] = { 'D', 'S', 'I', 'M', 'P', 'O', 'S', '\0' };
+static const uint32_t indexVersion = 1;
+// Traversal stack entries; load rejects trees deeper than maxTreeDepth, which
+// median splits reach only past 2^40 entries.
+static const int traversalStack = 64;
+static const uint32_t maxTreeDepth = 48;
+
+PoseEntry makePoseEntry(const rage_matrices& matrices, float farDistance)
+{
+	PoseEntry e = {};
+	const Matrix3f R = matrices.Vinv.topLeftCorner<3, 3>();
+	const Vector3f position = matrices.Vinv.block<3, 1>(0, 3);
+	const Matrix4f P = projectionFromMatrices(matrices);
+	Map<Vector3f>(e.position) = position;
+	Map<Matrix3f>(e.rotation) = R;
+	e.projection[0] = std::abs(P(0, 0)) > 1e-6f ? P(0, 0) : 1.0f;
+	e.projection[1] = P(0, 2);
+	e.projection[2] = std::abs(P(1, 1)) > 1e-6f ? P(1, 1) : 1.0f;
+	e.projection[3] = P(1, 2);
+	const Vector3f forward = -R.col(2).normalized();
+	e.yaw = std::atan2(-forward.x(), forward.y()) * RAD2DEG;
+	e.pitch = std::asin(std::max(-1.0f, std::min(1.0f, forward.z()))) * RAD2DEG;
+
+	// the pyramid from the camera to the corners of the far cut
+	Vector3f lo = position, hi = position;
+	for (int c = 0; c < 4; ++c) {
+		float nx = c & 1 ? 1.0f : -1.0f, ny = c & 2 ? 1.0f : -1.0f;
+		Vector3f corner(farDistance * (nx + e.projection[1]) / e.projection[0],
+			farDistance * (ny + e.projection[3]) / e.projection[2], -farDistance);
+		Vector3f world = position + R * corner;
+		lo = lo.cwiseMin(world);
+		hi = hi.cwiseMax(world);
+	}
+	Map<Vector3f>(e.frustumMin) = lo;
+	Map<Vector3f>(e.frustumMax) = hi;
+	return e;
+}
+
+Vector3f poseForward(float yaw, float pitch)
+{
+	const float y = yaw * DEG2RAD, p = pitch * DEG2RAD;
+	return Vector3f(-std::sin(y) * std::cos(p), std::cos(y) * std::cos(p), std::sin(p));
+}
+
+std::string posesPathFor(const std::string& datasetPath)
+{
+	return datasetPath + ".poses";
+}
+
+static Vector3f entryForward(const PoseEntry& e)
+{
+	return -Vector3f(e.rotation[6], e.rotation[7], e.rotation[8]).normalized();
+}
+
+// Squared distance from p to the box, 0 inside.
+static float boxDistance2(const float* lo, const float* hi, const Vector3f& p)
+{
+	float d2 = 0.0f;
+	for (int a = 0; a < 3; ++a) {
+		float d = std::max(std::max(lo[a] - p[a], p[a] - hi[a]), 0.0f);
+		d2 += d * d;
+	}
+	return d2;
+}
+
+static uint32_t subtreeNodes(uint32_t count, uint32_t leafSize)
+{
+	return count <= leafSize ? 1 : 1 + subtreeNodes(count / 2, leafSize) + subtreeNodes(count - count / 2, leafSize);
+}
+
+namespace {
+struct TreeBuilder {
+	std::vector<PoseEntry>& entries;
+	std::vector<PoseNode>& nodes;
+	uint32_t leafSize;
+	int parallelDepth;
+
+	void build(uint32_t index, uint32_t first, uint32_t count, int depth)
+	{
+		PoseNode& node = nodes[index];
+		Map<Vector3f> posLo(node.positionMin), posHi(node.positionMax), frLo(node.frustumMin), frHi(node.frustumMax);
+		posLo.setConstant(INFINITY);
+		posHi.setConstant(-INFINITY);
+		frLo.setConstant(INFINITY);
+		frHi.setConstant(-INFINITY);
+		for (uint32_t i = first; i < first + count; ++i) {
+			const PoseEntry& e = entries[i];
+			posLo = posLo.cwiseMin(Map<const Vector3f>(e.position));
+			posHi = posHi.cwiseMax(Map<const Vector3f>(e.position));
+			frLo = frLo.cwiseMin(Map<const Vector3f>(e.frustumMin));
+			frHi = frHi.cwiseMax(Map<const Vector3f>(e.frustumMax));
+		}
+		node.first = first;
+		node.count = count;
+		node.right = 0;
+		node.axis = 0;
+		if (count <= leafSize) return;
+
+		Vector3f extent = posHi - posLo;
+		int axis = 0;
+		extent.maxCoeff(&axis);
+		node.axis = (uint32_t)axis;
+		uint32_t half = count / 2;
+		std::nth_element(entries.begin() + first, entries.begin() + first + half, entries.begin() + first + count,
+			[axis](const PoseEntry& a, const PoseEntry& b) { return a.position[axis] < b.position[axis]; });
+		uint32_t left = index + 1;
+		uint32_t right = left + subtreeNodes(half, leafSize);
+		node.right = right;
+		if (depth < parallelDepth) {
+			std::thread t(&TreeBuilder::build, this, left, first, half, depth + 1);
+			build(right, first + half, count - half, depth + 1);
+			t.join();
+		}
+		else {
+			build(left, first, half, depth + 1);
+			build(right, first + half, count - half, depth + 1);
+		}
+	}
+};
+}
+
+void PoseIndex::build(std::vector<PoseEntry> entries, float farDistance, int threads, int leafSize)
+{
+	entries_ = std::move(entries);
+	farDistance_ = farDistance;
+	leafSize_ = (uint32_t)std::max(1, leafSize);
+	nodes_.clear();
+	if (entries_.empty()) return;
+	if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+	int parallelDepth = 0;
+	while ((1 << parallelDepth) < threads) ++parallelDepth;
+	nodes_.resize(subtreeNodes((uint32_t)entries_.size(), leafSize_));
+	TreeBuilder builder{ entries_, nodes_, leafSize_, parallelDepth };
+	builder.build(0, 0, (uint32_t)entries_.size(), 0);
+}
+
+bool PoseIndex::build(const std::vector<std::string>& datasets, float farDistance, std::string& error, int threads,
+	int leafSize)
+{
+	std::vector<PoseEntry> entries;
+	std::vector<uint32_t> frames;
+	for (size_t d = 0; d < datasets.size(); ++d) {
+		DatasetReader reader;
+		if (!reader.open(datasets[d], error)) return false;
+		size_t base = entries.size();
+		entries.resize(base + reader.frameCount());
+		frames.push_back((uint32_t)reader.frameCount());
+		std::mutex error_mtx;
+		std::string firstError;
+		parallelFor(0, (int)reader.frameCount(), [&](int f0, int f1) {
+			DatasetChannel matrices;
+			std::string err;
+			for (int f = f0; f < f1; ++f) {
+				if (!reader.channel(f, "MATX", matrices, err) || matrices.size != sizeof(rage_matrices)) {
+					std::lock_guard<std::mutex> lk(error_mtx);
+					if (firstError.empty()) firstError = datasets[d] + ": frame " + std::to_string(f) + " has no matrices " + err;
+					return;
+				}
+				PoseEntry& e = entries[base + f];
+				e = makePoseEntry(matricesFromFloats((const float*)matrices.data), farDistance);
+				e.dataset = (uint32_t)d;
+				e.frame = (uint32_t)f;
+				e.frameId = reader.frame(f).frameId;
+				e.timestamp = reader.frame(f).timestamp;
+			}
+		}, 256);
+		if (!firstError.empty()) {
+			error = firstError;
+			return false;
+		}
+	}
+	build(std::move(entries), farDistance, threads, leafSize);
+	datasets_ = datasets;
+	datasetFrames_ = frames;
+	return true;
+}
+
+bool PoseIndex::save(const std::string& path, std::string& error) const
+{
+	namespace fs = std::filesystem;
+	FILE* f = fopen(path.c_str(), "wb");
+	if (f == nullptr) {
+		error = "cannot create " + path;
+		return false;
+	}
+	uint32_t header[5] = { indexVersion, (uint32_t)datasets_.size(), (uint32_t)entries_.size(), (uint32_t)nodes_.size(),
+		leafSize_ };
+	bool ok = fwrite(indexMagic, 1, sizeof(indexMagic), f) == sizeof(indexMagic)
+		&& fwrite(header, sizeof(header), 1, f) == 1 && fwrite(&farDistance_, sizeof(float), 1, f) == 1;
+	fs::path base = fs::absolute(fs::path(path)).parent_path();
+	for (size_t d = 0; ok && d < datasets_.size(); ++d) {
+		std::string rel = fs::absolute(datasets_[d]).lexically_proximate(base).generic_string();
+		uint32_t sizes[2] = { d < datasetFrames_.size() ? datasetFrames_[d] : 0, (uint32_t)rel.size() };
+		ok = fwrite(sizes, sizeof(sizes), 1, f) == 1 && fwrite(rel.data(), 1, rel.size(), f) == rel.size();
+	}
+	ok = ok && fwrite(entries_.data(), sizeof(PoseEntry), entries_.size(), f) == entries_.size()
+		&& fwrite(nodes_.data(), sizeof(PoseNode), nodes_.size(), f) == nodes_.size();
+	ok = fclose(f) == 0 && ok;
+	if (!ok) error = "write to " + path + " failed";
+	return ok;
+}
+
+bool PoseIndex::load(const std::string& path, std::string& error)
+{
+	namespace fs = std::filesystem;
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == nullptr) {
+		error = "cannot open " + path;
+		return false;
+	}
+	char magic[8];
+	uint32_t header[5];
+	float farDistance;
+	bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, indexMagic, sizeof(magic)) == 0
+		&& fread(header, sizeof(header), 1, f) == 1 && header[0] == indexVersion && fread(&farDistance, sizeof(float), 1, f) == 1;
+	std::vector<std::string> datasets;
+	std::vector<uint32_t> frames;
+	fs::path base = fs::absolute(fs::path(path)).parent_path();
+	for (uint32_t d = 0; ok && d < header[1]; ++d) {
+		uint32_t sizes[2];
+		ok = fread(sizes, sizeof(sizes), 1, f) == 1 && sizes[1] < 4096;
+		std::string rel(ok ? sizes[1] : 0, '\0');
+		ok = ok && fread(&rel[0], 1, rel.size(), f) == rel.size();
+		if (!ok) break;
+		frames.push_back(sizes[0]);
+		fs::path p(rel);
+		datasets.push_back((p.is_absolute() ? p : (base / p).lexically_normal()).string());
+	}
+	std::vector<PoseEntry> entries;
+	std::vector<PoseNode> nodes;
+	if (ok) {
+		// the arrays must fit in what is left of the file before allocating them
+		std::error_code ec;
+		uint64_t fileBytes = fs::file_size(path, ec);
+		long at = ftell(f);
+		ok = !ec && at >= 0
+			&& (uint64_t)header[2] * sizeof(PoseEntry) + (uint64_t)header[3] * sizeof(PoseNode) <= fileBytes - (uint64_t)at;
+	}
+	if (ok) {
+		entries.resize(header[2]);
+		nodes.resize(header[3]);
+		ok = fread(entries.data(), sizeof(PoseEntry), entries.size(), f) == entries.size()
+			&& fread(nodes.data(), sizeof(PoseNode), nodes.size(), f) == nodes.size();
+	}
+	fclose(f);
+	// Entry ranges stay inside the array, the root covers every entry, children
+	// follow their parent, have no other parent and split its range in two, and
+	// the tree is shallow enough for the traversal stacks.
+	ok = ok && (nodes.empty() ? entries.empty() : nodes[0].first == 0 && nodes[0].count == entries.size());
+	std::vector<uint32_t> depth(nodes.size(), 0);
+	std::vector<bool> linked(nodes.size(), false);
+	for (size_t i = 0; ok && i < nodes.size(); ++i) {
+		const PoseNode& n = nodes[i];
+		ok = (uint64_t)n.first + n.count <= entries.size() && depth[i] < maxTreeDepth;
+		if (!ok || n.right == 0) continue;
+		ok = i + 1 < nodes.size() && n.right > i + 1 && n.right < nodes.size() && !linked[i + 1] && !linked[n.right];
+		if (!ok) break;
+		const PoseNode& left = nodes[i + 1];
+		const PoseNode& right = nodes[n.right];
+		ok = left.first == n.first && right.first == (uint64_t)left.first + left.count
+			&& (uint64_t)left.count + right.count == n.count;
+		linked[i + 1] = linked[n.right] = true;
+		depth[i + 1] = depth[n.right] = depth[i] + 1;
+	}
+	if (!ok) {
+		error = path + " is not a pose index or is damaged";
+		return false;
+	}
+	entries_.swap(entries);
+	nodes_.swap(nodes);
+	datasets_.swap(datasets);
+	datasetFrames_.swap(frames);
+	leafSize_ = header[4];
+	farDistance_ = farDistance;
+	return true;
+}
+
+void PoseIndex::radius(const Vector3f& centre, float radius, std::vector<uint32_t>& out, float yaw,
+	float yawTolerance) const
+{
+	out.clear();
+	if (nodes_.empty()) return;
+	const float r2 = radius * radius;
+	const bool anyYaw = yawTolerance >= 180.0f;
+	uint32_t stack[traversalStack];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const PoseNode& n = nodes_[stack[--top]];
+		if (boxDistance2(n.positionMin, n.positionMax, centre) > r2) continue;
+		if (n.right != 0) {
+			if (top + 2 > traversalStack) continue;		// deeper than load accepts
+			stack[top++] = n.right;
+			stack[top++] = (uint32_t)(&n - nodes_.data()) + 1;
+			continue;
+		}
+		for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+			const PoseEntry& e = entries_[i];
+			if ((Map<const Vector3f>(e.position) - centre).squaredNorm() > r2) continue;
+			if (!anyYaw) {
+				float diff = std::fmod(std::abs(e.yaw - yaw), 360.0f);
+				if (std::min(diff, 360.0f - diff) > yawTolerance) continue;
+			}
+			out.push_back(i);
+		}
+	}
+}
+
+void PoseIndex::nearest(const Vector3f& position, const Vector3f& forward, size_t k, float metresPerRadian,
+	std::vector<std::pair<float, uint32_t>>& out) const
+{
+	out.clear();
+	if (nodes_.empty() || k == 0) return;
+	const Vector3f f = forward.normalized();
+	const float w2 = metresPerRadian * metresPerRadian;
+	// nodes by the position bound, nearest first; the angle term only adds
+	typedef std::pair<float, uint32_t> Item;
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item>> frontier;
+	std::priority_queue<Item> best;		// the k nearest so far, worst on top
+	frontier.push(Item(boxDistance2(nodes_[0].positionMin, nodes_[0].positionMax, position), 0));
+	while (!frontier.empty()) {
+		Item item = frontier.top();
+		frontier.pop();
+		if (best.size() == k && item.first >= best.top().first) break;
+		const PoseNode& n = nodes_[item.second];
+		if (n.right != 0) {
+			uint32_t children[2] = { item.second + 1, n.right };
+			for (uint32_t c : children) {
+				float d2 = boxDistance2(nodes_[c].positionMin, nodes_[c].positionMax, position);
+				if (best.size() < k || d2 < best.top().first) frontier.push(Item(d2, c));
+			}
+			continue;
+		}
+		for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+			const PoseEntry& e = entries_[i];
+			float angle = std::acos(std::max(-1.0f, std::min(1.0f, entryForward(e).dot(f))));
+			float d2 = (Map<const Vector3f>(e.position) - position).squaredNorm() + w2 * angle * angle;
+			if (best.size() < k) best.push(Item(d2, i));
+			else if (d2 < best.top().first) {
+				best.pop();
+				best.push(Item(d2, i));
+			}
+		}
+	}
+	out.resize(best.size());
+	for (size_t i = out.size(); i-- > 0; best.pop()) out[i] = Item(std::sqrt(best.top().first), best.top().second);
+}
+
+void PoseIndex::seeing(const Vector3f& point, std::vector<uint32_t>& out) const
+{
+	out.clear();
+	if (nodes_.empty()) return;
+	auto inside = [&](const float* lo, const float* hi) {
+		return point.x() >= lo[0] && point.x() <= hi[0] && point.y() >= lo[1] && point.y() <= hi[1]
+			&& point.z() >= lo[2] && point.z() <= hi[2];
+	};
+	uint32_t stack[traversalStack];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t index = stack[--top];
+		const PoseNode& n = nodes_[index];
+		if (!inside(n.frustumMin, n.frustumMax)) continue;
+		if (n.right != 0) {
+			if (top + 2 > traversalStack) continue;		// deeper than load accepts
+			stack[top++] = n.right;
+			stack[top++] = index + 1;
+			continue;
+		}
+		for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+			const PoseEntry& e = entries_[i];
+			if (!inside(e.frustumMin, e.frustumMax)) continue;
+			Vector3f c = Map<const Matrix3f>(e.rotation).transpose() * (point - Map<const Vector3f>(e.position));
+			float depth = -c.z();
+			if (depth <= 0.0f || depth > farDistance_) continue;
+			float nx = (e.projection[0] * c.x() + e.projection[1] * c.z()) / depth;
+			float ny = (e.projection[2] * c.y() + e.projection[3] * c.z()) / depth;
+			if (std::abs(nx) <= 1.0f && std::abs(ny) <= 1.0f) out.push_back(i);
+		}
+	}
+}
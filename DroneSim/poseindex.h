@@ -0,0 +1,100 @@
+#pragma once
+#include "frame.h"
+#include <Eigen/Core>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Spatial index over the camera poses of one or more .dsq datasets, for view
+// selection: frames near a point facing a direction, the views closest to a
+// pose, the views whose frustum holds a point.
+//
+// A static KD-tree over camera positions (median splits on the widest axis,
+// up to leafSize frames per leaf) whose nodes also bound the frusta below
+// them, so the same tree serves as a BVH for frustum queries. Frusta are
+// cut at farDistance metres.
+//
+// Saved next to the datasets (posesPathFor) as
+//	header    "DSIMPOS\0", u32 version, u32 datasets, u32 entries, u32 nodes,
+//	          u32 leaf size, f32 far distance
+//	datasets  u32 frame count, u32 path bytes, path (relative to the index)
+//	entries   PoseEntry[entries], in tree order
+//	nodes     PoseNode[nodes], preorder: a node's left child follows it
+//
+// Yaw and pitch follow SET_POSE: degrees, yaw 0 facing +y (north), 90 facing
+// -x, pitch up positive.
+#pragma pack(push, 1)
+struct PoseEntry {
+	float position[3];
+	float rotation[9];		// camera to world, column-major (Vinv's upper left)
+	float projection[4];	// P00, P02, P11, P12
+	float yaw;
+	float pitch;
+	float frustumMin[3];
+	float frustumMax[3];
+	uint32_t dataset;
+	uint32_t frame;			// position in the dataset, for DatasetReader
+	uint32_t frameId;
+	uint32_t reserved;
+	int64_t timestamp;
+};
+
+struct PoseNode {
+	float positionMin[3];
+	float positionMax[3];
+	float frustumMin[3];
+	float frustumMax[3];
+	uint32_t first;			// entries [first, first + count)
+	uint32_t count;
+	uint32_t right;			// right child, 0 for a leaf
+	uint32_t axis;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PoseEntry) == 120, "pose entry is 120 bytes");
+static_assert(sizeof(PoseNode) == 64, "pose node is 64 bytes");
+
+// Camera looking along -z, as the game's projection does.
+PoseEntry makePoseEntry(const rage_matrices& matrices, float farDistance);
+Eigen::Vector3f poseForward(float yaw, float pitch);
+
+// "<dataset>.poses"
+std::string posesPathFor(const std::string& datasetPath);
+
+class PoseIndex {
+public:
+	// Reads the matrices of every frame of the datasets and builds the tree,
+	// both on threads workers (0: one per hardware thread).
+	bool build(const std::vector<std::string>& datasets, float farDistance, std::string& error, int threads = 0,
+		int leafSize = 8);
+	// Bulk load from ready entries.
+	void build(std::vector<PoseEntry> entries, float farDistance, int threads = 0, int leafSize = 8);
+	bool save(const std::string& path, std::string& error) const;
+	bool load(const std::string& path, std::string& error);
+
+	// Frames within radius metres of centre, optionally only those whose yaw
+	// is within yawTolerance degrees of yaw (180 accepts any). Unordered.
+	void radius(const Eigen::Vector3f& centre, float radius, std::vector<uint32_t>& out, float yaw = 0.0f,
+		float yawTolerance = 180.0f) const;
+	// The k views nearest a pose by sqrt(metres^2 + (metresPerRadian * angle)^2),
+	// angle being between the view directions; nearest first, as (distance, entry).
+	void nearest(const Eigen::Vector3f& position, const Eigen::Vector3f& forward, size_t k, float metresPerRadian,
+		std::vector<std::pair<float, uint32_t>>& out) const;
+	// Frames whose frustum holds the point.
+	void seeing(const Eigen::Vector3f& point, std::vector<uint32_t>& out) const;
+
+	const std::vector<PoseEntry>& entries() const { return entries_; }
+	const std::vector<PoseNode>& nodes() const { return nodes_; }
+	// Paths as given to build, or as resolved by load.
+	const std::vector<std::string>& datasets() const { return datasets_; }
+	float farDistance() const { return farDistance_; }
+
+private:
+	std::vector<PoseEntry> entries_;
+	std::vector<PoseNode> nodes_;
+	std::vector<std::string> datasets_;
+	std::vector<uint32_t> datasetFrames_;
+	float farDistance_ = 0.0f;
+	uint32_t leafSize_ = 8;
+};
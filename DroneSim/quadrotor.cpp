@@ -0,0 +1,162 @@
+#include "quadrotor.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using Eigen::Matrix3f;
+using Eigen::Quaternionf;
+using Eigen::Vector3f;
+using Eigen::Vector4f;
+
+static const float DEG2RAD = 0.01745329f;
+static const float RAD2DEG = 57.2957795f;
+
+static Vector3f vee(const Matrix3f& m)
+{
+	return Vector3f(m(2, 1), m(0, 2), m(1, 0));
+}
+
+void stepQuadrotor(const QuadrotorParams& params, const QuadrotorSetpoint& setpoint, QuadrotorState& state, float h)
+{
+	const Matrix3f R = state.attitude.toRotationMatrix();
+	const Vector3f J = params.inertia;
+
+	// position loop -> desired acceleration including gravity, tilt limited
+	Vector3f acc = params.kVelocity * (setpoint.velocity - state.velocity);
+	if (setpoint.holdPosition) acc += params.kPosition * (setpoint.position - state.position);
+	acc.z() = std::max(acc.z() + params.gravity, 0.2f * params.gravity);
+	const float maxHorizontal = acc.z() * std::tan(params.maxTilt * DEG2RAD);
+	const float horizontal = std::sqrt(acc.x() * acc.x() + acc.y() * acc.y());
+	if (horizontal > maxHorizontal) {
+		acc.x() *= maxHorizontal / horizontal;
+		acc.y() *= maxHorizontal / horizontal;
+	}
+
+	// desired attitude: thrust along acc, forward (body y) towards the heading
+	const Vector3f b3 = acc.normalized();
+	const float yaw = setpoint.yaw * DEG2RAD;
+	const Vector3f heading(-std::sin(yaw), std::cos(yaw), 0.0f);
+	const Vector3f b1 = heading.cross(b3).normalized();
+	Matrix3f Rd;
+	Rd.col(0) = b1;
+	Rd.col(1) = b3.cross(b1);
+	Rd.col(2) = b3;
+
+	// geometric attitude control on SO(3)
+	const Vector3f eR = 0.5f * vee(Rd.transpose() * R - R.transpose() * Rd);
+	const Vector3f& w = state.angularVelocity;
+	const Vector3f Jw = J.cwiseProduct(w);
+	const Vector3f torque = J.cwiseProduct(-params.kAttitude * eR - params.kRate * w) + w.cross(Jw);
+	const float thrust = params.mass * acc.dot(R.col(2));
+
+	// X mixer; motors 0..3 at front-right, front-left, back-left, back-right
+	const float d = params.armLength * 0.70710678f;
+	const float f = 0.25f * thrust, tx = 0.25f * torque.x() / d, ty = 0.25f * torque.y() / d;
+	// yaw takes only the headroom roll and pitch leave: a saturated yaw
+	// demand would otherwise cost attitude authority and tip the drone over
+	const Vector4f base(f + tx - ty, f + tx + ty, f - tx + ty, f - tx - ty);
+	const float maxT = params.maxMotorThrust;
+	const float yawUp = std::max(0.0f, std::min(std::min(maxT - base[1], maxT - base[3]), std::min(base[0], base[2])));
+	const float yawDown = std::max(0.0f, std::min(std::min(maxT - base[0], maxT - base[2]), std::min(base[1], base[3])));
+	const float tz = std::max(-yawDown, std::min(yawUp, 0.25f * torque.z() / params.yawMomentCoefficient));
+	Vector4f command = base + Vector4f(-tz, tz, -tz, tz);
+	command = command.cwiseMax(0.0f).cwiseMin(params.maxMotorThrust);
+	const float lag = 1.0f - std::exp(-h / params.motorTimeConstant);
+	state.motorThrust += lag * (command - state.motorThrust);
+
+	// forces and moments actually produced by the motors
+	const Vector4f& T = state.motorThrust;
+	const float F = T.sum();
+	const Vector3f tau(d * (T[0] + T[1] - T[2] - T[3]),
+		d * (-T[0] + T[1] + T[2] - T[3]),
+		params.yawMomentCoefficient * (-T[0] + T[1] - T[2] + T[3]));
+
+	const Vector3f bodyVelocity = R.transpose() * state.velocity;
+	const Vector3f drag = R * params.linearDrag.cwiseProduct(bodyVelocity);
+	const Vector3f a = (R.col(2) * F - drag) / params.mass - Vector3f(0.0f, 0.0f, params.gravity);
+	const Vector3f wdot = (tau - w.cross(Jw) - params.angularDrag * w).cwiseQuotient(J);
+
+	state.velocity += a * h;
+	state.position += state.velocity * h;
+	state.angularVelocity += wdot * h;
+	const Vector3f rot = state.angularVelocity * h;
+	const float angle = rot.norm();
+	if (angle > 0.0f) {
+		state.attitude = (state.attitude * Quaternionf(Eigen::AngleAxisf(angle, rot / angle))).normalized();
+	}
+}
+
+Vector3f quadrotorEuler(const Quaternionf& attitude, float gimbalPitch)
+{
+	const Matrix3f R = (attitude * Quaternionf(Eigen::AngleAxisf(gimbalPitch * DEG2RAD, Vector3f::UnitX()))).toRotationMatrix();
+	// R = Rz(yaw) * Rx(pitch) * Ry(roll)
+	const float pitch = std::asin(std::max(-1.0f, std::min(1.0f, R(2, 1))));
+	const float roll = std::atan2(-R(2, 0), R(2, 2));
+	const float yaw = std::atan2(-R(0, 1), R(1, 1));
+	return Vector3f(pitch, roll, yaw) * RAD2DEG;
+}
+
+const float QuadrotorSim::maxFrameTime = 0.25f;
+
+QuadrotorSim::QuadrotorSim(const QuadrotorParams& params, float stepHz)
+	: params_(params), h_(1.0f / stepHz)
+{
+}
+
+void QuadrotorSim::reset(const Vector3f& position, float yaw)
+{
+	QuadrotorState s;
+	s.position = position;
+	s.attitude = Quaternionf(Eigen::AngleAxisf(yaw * DEG2RAD, Vector3f::UnitZ()));
+	s.motorThrust.setConstant(0.25f * params_.mass * params_.gravity);
+	previous_ = current_ = s;
+	accumulator_ = 0.0f;
+	setpoint_ = QuadrotorSetpoint();
+	setpoint_.position = position;
+	setpoint_.yaw = yaw;
+}
+
+int QuadrotorSim::advance(float dt)
+{
+	accumulator_ += std::min(std::max(dt, 0.0f), maxFrameTime);
+	int steps = 0;
+	while (accumulator_ >= h_) {
+		previous_ = current_;
+		if (!setpoint_.holdPosition) {
+			// velocity mode: the heading integrates at the physics rate and the
+			// position target follows, so switching back holds where it is
+			setpoint_.yaw = std::fmod(setpoint_.yaw + setpoint_.yawRate * h_ + 540.0f, 360.0f) - 180.0f;
+			setpoint_.position = current_.position;
+		}
+		stepQuadrotor(params_, setpoint_, current_, h_);
+		accumulator_ -= h_;
+		++steps;
+	}
+	return steps;
+}
+
+QuadrotorState QuadrotorSim::interpolated() const
+{
+	const float alpha = accumulator_ / h_;
+	QuadrotorState s = current_;
+	s.position = previous_.position + alpha * (current_.position - previous_.position);
+	s.velocity = previous_.velocity + alpha * (current_.velocity - previous_.velocity);
+	s.attitude = previous_.attitude.slerp(alpha, current_.attitude);
+	return s;
+}
+
+bool parseDroneGoto(const std::string& command, QuadrotorSetpoint& setpoint)
+{
+	std::istringstream ss(command);
+	std::string name;
+	float x, y, z;
+	if (!(ss >> name >> x >> y >> z) || name != "DRONE_GOTO") return false;
+	float yaw;
+	if (ss >> yaw) setpoint.yaw = yaw;
+	else if (!ss.eof()) return false;
+	setpoint.position = Vector3f(x, y, z);
+	setpoint.velocity.setZero();
+	setpoint.yawRate = 0.0f;
+	setpoint.holdPosition = true;
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <string>
+
+// Rigid-body X-quadrotor in world coordinates (z up, yaw 0 looking along +y).
+// Body axes: x right, y forward, z up (thrust). Units are SI; angles in the
+// setpoint and in quadrotorEuler are degrees like the camera pose.
+struct QuadrotorParams {
+	float mass = 1.5f;
+	float armLength = 0.23f;
+	Eigen::Vector3f inertia = Eigen::Vector3f(0.029f, 0.029f, 0.055f);	// diagonal, kg m^2
+	float maxMotorThrust = 12.0f;		// N per motor
+	float motorTimeConstant = 0.02f;	// s, first-order spin-up lag
+	float yawMomentCoefficient = 0.016f;	// reaction torque per newton of thrust
+	Eigen::Vector3f linearDrag = Eigen::Vector3f(0.25f, 0.25f, 0.4f);	// N per m/s, body axes
+	float angularDrag = 0.002f;		// N m per rad/s
+	float gravity = 9.81f;
+	float maxTilt = 35.0f;			// degrees
+	// geometric controller gains (position in 1/s^2, 1/s; attitude in 1/s^2, 1/s)
+	float kPosition = 4.0f;
+	float kVelocity = 3.6f;
+	float kAttitude = 80.0f;
+	float kRate = 14.0f;
+};
+
+struct QuadrotorState {
+	Eigen::Vector3f position = Eigen::Vector3f::Zero();
+	Eigen::Vector3f velocity = Eigen::Vector3f::Zero();
+	Eigen::Quaternionf attitude = Eigen::Quaternionf::Identity();	// body -> world
+	Eigen::Vector3f angularVelocity = Eigen::Vector3f::Zero();		// body frame
+	Eigen::Vector4f motorThrust = Eigen::Vector4f::Zero();
+};
+
+// Hold position with a velocity feed-forward and a heading, or with
+// holdPosition off track the velocity alone while the heading turns at
+// yawRate (degrees per second).
+struct QuadrotorSetpoint {
+	Eigen::Vector3f position = Eigen::Vector3f::Zero();
+	Eigen::Vector3f velocity = Eigen::Vector3f::Zero();
+	float yaw = 0.0f;
+	float yawRate = 0.0f;
+	bool holdPosition = true;
+};
+
+// One explicit step of h seconds: controller, mixer, motor lag and
+// semi-implicit Euler integration. Allocation-free and deterministic.
+void stepQuadrotor(const QuadrotorParams& params, const QuadrotorSetpoint& setpoint, QuadrotorState& state, float h);
+
+// Camera angles (pitch, roll, yaw in degrees, rotation order Z * X * Y) of the
+// body attitude tilted by a gimbal pitch.
+Eigen::Vector3f quadrotorEuler(const Eigen::Quaternionf& attitude, float gimbalPitch = 0.0f);
+
+// Runs stepQuadrotor at a fixed rate independent of the caller's tick and
+// interpolates between the last two physics states for rendering.
+class QuadrotorSim {
+public:
+	explicit QuadrotorSim(const QuadrotorParams& params = QuadrotorParams(), float stepHz = 500.0f);
+
+	// Hover at rest at position facing yaw (degrees).
+	void reset(const Eigen::Vector3f& position, float yaw);
+	void setSetpoint(const QuadrotorSetpoint& setpoint) { setpoint_ = setpoint; }
+	const QuadrotorSetpoint& setpoint() const { return setpoint_; }
+	// Advances by dt seconds of wall time; returns the physics steps taken.
+	// Stalls longer than maxFrameTime are clamped rather than replayed.
+	int advance(float dt);
+	const QuadrotorState& state() const { return current_; }
+	QuadrotorState interpolated() const;
+
+	static const float maxFrameTime;
+
+private:
+	QuadrotorParams params_;
+	float h_;
+	float accumulator_ = 0.0f;
+	QuadrotorSetpoint setpoint_;
+	QuadrotorState previous_, current_;
+};
+
+// "DRONE_GOTO x y z [yaw]"; yaw keeps the setpoint's when omitted.
+bool parseDroneGoto(const std::string& command, QuadrotorSetpoint& setpoint);
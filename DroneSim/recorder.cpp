@@ -0,0 +1,282 @@
+#include "recorder.h"
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Frames taken off the queue by a writer at a time.
+static const size_t writerBatch = 4;
+
+static std::mutex recorder_mtx;
+static std::condition_variable queued_cv;		// frames queued, or stopping
+static std::condition_variable space_cv;		// queue space freed, or stopping
+static std::atomic<bool> recording(false);
+static bool stopping = false;
+static RecorderConfig config;
+static std::deque<std::shared_ptr<const CapturedFrame>> queue;
+static std::vector<std::thread> writers;
+static RecorderStats stats;
+static Clock::time_point started;
+static double busySeconds = 0.0;
+static unsigned int lastSession = 0;
+
+static MetricCounter& writtenMetric = metricCounter("recorder.frames_written");
+static MetricCounter& droppedMetric = metricCounter("recorder.frames_dropped");
+static MetricCounter& bytesMetric = metricCounter("recorder.bytes_written");
+static MetricGauge& queueMetric = metricGauge("recorder.queue_depth");
+static MetricHistogram& appendMetric = metricHistogram("recorder.append_us");
+
+bool parseRecordCommand(const std::string& command, bool& start, RecorderConfig& cfg)
+{
+	std::istringstream ss(command);
+	std::string name, mode;
+	if (!(ss >> name >> mode) || name != "RECORD") return false;
+	if (mode == "STOP") {
+		start = false;
+		std::string extra;
+		return !(ss >> extra);
+	}
+	if (mode != "START") return false;
+	start = true;
+	for (std::string tok; ss >> tok;) {
+		size_t eq = tok.find('=');
+		if (eq == std::string::npos) return false;
+		std::string key = tok.substr(0, eq);
+		std::string value = tok.substr(eq + 1);
+		try {
+			if (key == "dir") cfg.directory = value;
+			else if (key == "writers") cfg.writers = std::stoi(value);
+			else if (key == "queue") cfg.queueFrames = (size_t)std::stoul(value);
+			else if (key == "segment_mb") cfg.segmentBytes = (uint64_t)std::stoull(value) << 20;
+			else if (key == "policy") {
+				if (value == "block") cfg.policy = recordBlock;
+				else if (value == "drop_newest") cfg.policy = recordDropNewest;
+				else if (value == "drop_oldest") cfg.policy = recordDropOldest;
+				else return false;
+			}
+			else if (key == "codec") {
+				if (value == "raw") cfg.codec = datasetRaw;
+				else if (value == "rle") cfg.codec = datasetRle;
+				else return false;
+			}
+			else return false;
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	}
+	return !cfg.directory.empty() && cfg.writers >= 1 && cfg.writers <= 16 && cfg.queueFrames >= 1 && cfg.segmentBytes > 0;
+}
+
+static uint64_t frameBytes(const CapturedFrame& f)
+{
+	return f.color.size() + f.depth.size() * sizeof(float) + f.stencil.size() + sizeof(rage_matrices) + f.metadata.size();
+}
+
+static void writerMain(int index, unsigned int session)
+{
+	DatasetWriter writer;
+	writer.setCodec(config.codec);
+	writer.setBufferSize(config.bufferBytes);
+	int segment = 0;
+	uint64_t reservedTo = 0;
+	std::vector<std::shared_ptr<const CapturedFrame>> batch;
+	std::string error;
+
+	auto account = [&](uint64_t before, bool ok, size_t frames, Clock::time_point since) {
+		double seconds = std::chrono::duration<double>(Clock::now() - since).count();
+		uint64_t bytes = writer.bytesWritten() >= before ? writer.bytesWritten() - before : 0;
+		bytesMetric.add(bytes);
+		std::lock_guard<std::mutex> lk(recorder_mtx);
+		stats.bytes += bytes;
+		busySeconds += seconds;
+		if (ok) stats.written += frames;
+		else {
+			stats.failed += frames;
+			stats.lastError = error;
+		}
+	};
+
+	while (true) {
+		batch.clear();
+		{
+			std::unique_lock<std::mutex> lk(recorder_mtx);
+			queued_cv.wait(lk, [] { return !queue.empty() || stopping; });
+			if (queue.empty()) break;
+			while (!queue.empty() && batch.size() < writerBatch) {
+				batch.push_back(std::move(queue.front()));
+				queue.pop_front();
+			}
+			stats.queueDepth = queue.size();
+			queueMetric.set((int64_t)queue.size());
+		}
+		space_cv.notify_all();
+
+		for (const auto& frame : batch) {
+			auto start = Clock::now();
+			if (writer.isOpen() && writer.bytesWritten() >= config.segmentBytes) {
+				uint64_t before = writer.bytesWritten();
+				bool ok = writer.close(error);
+				account(before, ok, 0, start);
+			}
+			if (!writer.isOpen()) {
+				char name[64];
+				snprintf(name, sizeof(name), "rec_%u_w%d_%03d.dsq", session, index, segment++);
+				std::string path = (std::filesystem::path(config.directory) / name).string();
+				if (!writer.open(path, false, error)) {
+					account(0, false, 1, start);
+					continue;
+				}
+				reservedTo = 0;
+				std::lock_guard<std::mutex> lk(recorder_mtx);
+				stats.files++;
+			}
+			uint64_t before = writer.bytesWritten();
+			if (before + frameBytes(*frame) > reservedTo) {
+				writer.reserve(config.reserveBytes);
+				reservedTo = before + config.reserveBytes;
+			}
+			bool ok = writer.append(*frame, error);
+			appendMetric.record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+			if (ok) writtenMetric.add();
+			account(before, ok, 1, start);
+		}
+	}
+	if (writer.isOpen()) {
+		auto start = Clock::now();
+		uint64_t before = writer.bytesWritten();
+		bool ok = writer.close(error);
+		account(before, ok, 0, start);
+	}
+}
+
+bool startRecording(const RecorderConfig& cfg, std::string& error)
+{
+	std::lock_guard<std::mutex> lk(recorder_mtx);
+	if (recording || !writers.empty()) {
+		error = "already recording to " + config.directory;
+		return false;
+	}
+	std::error_code ec;
+	std::filesystem::create_directories(cfg.directory, ec);
+	if (ec) {
+		error = "cannot create " + cfg.directory + ": " + ec.message();
+		return false;
+	}
+	config = cfg;
+	// sessions are named by start time, kept unique within a run
+	unsigned int session = std::max(lastSession + 1, (unsigned int)std::time(nullptr));
+	lastSession = session;
+	stats = RecorderStats();
+	stats.active = true;
+	stats.session = session;
+	stats.directory = cfg.directory;
+	busySeconds = 0.0;
+	started = Clock::now();
+	stopping = false;
+	queue.clear();
+	for (int i = 0; i < cfg.writers; ++i) writers.emplace_back(writerMain, i, session);
+	recording = true;
+	return true;
+}
+
+RecorderStats stopRecording()
+{
+	std::vector<std::thread> joining;
+	{
+		std::lock_guard<std::mutex> lk(recorder_mtx);
+		recording = false;
+		stopping = true;
+		joining.swap(writers);
+	}
+	queued_cv.notify_all();
+	space_cv.notify_all();
+	for (auto& t : joining) t.join();
+	std::lock_guard<std::mutex> lk(recorder_mtx);
+	if (stats.active) {
+		stats.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+		stats.active = false;
+	}
+	RecorderStats s = stats;
+	s.mbPerSecond = s.seconds > 0.0 ? s.bytes / 1048576.0 / s.seconds : 0.0;
+	s.writeMbPerSecond = busySeconds > 0.0 ? s.bytes / 1048576.0 / busySeconds : 0.0;
+	return s;
+}
+
+void recordFrame(const std::shared_ptr<const CapturedFrame>& frame)
+{
+	if (!recording.load(std::memory_order_acquire)) return;
+	std::unique_lock<std::mutex> lk(recorder_mtx);
+	if (!recording) return;
+	stats.offered++;
+	if (queue.size() >= config.queueFrames) {
+		if (config.policy == recordDropNewest) {
+			stats.dropped++;
+			droppedMetric.add();
+			return;
+		}
+		if (config.policy == recordDropOldest) {
+			queue.pop_front();
+			stats.dropped++;
+			droppedMetric.add();
+		}
+		else {
+			auto start = Clock::now();
+			space_cv.wait(lk, [] { return queue.size() < config.queueFrames || !recording; });
+			stats.blockedMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (!recording) {
+				stats.dropped++;
+				droppedMetric.add();
+				return;
+			}
+		}
+	}
+	queue.push_back(frame);
+	stats.queueDepth = queue.size();
+	stats.maxQueueDepth = std::max(stats.maxQueueDepth, queue.size());
+	queueMetric.set((int64_t)queue.size());
+	lk.unlock();
+	queued_cv.notify_one();
+}
+
+RecorderStats recorderStats()
+{
+	std::lock_guard<std::mutex> lk(recorder_mtx);
+	RecorderStats s = stats;
+	if (s.active) s.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+	s.mbPerSecond = s.seconds > 0.0 ? s.bytes / 1048576.0 / s.seconds : 0.0;
+	s.writeMbPerSecond = busySeconds > 0.0 ? s.bytes / 1048576.0 / busySeconds : 0.0;
+	return s;
+}
+
+static std::string jsonString(const std::string& s)
+{
+	std::string out = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') out += '\\';
+		out += c;
+	}
+	return out + "\"";
+}
+
+std::string recorderStatsJson(const RecorderStats& s)
+{
+	std::ostringstream ss;
+	ss << "{\"active\":" << (s.active ? "true" : "false") << ",\"session\":" << s.session
+		<< ",\"directory\":" << jsonString(s.directory) << ",\"offered\":" << s.offered << ",\"written\":" << s.written
+		<< ",\"dropped\":" << s.dropped << ",\"failed\":" << s.failed << ",\"bytes\":" << s.bytes << ",\"files\":" << s.files
+		<< ",\"queue_depth\":" << s.queueDepth << ",\"max_queue_depth\":" << s.maxQueueDepth << ",\"seconds\":" << s.seconds
+		<< ",\"blocked_ms\":" << s.blockedMs << ",\"mb_per_s\":" << s.mbPerSecond << ",\"write_mb_per_s\":" << s.writeMbPerSecond
+		<< ",\"last_error\":" << jsonString(s.lastError) << "}";
+	return ss.str();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "dataset.h"
+#include "frame.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Records every published capture to local disk at capture rate, so clients
+// need not pull frames over the network. Published frames are queued (the
+// frame itself is shared, not copied) and a pool of writer threads appends
+// them to .dsq datasets, one file per writer: rec_<session>_w<k>_<segment>.dsq.
+// Each file holds its writer's frames in capture order; merge the files by
+// frame id for the whole sequence.
+enum RecordDropPolicy {
+	recordBlock,		// the capturing thread waits for queue space
+	recordDropNewest,	// the incoming frame is dropped
+	recordDropOldest,	// the oldest queued frame makes room
+};
+
+struct RecorderConfig {
+	std::string directory = "record";
+	int writers = 2;
+	size_t queueFrames = 32;
+	RecordDropPolicy policy = recordDropOldest;
+	DatasetCodec codec = datasetRaw;
+	uint64_t segmentBytes = 4ull << 30;		// start a new file past this size
+	uint64_t reserveBytes = 256ull << 20;	// disk space allocated ahead of the writes
+	size_t bufferBytes = 8 << 20;			// per-writer buffer, the size of each disk write
+};
+
+// "RECORD START [dir=path] [writers=n] [queue=n] [policy=block|drop_newest|drop_oldest]
+// [codec=raw|rle] [segment_mb=n]" or "RECORD STOP"
+bool parseRecordCommand(const std::string& command, bool& start, RecorderConfig& cfg);
+
+struct RecorderStats {
+	bool active = false;
+	unsigned int session = 0;
+	std::string directory;
+	uint64_t offered = 0;
+	uint64_t written = 0;
+	uint64_t dropped = 0;
+	uint64_t failed = 0;		// frames a write error lost
+	uint64_t bytes = 0;			// written to disk, after compression
+	uint64_t files = 0;
+	size_t queueDepth = 0;
+	size_t maxQueueDepth = 0;
+	double seconds = 0.0;
+	double blockedMs = 0.0;		// capture time spent waiting for queue space
+	double mbPerSecond = 0.0;	// bytes over the session's wall time
+	double writeMbPerSecond = 0.0;	// bytes over the writers' busy time, per writer
+	std::string lastError;
+};
+
+bool startRecording(const RecorderConfig& cfg, std::string& error);
+// Writes out what is queued, closes the files and returns the final stats.
+RecorderStats stopRecording();
+// Called by publishCapturedFrame; returns at once when not recording.
+void recordFrame(const std::shared_ptr<const CapturedFrame>& frame);
+
+RecorderStats recorderStats();
+std::string recorderStatsJson(const RecorderStats& stats);
@@ -0,0 +1,183 @@
+#include "rig.h"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+
+using Eigen::AngleAxisf;
+using Eigen::Matrix3f;
+using Eigen::Vector3f;
+using std::string;
+using std::vector;
+
+static const float DEG2RAD = 0.01745329f;
+static const float RAD2DEG = 57.2957795f;
+
+Matrix3f rigRotation(const Vector3f& r)
+{
+	return (AngleAxisf(r.z() * DEG2RAD, Vector3f::UnitZ())
+		* AngleAxisf(r.x() * DEG2RAD, Vector3f::UnitX())
+		* AngleAxisf(r.y() * DEG2RAD, Vector3f::UnitY())).toRotationMatrix();
+}
+
+Vector3f rigEuler(const Matrix3f& R)
+{
+	// R = Rz(yaw) * Rx(pitch) * Ry(roll)
+	const float pitch = std::asin(std::max(-1.0f, std::min(1.0f, R(2, 1))));
+	const float roll = std::atan2(-R(2, 0), R(2, 2));
+	const float yaw = std::atan2(-R(0, 1), R(1, 1));
+	return Vector3f(pitch, roll, yaw) * RAD2DEG;
+}
+
+RigPose rigCameraPose(const RigPose& body, const RigCamera& camera)
+{
+	const Matrix3f Rb = rigRotation(body.rotation);
+	RigPose pose;
+	pose.position = body.position + Rb * camera.offset;
+	pose.rotation = rigEuler(Rb * rigRotation(camera.rotation));
+	pose.fov = camera.fov > 0.0f ? camera.fov : body.fov;
+	return pose;
+}
+
+static RigCamera rigCamera(const string& name, float x, float y, float z, float pitch, float roll, float yaw)
+{
+	RigCamera c;
+	c.name = name;
+	c.offset = Vector3f(x, y, z);
+	c.rotation = Vector3f(pitch, roll, yaw);
+	return c;
+}
+
+bool parseRigCommand(const string& command, vector<RigCamera>& rig)
+{
+	std::istringstream ss(command);
+	string name;
+	ss >> name;
+	if (name != "RIG") return false;
+	rig.clear();
+	for (string tok; ss >> tok;) {
+		size_t eq = tok.find('=');
+		string key = tok.substr(0, eq), value = eq == string::npos ? "" : tok.substr(eq + 1);
+		if (key == "stereo") {
+			float baseline = 0.5f;
+			try {
+				if (!value.empty()) baseline = std::stof(value);
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+			rig.push_back(rigCamera("left", -0.5f * baseline, 0, 0, 0, 0, 0));
+			rig.push_back(rigCamera("right", 0.5f * baseline, 0, 0, 0, 0, 0));
+		}
+		else if (key == "multiview") {
+			rig.push_back(rigCamera("front", 0, 0, 0, 0, 0, 0));
+			rig.push_back(rigCamera("down", 0, 0, 0, -90, 0, 0));
+			rig.push_back(rigCamera("left", 0, 0, 0, 0, 0, 90));
+			rig.push_back(rigCamera("right", 0, 0, 0, 0, 0, -90));
+		}
+		else if (key == "cam") {
+			std::istringstream fields(value);
+			vector<string> parts;
+			for (string part; std::getline(fields, part, ',');) parts.push_back(part);
+			if (parts.size() != 7 && parts.size() != 8) return false;
+			float v[7] = { 0 };
+			try {
+				for (size_t i = 1; i < parts.size(); ++i) v[i - 1] = std::stof(parts[i]);
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+			RigCamera c = rigCamera(parts[0], v[0], v[1], v[2], v[3], v[4], v[5]);
+			c.fov = parts.size() == 8 ? v[6] : 0.0f;
+			if (c.name.empty() || c.fov < 0.0f || c.fov >= 180.0f) return false;
+			rig.push_back(c);
+		}
+		else {
+			return false;
+		}
+	}
+	return !rig.empty();
+}
+
+void RigScheduler::start(const vector<RigCamera>& rig, const RigPose& body, unsigned int rigId, long long timestamp, int settleTicks)
+{
+	rig_ = rig;
+	body_ = body;
+	rigId_ = rigId;
+	timestamp_ = timestamp;
+	settleTicks_ = settleTicks;
+	index_ = 0;
+	state_ = Move;
+	active_ = !rig_.empty();
+}
+
+RigScheduler::Action RigScheduler::tick(bool captureIdle, RigPose& pose)
+{
+	if (!active_) return Idle;
+	switch (state_) {
+	case Wait:
+		if (!captureIdle) return Idle;
+		++index_;
+		state_ = Move;
+		// fall through
+	case Move:
+		if (index_ >= rig_.size()) {
+			active_ = false;
+			finishRig(rigId_);
+			pose = body_;
+			return Finished;
+		}
+		pose = rigCameraPose(body_, rig_[index_]);
+		settle_ = settleTicks_;
+		state_ = Settle;
+		return MoveTo;
+	case Settle:
+		if (settle_-- > 0 || !captureIdle) return Idle;
+		pose = rigCameraPose(body_, rig_[index_]);
+		state_ = Wait;
+		return Capture;
+	}
+	return Idle;
+}
+
+static string jsonString(const string& s)
+{
+	string out = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') out += '\\';
+		out += c;
+	}
+	return out + "\"";
+}
+
+string RigScheduler::metadata() const
+{
+	if (index_ >= rig_.size()) return string();
+	std::ostringstream ss;
+	ss << "\"rig\":" << rigId_ << ",\"rig_camera\":" << index_ << ",\"rig_cameras\":" << rig_.size()
+		<< ",\"rig_name\":" << jsonString(rig_[index_].name) << ",\"rig_timestamp\":" << timestamp_;
+	return ss.str();
+}
+
+static std::mutex rig_mtx;
+static unsigned int rigIds = 0;
+static unsigned int finishedRig = 0;
+
+unsigned int nextRigId()
+{
+	std::lock_guard<std::mutex> lk(rig_mtx);
+	return ++rigIds;
+}
+
+void finishRig(unsigned int rigId)
+{
+	std::lock_guard<std::mutex> lk(rig_mtx);
+	finishedRig = rigId;
+}
+
+unsigned int lastFinishedRig()
+{
+	std::lock_guard<std::mutex> lk(rig_mtx);
+	return finishedRig;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// A camera rig: cameras with fixed extrinsics relative to the drone body.
+// Body axes follow the camera convention at zero rotation: x right,
+// y forward, z up. Rotations are pitch, roll, yaw in degrees (rotation order
+// Z * X * Y, as the game's rotation order 2).
+struct RigCamera {
+	std::string name;
+	Eigen::Vector3f offset = Eigen::Vector3f::Zero();
+	Eigen::Vector3f rotation = Eigen::Vector3f::Zero();
+	float fov = 0.0f;	// 0 keeps the current fov
+};
+
+struct RigPose {
+	Eigen::Vector3f position;
+	Eigen::Vector3f rotation;	// pitch, roll, yaw
+	float fov;
+};
+
+Eigen::Matrix3f rigRotation(const Eigen::Vector3f& rotation);
+Eigen::Vector3f rigEuler(const Eigen::Matrix3f& R);
+// World pose of a rig camera mounted on a body at the given pose.
+RigPose rigCameraPose(const RigPose& body, const RigCamera& camera);
+
+// "RIG cam=name,x,y,z,pitch,roll,yaw[,fov] ..." or a preset:
+// "RIG stereo[=baseline]" (left/right, 0.5 m default) or "RIG multiview"
+// (front, down, left, right).
+bool parseRigCommand(const std::string& command, std::vector<RigCamera>& rig);
+
+// Visits each rig camera in turn on consecutive ticks: pose the camera,
+// let it render settleTicks frames, capture, wait for the capture, next.
+// The body pose is restored when the round is done.
+class RigScheduler {
+public:
+	enum Action { Idle, MoveTo, Capture, Finished };
+
+	void start(const std::vector<RigCamera>& rig, const RigPose& body, unsigned int rigId, long long timestamp, int settleTicks = 1);
+	bool active() const { return active_; }
+	Action tick(bool captureIdle, RigPose& pose);
+	// Capture metadata members for the camera about to be captured.
+	std::string metadata() const;
+	unsigned int rigId() const { return rigId_; }
+
+private:
+	enum State { Move, Settle, Wait };
+	std::vector<RigCamera> rig_;
+	RigPose body_;
+	unsigned int rigId_ = 0;
+	long long timestamp_ = 0;
+	int settleTicks_ = 1;
+	int settle_ = 0;
+	size_t index_ = 0;
+	State state_ = Move;
+	bool active_ = false;
+};
+
+// Id of the next rig round and of the last one that finished.
+unsigned int nextRigId();
+void finishRig(unsigned int rigId);
+unsigned int lastFinishedRig();
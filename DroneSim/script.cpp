@@ -1,22 +1,584 @@
 #include "script.h"
-#include "export.h"
+#include "capture.h"
 #include "main.h"
 #include "utils.h"
 #include "camera.h"
 #include "server.h"
+#include "survey.h"
+#include "trajectory.h"
+#include "quadrotor.h"
+#include "control.h"
+#include "commands.h"
+#include "rig.h"
+#include "sensors.h"
+#include "lockstep.h"
+#include "environment.h"
+#include "frame.h"
+#include "latency.h"
+#include "metrics.h"
 #include <string>
 #include <fstream>
 #include <algorithm>
 #include <set>
-#include <atlimage.h>
-#include <time.h>
 #include <chrono>
+#include <sstream>
+#include <deque>
 #include <cmath>
 
 char* logFilePathScript = "logs\\script.log";
 
 scriptStatusEnum scriptStatus = scriptStop;
 
+extern catchState cmdToCatch;
+static TrajectoryPlayer trajectoryPlayer;
+static SurveyRunner surveyRunner;
+static QuadrotorSim drone;
+static bool droneActive = false;
+static float droneGimbalPitch = 0.0f;
+static bool controlWasActive = false;
+static std::vector<RigCamera> rigCameras;
+static RigScheduler rigScheduler;
+static LockstepRunner lockstep;
+static bool lockstepEnabled = false;
+static EnvironmentSweep envSweep;
+static bool envSweepEnabled = false;
+
+// A rig round, a lockstep step or an environment sweep owns the camera until
+// it is done; the continuous movers leave the pose alone meanwhile.
+static bool cameraHeld()
+{
+	return rigScheduler.active() || lockstep.busy() || envSweep.active();
+}
+
+// Whether the capture asked for last is complete. With the environment sweep
+// on that is the whole sweep at the pose, not just its latest frame.
+static bool captureIdle()
+{
+	return cmdToCatch == catchStop && !envSweep.active();
+}
+
+// Captures at the current pose, tagged with metadata and the rig round it
+// belongs to. With the environment sweep on this becomes one capture per
+// environment setting.
+static void armCapture(const std::string& metadata, unsigned int rigId = 0)
+{
+	if (envSweepEnabled) {
+		envSweep.start(metadata, rigId, nextEnvironmentRound(), GAMEPLAY::GET_FRAME_COUNT());
+		return;
+	}
+	if (!metadata.empty()) setNextCaptureMetadata(metadata, rigId);
+	makeCmdStart();
+}
+
+// Time the script thread may spend on queued commands per tick, and how long
+// a capture may hold the queue before it is assumed lost.
+static const std::chrono::microseconds commandBudget(2000);
+static const std::chrono::milliseconds captureBarrierTimeout(1000);
+
+// Advances trajectory playback by the wall-clock time since the last tick.
+// While a scheduled capture is in flight the path is held still.
+static void stepTrajectory(float dt)
+{
+	if (!trajectoryPlayer.active() || cmdToCatch != catchStop || cameraHeld()) return;
+	TrajectoryKey key;
+	bool capture = false;
+	if (!trajectoryPlayer.step(dt, key, capture)) return;
+	CameraPose pose = getCameraPose();
+	pose.x = key.position.x();
+	pose.y = key.position.y();
+	pose.z = key.position.z();
+	pose.pitch = key.rotation.x();
+	pose.roll = key.rotation.y();
+	pose.yaw = key.rotation.z();
+	setCameraPose(pose);
+	if (capture) {
+		log_to_pedTxt("Trajectory capture at s = " + std::to_string(trajectoryPlayer.progress()), logFilePathScript);
+		armCapture("");
+	}
+	if (!trajectoryPlayer.active()) {
+		log_to_pedTxt("Trajectory finished.", logFilePathScript);
+	}
+}
+
+// Moves to the next survey waypoint or arms its capture. Each capture is
+// tagged with the survey generation so the server can stream it back.
+static void stepSurvey()
+{
+	if (cameraHeld()) return;
+	SurveyWaypoint waypoint;
+	switch (surveyRunner.tick(captureIdle(), waypoint)) {
+	case SurveyRunner::MoveTo: {
+		CameraPose pose = getCameraPose();
+		pose.x = waypoint.position.x();
+		pose.y = waypoint.position.y();
+		pose.z = waypoint.position.z();
+		pose.pitch = waypoint.pitch;
+		pose.roll = 0.0f;
+		pose.yaw = waypoint.yaw;
+		setCameraPose(pose);
+		break;
+	}
+	case SurveyRunner::Capture: {
+		SurveyStatus status = surveyStatus();
+		armCapture("\"survey\":" + std::to_string(status.generation)
+			+ ",\"index\":" + std::to_string(surveyRunner.index())
+			+ ",\"station\":" + std::to_string(waypoint.station)
+			+ ",\"pose\":[" + std::to_string(waypoint.position.x()) + "," + std::to_string(waypoint.position.y())
+			+ "," + std::to_string(waypoint.position.z()) + "," + std::to_string(waypoint.pitch)
+			+ ",0," + std::to_string(waypoint.yaw) + "]");
+		break;
+	}
+	case SurveyRunner::Finished:
+		log_to_pedTxt("Survey finished: " + surveyStatusJson(surveyStatus()), logFilePathScript);
+		break;
+	default:
+		break;
+	}
+}
+
+// Puts the simulated quadrotor at rest at the current camera pose.
+static void resetDrone(const CameraPose& pose)
+{
+	drone.reset(Eigen::Vector3f(pose.x, pose.y, pose.z), pose.yaw);
+}
+
+// Steps the quadrotor by the tick's wall time and poses the camera at the
+// state interpolated between the last two physics steps.
+static void stepDrone(float dt)
+{
+	if (!droneActive) return;
+	drone.advance(dt);
+	if (cameraHeld()) return;
+	QuadrotorState state = drone.interpolated();
+	Eigen::Vector3f euler = quadrotorEuler(state.attitude, droneGimbalPitch);
+	CameraPose pose = getCameraPose();
+	pose.x = state.position.x();
+	pose.y = state.position.y();
+	pose.z = state.position.z();
+	pose.pitch = euler.x();
+	pose.roll = euler.y();
+	pose.yaw = euler.z();
+	setCameraPose(pose);
+}
+
+// Applies the newest streamed velocity / yaw-rate setpoint. With dynamics on
+// it becomes the quadrotor's velocity target; otherwise the camera is moved
+// kinematically by this tick's dt. When the control session ends the drone
+// holds where it is.
+static void stepControl(float dt)
+{
+	ControlSetpoint setpoint;
+	if (cameraHeld()) return;
+	if (!currentControlSetpoint(setpoint)) {
+		if (controlWasActive && droneActive) {
+			QuadrotorSetpoint hold = drone.setpoint();
+			hold.holdPosition = true;
+			hold.position = drone.state().position;
+			hold.velocity.setZero();
+			hold.yawRate = 0.0f;
+			drone.setSetpoint(hold);
+		}
+		controlWasActive = false;
+		return;
+	}
+	if (!controlWasActive) {
+		log_to_pedTxt("Control session started.", logFilePathScript);
+		trajectoryPlayer.stop();
+		surveyRunner.stop();
+		controlWasActive = true;
+	}
+	if (droneActive) {
+		QuadrotorSetpoint target = drone.setpoint();
+		target.holdPosition = false;
+		target.velocity = controlWorldVelocity(setpoint, target.yaw);
+		target.yawRate = setpoint.yawRate;
+		drone.setSetpoint(target);
+	}
+	else {
+		CameraPose pose = getCameraPose();
+		Eigen::Vector3f position(pose.x, pose.y, pose.z);
+		integrateControl(setpoint, dt, position, pose.yaw);
+		pose.x = position.x();
+		pose.y = position.y();
+		pose.z = position.z();
+		setCameraPose(pose);
+	}
+	markControlApplied(setpoint);
+}
+
+static void setRigPose(const RigPose& rigPose)
+{
+	CameraPose pose = getCameraPose();
+	pose.x = rigPose.position.x();
+	pose.y = rigPose.position.y();
+	pose.z = rigPose.position.z();
+	pose.pitch = rigPose.rotation.x();
+	pose.roll = rigPose.rotation.y();
+	pose.yaw = rigPose.rotation.z();
+	pose.fov = rigPose.fov;
+	setCameraPose(pose);
+}
+
+// Switches the one scripted camera through the rig members on consecutive
+// frames and captures each; every frame carries the rig id and the shared
+// timestamp of the trigger.
+static void stepRig()
+{
+	RigPose pose;
+	switch (rigScheduler.tick(captureIdle(), pose)) {
+	case RigScheduler::MoveTo:
+		setRigPose(pose);
+		break;
+	case RigScheduler::Capture:
+		armCapture(rigScheduler.metadata(), rigScheduler.rigId());
+		break;
+	case RigScheduler::Finished:
+		setRigPose(pose);
+		log_to_pedTxt("Rig capture finished.", logFilePathScript);
+		break;
+	default:
+		break;
+	}
+}
+
+// Starts a rig round at the current camera pose.
+static bool startRigCapture()
+{
+	if (rigCameras.empty()) {
+		log_to_pedTxt("RIG_CAPTURE without a rig; send RIG first.", logFilePathScript);
+		return false;
+	}
+	// RIG_FRAMES collects the round from the frame history; a longer round
+	// would come back with its first frames missing
+	size_t frames = rigCameras.size() * (envSweepEnabled ? std::max<size_t>(envSweep.config().settings.size(), 1) : 1);
+	if (frames > capturedFrameHistory) {
+		log_to_pedTxt("RIG_CAPTURE would take " + std::to_string(frames) + " frames, more than the "
+			+ std::to_string(capturedFrameHistory) + " kept for RIG_FRAMES; use fewer cameras or environment settings.",
+			logFilePathScript);
+		return false;
+	}
+	CameraPose current = getCameraPose();
+	RigPose body;
+	body.position = Eigen::Vector3f(current.x, current.y, current.z);
+	body.rotation = Eigen::Vector3f(current.pitch, current.roll, current.yaw);
+	body.fov = current.fov;
+	long long timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	unsigned int rigId = nextRigId();
+	rigScheduler.start(rigCameras, body, rigId, timestamp);
+	log_to_pedTxt("Rig capture " + std::to_string(rigId) + " with " + std::to_string(rigCameras.size()) + " camera(s)", logFilePathScript);
+	return true;
+}
+
+// Freezes or resumes world time (traffic, peds, weather, clock). The clock
+// stays paused while the environment sweep owns the time of day.
+static void freezeWorld(bool freeze)
+{
+	GAMEPLAY::SET_TIME_SCALE(freeze ? 0.0f : 1.0f);
+	TIME::PAUSE_CLOCK(freeze || envSweepEnabled);
+}
+
+static void stepLockstep()
+{
+	switch (lockstep.tick(GAMEPLAY::GET_FRAME_COUNT(), captureIdle())) {
+	case LockstepRunner::Capture:
+		armCapture("\"lockstep_step\":" + std::to_string(lockstep.step())
+			+ ",\"settle_frames\":" + std::to_string(lockstep.config().settleFrames));
+		break;
+	case LockstepRunner::Unfreeze:
+		freezeWorld(false);
+		break;
+	case LockstepRunner::Freeze:
+		freezeWorld(true);
+		break;
+	default:
+		break;
+	}
+}
+
+static void applyEnvironment(const EnvironmentSetting& setting)
+{
+	if (!setting.weather.empty()) {
+		std::vector<char> weather(setting.weather.begin(), setting.weather.end());
+		weather.push_back('\0');
+		GAMEPLAY::SET_OVERRIDE_WEATHER(weather.data());
+		GAMEPLAY::SET_WEATHER_TYPE_NOW_PERSIST(weather.data());
+	}
+	if (setting.hour >= 0) {
+		TIME::SET_CLOCK_TIME(setting.hour, setting.minute, 0);
+	}
+}
+
+// Walks the environment settings at the pose the sweep was started at:
+// apply, wait the settle frames the change needs, capture, next.
+static void stepEnvironment()
+{
+	EnvironmentSetting setting;
+	std::string metadata;
+	switch (envSweep.tick(GAMEPLAY::GET_FRAME_COUNT(), cmdToCatch == catchStop, setting, metadata)) {
+	case EnvironmentSweep::Apply:
+		applyEnvironment(setting);
+		break;
+	case EnvironmentSweep::Capture:
+		setNextCaptureMetadata(metadata, envSweep.rigId(), envSweep.round());
+		makeCmdStart();
+		break;
+	case EnvironmentSweep::Finished:
+		log_to_pedTxt("Environment sweep round " + std::to_string(envSweep.round()) + " finished.", logFilePathScript);
+		break;
+	default:
+		break;
+	}
+}
+
+// Feeds the pose the camera ends this tick with to the sensor simulator,
+// stamped on the capture clock.
+static void feedSensors()
+{
+	if (!sensorStreamActive()) return;
+	CameraPose pose = getCameraPose();
+	int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	Eigen::Vector3f rotation(pose.pitch, pose.roll, pose.yaw);
+	feedSensorPose(now, Eigen::Vector3f(pose.x, pose.y, pose.z), Eigen::Quaternionf(rigRotation(rotation)));
+}
+
+// Commands that are neither pose changes nor captures. dt is zeroed when a
+// trajectory starts so it does not jump ahead by the time already elapsed.
+static void runCommand(const std::string& cmd, float& dt)
+{
+	if (cmd == "GET_POSE")
+	{
+		publishCameraPose(getCameraPose());
+	}
+	else if (cmd.rfind("TRAJECTORY", 0) == 0)
+	{
+		Trajectory trajectory;
+		if (cmd == "TRAJECTORY_STOP") {
+			log_to_pedTxt("Trajectory stopped.", logFilePathScript);
+			trajectoryPlayer.stop();
+		}
+		else if (parseTrajectoryCommand(cmd, trajectory)) {
+			log_to_pedTxt("Starting trajectory: " + std::to_string(trajectory.length()) + " m in "
+				+ std::to_string(trajectory.duration()) + " s, " + std::to_string(trajectory.captures().size()) + " capture(s)", logFilePathScript);
+			trajectoryPlayer.start(trajectory);
+			droneActive = false;
+			dt = 0.0f;
+		}
+		else {
+			log_to_pedTxt("Malformed TRAJECTORY command.", logFilePathScript);
+		}
+	}
+	else if (cmd.rfind("SURVEY", 0) == 0)
+	{
+		SurveyPlanConfig cfg;
+		if (cmd == "SURVEY_STOP") {
+			log_to_pedTxt("Survey stopped.", logFilePathScript);
+			surveyRunner.stop();
+		}
+		else if (parseSurveyCommand(cmd, cfg)) {
+			// planned once by the server off this thread
+			std::vector<SurveyWaypoint> plan;
+			if (!takeSurveyPlan(cfg.generation, plan)) {
+				log_to_pedTxt("Survey " + std::to_string(cfg.generation) + " has no plan.", logFilePathScript);
+				return;
+			}
+			log_to_pedTxt("Starting survey " + std::to_string(cfg.generation) + ": " + std::to_string(plan.size())
+				+ " waypoint(s), " + std::to_string(surveyPathLength(plan)) + " m path", logFilePathScript);
+			trajectoryPlayer.stop();
+			droneActive = false;
+			surveyRunner.start(std::move(plan), cfg.generation, cfg.settleTicks);
+		}
+		else {
+			log_to_pedTxt("Malformed SURVEY command.", logFilePathScript);
+		}
+	}
+	else if (cmd.rfind("DRONE ", 0) == 0)
+	{
+		std::istringstream args(cmd.substr(6));
+		std::string mode;
+		args >> mode;
+		if (mode == "ON") {
+			if (!(args >> droneGimbalPitch)) droneGimbalPitch = 0.0f;
+			CameraPose pose = getCameraPose();
+			pose.pitch = pose.roll = 0.0f;
+			resetDrone(pose);
+			trajectoryPlayer.stop();
+			surveyRunner.stop();
+			droneActive = true;
+			log_to_pedTxt("Quadrotor dynamics on, gimbal pitch " + std::to_string(droneGimbalPitch), logFilePathScript);
+		}
+		else if (mode == "OFF") {
+			droneActive = false;
+			log_to_pedTxt("Quadrotor dynamics off.", logFilePathScript);
+		}
+		else {
+			log_to_pedTxt("Malformed DRONE command: " + cmd, logFilePathScript);
+		}
+	}
+	else if (cmd.rfind("DRONE_GOTO", 0) == 0)
+	{
+		QuadrotorSetpoint setpoint = drone.setpoint();
+		if (droneActive && parseDroneGoto(cmd, setpoint)) {
+			drone.setSetpoint(setpoint);
+		}
+		else {
+			log_to_pedTxt("Ignored DRONE_GOTO (drone off or malformed): " + cmd, logFilePathScript);
+		}
+	}
+	else if (cmd.rfind("LOCKSTEP", 0) == 0)
+	{
+		bool enable = false;
+		LockstepConfig cfg = lockstep.config();
+		if (parseLockstepCommand(cmd, enable, cfg)) {
+			lockstep.configure(cfg);
+			lockstep.cancel();
+			lockstepEnabled = enable;
+			setLockstepEnabled(enable);
+			freezeWorld(enable);
+			log_to_pedTxt(enable ? "Lockstep on, settle " + std::to_string(cfg.settleFrames) + " frame(s), advance "
+				+ std::to_string(cfg.advanceFrames) + " frame(s)" : "Lockstep off.", logFilePathScript);
+		}
+		else {
+			log_to_pedTxt("Malformed LOCKSTEP command: " + cmd, logFilePathScript);
+		}
+	}
+	else if (cmd.rfind("ENV_SWEEP", 0) == 0)
+	{
+		bool enable = false;
+		EnvironmentSweepConfig cfg = envSweep.config();
+		if (!parseEnvironmentCommand(cmd, enable, cfg)) {
+			log_to_pedTxt("Malformed ENV_SWEEP command: " + cmd, logFilePathScript);
+		}
+		else if (enable && cfg.settings.size() > capturedFrameHistory) {
+			// ENV_FRAMES collects the round from the frame history; a longer round
+			// would come back with its first frames missing
+			log_to_pedTxt("ENV_SWEEP would take " + std::to_string(cfg.settings.size()) + " frames per pose, more than the "
+				+ std::to_string(capturedFrameHistory) + " kept for ENV_FRAMES; use fewer weathers or times.",
+				logFilePathScript);
+		}
+		else {
+			if (enable) envSweep.configure(cfg);
+			else envSweep.cancel();
+			envSweepEnabled = enable;
+			setEnvironmentSweepEnabled(enable, cfg.settings.size());
+			if (!enable) {
+				GAMEPLAY::CLEAR_OVERRIDE_WEATHER();
+				GAMEPLAY::CLEAR_WEATHER_TYPE_PERSIST();
+			}
+			TIME::PAUSE_CLOCK(enable || lockstepEnabled);
+			log_to_pedTxt(enable ? "Environment sweep on with " + std::to_string(cfg.settings.size()) + " setting(s)"
+				: "Environment sweep off.", logFilePathScript);
+		}
+	}
+	else if (cmd == "RIG_CLEAR")
+	{
+		rigCameras.clear();
+		log_to_pedTxt("Rig cleared.", logFilePathScript);
+	}
+	else if (cmd.rfind("RIG ", 0) == 0)
+	{
+		std::vector<RigCamera> rig;
+		if (parseRigCommand(cmd, rig)) {
+			rigCameras = rig;
+			log_to_pedTxt("Rig defined with " + std::to_string(rig.size()) + " camera(s)", logFilePathScript);
+		}
+		else {
+			log_to_pedTxt("Malformed RIG command: " + cmd, logFilePathScript);
+		}
+	}
+	else {
+		log_to_pedTxt("Unknown queued command: " + cmd, logFilePathScript);
+	}
+}
+
+// Drains the command queue each tick within commandBudget. Runs of moves
+// and SET_POSE are folded into one pose in software and written to the
+// camera once, before the next command that needs the real pose. REQUEST,
+// STEP and RIG_CAPTURE are barriers: the drain stops there so the capture
+// sees exactly the pose written so far, and resumes once the capture, the
+// lockstep step or the rig round is done.
+static void drainCommands(float& dt)
+{
+	static std::deque<std::string> pending;
+	static bool captureWait = false;
+	static std::chrono::steady_clock::time_point captureWaitStart;
+	const auto start = std::chrono::steady_clock::now();
+	CommandTick tick;
+	g_cmdQueue.drain(pending);
+
+	if (cameraHeld()) {
+		tick.backlog = pending.size();
+		recordCommandTick(tick);
+		return;
+	}
+	if (cmdToCatch != catchStop) {
+		if (!captureWait) {
+			captureWait = true;
+			captureWaitStart = start;
+		}
+		if (start - captureWaitStart < captureBarrierTimeout) {
+			tick.backlog = pending.size();
+			recordCommandTick(tick);
+			return;
+		}
+	}
+	else {
+		captureWait = false;
+	}
+
+	CommandSink sink;
+	sink.readPose = getCameraPose;
+	sink.writePose = [](const CameraPose& pose) {
+		setCameraPose(pose);
+		if (droneActive) resetDrone(pose);
+	};
+	sink.barrier = [](const std::string& cmd) {
+		// 检查是否为 REQUEST 命令
+		if (cmd == "REQUEST")
+		{
+			if (lockstepEnabled) {
+				// 锁步模式：先等画面稳定若干帧再捕获
+				lockstep.begin(GAMEPLAY::GET_FRAME_COUNT());
+				return true;
+			}
+			// 在游戏脚本线程中调用 makeCmdStart() 触发 D3D 渲染线程的捕获
+			log_to_pedTxt("Processing queued command: REQUEST. Triggering D3D capture.", logFilePathScript);
+			armCapture("");
+			return true;
+		}
+		if (cmd.rfind("STEP ", 0) == 0)
+		{
+			// STEP x y z pitch roll yaw [fov]: pose, settle and capture as one lockstep step
+			CameraPose stepPose = getCameraPose();
+			bool hasFov = false;
+			if (!lockstepEnabled || !parseSetPose("SET_POSE" + cmd.substr(4), stepPose, hasFov)) {
+				log_to_pedTxt("Ignored STEP (lockstep off or malformed): " + cmd, logFilePathScript);
+				return false;
+			}
+			setCameraPose(stepPose);
+			if (droneActive) resetDrone(stepPose);
+			lockstep.begin(GAMEPLAY::GET_FRAME_COUNT());
+			return true;
+		}
+		// RIG_CAPTURE
+		return startRigCapture();
+	};
+	sink.run = [&dt](const std::string& cmd) { runCommand(cmd, dt); };
+	sink.malformed = [](const std::string& cmd) {
+		log_to_pedTxt("Malformed SET_POSE command: " + cmd, logFilePathScript);
+	};
+	drainCommandQueue(pending, sink, start + commandBudget, tick);
+
+	tick.backlog = pending.size();
+	tick.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (tick.poseCommands > 0) {
+		log_to_pedTxt("Folded " + std::to_string(tick.poseCommands) + " pose command(s) into "
+			+ std::to_string(tick.poseWrites) + " camera write(s)", logFilePathScript);
+	}
+	recordCommandTick(tick);
+}
+
 void scriptMain()
 {
 
@@ -28,35 +590,35 @@ void scriptMain()
 	WAIT(5000);
 	
 	scriptStatus = cameraMode;
+	auto lastTick = std::chrono::steady_clock::now();
+	MetricCounter& ticksMetric = metricCounter("script.ticks");
+	MetricHistogram& tickMetric = metricHistogram("script.tick_us");
 
 	while (true)
 	{
+		auto now = std::chrono::steady_clock::now();
+		float dt = std::chrono::duration<float>(now - lastTick).count();
+		lastTick = now;
+
 		if (scriptStatus == cameraMode) {
 			if (CameraMode == false) {
 				startNewCamera();
 				setStatusText("Now you can move the camera.");
 			}
 			else {
-				if (g_cmdQueue.size() > 0)
-				{
-					std::string cmd = g_cmdQueue.front();
-					g_cmdQueue.pop();
-					
-					// 检查是否为 REQUEST 命令
-					if (cmd == "REQUEST")
-					{
-						// 在游戏脚本线程中调用 makeCmdStart() 触发 D3D 渲染线程的捕获
-						log_to_pedTxt("Processing queued command: REQUEST. Triggering D3D capture.", logFilePathScript);
-						makeCmdStart(); 
-					}
-					else if (cmd == "FORWARD" || cmd == "BACKWARD" || cmd == "LEFT" || cmd == "RIGHT" || cmd == "UP" || cmd == "DOWN" || cmd == "LEFTROTATE" || cmd == "RIGHTROTATE")
-					{
-						log_to_pedTxt("Processing queued camera movement command: " + cmd, logFilePathScript);
-						adjustCamera(cmd);
-					}
-				}
+				drainCommands(dt);
+				stepTrajectory(dt);
+				stepControl(dt);
+				stepDrone(dt);
+				stepSurvey();
+				stepRig();
+				stepLockstep();
+				stepEnvironment();
+				feedSensors();
 			}
 		}
+		ticksMetric.add();
+		tickMetric.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - now).count());
 		WAIT(0);
 	}
 }
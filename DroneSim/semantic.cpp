@@ -0,0 +1,166 @@
+#include "semantic.h"
+#include "parallel.h"
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+static std::mutex lut_mtx;
+static SemanticLut activeLut = buildSemanticLut({});
+
+SemanticLut buildSemanticLut(const vector<SemanticRule>& rules)
+{
+	SemanticLut lut;
+	for (int s = 0; s < 256; ++s) {
+		lut[s] = rules.empty() ? (uint8_t)(s & 0x07) : 0;
+		for (const auto& r : rules) {
+			if ((s & r.mask) == r.value) {
+				lut[s] = r.classId;
+				break;
+			}
+		}
+	}
+	return lut;
+}
+
+bool parseSemanticRules(const string& command, vector<SemanticRule>& rules)
+{
+	std::istringstream ss(command);
+	string name;
+	ss >> name;
+	if (name != "SEMANTIC_MAP") return false;
+	rules.clear();
+	for (string tok; ss >> tok;) {
+		unsigned long fields[3];
+		size_t start = 0;
+		for (int i = 0; i < 3; ++i) {
+			size_t end = tok.find(':', start);
+			if ((i < 2) != (end != string::npos)) return false;
+			string part = tok.substr(start, end == string::npos ? string::npos : end - start);
+			try {
+				size_t used = 0;
+				fields[i] = std::stoul(part, &used, 0);
+				if (used != part.size() || fields[i] > 255) return false;
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+			start = end + 1;
+		}
+		rules.push_back({ (uint8_t)fields[0], (uint8_t)fields[1], (uint8_t)fields[2] });
+	}
+	return true;
+}
+
+void setSemanticRules(const vector<SemanticRule>& rules)
+{
+	SemanticLut lut = buildSemanticLut(rules);
+	std::lock_guard<std::mutex> lk(lut_mtx);
+	activeLut = lut;
+}
+
+SemanticLut currentSemanticLut()
+{
+	std::lock_guard<std::mutex> lk(lut_mtx);
+	return activeLut;
+}
+
+void applySemanticLut(const vector<unsigned char>& stencil, const SemanticLut& lut, vector<unsigned char>& labels)
+{
+	labels.resize(stencil.size());
+	parallelFor(0, (int)stencil.size(), [&](int i0, int i1) {
+		for (int i = i0; i < i1; ++i) labels[i] = lut[stencil[i]];
+	}, 1 << 16);
+}
+
+void labelStencil(const vector<unsigned char>& stencil, int width, int height, const SemanticLut& lut,
+	vector<unsigned char>& labels, vector<SemanticClassStats>& classes)
+{
+	const size_t n = (size_t)width * height;
+	labels.resize(n);
+	classes.clear();
+	if (stencil.size() != n || n == 0) return;
+
+	// Lookup fused with a tiled transpose: the label image stays row-major
+	// for the reply, the column-major copy feeds the COCO run scan below.
+	vector<unsigned char> columnMajor(n);
+	const int tile = 64;
+	parallelFor(0, (height + tile - 1) / tile, [&](int t0, int t1) {
+		for (int ty = t0 * tile; ty < std::min(height, t1 * tile); ty += tile) {
+			int yEnd = std::min(height, ty + tile);
+			for (int tx = 0; tx < width; tx += tile) {
+				int xEnd = std::min(width, tx + tile);
+				for (int y = ty; y < yEnd; ++y) {
+					const unsigned char* src = &stencil[(size_t)y * width];
+					unsigned char* dst = &labels[(size_t)y * width];
+					for (int x = tx; x < xEnd; ++x) {
+						unsigned char c = lut[src[x]];
+						dst[x] = c;
+						columnMajor[(size_t)x * height + y] = c;
+					}
+				}
+			}
+		}
+	}, 1);
+
+	// One pass over the column-major labels builds every class's runs: a run
+	// of class c starting at s appends (gap since c's last run, length).
+	uint64_t lastEnd[256] = { 0 };
+	vector<uint32_t> counts[256];
+	uint64_t pixels[256] = { 0 };
+	size_t i = 0;
+	while (i < n) {
+		unsigned char c = columnMajor[i];
+		size_t j = i + 1;
+		while (j < n && columnMajor[j] == c) ++j;
+		counts[c].push_back((uint32_t)(i - lastEnd[c]));
+		counts[c].push_back((uint32_t)(j - i));
+		pixels[c] += j - i;
+		lastEnd[c] = j;
+		i = j;
+	}
+	for (int c = 0; c < 256; ++c) {
+		if (pixels[c] == 0) continue;
+		if (lastEnd[c] < n) counts[c].push_back((uint32_t)(n - lastEnd[c]));
+		classes.push_back({ c, pixels[c], std::move(counts[c]) });
+	}
+}
+
+string encodeCocoRle(const vector<uint32_t>& counts)
+{
+	string s;
+	for (size_t i = 0; i < counts.size(); ++i) {
+		long long x = counts[i];
+		if (i > 2) x -= (long long)counts[i - 2];
+		bool more = true;
+		while (more) {
+			char c = (char)(x & 0x1f);
+			x >>= 5;
+			more = (c & 0x10) ? x != -1 : x != 0;
+			if (more) c |= 0x20;
+			s.push_back((char)(c + 48));
+		}
+	}
+	return s;
+}
+
+string semanticClassesJson(const vector<SemanticClassStats>& classes, int width, int height)
+{
+	std::ostringstream ss;
+	ss << "{\"width\":" << width << ",\"height\":" << height << ",\"classes\":[";
+	for (size_t i = 0; i < classes.size(); ++i) {
+		if (i) ss << ",";
+		ss << "{\"id\":" << classes[i].classId << ",\"pixels\":" << classes[i].pixels
+			<< ",\"rle\":{\"size\":[" << height << "," << width << "],\"counts\":\"";
+		// the RLE alphabet is ASCII 48..111; only the backslash needs escaping
+		for (char c : encodeCocoRle(classes[i].counts)) {
+			if (c == '\\') ss << '\\';
+			ss << c;
+		}
+		ss << "\"}}";
+	}
+	ss << "]}";
+	return ss.str();
+}
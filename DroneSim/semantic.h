@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Stencil -> semantic class mapping. A rule matches a stencil value s when
+// (s & mask) == value; the first matching rule gives the class, unmatched
+// values map to class 0. Rules are compiled into a 256-entry lookup table.
+struct SemanticRule {
+	uint8_t mask;
+	uint8_t value;
+	uint8_t classId;
+};
+
+typedef std::array<uint8_t, 256> SemanticLut;
+
+SemanticLut buildSemanticLut(const std::vector<SemanticRule>& rules);
+// Parses "SEMANTIC_MAP mask:value:class ..." (numbers may be hex, 0x..).
+// With no rules the default table is restored.
+bool parseSemanticRules(const std::string& command, std::vector<SemanticRule>& rules);
+void setSemanticRules(const std::vector<SemanticRule>& rules);
+// Current table; defaults to the low three stencil bits, which carry the
+// entity type the game writes.
+SemanticLut currentSemanticLut();
+
+// Label image only, without the per-class statistics.
+void applySemanticLut(const std::vector<unsigned char>& stencil, const SemanticLut& lut, std::vector<unsigned char>& labels);
+
+struct SemanticClassStats {
+	int classId;
+	uint64_t pixels;
+	std::vector<uint32_t> counts;	// COCO RLE runs, column-major, zeros first
+};
+
+// Applies the table to a stencil plane and returns per-class pixel counts
+// and run-length encoded masks for every class that is present.
+void labelStencil(const std::vector<unsigned char>& stencil, int width, int height, const SemanticLut& lut,
+	std::vector<unsigned char>& labels, std::vector<SemanticClassStats>& classes);
+
+// COCO compressed RLE string, as produced by pycocotools' rleToString.
+std::string encodeCocoRle(const std::vector<uint32_t>& counts);
+// {"width":W,"height":H,"classes":[{"id":c,"pixels":n,"rle":{"size":[H,W],"counts":"..."}},...]}
+std::string semanticClassesJson(const std::vector<SemanticClassStats>& classes, int width, int height);
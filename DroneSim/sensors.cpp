@@ -0,0 +1,251 @@
+#include "sensors.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+using Eigen::Quaternionf;
+using Eigen::Vector3f;
+
+static const double EARTH_RADIUS = 6378137.0;
+static const double RAD2DEG = 57.29577951308232;
+
+bool parseSensorCommand(const std::string& command, SensorConfig& cfg)
+{
+	std::istringstream ss(command);
+	std::string name;
+	ss >> name;
+	if (name != "SENSORS") return false;
+	for (std::string tok; ss >> tok;) {
+		size_t eq = tok.find('=');
+		if (eq == std::string::npos) return false;
+		std::string key = tok.substr(0, eq);
+		std::string value = tok.substr(eq + 1);
+		if (key == "seed") {
+			// an integer: through a float, seeds above 2^24 would collide
+			unsigned long seed;
+			size_t used = 0;
+			try {
+				seed = std::stoul(value, &used);
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+			if (used != value.size() || value[0] == '-' || seed > UINT_MAX) return false;
+			cfg.seed = (unsigned int)seed;
+			continue;
+		}
+		float v;
+		try {
+			v = std::stof(value);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		if (key == "imu") cfg.imuRate = v;
+		else if (key == "gnss") cfg.gnssRate = v;
+		else if (key == "baro") cfg.baroRate = v;
+		else if (key == "gyro_noise") cfg.gyroNoise = v;
+		else if (key == "gyro_walk") cfg.gyroBiasWalk = v;
+		else if (key == "accel_noise") cfg.accelNoise = v;
+		else if (key == "accel_walk") cfg.accelBiasWalk = v;
+		else if (key == "gnss_h") cfg.gnssHorizontal = v;
+		else if (key == "gnss_v") cfg.gnssVertical = v;
+		else if (key == "baro_noise") cfg.baroNoise = v;
+		else return false;
+	}
+	return cfg.imuRate > 0.0f && cfg.imuRate <= 10000.0f && cfg.gnssRate > 0.0f && cfg.baroRate > 0.0f
+		&& cfg.gyroNoise >= 0.0f && cfg.gyroBiasWalk >= 0.0f && cfg.accelNoise >= 0.0f && cfg.accelBiasWalk >= 0.0f
+		&& cfg.gnssHorizontal >= 0.0f && cfg.gnssVertical >= 0.0f && cfg.baroNoise >= 0.0f;
+}
+
+SensorSimulator::SensorSimulator(const SensorConfig& cfg)
+	: cfg_(cfg), rng_(cfg.seed), normal_(0.0f, 1.0f)
+{
+}
+
+static int64_t periodUs(float rate)
+{
+	return std::max<int64_t>(1, (int64_t)std::llround(1e6 / rate));
+}
+
+// First multiple of period at or after t.
+static int64_t alignUp(int64_t t, int64_t period)
+{
+	int64_t k = t / period;
+	if (k * period < t) ++k;
+	return k * period;
+}
+
+void SensorSimulator::addPose(int64_t timeUs, const Vector3f& position, const Quaternionf& attitude)
+{
+	if (!poses_.empty() && timeUs <= poses_.back().timeUs) return;
+	if (!poses_.empty() && timeUs - poses_.back().timeUs > maxGapUs) poses_.clear();
+	poses_.push_back({ timeUs, position, attitude.normalized() });
+	// the first interval has no pose before it for a tangent, and a one-sided
+	// one shows up as a spurious acceleration: sampling starts at the second pose
+	if (poses_.size() == 2) {
+		nextImu_ = alignUp(timeUs, periodUs(cfg_.imuRate));
+		nextGnss_ = alignUp(timeUs, periodUs(cfg_.gnssRate));
+		nextBaro_ = alignUp(timeUs, periodUs(cfg_.baroRate));
+		return;
+	}
+	if (poses_.size() < 4) return;
+	if (poses_.size() > 4) poses_.pop_front();
+	// interval [a, b] now has tangents on both ends
+	generate(poses_[0], poses_[1], poses_[2], poses_[3]);
+}
+
+void SensorSimulator::generate(const PoseSample& prev, const PoseSample& a, const PoseSample& b, const PoseSample& next)
+{
+	const float T = (b.timeUs - a.timeUs) * 1e-6f;
+	// tangents from the quadratic through three neighbouring poses, which
+	// stays accurate when the tick length jitters
+	auto tangent = [](const PoseSample& p0, const PoseSample& p1, const PoseSample& p2) {
+		float h0 = (p1.timeUs - p0.timeUs) * 1e-6f, h1 = (p2.timeUs - p1.timeUs) * 1e-6f;
+		Vector3f d0 = (p1.position - p0.position) / h0, d1 = (p2.position - p1.position) / h1;
+		return Vector3f((d0 * h1 + d1 * h0) / (h0 + h1));
+	};
+	const Vector3f va = tangent(prev, a, b);
+	const Vector3f vb = tangent(a, b, next);
+	// body rate is constant over the interval: log(qa^-1 qb) / T
+	Eigen::AngleAxisf delta(a.attitude.conjugate() * b.attitude);
+	float angle = delta.angle();
+	if (angle > 3.14159265f) angle -= 6.2831853f;
+	const Vector3f omega = delta.axis() * (angle / T);
+
+	// in terms of the step a -> b: world coordinates are large and the
+	// second derivative of the absolute form cancels them away
+	const Vector3f D = b.position - a.position;
+	auto hermite = [&](float s, Vector3f& p, Vector3f& v, Vector3f& acc) {
+		float s2 = s * s, s3 = s2 * s;
+		p = a.position + (3 * s2 - 2 * s3) * D + (s3 - 2 * s2 + s) * T * va + (s3 - s2) * T * vb;
+		v = ((6 * s - 6 * s2) * D + (3 * s2 - 4 * s + 1) * T * va + (3 * s2 - 2 * s) * T * vb) / T;
+		acc = ((6 - 12 * s) * D + (6 * s - 4) * T * va + (6 * s - 2) * T * vb) / (T * T);
+	};
+
+	const int64_t imuPeriod = periodUs(cfg_.imuRate);
+	const float dt = imuPeriod * 1e-6f;
+	const float gyroSigma = cfg_.gyroNoise / std::sqrt(dt), accelSigma = cfg_.accelNoise / std::sqrt(dt);
+	const float gyroWalk = cfg_.gyroBiasWalk * std::sqrt(dt), accelWalk = cfg_.accelBiasWalk * std::sqrt(dt);
+	for (; nextImu_ < b.timeUs; nextImu_ += imuPeriod) {
+		float s = (nextImu_ - a.timeUs) / (float)(b.timeUs - a.timeUs);
+		Vector3f p, v, acc;
+		hermite(s, p, v, acc);
+		const Quaternionf q = a.attitude.slerp(s, b.attitude);
+		const Vector3f force = q.conjugate() * (acc + Vector3f(0.0f, 0.0f, cfg_.gravity));
+		for (int k = 0; k < 3; ++k) {
+			gyroBias_[k] += gyroWalk * gaussian();
+			accelBias_[k] += accelWalk * gaussian();
+		}
+		ImuSample sample;
+		sample.timeUs = nextImu_;
+		for (int k = 0; k < 3; ++k) {
+			sample.gyro[k] = omega[k] + gyroBias_[k] + gyroSigma * gaussian();
+			sample.accel[k] = force[k] + accelBias_[k] + accelSigma * gaussian();
+		}
+		pending_.imu.push_back(sample);
+	}
+
+	const int64_t gnssPeriod = periodUs(cfg_.gnssRate);
+	for (; nextGnss_ < b.timeUs; nextGnss_ += gnssPeriod) {
+		float s = (nextGnss_ - a.timeUs) / (float)(b.timeUs - a.timeUs);
+		Vector3f p, v, acc;
+		hermite(s, p, v, acc);
+		GnssSample sample;
+		sample.timeUs = nextGnss_;
+		p += Vector3f(cfg_.gnssHorizontal * gaussian(), cfg_.gnssHorizontal * gaussian(), cfg_.gnssVertical * gaussian());
+		for (int k = 0; k < 3; ++k) {
+			sample.position[k] = p[k];
+			sample.velocity[k] = v[k] + cfg_.gnssVelocity * gaussian();
+		}
+		// local tangent plane (x east, y north) around the configured origin
+		const double lat0 = cfg_.originLatitude / RAD2DEG;
+		sample.latitude = cfg_.originLatitude + p.y() / EARTH_RADIUS * RAD2DEG;
+		sample.longitude = cfg_.originLongitude + p.x() / (EARTH_RADIUS * std::cos(lat0)) * RAD2DEG;
+		sample.altitude = cfg_.originAltitude + p.z();
+		pending_.gnss.push_back(sample);
+	}
+
+	const int64_t baroPeriod = periodUs(cfg_.baroRate);
+	const float baroWalk = cfg_.baroBiasWalk * std::sqrt(baroPeriod * 1e-6f);
+	for (; nextBaro_ < b.timeUs; nextBaro_ += baroPeriod) {
+		float s = (nextBaro_ - a.timeUs) / (float)(b.timeUs - a.timeUs);
+		Vector3f p, v, acc;
+		hermite(s, p, v, acc);
+		baroBias_ += baroWalk * gaussian();
+		BaroSample sample;
+		sample.timeUs = nextBaro_;
+		sample.altitude = cfg_.originAltitude + p.z() + baroBias_ + cfg_.baroNoise * gaussian();
+		sample.pressure = 101325.0f * std::pow(1.0f - 2.25577e-5f * sample.altitude, 5.25588f);
+		pending_.baro.push_back(sample);
+	}
+}
+
+void SensorSimulator::drain(SensorBatch& out)
+{
+	out.imu.insert(out.imu.end(), pending_.imu.begin(), pending_.imu.end());
+	out.gnss.insert(out.gnss.end(), pending_.gnss.begin(), pending_.gnss.end());
+	out.baro.insert(out.baro.end(), pending_.baro.begin(), pending_.baro.end());
+	pending_ = SensorBatch();
+}
+
+static std::mutex sensor_mtx;
+static SensorSimulator simulator;
+static unsigned int streams = 0;
+static bool streamOpen = false;
+
+unsigned int beginSensorStream(const SensorConfig& cfg)
+{
+	std::lock_guard<std::mutex> lk(sensor_mtx);
+	simulator = SensorSimulator(cfg);
+	streamOpen = true;
+	return ++streams;
+}
+
+void endSensorStream(unsigned int stream)
+{
+	std::lock_guard<std::mutex> lk(sensor_mtx);
+	if (stream == streams) streamOpen = false;
+}
+
+bool sensorStreamActive()
+{
+	std::lock_guard<std::mutex> lk(sensor_mtx);
+	return streamOpen;
+}
+
+void feedSensorPose(int64_t timeUs, const Vector3f& position, const Quaternionf& attitude)
+{
+	std::lock_guard<std::mutex> lk(sensor_mtx);
+	if (streamOpen) simulator.addPose(timeUs, position, attitude);
+}
+
+bool takeSensorSamples(unsigned int stream, SensorBatch& out)
+{
+	std::lock_guard<std::mutex> lk(sensor_mtx);
+	if (stream != streams || !streamOpen) return false;
+	simulator.drain(out);
+	return true;
+}
+
+std::vector<unsigned char> serializeSensorBatch(const SensorBatch& batch)
+{
+	uint32_t counts[3] = { (uint32_t)batch.imu.size(), (uint32_t)batch.gnss.size(), (uint32_t)batch.baro.size() };
+	size_t imuBytes = batch.imu.size() * sizeof(ImuSample);
+	size_t gnssBytes = batch.gnss.size() * sizeof(GnssSample);
+	size_t baroBytes = batch.baro.size() * sizeof(BaroSample);
+	std::vector<unsigned char> out(4 + sizeof(counts) + imuBytes + gnssBytes + baroBytes);
+	unsigned char* at = out.data();
+	memcpy(at, "SENS", 4);
+	memcpy(at + 4, counts, sizeof(counts));
+	at += 4 + sizeof(counts);
+	if (imuBytes) memcpy(at, batch.imu.data(), imuBytes);
+	at += imuBytes;
+	if (gnssBytes) memcpy(at, batch.gnss.data(), gnssBytes);
+	at += gnssBytes;
+	if (baroBytes) memcpy(at, batch.baro.data(), baroBytes);
+	return out;
+}
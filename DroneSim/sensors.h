@@ -0,0 +1,116 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+// Inertial / GNSS / barometer simulation from the camera trajectory. Pose
+// samples come in at the script tick rate; positions are interpolated with a
+// cubic Hermite spline (three-point tangents) and orientations with slerp, and
+// the sensors are sampled from that at fixed rates aligned to the clock.
+// Body axes follow the camera: x right, y forward, z up. Timestamps are
+// microseconds on the capture clock (system_clock since the epoch).
+struct SensorConfig {
+	float imuRate = 200.0f;		// Hz
+	float gnssRate = 10.0f;
+	float baroRate = 25.0f;
+	unsigned int seed = 0;
+	// continuous-time noise densities and bias random walks (EuRoC-like)
+	float gyroNoise = 1.6968e-4f;	// rad/s/sqrt(Hz)
+	float gyroBiasWalk = 1.9393e-5f;	// rad/s^2/sqrt(Hz)
+	float accelNoise = 2.0e-3f;		// m/s^2/sqrt(Hz)
+	float accelBiasWalk = 3.0e-3f;	// m/s^3/sqrt(Hz)
+	float gnssHorizontal = 1.5f;	// m, per fix
+	float gnssVertical = 3.0f;
+	float gnssVelocity = 0.1f;		// m/s
+	float baroNoise = 0.3f;			// m
+	float baroBiasWalk = 0.01f;		// m/sqrt(s)
+	float gravity = 9.81f;
+	// world origin as a geodetic reference for latitude / longitude
+	double originLatitude = 34.0522;
+	double originLongitude = -118.2437;
+	float originAltitude = 0.0f;
+};
+
+#pragma pack(push, 1)
+struct ImuSample {
+	int64_t timeUs;
+	float gyro[3];		// rad/s, body
+	float accel[3];		// specific force, m/s^2, body
+};
+
+struct GnssSample {
+	int64_t timeUs;
+	double latitude;	// degrees
+	double longitude;
+	float altitude;		// m
+	float position[3];	// world metres, noisy
+	float velocity[3];	// world m/s, noisy
+};
+
+struct BaroSample {
+	int64_t timeUs;
+	float pressure;		// Pa, standard atmosphere
+	float altitude;		// m, noisy
+};
+#pragma pack(pop)
+
+struct SensorBatch {
+	std::vector<ImuSample> imu;
+	std::vector<GnssSample> gnss;
+	std::vector<BaroSample> baro;
+	bool empty() const { return imu.empty() && gnss.empty() && baro.empty(); }
+};
+
+// "SENSORS [imu=Hz] [gnss=Hz] [baro=Hz] [seed=n] [gyro_noise=f] [gyro_walk=f]
+//  [accel_noise=f] [accel_walk=f] [gnss_h=m] [gnss_v=m] [baro_noise=m]"
+bool parseSensorCommand(const std::string& command, SensorConfig& cfg);
+
+// Deterministic for a given seed and pose sequence. Samples for an interval
+// are produced once the pose after it is known, so output lags one tick, and
+// start at the second pose of a stream (or after a gap).
+class SensorSimulator {
+public:
+	explicit SensorSimulator(const SensorConfig& cfg = SensorConfig());
+
+	void addPose(int64_t timeUs, const Eigen::Vector3f& position, const Eigen::Quaternionf& attitude);
+	// Moves the samples generated so far to the back of out.
+	void drain(SensorBatch& out);
+
+	// Pose gaps longer than this are not interpolated across.
+	static const int64_t maxGapUs = 500000;
+
+private:
+	struct PoseSample {
+		int64_t timeUs;
+		Eigen::Vector3f position;
+		Eigen::Quaternionf attitude;
+	};
+	void generate(const PoseSample& prev, const PoseSample& a, const PoseSample& b, const PoseSample& next);
+	float gaussian() { return normal_(rng_); }
+
+	SensorConfig cfg_;
+	std::mt19937 rng_;
+	std::normal_distribution<float> normal_;
+	std::deque<PoseSample> poses_;
+	int64_t nextImu_ = 0, nextGnss_ = 0, nextBaro_ = 0;
+	Eigen::Vector3f gyroBias_ = Eigen::Vector3f::Zero();
+	Eigen::Vector3f accelBias_ = Eigen::Vector3f::Zero();
+	float baroBias_ = 0.0f;
+	SensorBatch pending_;
+};
+
+// Server / script hand-off. The server opens a stream (the newest one wins);
+// the script thread feeds it one pose per tick; the stream drains samples.
+unsigned int beginSensorStream(const SensorConfig& cfg);
+void endSensorStream(unsigned int stream);
+bool sensorStreamActive();
+void feedSensorPose(int64_t timeUs, const Eigen::Vector3f& position, const Eigen::Quaternionf& attitude);
+bool takeSensorSamples(unsigned int stream, SensorBatch& out);
+
+// Reply layout: "SENS", u32 imu count, u32 gnss count, u32 baro count, then
+// the three arrays of packed samples.
+std::vector<unsigned char> serializeSensorBatch(const SensorBatch& batch);
@@ -1,36 +1,242 @@
 #include "server.h"
+#include "capture.h"
+#include "channels.h"
+#include "commands.h"
+#include "control.h"
+#include "environment.h"
+#include "frame.h"
+#include "latency.h"
+#include "lidar.h"
+#include "lockstep.h"
+#include "metrics.h"
+#include "pose.h"
+#include "recorder.h"
+#include "rig.h"
+#include "semantic.h"
+#include "sensors.h"
+#include "sharedreply.h"
+#include "survey.h"
 
 namespace ba = boost::asio;
 namespace bap = boost::asio::ip;
 
-// 用于管理 ModServer 实例的全局指针
-static std::unique_ptr<class ModServer> g_modServerInstance;
 // 用于管理 io_context 的全局实例
 static ba::io_context g_ioContext;
+// 用于管理 ModServer 实例的全局指针。须在 g_ioContext 之后声明：静态对象逆序析构，
+// 服务器的 socket 和计时器要先于它们所属的 io_context 销毁
+static std::unique_ptr<class ModServer> g_modServerInstance;
 // 用于管理服务器线程的全局指针
 static std::unique_ptr<std::thread> g_serverThread;
 
-extern catchState cmdToCatch;
-extern std::string g_rgbCapturedFilePath;
-extern std::string g_depthCapturedFilePath;
-extern std::string g_stencilCapturedFilePath;
-extern std::string g_matrixCapturedFilePath;
-extern std::queue<std::string> g_cmdQueue;
-
 char* SERVER_LOG_FILE = "logs\\server.log";
 
+// 命令帧为 4 字节小端长度 + 命令文本。不带长度前缀的旧客户端以换行符结束命令，
+// 或在数据停止到达 COMMAND_GRACE 后按整条命令处理；命令不得超过 MAX_COMMAND_BYTES
+static const std::chrono::milliseconds COMMAND_GRACE(20);
+static const size_t MAX_COMMAND_BYTES = 4 * 1024 * 1024;
+
+// 运行指标：由 STATS 命令返回，STATS_LOG 定期写入文件
+static MetricCounter& g_connectionsMetric = metricCounter("server.connections");
+static MetricCounter& g_commandsMetric = metricCounter("server.commands");
+static MetricCounter& g_bytesSentMetric = metricCounter("server.bytes_sent");
+static MetricCounter& g_errorsMetric = metricCounter("server.errors");
+static MetricHistogram& g_sendMetric = metricHistogram("server.send_us");
+
+// ====================================================================
+// CONTROL 长连接：接管 socket 后持续读取固定长度的二进制设定点，
+// 主监听 socket 立即回到 accept，其它命令不受影响
+// ====================================================================
+class ControlSession : public std::enable_shared_from_this<ControlSession>
+{
+public:
+    explicit ControlSession(boost::asio::ip::tcp::socket socket)
+        : socket_(std::move(socket)), session_(beginControlSession())
+    {
+    }
+
+    void start()
+    {
+        // 先回复 OK（带长度前缀），之后只收不发
+        auto self = shared_from_this();
+        auto ok = std::make_shared<std::vector<unsigned char>>(std::vector<unsigned char>{ 2, 0, 0, 0, 'O', 'K' });
+        boost::asio::async_write(socket_, boost::asio::buffer(*ok),
+            [this, self, ok](const boost::system::error_code& error, size_t) {
+            if (error) {
+                close("Error acknowledging CONTROL: " + error.message());
+                return;
+            }
+            read_next();
+        });
+    }
+
+private:
+    void read_next()
+    {
+        auto self = shared_from_this();
+        boost::asio::async_read(socket_, boost::asio::buffer(message_),
+            [this, self](const boost::system::error_code& error, size_t) {
+            if (error) {
+                close("Control session closed: " + error.message());
+                return;
+            }
+            ControlSetpoint setpoint;
+            if (decodeControlSetpoint(message_.data(), setpoint)) {
+                publishControlSetpoint(session_, setpoint);
+            }
+            read_next();
+        });
+    }
+
+    void close(const std::string& reason)
+    {
+        ControlStats stats = controlStats();
+        log_to_pedTxt(reason + " (received " + std::to_string(stats.received) + ", applied " + std::to_string(stats.applied)
+            + ", mean latency " + std::to_string(stats.meanLatencyMs) + " ms)", SERVER_LOG_FILE);
+        endControlSession(session_);
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+    }
+
+    boost::asio::ip::tcp::socket socket_;
+    unsigned int session_;
+    std::array<unsigned char, sizeof(ControlSetpointMsg)> message_;
+};
+
+// ====================================================================
+// SENSORS 长连接：每 20ms 把新生成的 IMU/GNSS/气压计样本打包推送，
+// 同时挂一个读操作，客户端断开时结束推流
+// ====================================================================
+class SensorSession : public std::enable_shared_from_this<SensorSession>
+{
+public:
+    SensorSession(boost::asio::ip::tcp::socket socket, const SensorConfig& cfg)
+        : socket_(std::move(socket)), timer_(socket_.get_executor()), stream_(beginSensorStream(cfg))
+    {
+    }
+
+    void start()
+    {
+        auto self = shared_from_this();
+        socket_.async_read_some(boost::asio::buffer(discard_),
+            [this, self](const boost::system::error_code& error, size_t) {
+            close(error ? "Sensor stream closed by client: " + error.message() : "Sensor stream closed: unexpected client data");
+        });
+        poll();
+    }
+
+private:
+    void poll()
+    {
+        if (!socket_.is_open()) return;
+        SensorBatch batch;
+        if (!takeSensorSamples(stream_, batch)) {
+            close("Sensor stream superseded by a newer SENSORS connection");
+            return;
+        }
+        auto self = shared_from_this();
+        if (batch.empty()) {
+            timer_.expires_after(std::chrono::milliseconds(20));
+            timer_.async_wait([this, self](const boost::system::error_code& error) {
+                if (!error) poll();
+            });
+            return;
+        }
+        std::vector<unsigned char> payload = serializeSensorBatch(batch);
+        auto message = std::make_shared<std::vector<unsigned char>>(4 + payload.size());
+        uint32_t size = static_cast<uint32_t>(payload.size());
+        std::memcpy(message->data(), &size, sizeof(size));
+        std::memcpy(message->data() + 4, payload.data(), payload.size());
+        boost::asio::async_write(socket_, boost::asio::buffer(*message),
+            [this, self, message](const boost::system::error_code& error, size_t) {
+            if (error) {
+                g_errorsMetric.add();
+                close("Error sending sensor samples: " + error.message());
+                return;
+            }
+            g_bytesSentMetric.add(message->size());
+            timer_.expires_after(std::chrono::milliseconds(20));
+            timer_.async_wait([this, self](const boost::system::error_code& wait_error) {
+                if (!wait_error) poll();
+            });
+        });
+    }
+
+    void close(const std::string& reason)
+    {
+        if (!socket_.is_open()) return;
+        log_to_pedTxt(reason, SERVER_LOG_FILE);
+        endSensorStream(stream_);
+        boost::system::error_code ignored;
+        timer_.cancel();
+        socket_.close(ignored);
+    }
+
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::steady_timer timer_;
+    unsigned int stream_;
+    std::array<char, 64> discard_;
+};
+
 // ====================================================================
 // ModServer 类成员函数的实现
 // 记住使用 ModServer:: 前缀
 // ====================================================================
 ModServer::ModServer(boost::asio::io_context& io_context, unsigned short port)
     : acceptor_(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
-      socket_(io_context)
+      socket_(io_context),
+      command_timer_(io_context),
+      pose_timer_(io_context),
+      survey_timer_(io_context),
+      stats_timer_(io_context)
 {
     log_to_pedTxt("Mod Server listening on port " + std::to_string(port), SERVER_LOG_FILE);
     start_accept();
 }
 
+ModServer::~ModServer()
+{
+    if (survey_planner_.joinable()) survey_planner_.join();
+}
+
+// 从最近的捕获历史中挑出 match 选中的帧，按捕获先后组成回复：
+// 帧数(4字节)，每帧为 长度(4字节) + META/RGBA/DPTH 通道。没有匹配的帧时返回 0；
+// timelines 非空时按同样顺序收集各帧的阶段时间戳
+static uint32_t build_tagged_frames_reply(const std::function<bool(const CapturedFrame&)>& match, std::vector<unsigned char>& reply,
+                                          std::vector<CaptureTimeline>* timelines = nullptr)
+{
+    auto frames = recentCapturedFrames(capturedFrameHistory);
+    reply.assign(4, 0);
+    uint32_t count = 0;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        if (!match(**it)) continue;
+        std::vector<unsigned char> block;
+        appendFrameChannels(block, **it);
+        if (timelines) timelines->push_back((*it)->timeline);
+        uint32_t size = static_cast<uint32_t>(block.size());
+        reply.insert(reply.end(), reinterpret_cast<unsigned char*>(&size), reinterpret_cast<unsigned char*>(&size) + sizeof(uint32_t));
+        reply.insert(reply.end(), block.begin(), block.end());
+        count++;
+    }
+    std::memcpy(reply.data(), &count, sizeof(count));
+    return count;
+}
+
+// CAPTURE 的回复：RGB 大小(4字节) + 深度大小(4字节) + 截图 + 深度，再按命令追加派生通道，
+// 全部取自同一帧
+static bool build_capture_reply(const std::string& command, const std::shared_ptr<const CapturedFrame>& frame,
+                                std::vector<unsigned char>& reply, std::string& error)
+{
+    const unsigned char* depth_bytes = reinterpret_cast<const unsigned char*>(frame->depth.data());
+    uint32_t rgb_size = static_cast<uint32_t>(frame->screen.size());
+    uint32_t depth_size = static_cast<uint32_t>(frame->depth.size() * sizeof(float));
+    reply.clear();
+    reply.insert(reply.end(), reinterpret_cast<unsigned char*>(&rgb_size), reinterpret_cast<unsigned char*>(&rgb_size) + sizeof(uint32_t));
+    reply.insert(reply.end(), reinterpret_cast<unsigned char*>(&depth_size), reinterpret_cast<unsigned char*>(&depth_size) + sizeof(uint32_t));
+    reply.insert(reply.end(), frame->screen.begin(), frame->screen.end());
+    reply.insert(reply.end(), depth_bytes, depth_bytes + depth_size);
+    return appendRequestedChannels(command, frame, reply, error);
+}
+
 void ModServer::start_accept()
 {
     log_to_pedTxt("Waiting for new client connection...", SERVER_LOG_FILE);
@@ -44,6 +250,7 @@ void ModServer::start_accept()
                     std::string client_info = socket_.remote_endpoint().address().to_string() + ":" + 
                                             std::to_string(socket_.remote_endpoint().port());
                     log_to_pedTxt("Client connected from: " + client_info, SERVER_LOG_FILE);
+                    g_connectionsMetric.add();
                     
                     // 立即开始处理客户端连接
                     handle_client_connection();
@@ -55,6 +262,7 @@ void ModServer::start_accept()
             else
             {
                 log_to_pedTxt("Error accepting connection: " + error.message(), SERVER_LOG_FILE);
+                g_errorsMetric.add();
                 // 继续监听新的连接
                 start_accept();
             }
@@ -93,17 +301,24 @@ void ModServer::handle_client_connection()
         start_accept(); // 重新开始接受连接
         return;
     }
-    
+
     log_to_pedTxt("Starting async_read_some operation", SERVER_LOG_FILE);
-    
+    pipelined_ = false;
+    leftover_.clear();
+    read_command(std::make_shared<std::string>(), 0);
+}
+
+void ModServer::read_command(std::shared_ptr<std::string> pending, int64_t received_us)
+{
     // 使用shared_ptr管理buffer生命周期
-    auto buffer = std::make_shared<std::vector<char>>(128);
+    auto buffer = std::make_shared<std::vector<char>>(64 * 1024);
 
     socket_.async_read_some(boost::asio::buffer(*buffer),
-        [this, buffer](const boost::system::error_code& error, size_t bytes_transferred)
+        [this, buffer, pending, received_us](const boost::system::error_code& error, size_t bytes_transferred)
         {
+            const int64_t arrived_us = received_us != 0 ? received_us : latencyMicros();
             log_to_pedTxt("async_read_some callback triggered", SERVER_LOG_FILE);
-            
+
             if (!error)
             {
                 log_to_pedTxt("Async_read_some completed. Bytes transferred: " + std::to_string(bytes_transferred), SERVER_LOG_FILE);
@@ -120,120 +335,15 @@ void ModServer::handle_client_connection()
                     return;
                 }
 
-                // 在转换为字符串之前，打印原始字节内容 (ASCII表示)
-                std::string raw_command_bytes(buffer->begin(), buffer->begin() + bytes_transferred);
-                std::string debug_output = "Raw bytes received (ASCII): ";
-                for (char c : raw_command_bytes) {
-                    if (c >= 32 && c <= 126) { // 可打印ASCII字符
-                        debug_output += c;
-                    } else {
-                        debug_output += "\\x" + std::to_string(static_cast<unsigned int>(static_cast<unsigned char>(c))); // 非可打印字符显示十六进制
-                    }
-                }
-                log_to_pedTxt(debug_output, SERVER_LOG_FILE);
-
-                std::string command(buffer->begin(), buffer->begin() + bytes_transferred);
-                
-                // 去除字符串末尾的空白字符
-                command.erase(command.find_last_not_of(" \t\n\r\f\v") + 1);
-                
-                log_to_pedTxt("Received command (string conversion): '" + command + "'", SERVER_LOG_FILE);
-
-                if (command == "REQUEST")
-                {
-                    // REQUEST：将命令推入队列，由 GTAV 脚本线程（script.cpp）处理
-                    g_cmdQueue.push(command); 
-                    log_to_pedTxt("Command added to queue: 'REQUEST'", SERVER_LOG_FILE);
-
-                    // 立即关闭连接并重新开始接受新连接
-                    if (socket_.is_open()) {
-                        socket_.close(); 
-                    }
-                    start_accept(); 
-                }
-                else if (command == "CHECK") {
-                    // 检查是否捕获RGBD完成
-					std::string catch_flag = (cmdToCatch == catchStop) ? "READY" : "NOTREADY";
-					log_to_pedTxt("Command recognized: CHECK. Capture status: " + catch_flag, SERVER_LOG_FILE);
-                    if (cmdToCatch == catchStop) {
-                        send_data_async(std::vector<unsigned char>{'R','E','A','D','Y'});
-                    } else {
-                        send_data_async(std::vector<unsigned char>{'N','O','T','R','E','A','D','Y'});
-                    }
-                }
-                else if (command == "CAPTURE")
-                {
-                    // CAPTURE：立即发送上次捕获的文件
-                    log_to_pedTxt("Command recognized: CAPTURE. Sending last captured data.", SERVER_LOG_FILE);
-                    
-                    // 从全局路径变量中获取数据（这些路径是在 REQUEST 期间设置的）
-                    std::vector<unsigned char> rgb_data = GetBytes(g_rgbCapturedFilePath);
-                    std::vector<unsigned char> depth_data = GetBytes(g_depthCapturedFilePath);
-                    std::vector<unsigned char> stencil_data = GetBytes(g_stencilCapturedFilePath);
-                    std::vector<unsigned char> matrix_data = GetBytes(g_matrixCapturedFilePath);
-
-                    // 检查数据是否有效，如果无效（例如大小为0），则发送错误或空数据
-                    if (rgb_data.empty() || depth_data.empty()) {
-                        log_to_pedTxt("Error: RGB or Depth data is empty. Was REQUEST command sent?", SERVER_LOG_FILE);
-                        std::string error_resp = "ERROR: Last capture data not ready.";
-                        boost::asio::async_write(socket_, boost::asio::buffer(error_resp), [this](const boost::system::error_code& write_error, size_t) {
-                            if (write_error) log_to_pedTxt("Error sending error response: " + write_error.message(), SERVER_LOG_FILE);
-                            if (socket_.is_open()) socket_.close();
-                            start_accept();
-                        });
-                        return; // 结束处理
-                    }
-                    
-                    // 准备组合数据 
-                    std::vector<unsigned char> combined_data;
-                    uint32_t rgb_size = static_cast<uint32_t>(rgb_data.size());
-                    combined_data.insert(combined_data.end(), reinterpret_cast<unsigned char*>(&rgb_size), reinterpret_cast<unsigned char*>(&rgb_size) + sizeof(uint32_t));
-                    uint32_t depth_size = static_cast<uint32_t>(depth_data.size());
-                    combined_data.insert(combined_data.end(), reinterpret_cast<unsigned char*>(&depth_size), reinterpret_cast<unsigned char*>(&depth_size) + sizeof(uint32_t));
-                    // uint32_t stencil_size = static_cast<uint32_t>(stencil_data.size());
-                    // combined_data.insert(combined_data.end(), reinterpret_cast<unsigned char*>(&stencil_size), reinterpret_cast<unsigned char*>(&stencil_size) + sizeof(uint32_t));
-                    // uint32_t matrix_size = static_cast<uint32_t>(g_matrixCapturedFilePath.size());
-                    // combined_data.insert(combined_data.end(), reinterpret_cast<unsigned char*>(&matrix_size), reinterpret_cast<unsigned char*>(&matrix_size) + sizeof(uint32_t));
-                    
-                    combined_data.insert(combined_data.end(), rgb_data.begin(), rgb_data.end());
-                    combined_data.insert(combined_data.end(), depth_data.begin(), depth_data.end());
-                    // combined_data.insert(combined_data.end(), stencil_data.begin(), stencil_data.end());
-                    // combined_data.insert(combined_data.end(), matrix_data.begin(), matrix_data.end());
-                    
-                    log_to_pedTxt("Combined image data prepared with total size: " + std::to_string(combined_data.size()) + " bytes", SERVER_LOG_FILE);
-                    send_data_async(std::move(combined_data)); // 异步发送数据
-                    
-                    // 注意：send_data_async 会在发送完成后关闭连接并调用 start_accept()
-                }
-                else
-                {
-                    g_cmdQueue.push(command); // 将命令添加到队列中
-                    log_to_pedTxt("Command added to queue: '" + command + "'", SERVER_LOG_FILE);
-                    if (socket_.is_open()) {
-                        socket_.close(); // 关闭当前连接
-                    }
-                    start_accept(); // 重新开始接受新连接
-                }
-                // set_status_text("Command received: " + command);
-                // else
-                // {
-                //     log_to_pedTxt("Unknown command received: '" + command + "'. Sending error response.", SERVER_LOG_FILE);
-                //     std::string unknown_resp = "ERROR: Unknown command.";
-                //     boost::asio::async_write(socket_, boost::asio::buffer(unknown_resp),
-                //         [this](const boost::system::error_code& write_error, size_t){
-                //         if (write_error) log_to_pedTxt("Error sending unknown command response: " + write_error.message(), SERVER_LOG_FILE);
-                //         if (socket_.is_open()) {
-                //             socket_.close();
-                //         }
-                //         start_accept(); // 重新开始接受连接
-                //     });
-                // }
+                pending->append(buffer->data(), bytes_transferred);
+                process_command(pending, arrived_us);
             }
             else
             {
                 log_to_pedTxt("Error receiving command (read_some): " + error.message(), SERVER_LOG_FILE);
+                g_errorsMetric.add();
                 log_to_pedTxt("Error value: " + std::to_string(error.value()), SERVER_LOG_FILE);
-                
+
                 // 检查是否是连接重置错误
                 if (error == boost::asio::error::connection_reset || 
                     error == boost::asio::error::eof ||
@@ -241,19 +351,437 @@ void ModServer::handle_client_connection()
                 {
                     log_to_pedTxt("Client disconnected before sending data", SERVER_LOG_FILE);
                 }
-                
+
                 if (socket_.is_open()) {
                     socket_.close();
                 }
                 log_to_pedTxt("Connection closed due to read error.", SERVER_LOG_FILE);
-                
+
                 // 重新开始接受新连接
                 start_accept();
             }
         });
 }
 
-void ModServer::send_data_async(std::vector<unsigned char> data) {
+void ModServer::process_command(std::shared_ptr<std::string> pending, int64_t arrived_us)
+{
+    // 命令帧：4字节小端长度 + 命令文本，与回复的格式相同；TRAJECTORY 等长命令
+    // 可能分成多个 TCP 段到达，读满长度为止。流水线连接只接受命令帧
+    if (pipelined_ && pending->size() < 4) {
+        read_command(pending, arrived_us);
+        return;
+    }
+    if (pending->size() >= 4 && (*pending)[3] == '\0') {
+        uint32_t length = 0;
+        std::memcpy(&length, pending->data(), sizeof(length));
+        if (length > MAX_COMMAND_BYTES) {
+            log_to_pedTxt("Command frame of " + std::to_string(length) + " bytes exceeds the limit, closing connection", SERVER_LOG_FILE);
+            g_errorsMetric.add();
+            boost::system::error_code ignored;
+            socket_.close(ignored);
+            start_accept();
+            return;
+        }
+        if (pending->size() >= 4 + (size_t)length) {
+            // 流水线连接上紧随其后的命令留给下一次读取
+            leftover_ = pending->substr(4 + (size_t)length);
+            handle_command(pending->substr(4, length), arrived_us);
+        }
+        else {
+            read_command(pending, arrived_us);
+        }
+        return;
+    }
+
+    // 不带长度前缀的旧客户端（文本命令不含 NUL 字节）：换行符结束命令，
+    // 没有换行时数据停止到达 COMMAND_GRACE 后，已收到的内容即整条命令
+    size_t newline = pending->find('\n');
+    if (newline != std::string::npos) {
+        pending->resize(newline);
+        handle_command(std::move(*pending), arrived_us);
+        return;
+    }
+    if (pending->size() > MAX_COMMAND_BYTES) {
+        log_to_pedTxt("Command exceeds " + std::to_string(MAX_COMMAND_BYTES) + " bytes without a newline, closing connection", SERVER_LOG_FILE);
+        g_errorsMetric.add();
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        start_accept();
+        return;
+    }
+    if (pending->find('\0') != std::string::npos) {
+        // 长度前缀还没收全
+        read_command(pending, arrived_us);
+        return;
+    }
+    command_timer_.expires_after(COMMAND_GRACE);
+    command_timer_.async_wait([this, pending, arrived_us](const boost::system::error_code& wait_error) {
+        if (wait_error) return;
+        boost::system::error_code ignored;
+        if (socket_.is_open() && socket_.available(ignored) > 0) read_command(pending, arrived_us);
+        else handle_command(std::move(*pending), arrived_us);
+    });
+}
+
+void ModServer::finish_request()
+{
+    if (pipelined_ && socket_.is_open()) {
+        auto pending = std::make_shared<std::string>(std::move(leftover_));
+        leftover_.clear();
+        // 经 post 继续，缓冲中连续的无回复命令不会层层递归
+        ba::post(acceptor_.get_executor(), [this, pending]() {
+            if (!socket_.is_open()) {
+                start_accept();
+                return;
+            }
+            if (pending->empty()) read_command(pending, 0);
+            else process_command(pending, latencyMicros());
+        });
+        return;
+    }
+    if (socket_.is_open()) {
+        socket_.close(); // 关闭当前连接
+    }
+    start_accept(); // 重新开始接受新连接
+}
+
+void ModServer::handle_command(std::string command, int64_t received_us)
+{
+    // 打印原始字节内容 (ASCII表示)
+    std::string debug_output = "Raw bytes received (ASCII): ";
+    for (char c : command) {
+        if (c >= 32 && c <= 126) { // 可打印ASCII字符
+            debug_output += c;
+        } else {
+            debug_output += "\\x" + std::to_string(static_cast<unsigned int>(static_cast<unsigned char>(c))); // 非可打印字符显示十六进制
+        }
+    }
+    log_to_pedTxt(debug_output, SERVER_LOG_FILE);
+
+    // 去除字符串末尾的空白字符
+    command.erase(command.find_last_not_of(" \t\n\r\f\v") + 1);
+
+    log_to_pedTxt("Received command (string conversion): '" + command + "'", SERVER_LOG_FILE);
+    g_commandsMetric.add();
+
+    if (command == "REQUEST")
+    {
+        // REQUEST：将命令推入队列，由 GTAV 脚本线程（script.cpp）处理
+        markCaptureStage(stageCommandReceived, received_us);
+        g_cmdQueue.push(command); 
+        log_to_pedTxt("Command added to queue: 'REQUEST'", SERVER_LOG_FILE);
+
+        // 立即关闭连接并重新开始接受新连接（流水线连接则继续读下一条）
+        finish_request();
+    }
+    else if (command == "CHECK") {
+        // 检查是否捕获RGBD完成
+		std::string catch_flag = (cmdToCatch == catchStop) ? "READY" : "NOTREADY";
+		log_to_pedTxt("Command recognized: CHECK. Capture status: " + catch_flag, SERVER_LOG_FILE);
+        if (cmdToCatch == catchStop) {
+            send_data_async(std::vector<unsigned char>{'R','E','A','D','Y'});
+        } else {
+            send_data_async(std::vector<unsigned char>{'N','O','T','R','E','A','D','Y'});
+        }
+    }
+    else if (command == "PIPELINE")
+    {
+        // PIPELINE：本连接改为长连接，客户端可以不等回复连续发送命令帧，
+        // 服务器按顺序逐条处理并回复；CONTROL、SENSORS、SURVEY 会接管连接而结束流水线
+        log_to_pedTxt("Command recognized: PIPELINE. Keeping the connection open.", SERVER_LOG_FILE);
+        pipelined_ = true;
+        send_data_async(std::vector<unsigned char>{'O','K'});
+    }
+    else if (command == "CAPTURE_SHM" || command.rfind("CAPTURE_SHM ", 0) == 0)
+    {
+        // CAPTURE_SHM：与 CAPTURE 相同的数据写入共享内存环，socket 上只回复位置描述（JSON）
+        auto frame = lastCapturedFrame();
+        if (!frame || frame->screen.empty() || frame->depth.empty()) {
+            log_to_pedTxt("Error: RGB or Depth data is empty. Was REQUEST command sent?", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Last capture data not ready.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        std::vector<unsigned char> payload;
+        std::string error;
+        SharedReplyRef ref;
+        if (!build_capture_reply(command, frame, payload, error) || !writeSharedReply(payload.data(), payload.size(), ref, error)) {
+            log_to_pedTxt("Error building shared memory reply: " + error, SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: " + error;
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        std::string resp = sharedReplyJson(ref);
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()), std::vector<CaptureTimeline>{ frame->timeline }, received_us);
+    }
+    else if (command == "CAPTURE" || command.rfind("CAPTURE ", 0) == 0)
+    {
+        // CAPTURE：立即发送上次捕获的数据。图像、深度与派生通道都取自同一帧，
+        // 不会与磁盘上已被下一次捕获覆盖的文件混在一起
+        log_to_pedTxt("Command recognized: CAPTURE. Sending last captured data.", SERVER_LOG_FILE);
+
+        auto frame = lastCapturedFrame();
+
+        // 检查数据是否有效，如果无效（例如大小为0），则发送错误或空数据
+        if (!frame || frame->screen.empty() || frame->depth.empty()) {
+            log_to_pedTxt("Error: RGB or Depth data is empty. Was REQUEST command sent?", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Last capture data not ready.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return; // 结束处理
+        }
+
+        // 准备组合数据，以及 CAPTURE 之后可选的派生通道（如 NORMALS、EDGES）
+        std::vector<unsigned char> combined_data;
+        std::string channel_error;
+        if (!build_capture_reply(command, frame, combined_data, channel_error)) {
+            log_to_pedTxt("Error building requested channels: " + channel_error, SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: " + channel_error;
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+
+        log_to_pedTxt("Combined image data prepared with total size: " + std::to_string(combined_data.size()) + " bytes", SERVER_LOG_FILE);
+        send_data_async(std::move(combined_data), std::vector<CaptureTimeline>{ frame->timeline }, received_us); // 异步发送数据
+
+        // 注意：send_data_async 会在发送完成后关闭连接并调用 start_accept()
+    }
+    else if (command == "GET_POSE")
+    {
+        // GET_POSE：排队交给脚本线程读取真实相机位姿，定时轮询结果，不阻塞 io 线程
+        unsigned int ticket = requestCameraPoseTicket();
+        g_cmdQueue.push(command);
+        await_camera_pose(ticket, std::chrono::steady_clock::now() + std::chrono::milliseconds(2000));
+    }
+    else if (command.rfind("LIDAR", 0) == 0)
+    {
+        // LIDAR：用最近几次捕获的深度重采样出旋转激光雷达点云
+        LidarConfig cfg;
+        if (!parseLidarCommand(command, cfg)) {
+            log_to_pedTxt("Malformed LIDAR command: '" + command + "'", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Malformed LIDAR command.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        auto frames = recentCapturedFrames(cfg.frames);
+        if (frames.empty()) {
+            log_to_pedTxt("Error: no captured frame for LIDAR. Was REQUEST command sent?", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Last capture data not ready.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        LidarScan scan = simulateLidarScan(frames, cfg);
+        log_to_pedTxt("LIDAR scan from " + std::to_string(frames.size()) + " frame(s): " + std::to_string(scan.points.size()) + " points", SERVER_LOG_FILE);
+        send_data_async(serializeLidarScan(scan, cfg));
+    }
+    else if (command.rfind("SEMANTIC_MAP", 0) == 0)
+    {
+        // SEMANTIC_MAP：设置模板值到语义类别的映射规则，不带规则时恢复默认
+        std::vector<SemanticRule> rules;
+        std::string resp = "OK";
+        if (parseSemanticRules(command, rules)) {
+            setSemanticRules(rules);
+            log_to_pedTxt("Semantic map set with " + std::to_string(rules.size()) + " rule(s)", SERVER_LOG_FILE);
+        } else {
+            resp = "ERROR: Malformed SEMANTIC_MAP command.";
+            log_to_pedTxt("Malformed SEMANTIC_MAP command: '" + command + "'", SERVER_LOG_FILE);
+        }
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "CMD_STATS")
+    {
+        // CMD_STATS：脚本线程每帧处理命令的吞吐与合并统计（JSON）
+        std::string resp = commandStatsJson(commandStats());
+        log_to_pedTxt("Command recognized: CMD_STATS. " + resp, SERVER_LOG_FILE);
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "RIG_FRAMES")
+    {
+        // RIG_FRAMES：返回最近一轮完成的多相机捕获，按相机顺序
+        // 格式：帧数(4字节)，每帧为 长度(4字节) + META/RGBA/DPTH 通道
+        unsigned int rig = lastFinishedRig();
+        std::vector<unsigned char> reply;
+        std::vector<CaptureTimeline> timelines;
+        uint32_t count = rig == 0 ? 0 : build_tagged_frames_reply(
+            [rig](const CapturedFrame& f) { return f.rigId == rig; }, reply, &timelines);
+        if (count == 0) {
+            log_to_pedTxt("Error: no finished rig capture. Was RIG_CAPTURE sent?", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: No rig capture ready.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        log_to_pedTxt("Sending rig " + std::to_string(rig) + " with " + std::to_string(count) + " frame(s)", SERVER_LOG_FILE);
+        send_data_async(std::move(reply), std::move(timelines), received_us);
+    }
+    else if (command == "SENSORS" || command.rfind("SENSORS ", 0) == 0)
+    {
+        // SENSORS：按参数重置传感器仿真器，把连接交给 SensorSession 持续推送样本
+        SensorConfig cfg;
+        if (!parseSensorCommand(command, cfg)) {
+            log_to_pedTxt("Malformed SENSORS command: '" + command + "'", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Malformed SENSORS command.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        log_to_pedTxt("Command recognized: SENSORS. Starting sensor stream.", SERVER_LOG_FILE);
+        std::make_shared<SensorSession>(std::move(socket_), cfg)->start();
+        start_accept();
+    }
+    else if (command == "ENV_FRAMES")
+    {
+        // ENV_FRAMES：返回最近一轮完成的环境扫描（同一位姿下各天气/时刻的帧），格式同 RIG_FRAMES
+        unsigned int round = lastFinishedEnvironmentRound();
+        std::vector<unsigned char> reply;
+        std::vector<CaptureTimeline> timelines;
+        uint32_t count = round == 0 ? 0 : build_tagged_frames_reply(
+            [round](const CapturedFrame& f) { return f.envRound == round; }, reply, &timelines);
+        if (count == 0) {
+            log_to_pedTxt("Error: no finished environment sweep. Was ENV_SWEEP sent?", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: No environment sweep ready.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        log_to_pedTxt("Sending environment sweep " + std::to_string(round) + " with " + std::to_string(count) + " frame(s)", SERVER_LOG_FILE);
+        send_data_async(std::move(reply), std::move(timelines), received_us);
+    }
+    else if (command == "ENV_STATS")
+    {
+        // ENV_STATS：环境扫描的轮数、切换次数与稳定帧数统计（JSON）
+        std::string resp = environmentStatsJson(environmentStats());
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "LOCKSTEP_STATS")
+    {
+        // LOCKSTEP_STATS：锁步模式每步的耗时统计（JSON）
+        std::string resp = lockstepStatsJson(lockstepStats());
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "LATENCY_STATS")
+    {
+        // LATENCY_STATS：捕获各阶段耗时直方图与最近一次送达帧的时间线（JSON）
+        std::string resp = latencyStatsJson();
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "STATS")
+    {
+        // STATS：计数器、仪表与延迟直方图的快照（JSON）
+        std::string resp = metricsJson();
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command.rfind("STATS_LOG ", 0) == 0)
+    {
+        // STATS_LOG：每隔 interval 秒把 STATS 快照追加一行到文件，OFF 停止
+        std::string path;
+        double interval = 0.0;
+        if (!parseStatsLogCommand(command, path, interval)) {
+            log_to_pedTxt("Malformed STATS_LOG command: '" + command + "'", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Malformed STATS_LOG command.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        stats_log_path_ = path;
+        stats_log_interval_ = interval;
+        stats_timer_.cancel();
+        if (!path.empty()) schedule_stats_log();
+        log_to_pedTxt(path.empty() ? std::string("Metrics log stopped") : "Metrics log: " + path, SERVER_LOG_FILE);
+        send_data_async(std::vector<unsigned char>{'O','K'});
+    }
+    else if (command.rfind("RECORD ", 0) == 0)
+    {
+        // RECORD START：捕获的每一帧都由写线程写入本地 .dsq 文件；RECORD STOP 写完队列后返回最终统计（JSON）
+        RecorderConfig cfg;
+        bool start = false;
+        if (!parseRecordCommand(command, start, cfg)) {
+            log_to_pedTxt("Malformed RECORD command: '" + command + "'", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: Malformed RECORD command.";
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        std::string resp = "OK";
+        std::string error;
+        if (!start) {
+            resp = recorderStatsJson(stopRecording());
+            log_to_pedTxt("Recording stopped: " + resp, SERVER_LOG_FILE);
+        }
+        else if (!startRecording(cfg, error)) {
+            resp = "ERROR: " + error;
+            log_to_pedTxt("Recording not started: " + error, SERVER_LOG_FILE);
+        }
+        else log_to_pedTxt("Recording to " + cfg.directory, SERVER_LOG_FILE);
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "RECORD_STATS")
+    {
+        // RECORD_STATS：录制的帧数、丢帧、队列深度与写入速度（JSON）
+        std::string resp = recorderStatsJson(recorderStats());
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+    }
+    else if (command == "CONTROL")
+    {
+        // CONTROL：把当前连接交给 ControlSession 做长连接，然后继续接受新连接
+        log_to_pedTxt("Command recognized: CONTROL. Starting control session.", SERVER_LOG_FILE);
+        std::make_shared<ControlSession>(std::move(socket_))->start();
+        start_accept();
+    }
+    else if (command.rfind("SURVEY ", 0) == 0)
+    {
+        // SURVEY：先校验参数，再带上编号交给脚本线程执行；连接保持打开，逐帧推送捕获结果
+        SurveyPlanConfig cfg;
+        std::string survey_error;
+        if (!parseSurveyCommand(command, cfg, survey_error)) {
+            log_to_pedTxt("Rejected SURVEY command (" + survey_error + "): '" + command + "'", SERVER_LOG_FILE);
+            std::string error_resp = "ERROR: " + survey_error;
+            send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+            return;
+        }
+        unsigned int generation = requestSurveyGeneration();
+        openSurveyStream(generation);
+        // 航点在工作线程上规划一次，io 线程与脚本线程都不做这项计算；
+        // 规划交给脚本线程后再排队命令并开始推流。规划期间 io_context 没有挂起的操作，
+        // work guard 使 run() 不会提前返回。计划大小有上限，等待上一次规划结束不会很久
+        if (survey_planner_.joinable()) survey_planner_.join();
+        auto work = boost::asio::make_work_guard(acceptor_.get_executor());
+        std::weak_ptr<int> alive = alive_;
+        survey_planner_ = std::thread([this, alive, work = std::move(work), cfg, command, generation]() mutable {
+            std::vector<SurveyWaypoint> plan = planSurvey(cfg);
+            size_t waypoints = plan.size();
+            submitSurveyPlan(generation, std::move(plan));
+            boost::asio::post(work.get_executor(), [this, alive, command, generation, waypoints]() {
+                if (alive.expired()) return;
+                g_cmdQueue.push(command + " gen=" + std::to_string(generation));
+                log_to_pedTxt("Survey " + std::to_string(generation) + " queued with "
+                    + std::to_string(waypoints) + " waypoint(s)", SERVER_LOG_FILE);
+                stream_survey(generation, 0, std::chrono::steady_clock::now());
+            });
+            work.reset();
+        });
+    }
+    else
+    {
+        g_cmdQueue.push(command); // 将命令添加到队列中
+        log_to_pedTxt("Command added to queue: '" + command + "'", SERVER_LOG_FILE);
+        finish_request();
+    }
+    // set_status_text("Command received: " + command);
+    // else
+    // {
+    //     log_to_pedTxt("Unknown command received: '" + command + "'. Sending error response.", SERVER_LOG_FILE);
+    //     std::string unknown_resp = "ERROR: Unknown command.";
+    //     boost::asio::async_write(socket_, boost::asio::buffer(unknown_resp),
+    //         [this](const boost::system::error_code& write_error, size_t){
+    //         if (write_error) log_to_pedTxt("Error sending unknown command response: " + write_error.message(), SERVER_LOG_FILE);
+    //         if (socket_.is_open()) {
+    //             socket_.close();
+    //         }
+    //         start_accept(); // 重新开始接受连接
+    //     });
+    // }
+}
+
+void ModServer::send_data_async(std::vector<unsigned char> data, std::vector<CaptureTimeline> timelines, int64_t request_us) {
+    const int64_t encoded_us = latencyMicros();
+    const auto send_start = std::chrono::steady_clock::now();
+    for (auto& tl : timelines) tl.us[stageEncodeDone] = encoded_us;
+
     // 检查socket状态
     if (!socket_.is_open()) {
         log_to_pedTxt("Attempted to send data on a closed or invalid socket.", SERVER_LOG_FILE);
@@ -265,6 +793,7 @@ void ModServer::send_data_async(std::vector<unsigned char> data) {
 
     // 使用shared_ptr管理数据生命周期
     auto shared_data = std::make_shared<std::vector<unsigned char>>(std::move(data));
+    auto shared_timelines = std::make_shared<std::vector<CaptureTimeline>>(std::move(timelines));
     
     // 准备长度数据 (小端序)
     auto length_bytes = std::make_shared<std::vector<unsigned char>>(4);
@@ -275,20 +804,33 @@ void ModServer::send_data_async(std::vector<unsigned char> data) {
 
     // 先发送长度
     boost::asio::async_write(socket_, boost::asio::buffer(*length_bytes),
-        [this, shared_data, length_bytes](const boost::system::error_code& error_len, size_t bytes_transferred_len) {
+        [this, shared_data, length_bytes, shared_timelines, request_us, send_start](const boost::system::error_code& error_len, size_t bytes_transferred_len) {
         if (!error_len) {
             log_to_pedTxt("Successfully sent length header: " + std::to_string(bytes_transferred_len) + " bytes", SERVER_LOG_FILE);
+            const int64_t header_us = latencyMicros();
+            for (auto& tl : *shared_timelines) tl.us[stageFirstByteSent] = header_us;
             
             // 发送实际数据
             boost::asio::async_write(socket_, boost::asio::buffer(*shared_data),
-                [this, shared_data](const boost::system::error_code& error_data, size_t bytes_transferred_data) {
+                [this, shared_data, shared_timelines, request_us, send_start](const boost::system::error_code& error_data, size_t bytes_transferred_data) {
                 if (!error_data) {
                     log_to_pedTxt("Image data sent successfully: " + std::to_string(bytes_transferred_data) + " bytes", SERVER_LOG_FILE);
+                    g_bytesSentMetric.add(4 + bytes_transferred_data);
+                    g_sendMetric.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - send_start).count());
+                    // 回复送达后记录这些帧的发送阶段耗时
+                    const int64_t sent_us = latencyMicros();
+                    for (auto& tl : *shared_timelines) {
+                        tl.us[stageLastByteSent] = sent_us;
+                        recordReplyStages(tl, request_us);
+                    }
+                    // 发送完成后关闭连接并重新开始接受新连接；流水线连接继续处理下一条命令
+                    finish_request();
+                    return;
                 } else {
                     log_to_pedTxt("Error sending image data: " + error_data.message(), SERVER_LOG_FILE);
+                    g_errorsMetric.add();
                 }
                 
-                // 发送完成后关闭连接并重新开始接受新连接
                 if (socket_.is_open()) {
                     socket_.close();
                 }
@@ -299,6 +841,7 @@ void ModServer::send_data_async(std::vector<unsigned char> data) {
             });
         } else {
             log_to_pedTxt("Error sending image data length: " + error_len.message(), SERVER_LOG_FILE);
+            g_errorsMetric.add();
             if (socket_.is_open()) {
                 socket_.close();
             }
@@ -310,11 +853,136 @@ void ModServer::send_data_async(std::vector<unsigned char> data) {
     });
 }
 
+void ModServer::write_message(std::vector<unsigned char> data, std::function<void(bool)> next)
+{
+    auto shared_data = std::make_shared<std::vector<unsigned char>>(4 + data.size());
+    uint32_t data_len = static_cast<uint32_t>(data.size());
+    std::memcpy(shared_data->data(), &data_len, sizeof(data_len));
+    if (!data.empty()) {
+        std::memcpy(shared_data->data() + 4, data.data(), data.size());
+    }
+    boost::asio::async_write(socket_, boost::asio::buffer(*shared_data),
+        [shared_data, next](const boost::system::error_code& error, size_t) {
+        if (error) {
+            log_to_pedTxt("Error sending message: " + error.message(), SERVER_LOG_FILE);
+            g_errorsMetric.add();
+        }
+        else {
+            g_bytesSentMetric.add(shared_data->size());
+        }
+        next(!error);
+    });
+}
+
+void ModServer::stream_survey(unsigned int generation, size_t sent,
+                              std::chrono::steady_clock::time_point queued_at)
+{
+    auto close_and_accept = [this, generation]() {
+        closeSurveyStream(generation);
+        if (socket_.is_open()) {
+            socket_.close();
+        }
+        start_accept();
+    };
+
+    // 先读状态再取帧：结束前发布的帧此时都已入队，不会漏掉最后一帧
+    SurveyStatus status = surveyStatus();
+    bool started = status.generation >= generation;
+    bool finished = status.finishedGeneration >= generation || status.generation > generation;
+
+    // 推送本次 SURVEY 队列中最早的一帧
+    std::shared_ptr<const CapturedFrame> frame;
+    size_t dropped = 0;
+    if (takeSurveyFrame(generation, frame, dropped)) {
+        std::vector<unsigned char> message{ 'S', 'F', 'R', 'M' };
+        appendFrameChannels(message, *frame);
+        write_message(std::move(message), [this, generation, sent, queued_at, close_and_accept](bool ok) {
+            if (ok) {
+                stream_survey(generation, sent + 1, queued_at);
+                return;
+            }
+            // 客户端已断开：服务器一次只服务一个连接，无法再收到 SURVEY_STOP，这里代为停止
+            g_cmdQueue.push("SURVEY_STOP");
+            close_and_accept();
+        });
+        return;
+    }
+
+    if (started && finished) {
+        if (status.generation != generation) {
+            // 被新的 SURVEY 取代，只能报告已推送的部分
+            status = SurveyStatus();
+            status.generation = generation;
+        }
+        // 汇总里附上实际推送的帧数与队列满时丢弃的帧数
+        std::string summary = surveyStatusJson(status);
+        summary.insert(summary.size() - 1, ",\"sent\":" + std::to_string(sent) + ",\"dropped\":" + std::to_string(dropped));
+        if (dropped > 0) {
+            log_to_pedTxt("Survey " + std::to_string(generation) + " dropped " + std::to_string(dropped)
+                + " frame(s): the client read slower than the survey captured", SERVER_LOG_FILE);
+        }
+        log_to_pedTxt("Survey " + std::to_string(generation) + " done: " + summary, SERVER_LOG_FILE);
+        std::vector<unsigned char> message{ 'D', 'O', 'N', 'E' };
+        appendFrameChannel(message, "META", 0, 0, summary.data(), summary.size());
+        write_message(std::move(message), [close_and_accept](bool) { close_and_accept(); });
+        return;
+    }
+    if (!started && std::chrono::steady_clock::now() - queued_at > std::chrono::seconds(10)) {
+        log_to_pedTxt("Survey " + std::to_string(generation) + " was not picked up by the script thread", SERVER_LOG_FILE);
+        closeSurveyStream(generation);
+        std::string error_resp = "ERROR: Survey not started.";
+        send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+        return;
+    }
+
+    survey_timer_.expires_after(std::chrono::milliseconds(20));
+    survey_timer_.async_wait([this, generation, sent, queued_at](const boost::system::error_code& error) {
+        if (error) return;
+        stream_survey(generation, sent, queued_at);
+    });
+}
+
+void ModServer::await_camera_pose(unsigned int ticket, std::chrono::steady_clock::time_point deadline)
+{
+    CameraPose pose;
+    if (waitCameraPose(ticket, pose, 0)) {
+        std::string resp = formatCameraPose(pose);
+        log_to_pedTxt("Command recognized: GET_POSE. Pose: " + resp, SERVER_LOG_FILE);
+        send_data_async(std::vector<unsigned char>(resp.begin(), resp.end()));
+        return;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+        log_to_pedTxt("GET_POSE timed out waiting for the script thread", SERVER_LOG_FILE);
+        std::string error_resp = "ERROR: Camera pose not available.";
+        send_data_async(std::vector<unsigned char>(error_resp.begin(), error_resp.end()));
+        return;
+    }
+    pose_timer_.expires_after(std::chrono::milliseconds(1));
+    pose_timer_.async_wait([this, ticket, deadline](const boost::system::error_code& error) {
+        if (error) return;
+        await_camera_pose(ticket, deadline);
+    });
+}
+
+void ModServer::schedule_stats_log()
+{
+    stats_timer_.expires_after(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(stats_log_interval_)));
+    stats_timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error || stats_log_path_.empty()) return;
+        log_to_pedTxt(metricsJson(), stats_log_path_.c_str());
+        schedule_stats_log();
+    });
+}
+
+#ifdef _WIN32
 static bool g_winsock_initialized = false;
+#endif
 
 void InitializeModServer()
 {
-    // 确保只初始化一次 Winsock
+#ifdef _WIN32
+    // 确保只初始化一次 Winsock（其他平台的 socket 无需初始化）
     if (!g_winsock_initialized) {
         WSADATA wsaData;
         int result = WSAStartup(MAKEWORD(2, 2), &wsaData); // 请求 Winsock 2.2 版本
@@ -325,6 +993,7 @@ void InitializeModServer()
         log_to_pedTxt("WSAStartup successfully called.", SERVER_LOG_FILE);
         g_winsock_initialized = true;
     }
+#endif
     
     // 检查是否已经初始化过，避免重复启动
     if (g_modServerInstance) {
@@ -334,7 +1003,8 @@ void InitializeModServer()
 
     try
     {
-        // 在新线程中运行 io_context
+        // 在新线程中运行 io_context（ShutdownModServer 之后再次初始化时需先 restart）
+        g_ioContext.restart();
         g_serverThread = std::make_unique<std::thread>([]() {
             try {
                 g_modServerInstance = std::make_unique<ModServer>(g_ioContext, 12345);
@@ -345,7 +1015,6 @@ void InitializeModServer()
                 log_to_pedTxt("Server thread exception caught: " + std::string(e.what()), SERVER_LOG_FILE);
             }
         });
-        g_serverThread->detach(); // 分离线程，让它独立运行
 
         log_to_pedTxt("Mod Server initialization sequence started.", SERVER_LOG_FILE);
     }
@@ -362,6 +1031,11 @@ void ShutdownModServer()
     
     // 停止 io_context，这将导致 g_ioContext.run() 返回，从而结束服务器线程
     g_ioContext.stop();
+    // 等服务器线程退出 run() 后再销毁 ModServer，否则它的 socket 和计时器可能仍在使用中
+    if (g_serverThread && g_serverThread->joinable() && g_serverThread->get_id() != std::this_thread::get_id()) {
+        g_serverThread->join();
+    }
+    closeSharedReplies();
 
     // 清理 ModServer 实例和线程指针
     g_modServerInstance.reset();
@@ -7,7 +7,11 @@
 #include <thread>
 #include <vector>
 #include <fstream>
-#include "utils.h"
+#include <functional>
+#include <array>
+#include <chrono>
+#include "logging.h"
+#include "latency.h"
 
 extern char* SERVER_LOG_FILE;
 
@@ -20,6 +24,8 @@ class ModServer
 public:
     // 构造函数
     ModServer(boost::asio::io_context& io_context, unsigned short port);
+    // 等待 SURVEY 规划线程结束
+    ~ModServer();
 
 private:
     // 异步接受新连接的逻辑
@@ -28,8 +34,37 @@ private:
     // 处理单个客户端连接的逻辑
     void handle_client_connection();
 
-    // 异步发送数据辅助函数
-    void send_data_async(std::vector<unsigned char> data);
+    // 读取一条完整的命令（长度前缀帧，或旧客户端的文本命令），pending 为已收到的部分，
+    // received_us 为首段到达时刻
+    void read_command(std::shared_ptr<std::string> pending, int64_t received_us);
+
+    // 从已收到的数据中取出一条完整命令执行，不完整时继续读取
+    void process_command(std::shared_ptr<std::string> pending, int64_t received_us);
+
+    // 一条请求处理完毕：PIPELINE 连接继续处理下一条命令（可能已在缓冲中），
+    // 否则关闭连接并重新接受
+    void finish_request();
+
+    // 执行一条完整的命令并回复
+    void handle_command(std::string command, int64_t received_us);
+
+    // 异步发送数据辅助函数；timelines 为回复所携带帧的阶段时间戳，发送完成后
+    // 连同回复命令到达时刻 request_us 记入延迟直方图
+    void send_data_async(std::vector<unsigned char> data, std::vector<CaptureTimeline> timelines = {}, int64_t request_us = 0);
+
+    // 发送一条带长度前缀的消息，不关闭连接；完成后以是否成功调用 next
+    void write_message(std::vector<unsigned char> data, std::function<void(bool)> next);
+
+    // SURVEY 期间轮询本次巡航的帧队列并逐帧推送给客户端，结束时发送 DONE 汇总；
+    // sent 为已推送的帧数
+    void stream_survey(unsigned int generation, size_t sent,
+                       std::chrono::steady_clock::time_point queued_at);
+
+    // GET_POSE：轮询脚本线程发布的位姿，拿到后回复，到 deadline 仍未拿到则回复错误
+    void await_camera_pose(unsigned int ticket, std::chrono::steady_clock::time_point deadline);
+
+    // STATS_LOG 开启时每 stats_log_interval_ 秒追加一行指标快照
+    void schedule_stats_log();
 
     // 获取文件字节数据的函数
     std::vector<unsigned char> GetBytes(std::string filePath);
@@ -37,6 +72,18 @@ private:
     // 成员变量
     boost::asio::ip::tcp::acceptor acceptor_;
     boost::asio::ip::tcp::socket socket_; // 用于接受新连接，其所有权会转移
+    boost::asio::steady_timer command_timer_; // 等待旧客户端文本命令的后续数据
+    boost::asio::steady_timer pose_timer_;    // GET_POSE 等待位姿的轮询定时器
+    boost::asio::steady_timer survey_timer_; // SURVEY 推流的轮询定时器
+    boost::asio::steady_timer stats_timer_;  // STATS_LOG 的写入定时器
+    bool pipelined_ = false;                 // 当前连接已发送 PIPELINE
+    std::string leftover_;                   // 流水线上已收到、尚未处理的后续命令
+    std::string stats_log_path_;             // 为空表示未开启
+    double stats_log_interval_ = 10.0;
+    std::thread survey_planner_;             // SURVEY 航点规划线程，由本对象等待结束
+    // 规划线程投递回 io_context 的任务持有它的 weak_ptr：服务器销毁后，
+    // 重新初始化时 restart() 执行到的旧任务不会再访问本对象
+    std::shared_ptr<int> alive_ = std::make_shared<int>(0);
 };
 
 
@@ -0,0 +1,169 @@
+#include "sharedreply.h"
+#include <boost/interprocess/mapped_region.hpp>
+#ifdef _WIN32
+#include <boost/interprocess/windows_shared_memory.hpp>
+#else
+#include <boost/interprocess/shared_memory_object.hpp>
+#endif
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace bip = boost::interprocess;
+
+#ifdef _WIN32
+// Named file mappings live as long as a handle is open, here the server's.
+typedef bip::windows_shared_memory SharedSegment;
+#else
+typedef bip::shared_memory_object SharedSegment;
+#endif
+
+struct SegmentHeader {
+	char magic[4];
+	uint32_t slots;
+	uint64_t capacity;
+};
+
+struct SlotHeader {
+	std::atomic<uint64_t> sequence;
+	uint64_t size;
+};
+static_assert(sizeof(SlotHeader) == 16, "slot header layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "sequence must be lock-free to be shared");
+
+struct Segment {
+	std::string name;
+	SharedSegment memory;
+	bip::mapped_region region;
+	uint64_t capacity = 0;
+
+	unsigned char* base() const { return static_cast<unsigned char*>(region.get_address()); }
+	uint64_t slotOffset(uint32_t slot) const { return sizeof(SegmentHeader) + slot * (sizeof(SlotHeader) + capacity); }
+	SlotHeader* slot(uint32_t i) const { return reinterpret_cast<SlotHeader*>(base() + slotOffset(i)); }
+};
+
+static std::mutex writer_mtx;
+static std::unique_ptr<Segment> writer;
+static unsigned int segments = 0;
+static uint32_t nextSlot = 0;
+
+static void removeSegment(const std::string& name)
+{
+#ifndef _WIN32
+	bip::shared_memory_object::remove(name.c_str());
+#else
+	(void)name;
+#endif
+}
+
+// Whole megabytes, so a stream of similar frames reuses one segment.
+static std::unique_ptr<Segment> createSegment(uint64_t payload)
+{
+	auto segment = std::make_unique<Segment>();
+	segment->capacity = (payload + (1 << 20) - 1) / (1 << 20) * (1 << 20);
+	if (segment->capacity == 0) segment->capacity = 1 << 20;
+	const uint64_t bytes = segment->slotOffset(sharedReplySlots);
+	segment->name = "dronesim_reply_" + std::to_string(++segments);
+	removeSegment(segment->name);
+#ifdef _WIN32
+	segment->memory = SharedSegment(bip::create_only, segment->name.c_str(), bip::read_write, bytes);
+#else
+	segment->memory = SharedSegment(bip::create_only, segment->name.c_str(), bip::read_write);
+	segment->memory.truncate((bip::offset_t)bytes);
+#endif
+	segment->region = bip::mapped_region(segment->memory, bip::read_write, 0, bytes);
+	SegmentHeader header = { { 'D', 'S', 'H', 'M' }, sharedReplySlots, segment->capacity };
+	memcpy(segment->base(), &header, sizeof(header));
+	for (uint32_t i = 0; i < sharedReplySlots; ++i) {
+		new (segment->slot(i)) SlotHeader();
+		segment->slot(i)->sequence.store(0, std::memory_order_relaxed);
+		segment->slot(i)->size = 0;
+	}
+	return segment;
+}
+
+bool writeSharedReply(const unsigned char* data, size_t size, SharedReplyRef& ref, std::string& error)
+{
+	std::lock_guard<std::mutex> lk(writer_mtx);
+	try {
+		if (!writer || writer->capacity < size) {
+			if (writer) removeSegment(writer->name);
+			writer = createSegment(size);
+			nextSlot = 0;
+		}
+	}
+	catch (const bip::interprocess_exception& e) {
+		writer.reset();
+		error = std::string("cannot create shared memory: ") + e.what();
+		return false;
+	}
+	const uint32_t i = nextSlot;
+	nextSlot = (nextSlot + 1) % sharedReplySlots;
+	SlotHeader* slot = writer->slot(i);
+	const uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+	slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot->size = size;
+	if (size) memcpy(reinterpret_cast<unsigned char*>(slot) + sizeof(SlotHeader), data, size);
+	slot->sequence.store(sequence + 2, std::memory_order_release);
+
+	ref.name = writer->name;
+	ref.segmentBytes = writer->region.get_size();
+	ref.offset = writer->slotOffset(i) + sizeof(SlotHeader);
+	ref.size = size;
+	ref.sequence = sequence + 2;
+	return true;
+}
+
+std::string sharedReplyJson(const SharedReplyRef& ref)
+{
+	return "{\"shm\":\"" + ref.name + "\",\"bytes\":" + std::to_string(ref.segmentBytes) + ",\"offset\":"
+		+ std::to_string(ref.offset) + ",\"size\":" + std::to_string(ref.size) + ",\"sequence\":"
+		+ std::to_string(ref.sequence) + "}";
+}
+
+void closeSharedReplies()
+{
+	std::lock_guard<std::mutex> lk(writer_mtx);
+	if (writer) removeSegment(writer->name);
+	writer.reset();
+}
+
+static std::mutex reader_mtx;
+static std::unique_ptr<Segment> reader;
+
+bool readSharedReply(const SharedReplyRef& ref, std::vector<unsigned char>& out, std::string& error)
+{
+	std::lock_guard<std::mutex> lk(reader_mtx);
+	try {
+		if (!reader || reader->name != ref.name) {
+			auto segment = std::make_unique<Segment>();
+			segment->name = ref.name;
+			segment->memory = SharedSegment(bip::open_only, ref.name.c_str(), bip::read_only);
+			segment->region = bip::mapped_region(segment->memory, bip::read_only);
+			reader = std::move(segment);
+		}
+	}
+	catch (const bip::interprocess_exception& e) {
+		reader.reset();
+		error = "cannot map " + ref.name + ": " + e.what();
+		return false;
+	}
+	if (ref.offset < sizeof(SegmentHeader) + sizeof(SlotHeader) || ref.offset + ref.size > reader->region.get_size()) {
+		error = "reply outside the segment";
+		return false;
+	}
+	const SlotHeader* slot = reinterpret_cast<const SlotHeader*>(reader->base() + ref.offset - sizeof(SlotHeader));
+	if (slot->sequence.load(std::memory_order_acquire) != ref.sequence) {
+		error = "reply overwritten";
+		return false;
+	}
+	out.assign(reader->base() + ref.offset, reader->base() + ref.offset + ref.size);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (slot->sequence.load(std::memory_order_relaxed) != ref.sequence) {
+		error = "reply overwritten";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Replies through shared memory for clients on the same machine: the payload
+// is copied into one slot of a named segment and the socket carries only a
+// small descriptor (sharedReplyJson). The segment is a ring of
+// sharedReplySlots slots. Each slot's sequence number is odd while the slot
+// is being written, so a reader copies the payload out and then checks the
+// sequence still matches the descriptor's.
+//
+// Segment layout, little-endian:
+//   "DSHM", u32 slot count, u64 slot capacity in bytes
+//   per slot: u64 sequence, u64 payload size, capacity bytes of payload
+// A payload larger than the capacity moves the ring to a new, larger segment
+// under a new name; the descriptor always names the segment to map.
+// Segments are POSIX shared memory objects, named file mappings on Windows.
+static const uint32_t sharedReplySlots = 4;
+
+struct SharedReplyRef {
+	std::string name;
+	uint64_t segmentBytes = 0;
+	uint64_t offset = 0;	// of the payload from the start of the segment
+	uint64_t size = 0;
+	uint64_t sequence = 0;	// the slot's sequence once the payload is in
+};
+
+bool writeSharedReply(const unsigned char* data, size_t size, SharedReplyRef& ref, std::string& error);
+// {"shm":name,"bytes":segmentBytes,"offset":o,"size":n,"sequence":s}
+std::string sharedReplyJson(const SharedReplyRef& ref);
+// Removes the segment; readers that mapped it keep their mapping.
+void closeSharedReplies();
+
+// Reader side: maps the named segment (kept mapped for the next call) and
+// copies the payload out. False if the slot has been reused since.
+bool readSharedReply(const SharedReplyRef& ref, std::vector<unsigned char>& out, std::string& error);
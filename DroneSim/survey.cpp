@@ -0,0 +1,380 @@
+#include "survey.h"
+#include "frame.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <sstream>
+
+using Eigen::Vector3f;
+using std::string;
+using std::vector;
+
+static const float DEG2RAD = 0.01745329f;
+
+static bool parseFloats(const string& s, vector<float>& out)
+{
+	out.clear();
+	std::istringstream ss(s);
+	for (string tok; std::getline(ss, tok, ',');) {
+		try {
+			size_t used = 0;
+			out.push_back(std::stof(tok, &used));
+			if (used != tok.size()) return false;
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	}
+	return !out.empty();
+}
+
+bool parseSurveyCommand(const string& command, SurveyPlanConfig& cfg)
+{
+	string error;
+	return parseSurveyCommand(command, cfg, error);
+}
+
+bool parseSurveyCommand(const string& command, SurveyPlanConfig& cfg, string& error)
+{
+	error = "malformed SURVEY command";
+	std::istringstream ss(command);
+	string name;
+	ss >> name;
+	if (name != "SURVEY") return false;
+	bool haveArea = false, haveAlt = false;
+	for (string tok; ss >> tok;) {
+		size_t eq = tok.find('=');
+		if (eq == string::npos) return false;
+		string key = tok.substr(0, eq), value = tok.substr(eq + 1);
+		vector<float> v;
+		if (key == "order") {
+			if (value == "tsp") cfg.tspOrder = true;
+			else if (value == "lawnmower") cfg.tspOrder = false;
+			else return false;
+			continue;
+		}
+		if (!parseFloats(value, v)) return false;
+		for (float f : v) {
+			if (!std::isfinite(f)) return false;
+		}
+		if (key == "area" && v.size() == 4) {
+			cfg.x0 = std::min(v[0], v[2]);
+			cfg.x1 = std::max(v[0], v[2]);
+			cfg.y0 = std::min(v[1], v[3]);
+			cfg.y1 = std::max(v[1], v[3]);
+			haveArea = true;
+		}
+		else if (key == "alt" && (v.size() == 2 || v.size() == 3)) {
+			cfg.zMin = std::min(v[0], v[1]);
+			cfg.zMax = std::max(v[0], v[1]);
+			if (v.size() == 3) cfg.zStep = v[2];
+			haveAlt = true;
+		}
+		else if (key == "overlap" && v.size() == 1) cfg.overlap = v[0];
+		else if (key == "ground" && v.size() == 1) cfg.groundZ = v[0];
+		else if (key == "fov" && v.size() == 1) cfg.fov = v[0];
+		else if (key == "aspect" && v.size() == 1) cfg.aspect = v[0];
+		else if (key == "pitch" && v.size() == 1) cfg.pitch = v[0];
+		else if (key == "yaw") cfg.yaws = v;
+		else if (key == "settle" && v.size() == 1) cfg.settleTicks = (int)v[0];
+		else if (key == "gen" && v.size() == 1) cfg.generation = (unsigned int)v[0];
+		else return false;
+	}
+	if (!(haveArea && haveAlt && cfg.zStep > 0.0f && cfg.overlap >= 0.0f && cfg.overlap < 1.0f
+		&& cfg.fov > 0.0f && cfg.fov < 180.0f && cfg.aspect > 0.0f && cfg.settleTicks >= 0)) {
+		return false;
+	}
+	size_t stations, waypoints;
+	surveyPlanSize(cfg, stations, waypoints);
+	if (stations > surveyMaxStations || waypoints > surveyMaxWaypoints) {
+		error = "SURVEY plan too large (more than " + std::to_string(surveyMaxStations) + " stations or "
+			+ std::to_string(surveyMaxWaypoints) + " waypoints); use a smaller area, fewer altitudes or yaws, or less overlap";
+		return false;
+	}
+	error.clear();
+	return true;
+}
+
+static double axisStopCount(float lo, float hi, float spacing)
+{
+	return std::max(1.0, std::ceil(((double)hi - lo) / spacing - 1e-4) + 1.0);
+}
+
+static float layerSpacing(const SurveyPlanConfig& cfg, float z)
+{
+	const float halfH = std::atan(std::tan(0.5f * cfg.fov * DEG2RAD) * cfg.aspect);
+	float height = std::max(z - cfg.groundZ, 1.0f);
+	return std::max(2.0f * height * std::tan(halfH) * (1.0f - cfg.overlap), 1.0f);
+}
+
+void surveyPlanSize(const SurveyPlanConfig& cfg, size_t& stations, size_t& waypoints)
+{
+	// the layer loop below matches planSurvey's, which can only stop once
+	// there are more layers than stations allowed
+	double total = 0.0;
+	for (float z = cfg.zMin; z <= cfg.zMax + 1e-3f && total <= surveyMaxStations; z += cfg.zStep) {
+		const float spacing = layerSpacing(cfg, z);
+		total += axisStopCount(cfg.x0, cfg.x1, spacing) * axisStopCount(cfg.y0, cfg.y1, spacing);
+		if (z + cfg.zStep == z) total = INFINITY;	// a step too small to move z never ends
+	}
+	const double limit = (double)surveyMaxWaypoints + 1.0;
+	stations = (size_t)std::min(total, limit);
+	waypoints = (size_t)std::min(total * cfg.yaws.size(), limit);
+}
+
+static vector<float> axisStops(float lo, float hi, float spacing)
+{
+	int n = (int)axisStopCount(lo, hi, spacing);
+	vector<float> stops(n);
+	for (int i = 0; i < n; ++i) stops[i] = n == 1 ? 0.5f * (lo + hi) : lo + (hi - lo) * i / (n - 1);
+	return stops;
+}
+
+static float pathLength(const vector<Vector3f>& stations)
+{
+	float length = 0.0f;
+	for (size_t i = 1; i < stations.size(); ++i) length += (stations[i] - stations[i - 1]).norm();
+	return length;
+}
+
+// Nearest-neighbour tour from the first station (or the lawnmower order if that
+// is shorter), then 2-opt on the open path.
+// 2-opt only tries reversals up to twoOptWindow stations long, which keeps a
+// pass linear in the plan size; long reversals rarely pay off after NN.
+static const size_t twoOptWindow = 128;
+
+static void orderTsp(vector<Vector3f>& stations)
+{
+	size_t n = stations.size();
+	if (n < 3) return;
+	const vector<Vector3f> lawnmower = stations;
+	for (size_t i = 1; i < n; ++i) {
+		size_t best = i;
+		float bestD = (stations[best] - stations[i - 1]).squaredNorm();
+		for (size_t j = i + 1; j < n; ++j) {
+			float d = (stations[j] - stations[i - 1]).squaredNorm();
+			if (d < bestD) {
+				bestD = d;
+				best = j;
+			}
+		}
+		std::swap(stations[i], stations[best]);
+	}
+	// on a regular grid the boustrophedon order is already near optimal
+	if (pathLength(lawnmower) < pathLength(stations)) stations = lawnmower;
+	for (int pass = 0; pass < 50; ++pass) {
+		bool improved = false;
+		for (size_t i = 0; i + 2 < n; ++i) {
+			for (size_t j = i + 2; j < std::min(n, i + 2 + twoOptWindow); ++j) {
+				// reverse stations[i+1 .. j]; the path end has no closing edge
+				float before = (stations[i + 1] - stations[i]).norm() + (j + 1 < n ? (stations[j + 1] - stations[j]).norm() : 0.0f);
+				float after = (stations[j] - stations[i]).norm() + (j + 1 < n ? (stations[j + 1] - stations[i + 1]).norm() : 0.0f);
+				if (after + 1e-4f < before) {
+					std::reverse(stations.begin() + i + 1, stations.begin() + j + 1);
+					improved = true;
+				}
+			}
+		}
+		if (!improved) break;
+	}
+}
+
+vector<SurveyWaypoint> planSurvey(const SurveyPlanConfig& cfg)
+{
+	vector<Vector3f> stations;
+	int layer = 0;
+	for (float z = cfg.zMin; z <= cfg.zMax + 1e-3f; z += cfg.zStep, ++layer) {
+		const float spacing = layerSpacing(cfg, z);
+		vector<float> xs = axisStops(cfg.x0, cfg.x1, spacing);
+		vector<float> ys = axisStops(cfg.y0, cfg.y1, spacing);
+		vector<Vector3f> layerStations;
+		for (size_t r = 0; r < ys.size(); ++r) {
+			for (size_t c = 0; c < xs.size(); ++c) {
+				float x = (r % 2 == 0) ? xs[c] : xs[xs.size() - 1 - c];
+				layerStations.emplace_back(x, ys[r], z);
+			}
+		}
+		// alternate layers run backwards so each starts where the last ended
+		if (layer % 2 == 1) std::reverse(layerStations.begin(), layerStations.end());
+		stations.insert(stations.end(), layerStations.begin(), layerStations.end());
+	}
+	if (cfg.tspOrder) orderTsp(stations);
+
+	vector<SurveyWaypoint> plan;
+	plan.reserve(stations.size() * cfg.yaws.size());
+	for (size_t s = 0; s < stations.size(); ++s) {
+		for (size_t k = 0; k < cfg.yaws.size(); ++k) {
+			// alternate the sweep direction so consecutive stations share a yaw
+			float yaw = cfg.yaws[s % 2 == 0 ? k : cfg.yaws.size() - 1 - k];
+			plan.push_back({ stations[s], cfg.pitch, yaw, (int)s });
+		}
+	}
+	return plan;
+}
+
+float surveyPathLength(const vector<SurveyWaypoint>& plan)
+{
+	float length = 0.0f;
+	for (size_t i = 1; i < plan.size(); ++i) length += (plan[i].position - plan[i - 1].position).norm();
+	return length;
+}
+
+static std::mutex status_mtx;
+static SurveyStatus status;
+static unsigned int generations = 0;
+static std::chrono::steady_clock::time_point startTime;
+
+unsigned int requestSurveyGeneration()
+{
+	std::lock_guard<std::mutex> lk(status_mtx);
+	return ++generations;
+}
+
+SurveyStatus surveyStatus()
+{
+	std::lock_guard<std::mutex> lk(status_mtx);
+	SurveyStatus s = status;
+	if (s.active) s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	s.framesPerMinute = s.seconds > 0.0 ? s.captured * 60.0 / s.seconds : 0.0;
+	return s;
+}
+
+string surveyStatusJson(const SurveyStatus& s)
+{
+	std::ostringstream ss;
+	ss << "{\"survey\":" << s.generation << ",\"active\":" << (s.active ? "true" : "false")
+		<< ",\"planned\":" << s.planned << ",\"captured\":" << s.captured
+		<< ",\"seconds\":" << s.seconds << ",\"frames_per_minute\":" << s.framesPerMinute << "}";
+	return ss.str();
+}
+
+static void finishStatus()
+{
+	std::lock_guard<std::mutex> lk(status_mtx);
+	if (!status.active) return;
+	status.active = false;
+	status.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	status.finishedGeneration = status.generation;
+}
+
+void SurveyRunner::start(vector<SurveyWaypoint> plan, unsigned int generation, int settleTicks)
+{
+	stop();
+	plan_ = std::move(plan);
+	generation_ = generation;
+	settleTicks_ = settleTicks;
+	index_ = 0;
+	state_ = Move;
+	active_ = true;
+	std::lock_guard<std::mutex> lk(status_mtx);
+	status = SurveyStatus();
+	status.generation = generation;
+	status.finishedGeneration = generation - 1;
+	status.active = true;
+	status.planned = plan_.size();
+	startTime = std::chrono::steady_clock::now();
+}
+
+void SurveyRunner::stop()
+{
+	if (!active_) return;
+	active_ = false;
+	finishStatus();
+}
+
+SurveyRunner::Action SurveyRunner::tick(bool captureIdle, SurveyWaypoint& waypoint)
+{
+	if (!active_) return Idle;
+	switch (state_) {
+	case Wait:
+		if (!captureIdle) return Idle;
+		{
+			std::lock_guard<std::mutex> lk(status_mtx);
+			status.captured++;
+		}
+		++index_;
+		state_ = Move;
+		// fall through
+	case Move:
+		if (index_ >= plan_.size()) {
+			stop();
+			return Finished;
+		}
+		waypoint = plan_[index_];
+		settle_ = settleTicks_;
+		state_ = Settle;
+		return MoveTo;
+	case Settle:
+		if (settle_-- > 0 || !captureIdle) return Idle;
+		waypoint = plan_[index_];
+		state_ = Wait;
+		return Capture;
+	}
+	return Idle;
+}
+
+static std::mutex plan_mtx;
+static unsigned int plannedGeneration = 0;
+static vector<SurveyWaypoint> plannedWaypoints;
+
+void submitSurveyPlan(unsigned int generation, vector<SurveyWaypoint> plan)
+{
+	std::lock_guard<std::mutex> lk(plan_mtx);
+	if (generation < plannedGeneration) return;
+	plannedGeneration = generation;
+	plannedWaypoints = std::move(plan);
+}
+
+bool takeSurveyPlan(unsigned int generation, vector<SurveyWaypoint>& plan)
+{
+	std::lock_guard<std::mutex> lk(plan_mtx);
+	if (generation != plannedGeneration) return false;
+	plan = std::move(plannedWaypoints);
+	plannedWaypoints.clear();
+	plannedGeneration = 0;
+	return true;
+}
+
+static std::mutex stream_mtx;
+static unsigned int streamGeneration = 0;
+static string streamTag;
+static std::deque<std::shared_ptr<const CapturedFrame>> streamFrames;
+static size_t streamDropped = 0;
+
+void openSurveyStream(unsigned int generation)
+{
+	std::lock_guard<std::mutex> lk(stream_mtx);
+	streamGeneration = generation;
+	streamTag = "\"survey\":" + std::to_string(generation) + ",";
+	streamFrames.clear();
+	streamDropped = 0;
+}
+
+void closeSurveyStream(unsigned int generation)
+{
+	std::lock_guard<std::mutex> lk(stream_mtx);
+	if (generation != streamGeneration) return;
+	streamGeneration = 0;
+	streamFrames.clear();
+}
+
+void offerSurveyFrame(const std::shared_ptr<const CapturedFrame>& frame)
+{
+	std::lock_guard<std::mutex> lk(stream_mtx);
+	if (streamGeneration == 0 || frame->metadata.compare(0, streamTag.size(), streamTag) != 0) return;
+	if (streamFrames.size() >= surveyQueueLimit) ++streamDropped;
+	else streamFrames.push_back(frame);
+}
+
+bool takeSurveyFrame(unsigned int generation, std::shared_ptr<const CapturedFrame>& frame, size_t& dropped)
+{
+	std::lock_guard<std::mutex> lk(stream_mtx);
+	if (generation != streamGeneration) return false;
+	dropped = streamDropped;
+	if (streamFrames.empty()) return false;
+	frame = std::move(streamFrames.front());
+	streamFrames.pop_front();
+	return true;
+}
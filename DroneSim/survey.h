@@ -0,0 +1,104 @@
+#pragma once
+#include <Eigen/Core>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CapturedFrame;
+
+// Coverage survey over a rectangle at one or more altitudes. Station spacing
+// follows the horizontal footprint of the camera at each altitude above
+// groundZ, shrunk by the requested overlap; every station is captured at
+// every yaw in the orientation set.
+struct SurveyPlanConfig {
+	float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;
+	float zMin = 0.0f, zMax = 0.0f, zStep = 5.0f;
+	float overlap = 0.6f;
+	float groundZ = 0.0f;
+	float fov = 40.0f;				// vertical, degrees
+	float aspect = 16.0f / 9.0f;
+	float pitch = 0.0f;
+	std::vector<float> yaws = { 0.0f, 45.0f, 90.0f, 135.0f, 180.0f, 225.0f, 270.0f, 315.0f };
+	bool tspOrder = false;			// false: lawnmower
+	int settleTicks = 2;			// script ticks between a move and its capture
+	unsigned int generation = 0;	// filled in by the server, see requestSurveyGeneration
+};
+
+struct SurveyWaypoint {
+	Eigen::Vector3f position;
+	float pitch;
+	float yaw;
+	int station;
+};
+
+// Plan size limits: TSP ordering is quadratic in the stations, and the plan
+// is held in memory until the survey ends.
+static const size_t surveyMaxStations = 20000;
+static const size_t surveyMaxWaypoints = 100000;
+
+// "SURVEY area=x0,y0,x1,y1 alt=zMin,zMax[,zStep] [overlap=f] [ground=z] [fov=deg]
+//  [aspect=f] [pitch=deg] [yaw=a,b,...] [order=lawnmower|tsp] [settle=n] [gen=n]"
+// Plans past the limits above are rejected; error says why.
+bool parseSurveyCommand(const std::string& command, SurveyPlanConfig& cfg, std::string& error);
+bool parseSurveyCommand(const std::string& command, SurveyPlanConfig& cfg);
+// Stations and waypoints planSurvey would make, counted without making them;
+// both stop counting past the limits.
+void surveyPlanSize(const SurveyPlanConfig& cfg, size_t& stations, size_t& waypoints);
+std::vector<SurveyWaypoint> planSurvey(const SurveyPlanConfig& cfg);
+float surveyPathLength(const std::vector<SurveyWaypoint>& plan);
+
+// Executes a plan one waypoint at a time on the script thread. tick() says
+// what to do this tick: move to the waypoint, capture there, or nothing while
+// the pose settles or the previous capture is still in flight.
+class SurveyRunner {
+public:
+	enum Action { Idle, MoveTo, Capture, Finished };
+
+	void start(std::vector<SurveyWaypoint> plan, unsigned int generation, int settleTicks);
+	void stop();
+	bool active() const { return active_; }
+	Action tick(bool captureIdle, SurveyWaypoint& waypoint);
+	size_t index() const { return index_; }
+
+private:
+	enum State { Move, Settle, Wait };
+	std::vector<SurveyWaypoint> plan_;
+	unsigned int generation_ = 0;
+	int settleTicks_ = 0;
+	int settle_ = 0;
+	size_t index_ = 0;
+	State state_ = Move;
+	bool active_ = false;
+};
+
+struct SurveyStatus {
+	unsigned int generation = 0;		// survey this status belongs to
+	unsigned int finishedGeneration = 0;
+	bool active = false;
+	size_t planned = 0;
+	size_t captured = 0;
+	double seconds = 0.0;
+	double framesPerMinute = 0.0;
+};
+
+SurveyStatus surveyStatus();
+// Server side: reserves the generation the queued SURVEY will run under.
+unsigned int requestSurveyGeneration();
+std::string surveyStatusJson(const SurveyStatus& status);
+
+// The plan is made once, on a worker: the server submits it under the
+// survey's generation before queueing SURVEY and the script thread takes it
+// from there. Only the newest plan is kept.
+void submitSurveyPlan(unsigned int generation, std::vector<SurveyWaypoint> plan);
+bool takeSurveyPlan(unsigned int generation, std::vector<SurveyWaypoint>& plan);
+
+// Frames of the survey being streamed, queued as they are published so a
+// slow client does not lose them to the short frame history. At most
+// surveyQueueLimit wait; later ones are dropped and counted. Opening a stream
+// ends the previous one.
+static const size_t surveyQueueLimit = 32;
+void openSurveyStream(unsigned int generation);
+void closeSurveyStream(unsigned int generation);
+void offerSurveyFrame(const std::shared_ptr<const CapturedFrame>& frame);
+// Oldest queued frame of the stream, if any; dropped is the count so far.
+bool takeSurveyFrame(unsigned int generation, std::shared_ptr<const CapturedFrame>& frame, size_t& dropped);
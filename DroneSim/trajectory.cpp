@@ -0,0 +1,164 @@
+#include "trajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using Eigen::Vector3f;
+using std::vector;
+
+static const int samplesPerSegment = 32;
+
+static Vector3f catmullRom(const Vector3f& p0, const Vector3f& p1, const Vector3f& p2, const Vector3f& p3, float t)
+{
+	float t2 = t * t, t3 = t2 * t;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2
+		+ (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+bool Trajectory::build(const vector<TrajectoryKey>& keys, float duration, vector<float> captureAt)
+{
+	if (keys.size() < 2 || !(duration > 0.0f)) return false;
+	for (float s : captureAt)
+		if (!(s >= 0.0f && s <= 1.0f)) return false;
+	std::sort(captureAt.begin(), captureAt.end());
+
+	keys_ = keys;
+	for (size_t i = 1; i < keys_.size(); ++i) {
+		// unwrap every angle so consecutive keys differ by at most 180 degrees
+		for (int a = 0; a < 3; ++a) {
+			float d = keys_[i].rotation[a] - keys_[i - 1].rotation[a];
+			keys_[i].rotation[a] -= 360.0f * std::round(d / 360.0f);
+		}
+	}
+	duration_ = duration;
+	captureAt_ = captureAt;
+
+	int segments = (int)keys_.size() - 1;
+	arcLength_.assign(1, 0.0f);
+	Vector3f prev = keys_[0].position;
+	for (int seg = 0; seg < segments; ++seg) {
+		for (int k = 1; k <= samplesPerSegment; ++k) {
+			Vector3f p = evaluateSegment(seg, (float)k / samplesPerSegment).position;
+			arcLength_.push_back(arcLength_.back() + (p - prev).norm());
+			prev = p;
+		}
+	}
+	return true;
+}
+
+TrajectoryKey Trajectory::evaluateSegment(int seg, float t) const
+{
+	int last = (int)keys_.size() - 1;
+	const TrajectoryKey& k0 = keys_[std::max(seg - 1, 0)];
+	const TrajectoryKey& k1 = keys_[seg];
+	const TrajectoryKey& k2 = keys_[std::min(seg + 1, last)];
+	const TrajectoryKey& k3 = keys_[std::min(seg + 2, last)];
+	TrajectoryKey out;
+	out.position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+	out.rotation = catmullRom(k0.rotation, k1.rotation, k2.rotation, k3.rotation, t);
+	return out;
+}
+
+TrajectoryKey Trajectory::evaluate(float s) const
+{
+	s = std::min(std::max(s, 0.0f), 1.0f);
+	int segments = (int)keys_.size() - 1;
+	float total = length();
+	float u;
+	if (total <= 0.0f) {
+		// all keys at one spot: fall back to the spline parameter
+		u = s * segments;
+	}
+	else {
+		float target = s * total;
+		size_t i = std::upper_bound(arcLength_.begin(), arcLength_.end(), target) - arcLength_.begin();
+		i = std::min(std::max(i, (size_t)1), arcLength_.size() - 1);
+		// The spline's speed varies within a sample, so interpolating the
+		// parameter linearly there is not constant speed: search the sample
+		// for the point whose chord from its start covers the remainder.
+		const float remainder = target - arcLength_[i - 1];
+		float lo = (float)(i - 1) / samplesPerSegment, hi = (float)i / samplesPerSegment;
+		const Vector3f start = evaluateAt(lo, segments).position;
+		for (int k = 0; k < 16 && remainder > 0.0f; ++k) {
+			float mid = 0.5f * (lo + hi);
+			if ((evaluateAt(mid, segments).position - start).norm() < remainder) lo = mid;
+			else hi = mid;
+		}
+		u = remainder > 0.0f ? 0.5f * (lo + hi) : lo;
+	}
+	return evaluateAt(u, segments);
+}
+
+TrajectoryKey Trajectory::evaluateAt(float u, int segments) const
+{
+	int seg = std::min((int)u, segments - 1);
+	return evaluateSegment(seg, u - seg);
+}
+
+void TrajectoryPlayer::start(const Trajectory& trajectory)
+{
+	trajectory_ = trajectory;
+	active_ = true;
+	s_ = 0.0f;
+	nextCapture_ = 0;
+}
+
+void TrajectoryPlayer::stop()
+{
+	active_ = false;
+}
+
+bool TrajectoryPlayer::step(float dt, TrajectoryKey& pose, bool& capture)
+{
+	capture = false;
+	if (!active_) return false;
+	const vector<float>& captures = trajectory_.captures();
+	float next = s_ + std::max(dt, 0.0f) / trajectory_.duration();
+	if (nextCapture_ < captures.size() && captures[nextCapture_] <= next) {
+		s_ = captures[nextCapture_++];
+		capture = true;
+	}
+	else {
+		s_ = std::min(next, 1.0f);
+	}
+	pose = trajectory_.evaluate(s_);
+	if (s_ >= 1.0f && nextCapture_ >= captures.size()) active_ = false;
+	return true;
+}
+
+bool parseTrajectoryCommand(const std::string& command, Trajectory& trajectory)
+{
+	std::istringstream ss(command);
+	std::string name;
+	ss >> name;
+	if (name != "TRAJECTORY") return false;
+	vector<float> values;
+	vector<float> captureAt;
+	bool inCaptures = false;
+	for (std::string tok; ss >> tok;) {
+		if (tok == "CAPTURE") {
+			if (inCaptures) return false;
+			inCaptures = true;
+			continue;
+		}
+		float v;
+		size_t used = 0;
+		try {
+			v = std::stof(tok, &used);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		if (used != tok.size() || !std::isfinite(v)) return false;
+		(inCaptures ? captureAt : values).push_back(v);
+	}
+	if (values.empty() || (values.size() - 1) % 6 != 0) return false;
+	vector<TrajectoryKey> keys;
+	for (size_t i = 1; i + 6 <= values.size(); i += 6) {
+		TrajectoryKey k;
+		k.position = Vector3f(values[i], values[i + 1], values[i + 2]);
+		k.rotation = Vector3f(values[i + 3], values[i + 4], values[i + 5]);
+		keys.push_back(k);
+	}
+	return trajectory.build(keys, values[0], captureAt);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// Camera path through control poses. Positions and the three rotation angles
+// (pitch, roll, yaw in degrees, unwrapped so yaw takes the short way round)
+// follow a uniform Catmull-Rom spline through every key; the path is
+// re-parameterized by arc length so playback moves at constant speed.
+struct TrajectoryKey {
+	Eigen::Vector3f position;
+	Eigen::Vector3f rotation;	// pitch, roll, yaw
+};
+
+class Trajectory {
+public:
+	// Needs at least two keys and a positive duration. captureAt holds path
+	// fractions in [0, 1] at which frames are captured.
+	bool build(const std::vector<TrajectoryKey>& keys, float duration, std::vector<float> captureAt);
+
+	// Pose at path fraction s in [0, 1] of the total arc length.
+	TrajectoryKey evaluate(float s) const;
+	float length() const { return arcLength_.empty() ? 0.0f : arcLength_.back(); }
+	float duration() const { return duration_; }
+	const std::vector<float>& captures() const { return captureAt_; }
+
+private:
+	TrajectoryKey evaluateSegment(int segment, float t) const;
+	// u in [0, segments]: segment index plus the parameter within it
+	TrajectoryKey evaluateAt(float u, int segments) const;
+
+	std::vector<TrajectoryKey> keys_;
+	float duration_ = 0.0f;
+	std::vector<float> captureAt_;
+	// cumulative arc length at samplesPerSegment steps per segment
+	std::vector<float> arcLength_;
+};
+
+// Walks a Trajectory in wall-clock time. Each step advances by dt seconds;
+// when a capture fraction is crossed the step stops exactly on it and asks
+// for a capture, and the caller must not step again until that capture is
+// done, so every frame is taken at its scheduled pose.
+class TrajectoryPlayer {
+public:
+	void start(const Trajectory& trajectory);
+	void stop();
+	bool active() const { return active_; }
+	float progress() const { return s_; }
+
+	// Returns false once the path is finished (the last call yields the end pose).
+	bool step(float dt, TrajectoryKey& pose, bool& capture);
+
+private:
+	Trajectory trajectory_;
+	bool active_ = false;
+	float s_ = 0.0f;
+	size_t nextCapture_ = 0;
+};
+
+// "TRAJECTORY duration x y z pitch roll yaw [x y z pitch roll yaw ...] [CAPTURE s ...]"
+bool parseTrajectoryCommand(const std::string& command, Trajectory& trajectory);
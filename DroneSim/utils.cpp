@@ -9,6 +9,7 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <cmath>
 #include <vector>
 #include "script.h"
 
@@ -21,17 +22,6 @@ void setStatusText(std::string text)
 	UI::_DRAW_NOTIFICATION(1, 1);
 }
 
-void log_to_pedTxt(std::string text, char* file)
-{
-	FILE* fp;
-	fopen_s(&fp, file, "a");
-	if (fp == NULL) {
-		return;
-	}
-	fprintf(fp, "%s\n", text.c_str());
-	fclose(fp);
-}
-
 std::string cachedModulePath;
 
 std::string GetCurrentModulePath()
@@ -86,8 +76,8 @@ Vector3 MathUtils::rotationToDirection(Vector3 rotation)
 	//big thanks to camxxcore's C# code https://github.com/CamxxCore/ScriptCamTool/blob/master/GTAV_ScriptCamTool/Utils.cs
 	float retZ = rotation.z * 0.01745329f;
 	float retX = rotation.x * 0.01745329f;
-	float absX = abs(cos(retX));
-	Vector3 retVector = { 0.0,0.0,0.0 };
+	float absX = fabs(cos(retX));
+	Vector3 retVector = {};
 	retVector.x = (float)-(sin(retZ) * absX);
 	retVector.y = (float)cos(retZ) * absX;
 	retVector.z = (float)sin(retX);
@@ -97,7 +87,7 @@ Vector3 MathUtils::rotationToDirection(Vector3 rotation)
 Vector3 MathUtils::crossProduct(Vector3 a, Vector3 b)
 {
 	//http://onlinemschool.com/math/assistance/vector/multiply1/
-	Vector3 retVector = { 0.0,0.0,0.0 };
+	Vector3 retVector = {};
 	retVector.x = a.y*b.z - a.z*b.y;
 	retVector.y = a.z*b.x - a.x*b.z;
 	retVector.z = a.x*b.y - a.y*b.x;
@@ -11,6 +11,7 @@
 #include <sstream>
 #include "types.h"
 #include "natives.h"
+#include "logging.h"
 
 // returns module load path with trailing slash
 std::string GetCurrentModulePath();
@@ -28,7 +29,6 @@ public:
 };
 
 void setStatusText(std::string text);
-void log_to_pedTxt(std::string text, char* file);
 
 
 class MathUtils {
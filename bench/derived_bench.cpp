@@ -0,0 +1,107 @@
+// Derived-channel benchmark: times unprojectDepth, computeNormals and
+// computeDepthEdges on a synthetic frame, the stages behind CAPTURE NORMALS
+// and EDGES. --out writes the inputs and results as raw little-endian planes
+// (depth.f32, P.f32 column-major, normals.f32, edges.u8) so derived_numpy.py
+// can check a numpy reference against them and time it on the same frame.
+//
+//   dronesim_derived [--size WxH] [--repeat N] [--edges ratio] [--out DIR] [--json]
+#include "synthetic.h"
+#include "derived.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static void usage()
+{
+	fprintf(stderr, "usage: dronesim_derived [--size WxH] [--repeat N] [--edges ratio] [--out DIR] [--json]\n");
+}
+
+static bool writeFile(const std::filesystem::path& path, const void* data, size_t size)
+{
+	std::ofstream f(path, std::ios::binary);
+	f.write((const char*)data, size);
+	return (bool)f;
+}
+
+static double median(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	return v.empty() ? 0.0 : v[v.size() / 2];
+}
+
+int main(int argc, char** argv)
+{
+	int width = 1280, height = 720, repeat = 20;
+	float edgeRatio = 0.05f;
+	std::string out;
+	bool json = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string opt = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (opt == "--repeat" && hasValue) repeat = std::max(1, atoi(argv[++i]));
+		else if (opt == "--edges" && hasValue) edgeRatio = (float)atof(argv[++i]);
+		else if (opt == "--out" && hasValue) out = argv[++i];
+		else if (opt == "--json") json = true;
+		else if (opt == "--size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				usage();
+				return 2;
+			}
+		}
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	auto frame = syntheticFrame(width, height);
+	PositionPlanes planes;
+	std::vector<float> normals;
+	std::vector<unsigned char> edges;
+	std::vector<double> unprojectMs, normalsMs, edgesMs;
+	for (int r = 0; r < repeat; ++r) {
+		auto t0 = Clock::now();
+		unprojectDepth(*frame, planes);
+		auto t1 = Clock::now();
+		computeNormals(planes, normals);
+		auto t2 = Clock::now();
+		computeDepthEdges(planes, edges, edgeRatio);
+		auto t3 = Clock::now();
+		unprojectMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+		normalsMs.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+		edgesMs.push_back(std::chrono::duration<double, std::milli>(t3 - t2).count());
+	}
+
+	if (!out.empty()) {
+		std::filesystem::path dir(out);
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (!writeFile(dir / "depth.f32", frame->depth.data(), frame->depth.size() * sizeof(float))
+			|| !writeFile(dir / "P.f32", frame->P.data(), 16 * sizeof(float))
+			|| !writeFile(dir / "normals.f32", normals.data(), normals.size() * sizeof(float))
+			|| !writeFile(dir / "edges.u8", edges.data(), edges.size())) {
+			fprintf(stderr, "cannot write to %s\n", out.c_str());
+			return 1;
+		}
+	}
+
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	double u = median(unprojectMs), n = median(normalsMs), e = median(edgesMs);
+	if (json) {
+		printf("{\"width\":%d,\"height\":%d,\"threads\":%u,\"repeat\":%d,\"unproject_ms\":%.3f,\"normals_ms\":%.3f,"
+			"\"edges_ms\":%.3f,\"total_ms\":%.3f}\n", width, height, threads, repeat, u, n, e, u + n + e);
+	}
+	else {
+		printf("%dx%d, %u thread(s), median of %d\n", width, height, threads, repeat);
+		printf("unproject %8.3f ms\nnormals   %8.3f ms\nedges     %8.3f ms\ntotal     %8.3f ms\n", u, n, e, u + n + e);
+	}
+	return 0;
+}
@@ -0,0 +1,130 @@
+"""
+Compares the derived channels (CAPTURE NORMALS / EDGES) with a numpy
+reference of the same math, the per-image Python this stage replaces.
+
+Runs dronesim_derived on a synthetic frame, checks the numpy results against
+its output and prints the median time of both per stage.
+
+    python derived_numpy.py --binary _build/bench/dronesim_derived [--size 1280x720] [--repeat 10]
+"""
+import argparse
+import json
+import os
+import subprocess
+import tempfile
+import time
+
+import numpy as np
+
+
+def unproject(depth, P):
+    """Camera-space x, y, z planes of a reversed-z depth buffer; sky is zero."""
+    h, w = depth.shape
+    Pinv = np.linalg.inv(P.astype(np.float64)).astype(np.float32)
+    nx = ((np.arange(w, dtype=np.float32) + 0.5) * (2.0 / w) - 1.0)[None, :]
+    ny = (1.0 - (np.arange(h, dtype=np.float32) + 0.5) * (2.0 / h))[:, None]
+    v = [Pinv[r, 0] * nx + Pinv[r, 1] * ny + Pinv[r, 2] * depth + Pinv[r, 3] for r in range(4)]
+    valid = depth > 0.0
+    inv = np.where(valid, 1.0 / np.where(valid, v[3], 1.0), 0.0).astype(np.float32)
+    return v[0] * inv, v[1] * inv, v[2] * inv
+
+
+def _shift(a, dy, dx):
+    """a[y + dy, x + dx], edge pixels repeated."""
+    h, w = a.shape
+    ys = np.clip(np.arange(h) + dy, 0, h - 1)
+    xs = np.clip(np.arange(w) + dx, 0, w - 1)
+    return a[ys][:, xs]
+
+
+def normals(X, Y, Z):
+    """One-sided differences towards the smaller depth step, facing the camera."""
+    h, w = Z.shape
+    P = np.stack([X, Y, Z], axis=-1)
+    xs = np.arange(w)[None, :]
+    ys = np.arange(h)[:, None]
+
+    def side(dy, dx, inside):
+        Zn = _shift(Z, dy, dx)
+        return Zn, inside & (Zn != 0.0)
+
+    Zl, hasL = side(0, -1, xs > 0)
+    Zr, hasR = side(0, 1, xs + 1 < w)
+    Zu, hasU = side(-1, 0, ys > 0)
+    Zd, hasD = side(1, 0, ys + 1 < h)
+    useR = hasR & (~hasL | (np.abs(Zr - Z) < np.abs(Z - Zl)))
+    useD = hasD & (~hasU | (np.abs(Zd - Z) < np.abs(Z - Zu)))
+    shifted = lambda dy, dx: np.stack([_shift(c, dy, dx) for c in (X, Y, Z)], axis=-1)
+    a = np.where(useR[..., None], shifted(0, 1) - P, np.where(hasL[..., None], P - shifted(0, -1), 0.0))
+    b = np.where(useD[..., None], shifted(1, 0) - P, np.where(hasU[..., None], P - shifted(-1, 0), 0.0))
+    n = np.cross(a, b).astype(np.float32)
+    length = np.linalg.norm(n, axis=-1)
+    length = np.where(np.sum(n * P, axis=-1) > 0.0, -length, length)
+    ok = (Z != 0.0) & (useR | hasL) & (useD | hasU) & (length != 0.0)
+    return np.where(ok[..., None], n / np.where(ok, length, 1.0)[..., None], 0.0).astype(np.float32)
+
+
+def edges(Z, ratio):
+    """1 where linear depth jumps by more than ratio of the nearer side, or borders sky."""
+    z = -Z
+    valid = z > 0.0
+    edge = np.zeros(Z.shape, dtype=bool)
+    for dy, dx in ((0, -1), (0, 1), (-1, 0), (1, 0)):
+        zn = _shift(z, dy, dx)
+        edge |= ~(zn > 0.0) | (np.abs(z - zn) > ratio * np.minimum(z, zn))
+    return (edge & valid).astype(np.uint8)
+
+
+def timed(fn, repeat):
+    times = []
+    for _ in range(repeat):
+        t = time.perf_counter()
+        result = fn()
+        times.append((time.perf_counter() - t) * 1000.0)
+    return result, float(np.median(times))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--binary', required=True, help='path to dronesim_derived')
+    parser.add_argument('--size', default='1280x720')
+    parser.add_argument('--repeat', type=int, default=10)
+    parser.add_argument('--edges', type=float, default=0.05)
+    args = parser.parse_args()
+    w, h = (int(v) for v in args.size.split('x'))
+
+    with tempfile.TemporaryDirectory() as out:
+        run = subprocess.run([args.binary, '--size', args.size, '--repeat', str(args.repeat),
+                              '--edges', str(args.edges), '--out', out, '--json'],
+                             check=True, capture_output=True, text=True)
+        native = json.loads(run.stdout)
+        load = lambda name, dtype: np.fromfile(os.path.join(out, name), dtype=dtype)
+        depth = load('depth.f32', np.float32).reshape(h, w)
+        P = load('P.f32', np.float32).reshape(4, 4, order='F')
+        ref_normals = load('normals.f32', np.float32).reshape(h, w, 3)
+        ref_edges = load('edges.u8', np.uint8).reshape(h, w)
+
+    (X, Y, Z), t_unproject = timed(lambda: unproject(depth, P), args.repeat)
+    N, t_normals = timed(lambda: normals(X, Y, Z), args.repeat)
+    E, t_edges = timed(lambda: edges(Z, args.edges), args.repeat)
+
+    # the SSE path rounds differently, which can flip a tie in the side choice
+    geometry = np.linalg.norm(ref_normals, axis=-1) > 0.0
+    agree = np.sum(N * ref_normals, axis=-1) > 0.999
+    normal_match = float(np.mean(agree[geometry])) if geometry.any() else 1.0
+    edge_match = float(np.mean(E == ref_edges))
+
+    print(f"{w}x{h}, native {native['threads']} thread(s), median of {args.repeat}")
+    print(f"{'stage':<10} {'numpy ms':>10} {'native ms':>10} {'speedup':>8}")
+    for stage, t in (('unproject', t_unproject), ('normals', t_normals), ('edges', t_edges)):
+        ms = native[stage + '_ms']
+        print(f"{stage:<10} {t:10.3f} {ms:10.3f} {t / max(ms, 1e-6):7.1f}x")
+    total = t_unproject + t_normals + t_edges
+    print(f"{'total':<10} {total:10.3f} {native['total_ms']:10.3f} {total / max(native['total_ms'], 1e-6):7.1f}x")
+    print(f"normals within 2.6 degrees: {normal_match * 100.0:.3f}%, edges equal: {edge_match * 100.0:.3f}%")
+    if normal_match < 0.999 or edge_match < 0.999:
+        raise SystemExit('numpy reference and native output disagree')
+
+
+if __name__ == '__main__':
+    main()
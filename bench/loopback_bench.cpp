@@ -0,0 +1,503 @@
+// End-to-end ModServer benchmark over TCP loopback. Starts the server against
+// a synthetic frame source and drives it with concurrent clients, one protocol
+// mode at a time:
+//
+//   oneshot    CAPTURE: connect, command, length-prefixed reply, close
+//   pipelined  CAPTURE on one PIPELINE connection per client, --depth
+//              requests in flight; latency runs from each request's write
+//   shm        CAPTURE_SHM: one-shot, the payload copied out of the shared
+//              memory ring the reply points to
+//   frames     RIG_FRAMES: a two-camera rig straight from the frame store
+//   stats      CMD_STATS: small JSON reply, the per-request floor
+//   control    CONTROL: one session streaming setpoints at --rate Hz into a
+//              mock 60 Hz game loop that applies them as the script thread
+//              does; replies counts setpoints sent, frames the ones that
+//              reached the pose, and latency runs from writing a setpoint to
+//              the tick that applied it
+//   subscribe  SENSORS: one long-lived stream fed at 60 Hz; frames counts
+//              IMU samples and latency is the age of the newest one when its
+//              batch arrives
+//
+// Otherwise latency runs from the command (including the connect the
+// protocol needs) to the last byte of the reply.
+//
+//   dronesim_loopback [--clients N] [--requests N] [--size WxH] [--depth N] [--rate HZ]
+//                     [--modes oneshot,pipelined,shm,frames,stats,control,subscribe]
+//                     [--seconds S] [--json]
+#include "synthetic.h"
+#include "control.h"
+#include "frame.h"
+#include "rig.h"
+#include "sensors.h"
+#include "server.h"
+#include "sharedreply.h"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using boost::asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+static const unsigned short serverPort = 12345;
+
+struct ModeResult {
+	std::string mode;
+	int clients = 0;
+	uint64_t replies = 0;
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+	uint64_t errors = 0;
+	double seconds = 0.0;
+	std::vector<double> latencyMs;
+};
+
+static double percentile(std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+	size_t i = (size_t)std::ceil(p * sorted.size());
+	return sorted[std::min(sorted.size() - 1, i == 0 ? 0 : i - 1)];
+}
+
+// What the capture hook would have left behind: a finished two-camera rig in
+// the frame history, the newest frame carrying the screenshot CAPTURE sends.
+static void publishSyntheticSource(int width, int height)
+{
+	auto frame = syntheticFrame(width, height);
+	frame->screen.assign(54 + (size_t)width * height * 3, 0);
+	frame->screen[0] = 'B';
+	frame->screen[1] = 'M';
+
+	unsigned int rig = nextRigId();
+	for (const char* camera : { "left", "right" }) {
+		auto copy = std::make_shared<CapturedFrame>(*frame);
+		copy->metadata = "\"rig\":" + std::to_string(rig) + ",\"camera\":\"" + camera + "\"";
+		copy->rigId = rig;
+		publishCapturedFrame(copy);
+	}
+	finishRig(rig);
+}
+
+static void readExact(tcp::socket& socket, void* data, size_t size)
+{
+	boost::asio::read(socket, boost::asio::buffer(data, size));
+}
+
+// A command frame: u32 length, then the text.
+static void writeCommand(tcp::socket& socket, const std::string& command)
+{
+	uint32_t size = (uint32_t)command.size();
+	std::string frame(reinterpret_cast<const char*>(&size), sizeof(size));
+	boost::asio::write(socket, boost::asio::buffer(frame + command));
+}
+
+// One request on its own connection, as every one-shot command works.
+// Returns the reply payload size; frames is the frame count for list replies.
+static size_t oneShot(boost::asio::io_context& io, const std::string& command, bool frameList, uint64_t& frames,
+	std::vector<unsigned char>& payload)
+{
+	tcp::socket socket(io);
+	socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), serverPort));
+	writeCommand(socket, command);
+	uint32_t size = 0;
+	readExact(socket, &size, sizeof(size));
+	payload.resize(size);
+	readExact(socket, payload.data(), size);
+	if (frameList) {
+		uint32_t count = 0;
+		if (size >= 4) memcpy(&count, payload.data(), 4);
+		frames += count;
+	}
+	else {
+		frames += 1;
+	}
+	return size + sizeof(size);
+}
+
+static uint64_t jsonNumber(const std::string& json, const std::string& key)
+{
+	size_t at = json.find("\"" + key + "\":");
+	return at == std::string::npos ? 0 : std::stoull(json.substr(at + key.size() + 3));
+}
+
+// CAPTURE_SHM on its own connection, then the payload out of shared memory.
+// Returns the payload size.
+static size_t sharedMemoryShot(boost::asio::io_context& io, const std::string& command, std::vector<unsigned char>& payload)
+{
+	uint64_t frames = 0;
+	std::vector<unsigned char> reply;
+	oneShot(io, command, false, frames, reply);
+	std::string json(reply.begin(), reply.end());
+	if (json.compare(0, 8, "{\"shm\":\"") != 0) throw std::runtime_error(json);
+	SharedReplyRef ref;
+	ref.name = json.substr(8, json.find('"', 8) - 8);
+	ref.segmentBytes = jsonNumber(json, "bytes");
+	ref.offset = jsonNumber(json, "offset");
+	ref.size = jsonNumber(json, "size");
+	ref.sequence = jsonNumber(json, "sequence");
+	std::string error;
+	if (!readSharedReply(ref, payload, error)) throw std::runtime_error(error);
+	return payload.size();
+}
+
+static ModeResult runOneShot(const std::string& mode, const std::string& command, bool frameList, int clients, int requests)
+{
+	ModeResult result;
+	result.mode = mode;
+	result.clients = clients;
+	std::mutex mtx;
+	auto start = Clock::now();
+	std::vector<std::thread> threads;
+	for (int c = 0; c < clients; ++c) {
+		threads.emplace_back([&] {
+			boost::asio::io_context io;
+			std::vector<unsigned char> payload;
+			std::vector<double> latency;
+			uint64_t bytes = 0, frames = 0, errors = 0;
+			for (int i = 0; i < requests; ++i) {
+				auto t0 = Clock::now();
+				try {
+					if (mode == "shm") {
+						bytes += sharedMemoryShot(io, command, payload);
+						frames++;
+					}
+					else bytes += oneShot(io, command, frameList, frames, payload);
+					latency.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+				}
+				catch (const std::exception&) {
+					errors++;
+				}
+			}
+			std::lock_guard<std::mutex> lk(mtx);
+			result.latencyMs.insert(result.latencyMs.end(), latency.begin(), latency.end());
+			result.replies += latency.size();
+			result.bytes += bytes;
+			result.frames += frames;
+			result.errors += errors;
+		});
+	}
+	for (auto& t : threads) t.join();
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return result;
+}
+
+// Each client opens one PIPELINE connection and keeps depth CAPTURE requests
+// in flight: a new one is written as each reply is read. The server serves
+// one connection at a time, so clients take turns.
+static ModeResult runPipelined(int clients, int requests, int depth)
+{
+	ModeResult result;
+	result.mode = "pipelined";
+	result.clients = clients;
+	std::mutex mtx;
+	auto start = Clock::now();
+	std::vector<std::thread> threads;
+	for (int c = 0; c < clients; ++c) {
+		threads.emplace_back([&] {
+			std::vector<double> latency;
+			uint64_t bytes = 0, errors = 0;
+			try {
+				boost::asio::io_context io;
+				tcp::socket socket(io);
+				socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), serverPort));
+				writeCommand(socket, "PIPELINE");
+				uint32_t size = 0;
+				std::vector<unsigned char> payload;
+				readExact(socket, &size, sizeof(size));
+				payload.resize(size);
+				readExact(socket, payload.data(), size);
+				std::deque<Clock::time_point> inFlight;
+				int sent = 0;
+				while ((int)latency.size() < requests) {
+					while (sent < requests && (int)inFlight.size() < depth) {
+						inFlight.push_back(Clock::now());
+						writeCommand(socket, "CAPTURE");
+						sent++;
+					}
+					readExact(socket, &size, sizeof(size));
+					payload.resize(size);
+					readExact(socket, payload.data(), size);
+					latency.push_back(std::chrono::duration<double, std::milli>(Clock::now() - inFlight.front()).count());
+					inFlight.pop_front();
+					bytes += size + sizeof(size);
+				}
+			}
+			catch (const std::exception&) {
+				errors++;
+			}
+			std::lock_guard<std::mutex> lk(mtx);
+			result.latencyMs.insert(result.latencyMs.end(), latency.begin(), latency.end());
+			result.replies += latency.size();
+			result.frames += latency.size();
+			result.bytes += bytes;
+			result.errors += errors;
+		});
+	}
+	for (auto& t : threads) t.join();
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return result;
+}
+
+static int64_t systemMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Feeds the sensor stream at the script tick rate the way feedSensors does,
+// and reads batches off one SENSORS connection for the given time.
+static ModeResult runSubscribe(double seconds)
+{
+	ModeResult result;
+	result.mode = "subscribe";
+	result.clients = 1;
+	std::atomic<bool> running(true);
+	std::thread feeder([&] {
+		float t = 0.0f;
+		while (running) {
+			Eigen::Vector3f position(10.0f * std::cos(t * 0.2f), 10.0f * std::sin(t * 0.2f), 30.0f);
+			Eigen::Quaternionf attitude(Eigen::AngleAxisf(t * 0.2f, Eigen::Vector3f::UnitZ()));
+			feedSensorPose(systemMicros(), position, attitude);
+			std::this_thread::sleep_for(std::chrono::microseconds(16667));
+			t += 1.0f / 60.0f;
+		}
+	});
+
+	try {
+		boost::asio::io_context io;
+		tcp::socket socket(io);
+		socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), serverPort));
+		writeCommand(socket, "SENSORS imu=200 gnss=10 baro=25");
+		auto start = Clock::now();
+		std::vector<unsigned char> payload;
+		while (std::chrono::duration<double>(Clock::now() - start).count() < seconds) {
+			uint32_t size = 0;
+			readExact(socket, &size, sizeof(size));
+			payload.resize(size);
+			readExact(socket, payload.data(), size);
+			int64_t now = systemMicros();
+			result.replies++;
+			result.bytes += size + sizeof(size);
+			uint32_t counts[3] = { 0, 0, 0 };
+			if (size >= 16 && memcmp(payload.data(), "SENS", 4) == 0) {
+				memcpy(counts, payload.data() + 4, sizeof(counts));
+			}
+			result.frames += counts[0];
+			if (counts[0] > 0) {
+				ImuSample last;
+				memcpy(&last, payload.data() + 16 + (counts[0] - 1) * sizeof(ImuSample), sizeof(last));
+				result.latencyMs.push_back((now - last.timeUs) / 1000.0);
+			}
+		}
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		socket.close();
+	}
+	catch (const std::exception&) {
+		result.errors++;
+	}
+	running = false;
+	feeder.join();
+	return result;
+}
+
+// A mock game loop ticking at 60 Hz applies the current setpoint the way the
+// script thread's stepControl does on the kinematic path, and notes when each
+// sequence first reaches the pose. One client streams setpoints meanwhile;
+// those overtaken before a tick are never applied, as in the game.
+static ModeResult runControl(double seconds, double rate)
+{
+	ModeResult result;
+	result.mode = "control";
+	result.clients = 1;
+	std::atomic<bool> running(true);
+	std::mutex mtx;
+	std::vector<std::pair<uint32_t, Clock::time_point>> applied;
+	std::thread game([&] {
+		const auto tick = std::chrono::microseconds(16667);
+		Eigen::Vector3f position(0.0f, 0.0f, 30.0f);
+		float yaw = 0.0f;
+		uint32_t last = 0;
+		auto previous = Clock::now();
+		auto next = previous + tick;
+		while (running) {
+			std::this_thread::sleep_until(next);
+			next += tick;
+			auto now = Clock::now();
+			float dt = std::chrono::duration<float>(now - previous).count();
+			previous = now;
+			ControlSetpoint setpoint;
+			if (!currentControlSetpoint(setpoint)) continue;
+			integrateControl(setpoint, dt, position, yaw);
+			markControlApplied(setpoint);
+			if (setpoint.sequence != 0 && setpoint.sequence != last) {
+				last = setpoint.sequence;
+				std::lock_guard<std::mutex> lk(mtx);
+				applied.emplace_back(last, Clock::now());
+			}
+		}
+	});
+
+	// sentAt[sequence - 1]
+	std::vector<Clock::time_point> sentAt;
+	try {
+		boost::asio::io_context io;
+		tcp::socket socket(io);
+		socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), serverPort));
+		writeCommand(socket, "CONTROL");
+		uint32_t size = 0;
+		readExact(socket, &size, sizeof(size));
+		std::vector<unsigned char> ok(size);
+		readExact(socket, ok.data(), size);
+		auto start = Clock::now();
+		const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+		auto next = start;
+		while (std::chrono::duration<double>(Clock::now() - start).count() < seconds) {
+			ControlSetpointMsg msg = {};
+			memcpy(msg.magic, "CTRL", 4);
+			msg.sequence = (uint32_t)sentAt.size() + 1;
+			msg.velocity[1] = 2.0f;
+			msg.yawRate = 10.0f;
+			msg.frame = controlHeading;
+			sentAt.push_back(Clock::now());
+			boost::asio::write(socket, boost::asio::buffer(&msg, sizeof(msg)));
+			result.replies++;
+			result.bytes += sizeof(msg);
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+		// let the last setpoint reach a tick before the session ends
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		socket.close();
+	}
+	catch (const std::exception&) {
+		result.errors++;
+	}
+	running = false;
+	game.join();
+
+	for (const auto& a : applied) {
+		if (a.first == 0 || a.first > sentAt.size()) continue;
+		result.frames++;
+		result.latencyMs.push_back(std::chrono::duration<double, std::milli>(a.second - sentAt[a.first - 1]).count());
+	}
+	return result;
+}
+
+static void report(ModeResult& r, bool json)
+{
+	std::sort(r.latencyMs.begin(), r.latencyMs.end());
+	double fps = r.seconds > 0.0 ? r.frames / r.seconds : 0.0;
+	double mbps = r.seconds > 0.0 ? r.bytes / r.seconds / (1024.0 * 1024.0) : 0.0;
+	double p50 = percentile(r.latencyMs, 0.50), p99 = percentile(r.latencyMs, 0.99), p999 = percentile(r.latencyMs, 0.999);
+	if (json) {
+		printf("{\"mode\":\"%s\",\"clients\":%d,\"replies\":%llu,\"frames\":%llu,\"errors\":%llu,\"seconds\":%.3f,"
+			"\"frames_per_s\":%.2f,\"mb_per_s\":%.2f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f}\n",
+			r.mode.c_str(), r.clients, (unsigned long long)r.replies, (unsigned long long)r.frames,
+			(unsigned long long)r.errors, r.seconds, fps, mbps, p50, p99, p999);
+	}
+	else {
+		printf("%-10s %7d %8llu %8llu %6llu %10.1f %9.1f %9.3f %9.3f %9.3f\n", r.mode.c_str(), r.clients,
+			(unsigned long long)r.replies, (unsigned long long)r.frames, (unsigned long long)r.errors,
+			fps, mbps, p50, p99, p999);
+	}
+	fflush(stdout);
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: dronesim_loopback [--clients N] [--requests N] [--size WxH] [--depth N] [--rate HZ] "
+		"[--modes oneshot,pipelined,shm,frames,stats,control,subscribe] [--seconds S] [--json]\n");
+}
+
+int main(int argc, char** argv)
+{
+	int clients = 4, requests = 100, width = 1280, height = 720, depth = 8;
+	double seconds = 3.0, rate = 500.0;
+	std::string modes = "oneshot,pipelined,shm,frames,stats,control,subscribe";
+	bool json = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string opt = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (opt == "--clients" && hasValue) clients = std::max(1, atoi(argv[++i]));
+		else if (opt == "--requests" && hasValue) requests = std::max(1, atoi(argv[++i]));
+		else if (opt == "--seconds" && hasValue) seconds = atof(argv[++i]);
+		else if (opt == "--depth" && hasValue) depth = std::max(1, atoi(argv[++i]));
+		else if (opt == "--rate" && hasValue) rate = std::max(1.0, atof(argv[++i]));
+		else if (opt == "--modes" && hasValue) modes = argv[++i];
+		else if (opt == "--json") json = true;
+		else if (opt == "--size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				usage();
+				return 2;
+			}
+		}
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	// The server logs to logs\server.log relative to the working directory.
+	auto workdir = std::filesystem::temp_directory_path() / "dronesim_loopback";
+	std::filesystem::create_directories(workdir / "logs");
+	std::filesystem::create_directories(workdir / "data");
+	std::filesystem::current_path(workdir);
+
+	publishSyntheticSource(width, height);
+	InitializeModServer();
+
+	// Wait for the acceptor before timing anything.
+	bool up = false;
+	for (int i = 0; i < 100 && !up; ++i) {
+		try {
+			boost::asio::io_context io;
+			std::vector<unsigned char> payload;
+			uint64_t frames = 0;
+			oneShot(io, "CMD_STATS", false, frames, payload);
+			up = true;
+		}
+		catch (const std::exception&) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+	if (!up) {
+		fprintf(stderr, "ModServer did not come up on port %u\n", serverPort);
+		return 1;
+	}
+
+	if (!json) {
+		printf("%dx%d, %d client(s), %d request(s) each, pipeline depth %d\n", width, height, clients, requests, depth);
+		printf("%-10s %7s %8s %8s %6s %10s %9s %9s %9s %9s\n", "mode", "clients", "replies", "frames", "errors",
+			"frames/s", "MB/s", "p50 ms", "p99 ms", "p999 ms");
+	}
+	std::stringstream list(modes);
+	std::string mode;
+	while (std::getline(list, mode, ',')) {
+		ModeResult r;
+		if (mode == "oneshot") r = runOneShot(mode, "CAPTURE", false, clients, requests);
+		else if (mode == "pipelined") r = runPipelined(clients, requests, depth);
+		else if (mode == "shm") r = runOneShot(mode, "CAPTURE_SHM", false, clients, requests);
+		else if (mode == "frames") r = runOneShot(mode, "RIG_FRAMES", true, clients, requests);
+		else if (mode == "stats") r = runOneShot(mode, "CMD_STATS", false, clients, requests);
+		else if (mode == "control") r = runControl(seconds, rate);
+		else if (mode == "subscribe") r = runSubscribe(seconds);
+		else {
+			fprintf(stderr, "unknown mode %s\n", mode.c_str());
+			continue;
+		}
+		report(r, json);
+	}
+
+	ShutdownModServer();
+	// The server thread is detached; skip static destructors it may still use.
+	std::quick_exit(0);
+}
@@ -0,0 +1,392 @@
+// Microbenchmarks for the capture and transport hot paths, on synthetic data.
+// Machine-readable results for tracking across releases:
+//   dronesim_bench --benchmark_format=json --benchmark_out=bench.json
+#include "synthetic.h"
+#include "commands.h"
+#include "dataset.h"
+#include "derived.h"
+#include "environment.h"
+#include "frame.h"
+#include "instances.h"
+#include "pixels.h"
+#include "pose.h"
+#include "poseindex.h"
+#include "quadrotor.h"
+#include "semantic.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// The capture resolutions the suite sweeps: 720p, 1080p, 1440p, 4K.
+inline void captureResolutions(benchmark::internal::Benchmark* b)
+{
+	b->Args({ 1280, 720 })->Args({ 1920, 1080 })->Args({ 2560, 1440 })->Args({ 3840, 2160 });
+	b->ArgNames({ "w", "h" });
+}
+
+// D3D staging textures pad rows to 256 bytes.
+static size_t pitchFor(int width, int bytesPerTexel)
+{
+	return ((size_t)width * bytesPerTexel + 255) / 256 * 256;
+}
+
+static void BM_SplitDepthStencil(benchmark::State& state)
+{
+	const int width = (int)state.range(0), height = (int)state.range(1);
+	const size_t pitch = pitchFor(width, 8);
+	std::vector<unsigned char> texture(pitch * height);
+	for (size_t i = 0; i < texture.size(); ++i) texture[i] = (unsigned char)benchHash((uint32_t)i);
+	std::vector<float> depth((size_t)width * height);
+	std::vector<unsigned char> stencil((size_t)width * height);
+	for (auto _ : state) {
+		splitDepthStencil(texture.data(), pitch, width, height, depth.data(), stencil.data());
+		benchmark::DoNotOptimize(depth.data());
+		benchmark::DoNotOptimize(stencil.data());
+	}
+	state.SetBytesProcessed(state.iterations() * (int64_t)width * height * 8);
+}
+BENCHMARK(BM_SplitDepthStencil)->Apply(captureResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_SwizzleBgraToRgba(benchmark::State& state)
+{
+	const int width = (int)state.range(0), height = (int)state.range(1);
+	const size_t pitch = pitchFor(width, 4);
+	std::vector<unsigned char> texture(pitch * height);
+	for (size_t i = 0; i < texture.size(); ++i) texture[i] = (unsigned char)benchHash((uint32_t)i);
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+	for (auto _ : state) {
+		swizzleBgraToRgba(texture.data(), pitch, width, height, rgba.data());
+		benchmark::DoNotOptimize(rgba.data());
+	}
+	state.SetBytesProcessed(state.iterations() * (int64_t)width * height * 4);
+}
+BENCHMARK(BM_SwizzleBgraToRgba)->Apply(captureResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Reversed-z buffer to camera-space positions (linear depth in z).
+static void BM_UnprojectDepth(benchmark::State& state)
+{
+	auto frame = syntheticFrame((int)state.range(0), (int)state.range(1));
+	PositionPlanes planes;
+	for (auto _ : state) {
+		unprojectDepth(*frame, planes);
+		benchmark::DoNotOptimize(planes.z.data());
+	}
+	state.SetItemsProcessed(state.iterations() * (int64_t)frame->depth.size());
+}
+BENCHMARK(BM_UnprojectDepth)->Apply(captureResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Stencil -> semantic labels, per-class COCO RLE masks and their JSON.
+static void BM_SemanticEncode(benchmark::State& state)
+{
+	auto frame = syntheticFrame((int)state.range(0), (int)state.range(1));
+	SemanticLut lut = currentSemanticLut();
+	std::vector<unsigned char> labels;
+	std::vector<SemanticClassStats> classes;
+	size_t bytes = 0;
+	for (auto _ : state) {
+		labelStencil(frame->stencil, frame->width, frame->height, lut, labels, classes);
+		std::string json = semanticClassesJson(classes, frame->width, frame->height);
+		bytes = json.size();
+		benchmark::DoNotOptimize(json.data());
+	}
+	state.counters["json_bytes"] = (double)bytes;
+	state.SetItemsProcessed(state.iterations() * (int64_t)frame->stencil.size());
+}
+BENCHMARK(BM_SemanticEncode)->Apply(captureResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The INSTANCES channel: semantic labels and linear depth -> instance records.
+static void BM_LabelInstances(benchmark::State& state)
+{
+	auto frame = syntheticFrame((int)state.range(0), (int)state.range(1));
+	std::vector<unsigned char> labels;
+	applySemanticLut(frame->stencil, currentSemanticLut(), labels);
+	PositionPlanes planes;
+	unprojectDepth(*frame, planes);
+	std::vector<float> depth(planes.z.size());
+	for (size_t i = 0; i < depth.size(); ++i) depth[i] = -planes.z[i];
+	std::vector<InstanceRecord> instances;
+	for (auto _ : state) {
+		labelInstances(labels, depth, frame->width, frame->height, instances);
+		benchmark::DoNotOptimize(instances.data());
+	}
+	state.counters["instances"] = (double)instances.size();
+	state.SetItemsProcessed(state.iterations() * (int64_t)labels.size());
+}
+BENCHMARK(BM_LabelInstances)->Args({ 2560, 1440 })->ArgNames({ "w", "h" })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// CAPTURE reply payload: META, RGBA and DPTH channels.
+static void BM_SerializeFrame(benchmark::State& state)
+{
+	auto frame = syntheticFrame((int)state.range(0), (int)state.range(1));
+	frame->metadata = "\"source\":\"bench\"";
+	std::vector<unsigned char> out;
+	for (auto _ : state) {
+		out.clear();
+		appendFrameChannels(out, *frame);
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetBytesProcessed(state.iterations() * (int64_t)out.size());
+}
+BENCHMARK(BM_SerializeFrame)->Apply(captureResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_ParseSetPose(benchmark::State& state)
+{
+	const std::string cmd = "SET_POSE 123.25 -456.5 78.125 -12.5 0 270.75 60";
+	CameraPose pose = {};
+	bool hasFov = false;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(parseSetPose(cmd, pose, hasFov));
+	}
+}
+BENCHMARK(BM_ParseSetPose);
+
+static void BM_FoldMoveCommands(benchmark::State& state)
+{
+	static const char* moves[] = { "FORWARD", "LEFT", "UP", "LEFTROTATE", "BACKWARD", "RIGHT", "DOWN", "RIGHTROTATE" };
+	Eigen::Vector3f position(0.0f, 0.0f, 50.0f);
+	float yaw = 0.0f;
+	size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(foldMoveCommand(moves[i++ & 7], position, -10.0f, yaw));
+	}
+}
+BENCHMARK(BM_FoldMoveCommands);
+
+static void BM_ParseEnvironmentCommand(benchmark::State& state)
+{
+	const std::string cmd = "ENV_SWEEP weather=CLEAR,RAIN,FOGGY,THUNDER time=06:00,12:00,18:30,23:00 settle=2";
+	for (auto _ : state) {
+		bool enable = false;
+		EnvironmentSweepConfig cfg;
+		benchmark::DoNotOptimize(parseEnvironmentCommand(cmd, enable, cfg));
+	}
+}
+BENCHMARK(BM_ParseEnvironmentCommand);
+
+// One 500 Hz physics step of the drone model, flying a goto.
+static void BM_QuadrotorStep(benchmark::State& state)
+{
+	QuadrotorParams params;
+	QuadrotorSetpoint setpoint;
+	setpoint.position = Eigen::Vector3f(20.0f, -10.0f, 5.0f);
+	setpoint.yaw = 120.0f;
+	QuadrotorState s;
+	s.motorThrust.setConstant(0.25f * params.mass * params.gravity);
+	for (auto _ : state) {
+		stepQuadrotor(params, setpoint, s, 0.002f);
+		benchmark::DoNotOptimize(s.position.data());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QuadrotorStep);
+
+// The per-tick cost at 60 fps: about eight physics steps and the interpolation.
+static void BM_QuadrotorSimTick(benchmark::State& state)
+{
+	QuadrotorSim sim;
+	sim.reset(Eigen::Vector3f::Zero(), 0.0f);
+	QuadrotorSetpoint setpoint = sim.setpoint();
+	setpoint.holdPosition = false;
+	setpoint.velocity = Eigen::Vector3f(0.0f, 5.0f, 0.0f);
+	setpoint.yawRate = 15.0f;
+	sim.setSetpoint(setpoint);
+	for (auto _ : state) {
+		sim.advance(1.0f / 60.0f);
+		QuadrotorState s = sim.interpolated();
+		benchmark::DoNotOptimize(s.position.data());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QuadrotorSimTick);
+
+// The server thread pushes a burst of commands; the script thread drains it.
+static void BM_CommandQueuePushDrain(benchmark::State& state)
+{
+	const int burst = (int)state.range(0);
+	CommandQueue queue;
+	std::deque<std::string> drained;
+	for (auto _ : state) {
+		for (int i = 0; i < burst; ++i) queue.push("SET_POSE 1 2 3 4 5 6");
+		drained.clear();
+		benchmark::DoNotOptimize(queue.drain(drained));
+	}
+	state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_CommandQueuePushDrain)->RangeMultiplier(4)->Range(1, 256);
+
+static std::string benchDatasetPath()
+{
+	return (std::filesystem::temp_directory_path() / "dronesim_bench.dsq").string();
+}
+
+// Recording a sequence: arg 2 is the codec. The file is restarted every 16
+// frames to bound its size, outside the timing.
+static void BM_DatasetAppend(benchmark::State& state)
+{
+	auto frame = syntheticFrame((int)state.range(0), (int)state.range(1));
+	const std::string path = benchDatasetPath();
+	DatasetWriter writer;
+	writer.setCodec((DatasetCodec)state.range(2));
+	std::string error;
+	int64_t raw = 0;
+	uint64_t stored = 0;
+	for (auto _ : state) {
+		if (!writer.isOpen() || writer.frameCount() == 16) {
+			state.PauseTiming();
+			if (writer.isOpen()) stored += writer.bytesWritten();
+			writer.open(path, false, error);
+			state.ResumeTiming();
+		}
+		if (!writer.append(*frame, error)) state.SkipWithError(error.c_str());
+		raw += frame->color.size() + frame->depth.size() * sizeof(float) + frame->stencil.size();
+	}
+	stored += writer.bytesWritten();
+	writer.close(error);
+	std::filesystem::remove(path);
+	state.SetBytesProcessed(raw);
+	state.counters["ratio"] = stored > 0 ? (double)raw / stored : 0.0;
+}
+BENCHMARK(BM_DatasetAppend)->Args({ 1280, 720, datasetRaw })->Args({ 1280, 720, datasetRle })
+	->Args({ 1920, 1080, datasetRaw })->Args({ 1920, 1080, datasetRle })->ArgNames({ "w", "h", "codec" })
+	->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_DatasetRleDepth(benchmark::State& state)
+{
+	auto frame = syntheticFrame((int)state.range(0), (int)state.range(1));
+	const size_t bytes = frame->depth.size() * sizeof(float);
+	std::vector<unsigned char> encoded, decoded(bytes);
+	for (auto _ : state) {
+		encodeDatasetRle((const unsigned char*)frame->depth.data(), bytes, sizeof(float), encoded);
+		decodeDatasetRle(encoded.data(), encoded.size(), sizeof(float), decoded.data(), bytes);
+		benchmark::DoNotOptimize(decoded.data());
+	}
+	state.SetBytesProcessed(state.iterations() * (int64_t)bytes);
+	state.counters["ratio"] = (double)bytes / encoded.size();
+}
+BENCHMARK(BM_DatasetRleDepth)->Apply(captureResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Random access into a 32-frame 720p sequence: the depth of one frame.
+static void BM_DatasetRandomRead(benchmark::State& state)
+{
+	const std::string path = benchDatasetPath();
+	std::string error;
+	{
+		auto frame = syntheticFrame(1280, 720);
+		DatasetWriter writer;
+		writer.setCodec((DatasetCodec)state.range(0));
+		writer.open(path, false, error);
+		for (unsigned int i = 1; i <= 32; ++i) {
+			frame->id = i;
+			writer.append(*frame, error);
+		}
+		writer.close(error);
+	}
+	DatasetReader reader;
+	if (!reader.open(path, error)) {
+		state.SkipWithError(error.c_str());
+		return;
+	}
+	DatasetChannel depth;
+	uint32_t n = 0;
+	for (auto _ : state) {
+		size_t i = benchHash(n++) % reader.frameCount();
+		reader.channel(i, "DPTH", depth, error);
+		// touch every page, as a consumer would
+		float sum = 0.0f;
+		for (size_t b = 0; b < depth.size; b += 4096) sum += depth.data[b];
+		benchmark::DoNotOptimize(sum);
+	}
+	std::filesystem::remove(path);
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DatasetRandomRead)->Arg(datasetRaw)->Arg(datasetRle)->ArgName("codec")->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// Pose index over range(0) views of a survey grid, about 40 views per
+// 100 m square whatever the count.
+static std::vector<PoseEntry> benchPoseEntries(uint32_t count)
+{
+	const float area = std::sqrt(count / 8.0f) * 10.0f;
+	std::vector<PoseEntry> entries(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		entries[i] = makePoseEntry(syntheticViewMatrices(i, area), 150.0f);
+		entries[i].frame = i;
+	}
+	return entries;
+}
+
+static void BM_PoseIndexBuild(benchmark::State& state)
+{
+	const auto entries = benchPoseEntries((uint32_t)state.range(0));
+	for (auto _ : state) {
+		PoseIndex index;
+		index.build(entries, 150.0f, (int)state.range(1));
+		benchmark::DoNotOptimize(index.nodes().data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PoseIndexBuild)->Args({ 100000, 1 })->Args({ 100000, 0 })->Args({ 1000000, 1 })->Args({ 1000000, 0 })
+	->ArgNames({ "views", "threads" })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Query centres spread over the surveyed area.
+static Eigen::Vector3f benchQueryPoint(uint32_t n, uint32_t count, float z)
+{
+	const float area = std::sqrt(count / 8.0f) * 10.0f;
+	return Eigen::Vector3f(benchHash(n) % 10000 * 1e-4f * area, benchHash(n + 1) % 10000 * 1e-4f * area, z);
+}
+
+// "Frames within 30 m looking roughly north": yaw 0 +- 30 degrees.
+static void BM_PoseIndexRadius(benchmark::State& state)
+{
+	const uint32_t count = (uint32_t)state.range(0);
+	PoseIndex index;
+	index.build(benchPoseEntries(count), 150.0f);
+	std::vector<uint32_t> hits;
+	uint32_t n = 0;
+	size_t found = 0;
+	for (auto _ : state) {
+		index.radius(benchQueryPoint(n++, count, 60.0f), 30.0f, hits, 0.0f, 30.0f);
+		found += hits.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["hits"] = (double)found / state.iterations();
+}
+BENCHMARK(BM_PoseIndexRadius)->RangeMultiplier(10)->Range(10000, 1000000)->ArgName("views")->Unit(benchmark::kMicrosecond);
+
+static void BM_PoseIndexNearest(benchmark::State& state)
+{
+	const uint32_t count = (uint32_t)state.range(0);
+	PoseIndex index;
+	index.build(benchPoseEntries(count), 150.0f);
+	std::vector<std::pair<float, uint32_t>> nearest;
+	uint32_t n = 0;
+	for (auto _ : state) {
+		index.nearest(benchQueryPoint(n, count, 60.0f), poseForward((float)(n % 360), -30.0f), 16, 10.0f, nearest);
+		benchmark::DoNotOptimize(nearest.data());
+		++n;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoseIndexNearest)->RangeMultiplier(10)->Range(10000, 1000000)->ArgName("views")->Unit(benchmark::kMicrosecond);
+
+// Views whose frustum holds a ground point, as MVS view selection asks.
+static void BM_PoseIndexSeeing(benchmark::State& state)
+{
+	const uint32_t count = (uint32_t)state.range(0);
+	PoseIndex index;
+	index.build(benchPoseEntries(count), 150.0f);
+	std::vector<uint32_t> hits;
+	uint32_t n = 0;
+	size_t found = 0;
+	for (auto _ : state) {
+		index.seeing(benchQueryPoint(n++, count, 0.0f), hits);
+		found += hits.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["hits"] = (double)found / state.iterations();
+}
+BENCHMARK(BM_PoseIndexSeeing)->RangeMultiplier(10)->Range(10000, 1000000)->ArgName("views")->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
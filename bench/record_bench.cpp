@@ -0,0 +1,116 @@
+// Recording sink benchmark: publishes synthetic frames through
+// publishCapturedFrame while the recorder writes them to disk, as the capture
+// hook would, then reopens the files to check every written frame is there.
+//
+// --fps paces the frames like a capture rate (0 publishes as fast as frames
+// can be built), so drops and blocked time show whether the writers keep up.
+//
+//   dronesim_record [--frames N] [--size WxH] [--fps F] [--writers N] [--queue N]
+//                   [--policy block|drop_newest|drop_oldest] [--codec raw|rle] [--dir path] [--keep]
+#include "synthetic.h"
+#include "dataset.h"
+#include "frame.h"
+#include "recorder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static void usage()
+{
+	fprintf(stderr, "usage: dronesim_record [--frames N] [--size WxH] [--fps F] [--writers N] [--queue N] "
+		"[--policy block|drop_newest|drop_oldest] [--codec raw|rle] [--dir path] [--keep]\n");
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 300;
+	int width = 1280, height = 720;
+	double fps = 0.0;
+	bool keep = false;
+	RecorderConfig cfg;
+	cfg.directory = (std::filesystem::temp_directory_path() / "dronesim_record").string();
+	std::string command = "RECORD START";
+	for (int i = 1; i < argc; ++i) {
+		std::string opt = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (opt == "--frames" && hasValue) frames = std::max(1, atoi(argv[++i]));
+		else if (opt == "--fps" && hasValue) fps = atof(argv[++i]);
+		else if (opt == "--dir" && hasValue) cfg.directory = argv[++i];
+		else if (opt == "--keep") keep = true;
+		else if (opt == "--writers" && hasValue) command += std::string(" writers=") + argv[++i];
+		else if (opt == "--queue" && hasValue) command += std::string(" queue=") + argv[++i];
+		else if (opt == "--policy" && hasValue) command += std::string(" policy=") + argv[++i];
+		else if (opt == "--codec" && hasValue) command += std::string(" codec=") + argv[++i];
+		else if (opt == "--size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				usage();
+				return 1;
+			}
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+	bool start = false;
+	if (!parseRecordCommand(command, start, cfg)) {
+		usage();
+		return 1;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(cfg.directory, ec);
+	std::string error;
+	if (!startRecording(cfg, error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	auto source = syntheticFrame(width, height);
+	auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(fps > 0.0 ? 1.0 / fps : 0.0));
+	auto begin = Clock::now();
+	double publishMs = 0.0;
+	for (int i = 0; i < frames; ++i) {
+		if (fps > 0.0) std::this_thread::sleep_until(begin + interval * i);
+		auto frame = std::make_shared<CapturedFrame>(*source);
+		frame->timestamp = i;
+		auto t = Clock::now();
+		publishCapturedFrame(std::move(frame));
+		publishMs += std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+	}
+	double offerSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+	RecorderStats stats = stopRecording();
+
+	// every written frame must read back
+	uint64_t readBack = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(cfg.directory)) {
+		DatasetReader reader;
+		if (!reader.open(entry.path().string(), error)) {
+			fprintf(stderr, "%s: %s\n", entry.path().string().c_str(), error.c_str());
+			return 1;
+		}
+		readBack += reader.frameCount();
+	}
+
+	double frameMb = (double)source->color.size() + source->depth.size() * sizeof(float) + source->stencil.size();
+	frameMb /= 1048576.0;
+	printf("%dx%d (%.1f MB/frame), %d writer(s), queue %zu, %s, %s, %s\n", width, height, frameMb, cfg.writers,
+		cfg.queueFrames, cfg.policy == recordBlock ? "block" : cfg.policy == recordDropNewest ? "drop_newest" : "drop_oldest",
+		cfg.codec == datasetRle ? "rle" : "raw", fps > 0.0 ? (std::to_string((int)fps) + " fps").c_str() : "unpaced");
+	printf("offered %llu in %.2f s (%.1f fps), written %llu, dropped %llu, failed %llu, read back %llu\n",
+		(unsigned long long)stats.offered, offerSeconds, stats.offered / offerSeconds, (unsigned long long)stats.written,
+		(unsigned long long)stats.dropped, (unsigned long long)stats.failed, (unsigned long long)readBack);
+	printf("%.1f MB in %llu file(s) over %.2f s: %.1f MB/s, %.1f MB/s per busy writer\n", stats.bytes / 1048576.0,
+		(unsigned long long)stats.files, stats.seconds, stats.mbPerSecond, stats.writeMbPerSecond);
+	printf("max queue depth %zu, capture blocked %.1f ms, publish %.3f ms/frame\n", stats.maxQueueDepth, stats.blockedMs,
+		publishMs / frames);
+	if (!stats.lastError.empty()) printf("last error: %s\n", stats.lastError.c_str());
+
+	if (!keep) std::filesystem::remove_all(cfg.directory, ec);
+	return readBack == stats.written && stats.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "frame.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Synthetic inputs shaped like the game's buffers, so the suite runs without
+// the game or the harness.
+
+// Cheap deterministic noise.
+inline uint32_t benchHash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// Reversed-z depth (near / view depth) of a ground plane under a row of
+// blocks with sky along the top, the stencil's low bits carrying the entity
+// type, RGBA noise for color and a 60 degree perspective projection.
+inline std::shared_ptr<CapturedFrame> syntheticFrame(int width, int height)
+{
+	const float nearPlane = 0.15f;
+	auto frame = std::make_shared<CapturedFrame>();
+	frame->width = frame->colorWidth = width;
+	frame->height = frame->colorHeight = height;
+	frame->depth.resize((size_t)width * height);
+	frame->stencil.resize((size_t)width * height);
+	frame->color.resize((size_t)width * height * 4);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t i = (size_t)y * width + x;
+			float v = (float)y / height;
+			float d;
+			unsigned char s;
+			if (v < 0.3f) {
+				d = 0.0f;
+				s = 7;
+			}
+			else if ((x / 96) % 3 == 0 && v < 0.6f) {
+				d = nearPlane / (20.0f + (x / 96) % 7);
+				s = 3;
+			}
+			else {
+				d = nearPlane / (2.0f + 200.0f * (1.0f - v) * (1.0f - v));
+				s = (x / 40 + y / 40) % 11 == 0 ? 2 : 0;
+			}
+			frame->depth[i] = d;
+			frame->stencil[i] = s | (unsigned char)(benchHash((uint32_t)i) & 0xF0);
+			uint32_t c = benchHash((uint32_t)i * 2654435761u);
+			memcpy(&frame->color[i * 4], &c, 4);
+		}
+	}
+	float f = 1.0f / std::tan(0.5f * 60.0f * 3.14159265f / 180.0f);
+	Eigen::Matrix4f P = Eigen::Matrix4f::Zero();
+	P(0, 0) = f * height / width;
+	P(1, 1) = f;
+	P(2, 3) = nearPlane;
+	P(3, 2) = -1.0f;
+	frame->P = P;
+	frame->V = Eigen::Matrix4f::Identity();
+	frame->matrices.M = frame->matrices.MV = frame->matrices.Vinv = Eigen::Matrix4f::Identity();
+	frame->matrices.MVP = P;
+	return frame;
+}
+
+// Camera matrices of the i-th view of a survey over an area metres square:
+// positions on a 10 m lawnmower grid 30-120 m up, eight yaws per position,
+// looking 30 degrees down through syntheticFrame's projection at 16:9.
+inline rage_matrices syntheticViewMatrices(uint32_t i, float area)
+{
+	const float rad = 3.14159265f / 180.0f;
+	const int perRow = std::max(1, (int)(area / 10.0f));
+	const uint32_t spot = i / 8;
+	const float yaw = (i % 8) * 45.0f + (benchHash(i) % 100) * 0.01f;
+	const float pitch = -30.0f;
+	Eigen::Vector3f position(10.0f * (spot % perRow), 10.0f * ((spot / perRow) % perRow), 30.0f + (benchHash(spot) % 90));
+	Eigen::Vector3f forward(-std::sin(yaw * rad) * std::cos(pitch * rad), std::cos(yaw * rad) * std::cos(pitch * rad),
+		std::sin(pitch * rad));
+	Eigen::Vector3f right = forward.cross(Eigen::Vector3f::UnitZ()).normalized();
+	Eigen::Vector3f up = right.cross(forward);
+	rage_matrices m;
+	m.Vinv = Eigen::Matrix4f::Identity();
+	m.Vinv.block<3, 1>(0, 0) = right;
+	m.Vinv.block<3, 1>(0, 1) = up;
+	m.Vinv.block<3, 1>(0, 2) = -forward;
+	m.Vinv.block<3, 1>(0, 3) = position;
+	m.M = Eigen::Matrix4f::Identity();
+	m.MV = m.Vinv.inverse();
+	const float f = 1.0f / std::tan(30.0f * rad);
+	Eigen::Matrix4f P = Eigen::Matrix4f::Zero();
+	P(0, 0) = f * 9.0f / 16.0f;
+	P(1, 1) = f;
+	P(2, 3) = 0.15f;
+	P(3, 2) = -1.0f;
+	m.MVP = P * m.MV;
+	return m;
+}
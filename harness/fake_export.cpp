@@ -0,0 +1,61 @@
+#include "capture.h"
+#include "fake_renderer.h"
+#include <cstdlib>
+#include <cstring>
+
+// export_get_* over the synthetic renderer's last frame, with the same
+// layouts as the D3D read-back: float depth, one stencil byte and RGBA8 color
+// per pixel.
+extern "C" {
+	int export_get_depth_buffer(void** buf)
+	{
+		FakeFrame& frame = fakeExportFrame();
+		if (frame.depth.empty()) return -1;
+		*buf = frame.depth.data();
+		return (int)(frame.depth.size() * sizeof(float));
+	}
+	int export_get_color_buffer(void** buf)
+	{
+		FakeFrame& frame = fakeExportFrame();
+		if (frame.color.empty()) return -1;
+		*buf = frame.color.data();
+		return (int)frame.color.size();
+	}
+	int export_get_stencil_buffer(void** buf)
+	{
+		FakeFrame& frame = fakeExportFrame();
+		if (frame.stencil.empty()) return -1;
+		*buf = frame.stencil.data();
+		return (int)frame.stencil.size();
+	}
+	int export_get_constant_buffer(rage_matrices* buf)
+	{
+		FakeFrame& frame = fakeExportFrame();
+		if (frame.depth.empty()) return -1;
+		*buf = frame.matrices;
+		return sizeof(rage_matrices);
+	}
+	int export_get_screen_buffer(wchar_t* pictureName)
+	{
+		FakeFrame& frame = fakeExportFrame();
+		if (frame.color.empty()) return 0;
+		char path[256] = { 0 };
+		wcstombs(path, pictureName, sizeof(path) - 1);
+		for (char* c = path; *c; ++c) {
+			if (*c == '\\') *c = '/';
+		}
+		return writeFakeBmp(path, frame) ? 1 : 2;
+	}
+	int export_get_depth_dimensions(int* width, int* height)
+	{
+		FakeFrame& frame = fakeExportFrame();
+		if (frame.width == 0 || frame.height == 0) return -1;
+		*width = frame.width;
+		*height = frame.height;
+		return 1;
+	}
+	int export_get_color_dimensions(int* width, int* height)
+	{
+		return export_get_depth_dimensions(width, height);
+	}
+}
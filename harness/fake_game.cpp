@@ -0,0 +1,283 @@
+#include "fake_game.h"
+#include "fake_renderer.h"
+#include "capture.h"
+#include "latency.h"
+#include "main.h"
+#include "types.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using Eigen::Vector3f;
+
+// Module handle utils.cpp asks GetModuleFileNameA about; the shim ignores it.
+extern "C" {
+	IMAGE_DOS_HEADER __ImageBase = {};
+}
+
+// Thrown out of WAIT once the harness stops the script, like Script Hook V
+// tearing down a script fiber.
+struct FakeScriptStop {};
+
+struct FakeCam {
+	Vector3f position;
+	Vector3f rotation;
+	float fov;
+};
+
+static FakeGameConfig config;
+static std::thread scriptThread;
+static std::atomic<bool> stopRequested(false);
+static std::mutex stats_mtx;
+static FakeGameStats stats;
+
+// Game state, script thread only.
+static std::vector<FakeCam> cams;
+static int renderingCam = 0;		// handle of the camera rendered, 0 = gameplay camera
+static std::string weather = "CLEAR";
+static double clockSeconds = 12.0 * 3600.0;
+static bool clockPaused = false;
+static float timeScale = 1.0f;
+static int frameCount = 0;
+static double gameMs = 0.0;
+static std::chrono::steady_clock::time_point nextFrame;
+static std::string notification;
+
+// Native call in flight: nativeInit, nativePush64..., nativeCall.
+static UINT64 nativeHash = 0;
+static UINT64 args[32];
+static int argCount = 0;
+static UINT64 result[4];
+
+template<typename T>
+static T arg(int i)
+{
+	T v;
+	memcpy(&v, &args[i], sizeof(T));
+	return v;
+}
+
+template<typename T>
+static void ret(const T& v)
+{
+	static_assert(sizeof(T) <= sizeof(result), "native result too large");
+	memcpy(result, &v, sizeof(T));
+}
+
+static void retVector(const Vector3f& v)
+{
+	Vector3 r = {};
+	r.x = v.x();
+	r.y = v.y();
+	r.z = v.z();
+	ret(r);
+}
+
+static FakeCam* camArg(int i)
+{
+	int handle = arg<int>(i);
+	return handle >= 1 && handle <= (int)cams.size() ? &cams[handle - 1] : nullptr;
+}
+
+static const char* stringArg(int i)
+{
+	const char* s = arg<const char*>(i);
+	return s != nullptr ? s : "";
+}
+
+static Vector3f playerOffset(float x, float y, float z)
+{
+	float h = config.playerHeading * 0.01745329f;
+	return config.playerPosition + Vector3f(x * std::cos(h) - y * std::sin(h), x * std::sin(h) + y * std::cos(h), z);
+}
+
+// The natives the plugin calls, by hash. Anything else returns zero.
+static const std::unordered_map<UINT64, void (*)()>& natives()
+{
+	static const std::unordered_map<UINT64, void (*)()> table = {
+		// PLAYER::PLAYER_PED_ID
+		{ 0xD80958FC74E988A6, [] { ret(1); } },
+		// ENTITY::GET_ENTITY_COORDS
+		{ 0x3FEF770D40960D5A, [] { retVector(config.playerPosition); } },
+		// ENTITY::GET_ENTITY_HEADING
+		{ 0xE83D4F9BA2A38914, [] { ret(config.playerHeading); } },
+		// ENTITY::GET_OFFSET_FROM_ENTITY_IN_WORLD_COORDS
+		{ 0x1899F328B0E12848, [] { retVector(playerOffset(arg<float>(1), arg<float>(2), arg<float>(3))); } },
+		// CAM::CREATE_CAM_WITH_PARAMS
+		{ 0xB51194800B257161, [] {
+			cams.push_back({ Vector3f(arg<float>(1), arg<float>(2), arg<float>(3)),
+				Vector3f(arg<float>(4), arg<float>(5), arg<float>(6)), arg<float>(7) });
+			ret((int)cams.size());
+		} },
+		// CAM::RENDER_SCRIPT_CAMS
+		{ 0x07E5B515DB0636FC, [] { renderingCam = arg<BOOL>(0) ? (int)cams.size() : 0; } },
+		// CAM::GET_CAM_COORD
+		{ 0xBAC038F7459AE5AE, [] { if (FakeCam* c = camArg(0)) retVector(c->position); } },
+		// CAM::SET_CAM_COORD
+		{ 0x4D41783FB745E42E, [] { if (FakeCam* c = camArg(0)) c->position = Vector3f(arg<float>(1), arg<float>(2), arg<float>(3)); } },
+		// CAM::GET_CAM_ROT
+		{ 0x7D304C1C955E3E12, [] { if (FakeCam* c = camArg(0)) retVector(c->rotation); } },
+		// CAM::SET_CAM_ROT
+		{ 0x85973643155D0B07, [] { if (FakeCam* c = camArg(0)) c->rotation = Vector3f(arg<float>(1), arg<float>(2), arg<float>(3)); } },
+		// CAM::GET_CAM_FOV
+		{ 0xC3330A45CCCDB26A, [] { if (FakeCam* c = camArg(0)) ret(c->fov); } },
+		// CAM::SET_CAM_FOV
+		{ 0xB13C14F66A00D047, [] { if (FakeCam* c = camArg(0)) c->fov = arg<float>(1); } },
+		// GAMEPLAY::GET_FRAME_COUNT
+		{ 0xFC8202EFC642E6F2, [] { ret(frameCount); } },
+		// GAMEPLAY::SET_TIME_SCALE
+		{ 0x1D408577D440E81E, [] { timeScale = arg<float>(0); } },
+		// GAMEPLAY::SET_WEATHER_TYPE_NOW_PERSIST
+		{ 0xED712CA327900C8A, [] { weather = stringArg(0); } },
+		// GAMEPLAY::SET_WEATHER_TYPE_NOW
+		{ 0x29B487C359E19889, [] { weather = stringArg(0); } },
+		// GAMEPLAY::SET_OVERRIDE_WEATHER
+		{ 0xA43D5C6FE51ADBEF, [] { weather = stringArg(0); } },
+		// GAMEPLAY::CLEAR_OVERRIDE_WEATHER
+		{ 0x338D2E3477711050, [] {} },
+		// GAMEPLAY::CLEAR_WEATHER_TYPE_PERSIST
+		{ 0xCCC39339BEF76CF5, [] {} },
+		// GAMEPLAY::UPDATE_ONSCREEN_KEYBOARD: 2 = cancelled, there is nobody to type
+		{ 0x0CF2B696BBF945AE, [] { ret(2); } },
+		// GAMEPLAY::GET_ONSCREEN_KEYBOARD_RESULT
+		{ 0x8362B09B91893647, [] { static char empty[1] = { 0 }; ret(empty); } },
+		// GAMEPLAY::IS_STRING_NULL_OR_EMPTY
+		{ 0xCA042B6957743895, [] { ret((BOOL)(*stringArg(0) == 0)); } },
+		// TIME::PAUSE_CLOCK
+		{ 0x4055E40BD2DBEC1D, [] { clockPaused = arg<BOOL>(0) != 0; } },
+		// TIME::SET_CLOCK_TIME
+		{ 0x47C3B5848C3E45D8, [] { clockSeconds = arg<int>(0) * 3600.0 + arg<int>(1) * 60.0 + arg<int>(2); } },
+		// TIME::GET_CLOCK_HOURS / GET_CLOCK_MINUTES / GET_CLOCK_SECONDS
+		{ 0x25223CA6B4D20B7F, [] { ret((int)(clockSeconds / 3600.0)); } },
+		{ 0x13D2B8ADD79640F2, [] { ret((int)std::fmod(clockSeconds / 60.0, 60.0)); } },
+		{ 0x494E97C2EF27C470, [] { ret((int)std::fmod(clockSeconds, 60.0)); } },
+		// UI::_SET_NOTIFICATION_TEXT_ENTRY / _ADD_TEXT_COMPONENT_STRING / _DRAW_NOTIFICATION
+		{ 0x202709F4C58A0424, [] { notification.clear(); } },
+		{ 0x6C188BE134E074AA, [] { notification += stringArg(0); } },
+		{ 0x2ED7843F8F801023, [] { if (config.verbose) printf("[notification] %s\n", notification.c_str()); } },
+	};
+	return table;
+}
+
+void nativeInit(UINT64 hash)
+{
+	nativeHash = hash;
+	argCount = 0;
+}
+
+void nativePush64(UINT64 val)
+{
+	if (argCount < 32) args[argCount++] = val;
+}
+
+PUINT64 nativeCall()
+{
+	memset(result, 0, sizeof(result));
+	auto it = natives().find(nativeHash);
+	if (it != natives().end()) {
+		it->second();
+	}
+	else {
+		std::lock_guard<std::mutex> lk(stats_mtx);
+		stats.unknownNatives++;
+	}
+	return result;
+}
+
+// One game frame: advance the clock, and if a capture is armed render the
+// scripted camera's view and store it the way the D3D hooks do.
+static void renderGameFrame()
+{
+	const double frameMs = 1000.0 / (config.fps > 0.0 ? config.fps : 60.0);
+	if (!clockPaused) {
+		// the game clock runs one minute per two real seconds
+		clockSeconds = std::fmod(clockSeconds + frameMs * 0.03 * timeScale, 86400.0);
+	}
+	gameMs += frameMs;
+	++frameCount;
+
+	if (cmdToCatch == catchStart) {
+		auto start = std::chrono::steady_clock::now();
+		FakeView view;
+		view.width = config.width;
+		view.height = config.height;
+		view.weather = weather;
+		view.hour = (float)(clockSeconds / 3600.0);
+		if (renderingCam >= 1 && renderingCam <= (int)cams.size()) {
+			const FakeCam& cam = cams[renderingCam - 1];
+			view.position = cam.position;
+			view.rotation = cam.rotation;
+			view.fov = cam.fov;
+		}
+		else {
+			view.position = config.playerPosition + Vector3f(0.0f, 0.0f, 1.6f);
+			view.rotation = Vector3f(0.0f, 0.0f, config.playerHeading);
+		}
+		markCaptureStage(stageCopyIssued);
+		renderFakeFrame(view, fakeExportFrame());
+		markCaptureStage(stageMapComplete);
+		static wchar_t imgPath[] = L"data/screen.bmp";
+		FILE* log = fopen("logs/harness.log", "a");
+		completeCapture(imgPath, "data/stencil.raw", "data/depth.raw", log != nullptr ? log : stderr);
+		if (log != nullptr) fclose(log);
+		std::lock_guard<std::mutex> lk(stats_mtx);
+		stats.captures++;
+		stats.captureMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	{
+		std::lock_guard<std::mutex> lk(stats_mtx);
+		stats.frames++;
+	}
+
+	if (config.fps > 0.0) {
+		auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / config.fps));
+		auto now = std::chrono::steady_clock::now();
+		nextFrame = now - nextFrame > period ? now + period : nextFrame + period;
+		std::this_thread::sleep_until(nextFrame);
+	}
+}
+
+void scriptWait(DWORD time)
+{
+	if (stopRequested) throw FakeScriptStop();
+	const double until = gameMs + time;
+	do {
+		renderGameFrame();
+	} while (gameMs < until && !stopRequested);
+	if (stopRequested) throw FakeScriptStop();
+}
+
+void configureFakeGame(const FakeGameConfig& cfg)
+{
+	config = cfg;
+}
+
+void startFakeScript(void (*scriptMain)())
+{
+	stopRequested = false;
+	nextFrame = std::chrono::steady_clock::now();
+	scriptThread = std::thread([scriptMain] {
+		try {
+			scriptMain();
+		}
+		catch (const FakeScriptStop&) {
+		}
+	});
+}
+
+void stopFakeScript()
+{
+	stopRequested = true;
+	if (scriptThread.joinable()) scriptThread.join();
+}
+
+FakeGameStats fakeGameStats()
+{
+	std::lock_guard<std::mutex> lk(stats_mtx);
+	return stats;
+}
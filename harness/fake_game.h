@@ -0,0 +1,32 @@
+#pragma once
+#include <Eigen/Core>
+#include <string>
+
+// Fake Script Hook V runtime: implements the SDK entry points (nativeInit /
+// nativePush64 / nativeCall, scriptWait, scriptRegister, ...) against a small
+// simulated game state, so the plugin's script thread runs unchanged. Each
+// WAIT renders at least one game frame; a frame with a capture requested is
+// ray cast by the synthetic renderer and handed to completeCapture, as the
+// D3D hooks do in the game.
+struct FakeGameConfig {
+	int width = 1280;
+	int height = 720;
+	double fps = 60.0;		// frame pacing; 0 runs frames back to back
+	Eigen::Vector3f playerPosition = Eigen::Vector3f(20.0f, 20.0f, 1.0f);
+	float playerHeading = 0.0f;
+	bool verbose = false;	// echo on-screen notifications to stdout
+};
+
+struct FakeGameStats {
+	unsigned long long frames = 0;
+	unsigned long long captures = 0;
+	double captureMs = 0.0;		// total time spent rendering and storing captures
+	unsigned long long unknownNatives = 0;
+};
+
+void configureFakeGame(const FakeGameConfig& cfg);
+// Runs scriptMain on its own thread, as Script Hook V runs registered scripts.
+void startFakeScript(void (*scriptMain)());
+// Makes the script's next WAIT return to the harness and joins its thread.
+void stopFakeScript();
+FakeGameStats fakeGameStats();
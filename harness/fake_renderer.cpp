@@ -0,0 +1,271 @@
+#include "fake_renderer.h"
+#include "parallel.h"
+#include "rig.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+
+using Eigen::Matrix3f;
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+
+static const float cellSize = 40.0f;		// one city block, street along its low x and y edges
+static const float streetWidth = 6.0f;
+static const float nearClip = 0.15f;
+static const float maxDistance = 2000.0f;
+static const float PI_F = 3.14159265f;
+
+struct Box {
+	Vector3f lo, hi;
+	Vector3f albedo;
+	unsigned char stencil;
+};
+
+struct Hit {
+	float t = std::numeric_limits<float>::infinity();
+	Vector3f normal = Vector3f::UnitZ();
+	Vector3f albedo = Vector3f::Zero();
+	unsigned char stencil = fakeStencilSky;
+};
+
+static uint32_t hashCell(int i, int j, uint32_t salt)
+{
+	uint32_t h = (uint32_t)i * 73856093u ^ (uint32_t)j * 19349663u ^ salt * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return h;
+}
+
+static float unit(uint32_t h)
+{
+	return (h & 0xffffff) / float(0x1000000);
+}
+
+// Contents of block (i, j): most blocks hold a building, some streets a car.
+static int cellBoxes(int i, int j, Box out[2])
+{
+	int n = 0;
+	const float x0 = i * cellSize, y0 = j * cellSize;
+	if (hashCell(i, j, 1) % 4 != 0) {
+		float hx = 5.0f + 9.0f * unit(hashCell(i, j, 2));
+		float hy = 5.0f + 9.0f * unit(hashCell(i, j, 3));
+		float r = unit(hashCell(i, j, 4));
+		float height = 8.0f + 52.0f * r * r;
+		float room = 0.5f * (cellSize - streetWidth) - 1.0f;
+		float cx = x0 + streetWidth + 0.5f * (cellSize - streetWidth) + (unit(hashCell(i, j, 6)) - 0.5f) * 2.0f * (room - hx);
+		float cy = y0 + streetWidth + 0.5f * (cellSize - streetWidth) + (unit(hashCell(i, j, 7)) - 0.5f) * 2.0f * (room - hy);
+		float shade = 0.45f + 0.4f * unit(hashCell(i, j, 8));
+		out[n++] = { Vector3f(cx - hx, cy - hy, 0.0f), Vector3f(cx + hx, cy + hy, height),
+			Vector3f(shade, shade * 0.95f, shade * 0.85f), fakeStencilBuilding };
+	}
+	if (hashCell(i, j, 5) % 3 == 0) {
+		float y = y0 + streetWidth + unit(hashCell(i, j, 9)) * (cellSize - streetWidth - 4.5f);
+		bool red = hashCell(i, j, 10) & 1;
+		out[n++] = { Vector3f(x0 + 1.5f, y, 0.0f), Vector3f(x0 + 3.5f, y + 4.5f, 1.5f),
+			red ? Vector3f(0.7f, 0.1f, 0.1f) : Vector3f(0.1f, 0.2f, 0.7f), fakeStencilVehicle };
+	}
+	return n;
+}
+
+static void intersectBox(const Box& box, const Vector3f& o, const Vector3f& d, Hit& hit)
+{
+	float t0 = 0.0f, t1 = hit.t;
+	int axis = -1;
+	for (int a = 0; a < 3; ++a) {
+		if (std::fabs(d[a]) < 1e-12f) {
+			if (o[a] < box.lo[a] || o[a] > box.hi[a]) return;
+			continue;
+		}
+		float inv = 1.0f / d[a];
+		float n = (box.lo[a] - o[a]) * inv, f = (box.hi[a] - o[a]) * inv;
+		if (n > f) std::swap(n, f);
+		if (n > t0) {
+			t0 = n;
+			axis = a;
+		}
+		t1 = std::min(t1, f);
+		if (t0 > t1) return;
+	}
+	if (axis < 0) return;	// starts inside the box
+	hit.t = t0;
+	hit.normal = Vector3f::Zero();
+	hit.normal[axis] = d[axis] > 0.0f ? -1.0f : 1.0f;
+	hit.albedo = box.albedo;
+	hit.stencil = box.stencil;
+}
+
+static void traceRay(const Vector3f& o, const Vector3f& d, Hit& hit)
+{
+	if (d.z() < 0.0f && o.z() > 0.0f) {
+		hit.t = -o.z() / d.z();
+		hit.normal = Vector3f::UnitZ();
+		Vector3f p = o + d * hit.t;
+		float sx = p.x() - std::floor(p.x() / cellSize) * cellSize;
+		float sy = p.y() - std::floor(p.y() / cellSize) * cellSize;
+		if (sx < streetWidth || sy < streetWidth) {
+			hit.albedo = Vector3f(0.22f, 0.22f, 0.24f);
+		}
+		else {
+			bool checker = ((int)std::floor(p.x() / 5.0f) + (int)std::floor(p.y() / 5.0f)) & 1;
+			hit.albedo = checker ? Vector3f(0.30f, 0.45f, 0.22f) : Vector3f(0.36f, 0.52f, 0.26f);
+		}
+		hit.stencil = fakeStencilGround;
+	}
+	float tEnd = std::min(hit.t, maxDistance);
+
+	// walk the blocks under the ray (2D DDA), nearest first
+	int i = (int)std::floor(o.x() / cellSize), j = (int)std::floor(o.y() / cellSize);
+	int si = d.x() > 0.0f ? 1 : -1, sj = d.y() > 0.0f ? 1 : -1;
+	float dtx = std::fabs(d.x()) > 1e-12f ? cellSize / std::fabs(d.x()) : std::numeric_limits<float>::infinity();
+	float dty = std::fabs(d.y()) > 1e-12f ? cellSize / std::fabs(d.y()) : std::numeric_limits<float>::infinity();
+	float tx = std::fabs(d.x()) > 1e-12f ? ((si > 0 ? (i + 1) * cellSize : i * cellSize) - o.x()) / d.x() : std::numeric_limits<float>::infinity();
+	float ty = std::fabs(d.y()) > 1e-12f ? ((sj > 0 ? (j + 1) * cellSize : j * cellSize) - o.y()) / d.y() : std::numeric_limits<float>::infinity();
+	float tCell = 0.0f;
+	Box boxes[2];
+	while (tCell < tEnd) {
+		int n = cellBoxes(i, j, boxes);
+		for (int k = 0; k < n; ++k) intersectBox(boxes[k], o, d, hit);
+		float tNext = std::min(tx, ty);
+		if (hit.t <= tNext) break;
+		tCell = tNext;
+		if (tx < ty) {
+			i += si;
+			tx += dtx;
+		}
+		else {
+			j += sj;
+			ty += dty;
+		}
+	}
+	if (hit.t > maxDistance) hit = Hit();
+}
+
+// Direct sun scale and fog density (1/m) per weather type.
+static void weatherTerms(const std::string& weather, float& sun, float& fog)
+{
+	sun = 1.0f;
+	fog = 0.0015f;
+	if (weather == "CLOUDS" || weather == "SMOG" || weather == "CLEARING") sun = 0.6f;
+	else if (weather == "OVERCAST" || weather == "SNOWLIGHT") sun = 0.35f;
+	else if (weather == "RAIN" || weather == "THUNDER" || weather == "SNOW" || weather == "BLIZZARD") sun = 0.2f;
+	else if (weather == "FOGGY") sun = 0.4f;
+	if (weather == "FOGGY") fog = 0.02f;
+	else if (weather == "RAIN" || weather == "SNOW") fog = 0.006f;
+	else if (weather == "THUNDER" || weather == "BLIZZARD") fog = 0.01f;
+	else if (weather == "SMOG") fog = 0.004f;
+}
+
+void renderFakeFrame(const FakeView& view, FakeFrame& frame)
+{
+	const int w = view.width, h = view.height;
+	const size_t n = (size_t)w * h;
+	frame.width = w;
+	frame.height = h;
+	frame.depth.resize(n);
+	frame.stencil.resize(n);
+	frame.color.resize(n * 4);
+
+	const Matrix3f R = rigRotation(view.rotation);
+	const Vector3f right = R.col(0), forward = R.col(1), up = R.col(2);
+	const float f = 1.0f / std::tan(0.5f * view.fov * PI_F / 180.0f);
+	const float aspect = (float)w / h;
+
+	Matrix4f Vinv = Matrix4f::Identity();
+	Vinv.block<3, 1>(0, 0) = right;
+	Vinv.block<3, 1>(0, 1) = up;
+	Vinv.block<3, 1>(0, 2) = -forward;
+	Vinv.block<3, 1>(0, 3) = view.position;
+	Matrix4f P = Matrix4f::Zero();
+	P(0, 0) = f / aspect;
+	P(1, 1) = f;
+	P(2, 3) = nearClip;
+	P(3, 2) = -1.0f;
+	frame.matrices.M = Matrix4f::Identity();
+	frame.matrices.Vinv = Vinv;
+	frame.matrices.MV = Vinv.inverse();
+	frame.matrices.MVP = P * frame.matrices.MV;
+
+	// sun rises at 6:00 in the east and sets at 18:00 in the west
+	const float angle = (view.hour - 6.0f) / 12.0f * PI_F;
+	const Vector3f sunDir = Vector3f(std::cos(angle), 0.3f, std::sin(angle)).normalized();
+	const float daylight = std::min(std::max(std::sin(angle) * 3.0f, 0.0f), 1.0f);
+	float sunScale, fog;
+	weatherTerms(view.weather, sunScale, fog);
+	const float sun = daylight * sunScale;
+	const float ambient = 0.08f + 0.3f * daylight;
+	const Vector3f clearSky(0.45f, 0.65f, 0.95f), greySky(0.6f, 0.62f, 0.65f), nightSky(0.02f, 0.03f, 0.08f);
+	const Vector3f sky = nightSky + daylight * ((1.0f - sunScale) * greySky + sunScale * clearSky - nightSky);
+
+	parallelFor(0, h, [&](int y0, int y1) {
+		for (int y = y0; y < y1; ++y) {
+			const float ny = 1.0f - (y + 0.5f) * 2.0f / h;
+			for (int x = 0; x < w; ++x) {
+				const float nx = (x + 0.5f) * 2.0f / w - 1.0f;
+				// camera-space direction with z = -1, so the ray parameter is the view depth
+				Vector3f d = right * (nx * aspect / f) + up * (ny / f) + forward;
+				Hit hit;
+				traceRay(view.position, d, hit);
+				size_t i = (size_t)y * w + x;
+				Vector3f c;
+				if (hit.stencil == fakeStencilSky) {
+					frame.depth[i] = 0.0f;
+					c = sky;
+				}
+				else {
+					frame.depth[i] = nearClip / hit.t;
+					float lambert = std::max(hit.normal.dot(sunDir), 0.0f);
+					c = hit.albedo * (ambient + sun * lambert);
+					float haze = 1.0f - std::exp(-fog * hit.t * d.norm());
+					c = c + haze * (sky - c);
+				}
+				frame.stencil[i] = hit.stencil;
+				unsigned char* p = &frame.color[i * 4];
+				for (int k = 0; k < 3; ++k) p[k] = (unsigned char)std::lround(std::min(std::max(c[k], 0.0f), 1.0f) * 255.0f);
+				p[3] = 255;
+			}
+		}
+	});
+}
+
+bool writeFakeBmp(const std::string& path, const FakeFrame& frame)
+{
+	FILE* f = fopen(path.c_str(), "wb");
+	if (f == nullptr) return false;
+	const int w = frame.width, h = frame.height;
+	const int rowBytes = (w * 3 + 3) & ~3;
+	const uint32_t dataSize = (uint32_t)rowBytes * h;
+	unsigned char header[54] = { 'B', 'M' };
+	auto put32 = [&](int offset, uint32_t v) {
+		for (int k = 0; k < 4; ++k) header[offset + k] = (unsigned char)(v >> (8 * k));
+	};
+	put32(2, 54 + dataSize);
+	put32(10, 54);
+	put32(14, 40);
+	put32(18, (uint32_t)w);
+	put32(22, (uint32_t)h);
+	header[26] = 1;
+	header[28] = 24;
+	put32(34, dataSize);
+	fwrite(header, 1, sizeof(header), f);
+	std::vector<unsigned char> row(rowBytes, 0);
+	for (int y = h - 1; y >= 0; --y) {
+		const unsigned char* src = &frame.color[(size_t)y * w * 4];
+		for (int x = 0; x < w; ++x) {
+			row[x * 3 + 0] = src[x * 4 + 2];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 0];
+		}
+		fwrite(row.data(), 1, row.size(), f);
+	}
+	fclose(f);
+	return true;
+}
+
+FakeFrame& fakeExportFrame()
+{
+	static FakeFrame frame;
+	return frame;
+}
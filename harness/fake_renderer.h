@@ -0,0 +1,46 @@
+#pragma once
+#include "frame.h"
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// Synthetic stand-in for the game's renderer: ray casts an analytic city
+// (ground plane, a grid of box buildings and car-sized boxes) from the
+// scripted camera and fills the same buffers the D3D hooks read back.
+// Depth is reversed-z with an infinite far plane (sky = 0), stencil carries
+// the entity type in its low bits, color is RGBA8, and the matrices follow
+// the game's convention (camera looks down -z, M = identity).
+struct FakeView {
+	Eigen::Vector3f position = Eigen::Vector3f::Zero();
+	Eigen::Vector3f rotation = Eigen::Vector3f::Zero();	// pitch, roll, yaw (degrees)
+	float fov = 50.0f;									// vertical, degrees
+	int width = 1280;
+	int height = 720;
+	std::string weather = "CLEAR";
+	float hour = 12.0f;									// clock, fractional hours
+};
+
+struct FakeFrame {
+	int width = 0;
+	int height = 0;
+	std::vector<float> depth;
+	std::vector<unsigned char> stencil;
+	std::vector<unsigned char> color;
+	rage_matrices matrices;
+};
+
+// Stencil values written for each kind of surface.
+enum FakeStencil : unsigned char {
+	fakeStencilGround = 0,
+	fakeStencilVehicle = 2,
+	fakeStencilBuilding = 3,
+	fakeStencilSky = 7,
+};
+
+void renderFakeFrame(const FakeView& view, FakeFrame& frame);
+
+// The frame's color as a 24-bit BMP, as the plugin's screenshot is sent.
+bool writeFakeBmp(const std::string& path, const FakeFrame& frame);
+
+// Frame the harness' export_get_* functions read from.
+FakeFrame& fakeExportFrame();
@@ -0,0 +1,97 @@
+// Headless DroneSim: runs scriptMain and the ModServer against the fake
+// Script Hook V runtime and renderer, so clients can connect on port 12345
+// exactly as they would to the game.
+//
+//   dronesim_harness [--frames N] [--seconds S] [--fps F] [--size WxH]
+//                    [--workdir DIR] [--verbose]
+#include "fake_game.h"
+#include "script.h"
+#include "server.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+static std::atomic<bool> interrupted(false);
+
+static void onSignal(int)
+{
+	interrupted = true;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: dronesim_harness [--frames N] [--seconds S] [--fps F] [--size WxH] [--workdir DIR] [--verbose]\n");
+}
+
+int main(int argc, char** argv)
+{
+	FakeGameConfig config;
+	unsigned long long maxFrames = 0;
+	double maxSeconds = 0.0;
+	std::string workdir = ".";
+
+	for (int i = 1; i < argc; ++i) {
+		std::string opt = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (opt == "--frames" && hasValue) maxFrames = strtoull(argv[++i], nullptr, 10);
+		else if (opt == "--seconds" && hasValue) maxSeconds = atof(argv[++i]);
+		else if (opt == "--fps" && hasValue) config.fps = atof(argv[++i]);
+		else if (opt == "--size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &config.width, &config.height) != 2 || config.width <= 0 || config.height <= 0) {
+				usage();
+				return 2;
+			}
+		}
+		else if (opt == "--workdir" && hasValue) workdir = argv[++i];
+		else if (opt == "--verbose") config.verbose = true;
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	// The plugin writes logs\ and data\ relative to the game directory.
+	std::error_code ec;
+	std::filesystem::create_directories(workdir, ec);
+	std::filesystem::current_path(workdir, ec);
+	if (ec) {
+		fprintf(stderr, "cannot use work directory %s: %s\n", workdir.c_str(), ec.message().c_str());
+		return 1;
+	}
+	std::filesystem::create_directories("logs");
+	std::filesystem::create_directories("data");
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	configureFakeGame(config);
+	auto start = std::chrono::steady_clock::now();
+	startFakeScript(scriptMain);
+	printf("DroneSim harness running at %dx%d, ModServer on port 12345\n", config.width, config.height);
+	fflush(stdout);
+
+	while (!interrupted) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (maxSeconds > 0.0 && elapsed >= maxSeconds) break;
+		if (maxFrames > 0 && fakeGameStats().frames >= maxFrames) break;
+	}
+
+	stopFakeScript();
+	ShutdownModServer();
+
+	FakeGameStats stats = fakeGameStats();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("frames %llu in %.2f s (%.1f fps), captures %llu (%.2f ms avg), unknown natives %llu\n",
+		stats.frames, elapsed, elapsed > 0.0 ? stats.frames / elapsed : 0.0, stats.captures,
+		stats.captures > 0 ? stats.captureMs / stats.captures : 0.0, stats.unknownNatives);
+	fflush(stdout);
+	// The server thread is detached and may still be unwinding; skip static
+	// destructors it could be using.
+	std::quick_exit(0);
+}
@@ -0,0 +1,51 @@
+#pragma once
+// Stand-in for the few Win32 declarations the plugin sources and the Script
+// Hook V SDK headers use, so they compile unchanged on Linux.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#define __declspec(x)
+#define __stdcall
+#define _stdcall
+
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t BYTE;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef int INT;
+typedef uint64_t UINT64;
+typedef uint64_t* PUINT64;
+typedef char* LPSTR;
+typedef void* LPVOID;
+typedef void* HMODULE;
+typedef wchar_t WCHAR;
+typedef long HRESULT;
+
+#define TRUE 1
+#define FALSE 0
+#define MAXDWORD 0xffffffffu
+#define MAX_PATH 260
+
+typedef struct {
+	WORD e_magic;
+} IMAGE_DOS_HEADER;
+
+// Opens with Windows separators mapped to '/', so "logs\\x.log" lands in logs/.
+inline int fopen_s(FILE** fp, const char* path, const char* mode)
+{
+	std::string p(path);
+	for (char& c : p) {
+		if (c == '\\') c = '/';
+	}
+	*fp = fopen(p.c_str(), mode);
+	return *fp == nullptr ? 1 : 0;
+}
+
+inline DWORD GetModuleFileNameA(HMODULE, char* path, DWORD size)
+{
+	snprintf(path, size, "./dronesim_harness");
+	return (DWORD)strlen(path);
+}
@@ -1,4 +1,5 @@
 import socket
+import json
 import struct
 import numpy as np
 from PIL import Image
@@ -20,6 +21,14 @@ def ensure_record_dir_exists():
         os.makedirs("record")
         print("已创建 'record' 文件夹。")
 
+def encode_command(command: str) -> bytes:
+    """
+    命令帧：4 字节小端长度 + 命令文本（与回复格式相同）。服务器读满长度为止，
+    TRAJECTORY 等长命令被拆成多个 TCP 段也不会被截断。
+    """
+    data = command.encode('utf-8')
+    return struct.pack('<I', len(data)) + data
+
 def send_camera_command(command: str):
     """
     连接服务器，发送单个相机控制指令，然后关闭连接。
@@ -29,7 +38,7 @@ def send_camera_command(command: str):
         with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
             s.connect((HOST, PORT))
             print(f"正在发送相机控制指令: '{command}'")
-            s.sendall(command.encode('utf-8'))
+            s.sendall(encode_command(command))
             print(f"指令 '{command}' 已发送。")
             
     except ConnectionRefusedError:
@@ -37,29 +46,71 @@ def send_camera_command(command: str):
     except Exception as e:
         print(f"发送命令时发生错误: {e}")
 
-def get_data_from_server(command: str):
+CHANNEL_DTYPES = {
+    'NRML': (np.float32, 3),
+    'EDGE': (np.uint8, 1),
+    'FLOW': (np.float32, 2),
+    'FVAL': (np.uint8, 1),
+    'STEN': (np.uint8, 1),
+    'SEMA': (np.uint8, 1),
+    'RGBA': (np.uint8, 4),
+    'DPTH': (np.float32, 1),
+}
+
+INSTANCE_DTYPE = np.dtype([('id', '<u4'), ('class_id', 'u1'), ('reserved', 'u1', 3),
+                           ('x0', '<u2'), ('y0', '<u2'), ('x1', '<u2'), ('y1', '<u2'),
+                           ('area', '<u4'), ('median_depth', '<f4')])
+
+def parse_capture_channels(data, offset):
+    """
+    解析 CAPTURE 回复末尾追加的派生通道。
+    每个通道为：TAG(4字节) + WIDTH(4字节) + HEIGHT(4字节) + SIZE(4字节) + DATA。
+    """
+    channels = {}
+    while offset + 16 <= len(data):
+        tag = data[offset:offset + 4].decode('ascii')
+        width, height, size = struct.unpack('<III', data[offset + 4:offset + 16])
+        offset += 16
+        payload = data[offset:offset + size]
+        offset += size
+        if tag == 'INST':
+            channels[tag] = np.frombuffer(payload, dtype=INSTANCE_DTYPE)
+            continue
+        if tag in ('SCLS', 'META'):
+            channels[tag] = json.loads(payload.decode('ascii'))
+            continue
+        dtype, depth = CHANNEL_DTYPES.get(tag, (np.uint8, None))
+        array = np.frombuffer(payload, dtype=dtype)
+        if depth is not None:
+            array = array.reshape((height, width, depth) if depth > 1 else (height, width))
+        channels[tag] = array
+    return channels
+
+def get_data_from_server(command: str, return_channels=False):
     """
     连接服务器，发送指令，接收合并的RGB和深度数据。
-    数据格式为：TOTAL_LENGTH(4字节) + RGB_SIZE(4字节) + DEPTH_SIZE(4字节) + RGB_DATA + DEPTH_DATA。
+    数据格式为：TOTAL_LENGTH(4字节) + RGB_SIZE(4字节) + DEPTH_SIZE(4字节) + RGB_DATA + DEPTH_DATA [+ 派生通道]。
+    return_channels 为 True 时额外返回派生通道字典，例如 get_data_from_server("CAPTURE NORMALS EDGES", True)。
     """
+    failure = (None, None, {}) if return_channels else (None, None)
     try:
         with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
             s.connect((HOST, PORT))
             print(f"\n正在发送数据获取指令: '{command}'")
 
-            s.sendall(command.encode('utf-8'))
+            s.sendall(encode_command(command))
             
             # 首先接收总数据长度
             total_length_bytes = s.recv(4)
             if not total_length_bytes:
                 print("未接收到总数据长度信息，服务器可能已关闭连接。")
-                return None, None
+                return failure
             total_data_length = struct.unpack('<I', total_length_bytes)[0]
             print(f"接收到总数据长度信息: {total_data_length} 字节。")
 
             if total_data_length == 0:
                 print("接收到的总数据长度为0。")
-                return None, None
+                return failure
 
             # 接收所有合并的数据
             combined_data = b""
@@ -68,10 +119,13 @@ def get_data_from_server(command: str):
                 chunk = s.recv(min(4096, remaining_bytes))
                 if not chunk:
                     print("服务器在数据传输完成前断开连接。")
-                    return None, None
+                    return failure
                 combined_data += chunk
             
             print(f"成功接收到所有合并数据，共 {len(combined_data)} 字节。")
+            if combined_data.startswith(b"ERROR"):
+                print(f"服务器返回错误: {combined_data.decode(errors='replace')}")
+                return failure
 
             # 从合并数据中解析RGB和深度数据
             offset = 0
@@ -83,16 +137,19 @@ def get_data_from_server(command: str):
             rgb_data = combined_data[offset : offset + rgb_data_length]
             offset += rgb_data_length
             depth_data = combined_data[offset : offset + depth_data_length]
+            offset += depth_data_length
 
             print(f"解析出RGB数据长度: {len(rgb_data)} 字节，深度数据长度: {len(depth_data)} 字节。")
-            
+
+            if return_channels:
+                return rgb_data, depth_data, parse_capture_channels(combined_data, offset)
             return rgb_data, depth_data
 
     except ConnectionRefusedError:
         print("连接失败。请确保C++服务器正在运行并监听正确的IP和端口。")
     except Exception as e:
         print(f"发生错误: {e}")
-    return None, None
+    return failure
 
 def save_rgb_image(image_data, filename=None):
     """
@@ -148,7 +205,7 @@ def get_string_from_server(command: str):
             s.connect((HOST, PORT))
             print(f"\n正在发送字符串获取指令: '{command}'")
 
-            s.sendall(command.encode('utf-8'))
+            s.sendall(encode_command(command))
 
             # 接收响应字符串的长度
             length_bytes = s.recv(4)
@@ -182,6 +239,435 @@ def get_string_from_server(command: str):
         print(f"发生错误: {e}")
     return None
 
+def set_pose(x, y, z, pitch=0.0, roll=0.0, yaw=0.0, fov=None):
+    """
+    一次性设置相机的绝对位姿（世界坐标，单位米/度），在一个脚本帧内生效。
+    fov 为 None 时保持当前视场角。
+    """
+    command = f"SET_POSE {x} {y} {z} {pitch} {roll} {yaw}"
+    if fov is not None:
+        command += f" {fov}"
+    send_camera_command(command)
+
+def get_pose():
+    """
+    读取游戏中相机的真实位姿，返回 (x, y, z, pitch, roll, yaw, fov)，失败时返回 None。
+    """
+    response = get_string_from_server("GET_POSE")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return tuple(float(v) for v in response.split())
+
+def get_command_stats():
+    """
+    读取脚本线程的命令处理统计：每帧命令数、位姿命令合并为几次相机写入、捕获屏障次数等，返回字典。
+    """
+    response = get_string_from_server("CMD_STATS")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def play_trajectory(keys, duration, captures=()):
+    """
+    上传一条相机轨迹并开始回放。keys 为 (x, y, z, pitch, roll, yaw) 控制位姿列表，
+    duration 为总时长（秒），captures 为沿弧长的路径参数 [0, 1]，到达时自动捕获。
+    """
+    command = f"TRAJECTORY {duration} " + " ".join(" ".join(str(v) for v in key) for key in keys)
+    if captures:
+        command += " CAPTURE " + " ".join(str(s) for s in captures)
+    send_camera_command(command)
+
+def lockstep(on=True, settle=3, advance=0):
+    """
+    开启/关闭锁步模式。开启后世界时间冻结；每一步先摆位姿、等待 settle 帧稳定、捕获，
+    再让世界前进 advance 帧后重新冻结（advance=0 时世界始终静止）。
+    """
+    send_camera_command(f"LOCKSTEP ON settle={settle} advance={advance}" if on else "LOCKSTEP OFF")
+
+def get_lockstep_stats():
+    """
+    读取锁步模式统计：步数、每步耗时（稳定、捕获、总计，毫秒）与每分钟步数，返回字典。
+    """
+    response = get_string_from_server("LOCKSTEP_STATS")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def get_latency_stats():
+    """
+    读取捕获延迟统计：各阶段（出队、位姿、拷贝、映射、解包、编码、发送）耗时直方图，
+    端到端耗时，以及最近一次送达帧的阶段时间线（微秒），返回字典。
+    """
+    response = get_string_from_server("LATENCY_STATS")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def get_stats():
+    """
+    读取运行指标快照：计数器（连接、命令、发送字节、错误、丢弃）、仪表（队列深度）
+    与延迟直方图（脚本帧、捕获、发送、D3D 钩子开销，微秒），返回字典。
+    """
+    response = get_string_from_server("STATS")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def set_stats_log(path, interval=10.0):
+    """
+    让服务器每隔 interval 秒把 STATS 快照追加一行到 path（相对游戏目录）；path 为 None 时停止。
+    """
+    command = "STATS_LOG OFF" if path is None else f"STATS_LOG {path} interval={interval}"
+    return get_string_from_server(command) == "OK"
+
+def start_recording(directory="record", writers=2, queue=32, policy="drop_oldest", codec="raw", segment_mb=4096):
+    """
+    开始录制：之后捕获的每一帧由服务器的写线程直接写入 directory（相对游戏目录）下的 .dsq 文件，
+    每个写线程一个文件，可用 dataset.Dataset 读取。队列满时按 policy（block / drop_newest / drop_oldest）处理，
+    codec 为 raw 或 rle。成功返回 True。
+    """
+    command = (f"RECORD START dir={directory} writers={writers} queue={queue} policy={policy}"
+               f" codec={codec} segment_mb={segment_mb}")
+    return get_string_from_server(command) == "OK"
+
+def stop_recording():
+    """
+    停止录制，等待队列写完并关闭文件，返回最终统计字典（帧数、丢帧、字节数、MB/s）。
+    """
+    response = get_string_from_server("RECORD STOP")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def get_recording_stats():
+    """
+    读取当前录制的统计：已写入与丢弃的帧数、队列深度、写入速度等，返回字典。
+    """
+    response = get_string_from_server("RECORD_STATS")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def lockstep_step(x, y, z, pitch=0.0, roll=0.0, yaw=0.0, fov=None, timeout=10.0, channels=""):
+    """
+    锁步模式下执行一步：摆到给定位姿、等待稳定、捕获，完成后取回该帧。
+    channels 为附加的 CAPTURE 选项，例如 "NORMALS STENCIL"。
+    """
+    before = get_lockstep_stats()
+    steps = before['steps'] if before else 0
+    command = f"STEP {x} {y} {z} {pitch} {roll} {yaw}"
+    if fov is not None:
+        command += f" {fov}"
+    send_camera_command(command)
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        stats = get_lockstep_stats()
+        if stats and stats['steps'] > steps:
+            return get_data_from_server(("CAPTURE " + channels).strip(), return_channels=True)
+        time.sleep(0.02)
+    return None, None, {}
+
+def define_rig(cameras=None, preset=None):
+    """
+    定义相对机体固定外参的多相机组。cameras 为 (name, x, y, z, pitch, roll, yaw[, fov]) 列表
+    （机体坐标：x 右、y 前、z 上，角度为度）；preset 可为 "stereo"、"stereo=0.3"、"multiview"。
+    """
+    parts = [preset] if preset else []
+    for cam in cameras or ():
+        parts.append("cam=" + ",".join(str(v) for v in cam))
+    send_camera_command("RIG " + " ".join(parts))
+
+def _get_frame_list(command):
+    """
+    发送返回多帧的命令（RIG_FRAMES、ENV_FRAMES），返回按捕获顺序的通道字典列表（META、RGBA、DPTH），失败时返回 None。
+    """
+    try:
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+            s.connect((HOST, PORT))
+            s.sendall(encode_command(command))
+            length_bytes = _recv_exact(s, 4)
+            if length_bytes is None:
+                return None
+            data = _recv_exact(s, struct.unpack('<I', length_bytes)[0])
+            if data is None or data.startswith(b"ERROR"):
+                return None
+            count = struct.unpack('<I', data[:4])[0]
+            offset = 4
+            frames = []
+            for _ in range(count):
+                size = struct.unpack('<I', data[offset:offset + 4])[0]
+                offset += 4
+                frames.append(parse_capture_channels(data[offset:offset + size], 0))
+                offset += size
+            return frames
+    except ConnectionRefusedError:
+        print("连接失败。请确保C++服务器正在运行并监听正确的IP和端口。")
+    except Exception as e:
+        print(f"发生错误: {e}")
+    return None
+
+def get_rig_frames():
+    """
+    读取最近一轮完成的多相机捕获，返回按相机顺序的通道字典列表（META、RGBA、DPTH），失败时返回 None。
+    """
+    return _get_frame_list("RIG_FRAMES")
+
+def capture_rig(timeout=10.0):
+    """
+    在当前位姿触发一轮多相机捕获并等待完成，返回各相机的帧（同一 rig 编号和时间戳）。
+    """
+    previous = get_rig_frames()
+    previous_id = previous[0]['META']['rig'] if previous else 0
+    send_camera_command("RIG_CAPTURE")
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        time.sleep(0.1)
+        frames = get_rig_frames()
+        if frames and frames[0]['META']['rig'] != previous_id:
+            return frames
+    return None
+
+def environment_sweep(weathers=(), times=(), settle=2, weather_settle=6):
+    """
+    开启环境扫描：之后每次捕获（REQUEST、航测、rig、锁步）都会在同一位姿下依次切换
+    weathers（如 "CLEAR"、"RAIN"）与 times（如 "06:00"、"20:30"）的全部组合并各捕获一帧，
+    帧元数据带有 weather、clock 与 env_round/env_index。仅改时刻等待 settle 帧，改天气等待 weather_settle 帧。
+    两者都为空时关闭扫描并恢复天气与时钟。组合数不能超过 16（服务器保留的帧数），否则服务器忽略该命令。
+    """
+    if not weathers and not times:
+        send_camera_command("ENV_SWEEP OFF")
+        return
+    command = "ENV_SWEEP"
+    if weathers:
+        command += " weather=" + ",".join(weathers)
+    if times:
+        command += " time=" + ",".join(times)
+    send_camera_command(f"{command} settle={settle} weather_settle={weather_settle}")
+
+def get_environment_frames():
+    """
+    读取最近一轮完成的环境扫描帧（同一位姿、按捕获顺序），失败时返回 None。
+    """
+    return _get_frame_list("ENV_FRAMES")
+
+def get_environment_stats():
+    """
+    读取环境扫描统计：轮数、捕获数、环境切换次数、稳定帧数与每轮耗时，返回字典。
+    """
+    response = get_string_from_server("ENV_STATS")
+    if response is None or response.startswith("ERROR"):
+        return None
+    return json.loads(response)
+
+def capture_environments(timeout=30.0):
+    """
+    在当前位姿触发一次捕获并等待整轮环境扫描完成，返回各环境设置下的帧。
+    """
+    previous = get_environment_frames()
+    previous_round = previous[0]['META']['env_round'] if previous else 0
+    send_camera_command("REQUEST")
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        time.sleep(0.1)
+        frames = get_environment_frames()
+        if frames and frames[0]['META']['env_round'] != previous_round:
+            return frames
+    return None
+
+IMU_DTYPE = np.dtype([('time_us', '<i8'), ('gyro', '<f4', 3), ('accel', '<f4', 3)])
+GNSS_DTYPE = np.dtype([('time_us', '<i8'), ('latitude', '<f8'), ('longitude', '<f8'), ('altitude', '<f4'),
+                       ('position', '<f4', 3), ('velocity', '<f4', 3)])
+BARO_DTYPE = np.dtype([('time_us', '<i8'), ('pressure', '<f4'), ('altitude', '<f4')])
+
+def stream_sensors(seed=0, imu=200, gnss=10, baro=25, **noise):
+    """
+    打开传感器长连接，逐批产出 (imu, gnss, baro) 结构化数组。时间戳为微秒，与捕获帧同一时钟。
+    noise 可覆盖 gyro_noise、gyro_walk、accel_noise、accel_walk、gnss_h、gnss_v、baro_noise。
+    关闭生成器即断开连接。
+    """
+    command = f"SENSORS imu={imu} gnss={gnss} baro={baro} seed={seed}"
+    for key, value in noise.items():
+        command += f" {key}={value}"
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.connect((HOST, PORT))
+        s.sendall(encode_command(command))
+        while True:
+            length_bytes = _recv_exact(s, 4)
+            if length_bytes is None:
+                return
+            data = _recv_exact(s, struct.unpack('<I', length_bytes)[0])
+            if data is None:
+                return
+            if not data.startswith(b'SENS'):
+                print(f"服务器返回错误: {data.decode('utf-8', errors='replace')}")
+                return
+            counts = struct.unpack('<III', data[4:16])
+            offset = 16
+            arrays = []
+            for dtype, count in zip((IMU_DTYPE, GNSS_DTYPE, BARO_DTYPE), counts):
+                arrays.append(np.frombuffer(data, dtype=dtype, count=count, offset=offset))
+                offset += dtype.itemsize * count
+            yield tuple(arrays)
+
+def drone_mode(on=True, gimbal_pitch=0.0):
+    """
+    开启/关闭四旋翼动力学模式。开启后相机由固定步长积分的刚体模型驱动，
+    从当前位置悬停开始；gimbal_pitch 为云台俯仰角（度）。
+    """
+    send_camera_command(f"DRONE ON {gimbal_pitch}" if on else "DRONE OFF")
+
+def drone_goto(x, y, z, yaw=None):
+    """
+    设置四旋翼的目标位置（世界坐标，米）和可选的航向角（度），由控制器飞过去。
+    """
+    command = f"DRONE_GOTO {x} {y} {z}"
+    if yaw is not None:
+        command += f" {yaw}"
+    send_camera_command(command)
+
+def _recv_exact(s, size):
+    data = b""
+    while len(data) < size:
+        chunk = s.recv(min(65536, size - len(data)))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+CONTROL_SETPOINT_FORMAT = '<4sI4fB3x'
+CONTROL_WORLD = 0
+CONTROL_HEADING = 1
+
+class ControlStream:
+    """
+    速度/偏航角速度连续控制的长连接。服务器回复 OK 后每次 send() 发送一个 28 字节的设定点，
+    服务器只采用序号最新的一个；超过 0.5 秒未更新时按零速度处理。
+    frame 为 CONTROL_WORLD（世界坐标）或 CONTROL_HEADING（x 右、y 沿当前航向、z 上）。
+    """
+    def __init__(self):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.sock.connect((HOST, PORT))
+        self.sock.sendall(encode_command("CONTROL"))
+        length_bytes = _recv_exact(self.sock, 4)
+        reply = _recv_exact(self.sock, struct.unpack('<I', length_bytes)[0]) if length_bytes else None
+        if reply != b"OK":
+            self.sock.close()
+            raise ConnectionError(f"CONTROL 被拒绝: {reply}")
+        self.sequence = 0
+
+    def send(self, vx, vy, vz, yaw_rate=0.0, frame=CONTROL_WORLD):
+        self.sequence = (self.sequence + 1) & 0xFFFFFFFF or 1
+        self.sock.sendall(struct.pack(CONTROL_SETPOINT_FORMAT, b'CTRL', self.sequence, vx, vy, vz, yaw_rate, frame))
+
+    def close(self):
+        self.sock.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+LIDAR_HEADER_FORMAT = '<4sIIHHfff3fIq'
+LIDAR_POINT_DTYPE = np.dtype([('x', '<f4'), ('y', '<f4'), ('z', '<f4'), ('ring', '<u2'), ('azimuth', '<u2')])
+
+def get_lidar_from_server(channels=32, fov_up=15.0, fov_down=-25.0, az_res=0.2, noise=0.0, max_range=200.0, frames=1):
+    """
+    连接服务器，请求由最近 frames 次捕获的深度重采样得到的激光雷达点云。
+    返回 (header 字典, 点数组)，点坐标相对于扫描原点、与世界坐标轴对齐。
+    """
+    command = f"LIDAR {channels} {fov_up} {fov_down} {az_res} {noise} {max_range} {frames}"
+    try:
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+            s.connect((HOST, PORT))
+            print(f"\n正在发送激光雷达获取指令: '{command}'")
+            s.sendall(encode_command(command))
+
+            length_bytes = s.recv(4)
+            if not length_bytes:
+                print("未接收到数据长度信息，服务器可能已关闭连接。")
+                return None, None
+            total_length = struct.unpack('<I', length_bytes)[0]
+
+            data = b""
+            while len(data) < total_length:
+                chunk = s.recv(min(65536, total_length - len(data)))
+                if not chunk:
+                    print("服务器在数据传输完成前断开连接。")
+                    return None, None
+                data += chunk
+
+            if not data.startswith(b'LIDR'):
+                print(f"服务器返回错误: {data.decode('utf-8', errors='replace')}")
+                return None, None
+
+            header_size = struct.calcsize(LIDAR_HEADER_FORMAT)
+            fields = struct.unpack(LIDAR_HEADER_FORMAT, data[:header_size])
+            header = {
+                'version': fields[1], 'point_count': fields[2], 'channels': fields[3],
+                'azimuth_steps': fields[4], 'fov_up': fields[5], 'fov_down': fields[6],
+                'azimuth_resolution': fields[7], 'origin': fields[8:11],
+                'frame_id': fields[11], 'timestamp': fields[12],
+            }
+            points = np.frombuffer(data, dtype=LIDAR_POINT_DTYPE, count=header['point_count'], offset=header_size)
+            print(f"成功接收到激光雷达点云，共 {len(points)} 个点。")
+            return header, points
+
+    except ConnectionRefusedError:
+        print("连接失败。请确保C++服务器正在运行并监听正确的IP和端口。")
+    except Exception as e:
+        print(f"发生错误: {e}")
+    return None, None
+
+def run_survey(area, altitudes, overlap=0.6, ground=0.0, fov=40.0, yaws=None, pitch=0.0, order="lawnmower", on_frame=None):
+    """
+    让服务器规划并执行覆盖式航测。area 为 (x0, y0, x1, y1)，altitudes 为 (z_min, z_max[, z_step])。
+    每捕获一帧服务器推送一条消息：META(JSON) + RGBA + DPTH，on_frame 为 None 时收集到列表中返回。
+    返回 (帧列表, 汇总字典)，汇总包含 frames_per_minute、已推送帧数 sent，以及客户端读取过慢时
+    服务器丢弃的帧数 dropped。计划超过 20000 个站点或 100000 个航点时服务器直接返回错误。
+    """
+    command = f"SURVEY area={','.join(str(v) for v in area)} alt={','.join(str(v) for v in altitudes)} " \
+              f"overlap={overlap} ground={ground} fov={fov} pitch={pitch} order={order}"
+    if yaws is not None:
+        command += " yaw=" + ",".join(str(v) for v in yaws)
+    frames = []
+    try:
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+            s.connect((HOST, PORT))
+            print(f"\n正在发送航测指令: '{command}'")
+            s.sendall(encode_command(command))
+            while True:
+                length_bytes = _recv_exact(s, 4)
+                if length_bytes is None:
+                    print("服务器在航测完成前断开连接。")
+                    return frames, None
+                message = _recv_exact(s, struct.unpack('<I', length_bytes)[0])
+                if message is None:
+                    print("服务器在数据传输完成前断开连接。")
+                    return frames, None
+                kind = message[:4]
+                if kind not in (b'SFRM', b'DONE'):
+                    print(f"服务器返回错误: {message.decode('utf-8', errors='replace')}")
+                    return frames, None
+                channels = parse_capture_channels(message, 4)
+                if kind == b'DONE':
+                    summary = channels.get('META')
+                    print(f"航测完成: {summary}")
+                    if isinstance(summary, dict) and summary.get('dropped'):
+                        print(f"警告: 服务器丢弃了 {summary['dropped']} 帧")
+                    return frames, summary
+                if on_frame is not None:
+                    on_frame(channels)
+                else:
+                    frames.append(channels)
+
+    except ConnectionRefusedError:
+        print("连接失败。请确保C++服务器正在运行并监听正确的IP和端口。")
+    except Exception as e:
+        print(f"发生错误: {e}")
+    return frames, None
+
 if __name__ == "__main__":
     ensure_record_dir_exists()
     
@@ -2,21 +2,20 @@ import os
 import time
 import numpy as np
 from PIL import Image
-from client import send_camera_command, get_data_from_server, save_rgb_image, save_depth_image, ensure_record_dir_exists
+from client import send_camera_command, get_data_from_server, set_pose, get_pose, save_rgb_image, save_depth_image, ensure_record_dir_exists
 
 ROOT_DATA_FOLDER = "record_data_" + time.strftime("%Y%m%d_%H%M%S", time.localtime())
 
-# 无人机移动和旋转的步长
-MOVE_STEP = 5.0  # 每次 FORWARD/BACKWARD 移动的距离 (米)
-ROTATE_STEP = 45.0 # 每次 RIGHTROTATE/LEFTROTATE 旋转的角度 (度)
-
-# 无人机当前估计位置和朝向 (x, y, z, yaw)
-# 初始位置假设为 (0, 0, 0)，初始朝向为 0 度 (沿X轴正方向)
+# 无人机当前位置和朝向 (x, y, z, yaw)，相对于采集开始时相机的真实位姿
+# 初始位置为 (0, 0, 0)，初始朝向为 0 度
 current_drone_x = 0.0
 current_drone_y = 0.0
 current_drone_z = 0.0
 current_drone_yaw = 0.0 # 0-360度
 
+# 采集开始时由 GET_POSE 读取的相机位姿 (x, y, z, pitch, roll, yaw, fov)
+start_pose = None
+
 # 定义遍历范围
 X_MIN, X_MAX, X_STEP = -50.0, 50.0, 10.0
 Y_MIN, Y_MAX, Y_STEP = -50.0, 50.0, 10.0
@@ -27,68 +26,24 @@ HORIZONTAL_ORIENTATIONS = [
         0.0, 45.0, 90.0, 135.0, 180.0, 225.0, 270.0, 315.0
     ]
 
+def apply_pose():
+    """
+    将当前相对位姿换算为世界坐标，用一条 SET_POSE 指令在一个脚本帧内设置到位。
+    """
+    sx, sy, sz, pitch, roll, syaw, _ = start_pose
+    set_pose(sx + current_drone_x, sy + current_drone_y, sz + current_drone_z,
+             pitch, roll, syaw + current_drone_yaw)
+
 def rotate_to_yaw(target_yaw):
     global current_drone_yaw
-    # 将目标偏航角规范化到 [0, 360) 范围
-    target_yaw = target_yaw % 360
-    if target_yaw < 0: 
-        target_yaw += 360
-
-    # 计算最短旋转角度
-    delta_yaw = target_yaw - current_drone_yaw
-    if delta_yaw > 180:
-        delta_yaw -= 360
-    elif delta_yaw < -180:
-        delta_yaw += 360
-
-    # 根据 delta_yaw 发送旋转指令
-    while abs(delta_yaw) > ROTATE_STEP / 2: # 允许一定的误差范围
-        if delta_yaw > 0:
-            send_camera_command("RIGHTROTATE")
-            current_drone_yaw = (current_drone_yaw + ROTATE_STEP) % 360
-            delta_yaw -= ROTATE_STEP
-        else:
-            send_camera_command("LEFTROTATE")
-            current_drone_yaw = (current_drone_yaw - ROTATE_STEP + 360) % 360
-            delta_yaw += ROTATE_STEP
-        time.sleep(0.01)
+    current_drone_yaw = target_yaw % 360
+    apply_pose()
     print(f"无人机已旋转到朝向: {current_drone_yaw:.2f} 度")
 
 def move_to_position(target_x, target_y, target_z):
-    global current_drone_x, current_drone_y, current_drone_z, current_drone_yaw
-
-    # 移动到目标Z坐标 (高度)
-    while abs(target_z - current_drone_z) > MOVE_STEP / 2:
-        if target_z > current_drone_z:
-            send_camera_command("UP")
-            current_drone_z += MOVE_STEP
-        else:
-            send_camera_command("DOWN")
-            current_drone_z -= MOVE_STEP
-        time.sleep(0.01)
-
-    # 调整X坐标
-    rotate_to_yaw(0) # 旋转到0度，假设0度是X轴正方向
-    while abs(target_x - current_drone_x) > MOVE_STEP / 2:
-        if target_x > current_drone_x:
-            send_camera_command("FORWARD") # 沿X轴正方向移动
-            current_drone_x += MOVE_STEP
-        else:
-            send_camera_command("BACKWARD") # 沿X轴负方向移动
-            current_drone_x -= MOVE_STEP
-        time.sleep(0.01)
-
-    # 调整Y坐标
-    rotate_to_yaw(90) # 旋转到90度，假设90度是Y轴正方向
-    while abs(target_y - current_drone_y) > MOVE_STEP / 2:
-        if target_y > current_drone_y:
-            send_camera_command("FORWARD") # 沿Y轴正方向移动
-            current_drone_y += MOVE_STEP
-        else:
-            send_camera_command("BACKWARD") # 沿Y轴负方向移动
-            current_drone_y -= MOVE_STEP
-        time.sleep(0.01)
-
+    global current_drone_x, current_drone_y, current_drone_z
+    current_drone_x, current_drone_y, current_drone_z = target_x, target_y, target_z
+    apply_pose()
     print(f"无人机已移动到位置: ({current_drone_x:.2f}, {current_drone_y:.2f}, {current_drone_z:.2f})")
 
 def capture_and_save_data(position, orientation):
@@ -124,6 +79,13 @@ if __name__ == "__main__":
     print("在10秒后开始无人机数据采集...")
     time.sleep(10)
 
+    start_pose = get_pose()
+    while start_pose is None:
+        print("无法读取相机位姿，重试...")
+        time.sleep(1)
+        start_pose = get_pose()
+    print(f"起始相机位姿: {start_pose}")
+
     for x in np.arange(X_MIN, X_MAX + X_STEP, X_STEP):
         for y in np.arange(Y_MIN, Y_MAX + Y_STEP, Y_STEP):
             for z in np.arange(Z_MIN, Z_MAX + Z_STEP, Z_STEP):
@@ -0,0 +1,158 @@
+import json
+import mmap
+import struct
+import numpy as np
+
+# DroneSim 序列容器（.dsq）的读取器，格式见 DroneSim/dataset.h。
+# 未压缩的通道直接映射文件（零拷贝），rle 压缩的通道用 numpy 向量化解码。
+
+FILE_MAGIC = b"DSIMSEQ\0"
+INDEX_MAGIC = b"DSIMIDX\0"
+END_MAGIC = b"DSIMEND\0"
+CHUNK_MAGIC = b"DSCH"
+HEADER_SIZE = 64
+ALIGNMENT = 64
+CODEC_RAW = 0
+CODEC_RLE = 1
+
+CHUNK_HEADER = struct.Struct("<4s4sIIqHHIIIQQ8x")
+FRAME_ENTRY = np.dtype([("first_chunk", "<u4"), ("chunk_count", "<u4"), ("frame_id", "<u4"),
+                        ("reserved", "<u4"), ("timestamp", "<i8")])
+CHUNK_ENTRY = np.dtype([("tag", "S4"), ("codec", "<u2"), ("elem_size", "<u2"), ("width", "<u4"),
+                        ("height", "<u4"), ("offset", "<u8"), ("stored_size", "<u8"), ("raw_size", "<u8")])
+
+def decode_rle(payload, elem_size, raw_size):
+    """
+    解码 rle 通道：还原游程与字面量，逐字节平面做前缀和撤销差分，再把字节平面交织回元素。
+    """
+    tokens, literal_bytes = struct.unpack_from("<II", payload, 0)
+    literal_length = np.frombuffer(payload, "<u4", tokens, 8)
+    run_length = np.frombuffer(payload, "<u4", tokens, 8 + 4 * tokens)
+    run_value = np.frombuffer(payload, np.uint8, tokens, 8 + 8 * tokens)
+    tables = (8 + 9 * tokens + 3) & ~3
+    literals = np.frombuffer(payload, np.uint8, literal_bytes, tables)
+
+    # 按 字面量段、游程段 交替展开，标记每个输出字节属于哪一类
+    segments = np.empty(2 * tokens, np.int64)
+    segments[0::2] = literal_length
+    segments[1::2] = run_length
+    is_literal = np.repeat(np.tile(np.array([True, False]), tokens), segments)
+    if is_literal.size != raw_size:
+        raise ValueError("rle 通道长度不符")
+    planes = np.empty(raw_size, np.uint8)
+    planes[is_literal] = literals
+    planes[~is_literal] = np.repeat(run_value, run_length)
+
+    planes = np.cumsum(planes.reshape(elem_size, -1), axis=1, dtype=np.uint8)
+    return np.ascontiguousarray(planes.T).reshape(-1)
+
+class Dataset:
+    """
+    只读打开一个 .dsq 文件。没有索引的文件（写入中途退出）会扫描块头恢复完整的帧。
+    """
+
+    def __init__(self, path):
+        self._file = open(path, "rb")
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self._buf = memoryview(self._map)
+        if self._buf[:8] != FILE_MAGIC:
+            raise ValueError(f"{path} 不是 DroneSim 数据集")
+        self.recovered = not self._load_index()
+        if self.recovered:
+            self._scan_chunks()
+
+    def close(self):
+        """
+        关闭文件。仍有引用映射的数组（未压缩通道）存在时会抛出 BufferError。
+        """
+        self._buf.release()
+        self._map.close()
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return len(self.frames)
+
+    def _load_index(self):
+        size = len(self._buf)
+        if size < HEADER_SIZE + 16 or self._buf[size - 8:] != END_MAGIC:
+            return False
+        index_offset, = struct.unpack_from("<Q", self._buf, size - 16)
+        if index_offset + 16 > size - 16 or self._buf[index_offset:index_offset + 8] != INDEX_MAGIC:
+            return False
+        frame_count, chunk_count = struct.unpack_from("<II", self._buf, index_offset + 8)
+        at = index_offset + 16
+        self.frames = np.frombuffer(self._buf, FRAME_ENTRY, frame_count, at).copy()
+        at += frame_count * FRAME_ENTRY.itemsize
+        self.chunks = np.frombuffer(self._buf, CHUNK_ENTRY, chunk_count, at).copy()
+        return True
+
+    def _scan_chunks(self):
+        frames, chunks, pending = [], [], []
+        at, size = HEADER_SIZE, len(self._buf)
+        while at + CHUNK_HEADER.size <= size:
+            (magic, tag, frame, frame_id, timestamp, codec, elem_size, width, height, _,
+             raw_size, stored_size) = CHUNK_HEADER.unpack_from(self._buf, at)
+            payload = at + CHUNK_HEADER.size
+            if magic != CHUNK_MAGIC or frame != len(frames) or stored_size > size - payload:
+                break
+            if not pending:
+                first = (len(chunks), frame_id, timestamp)
+            pending.append((tag, codec, elem_size, width, height, payload, stored_size, raw_size))
+            at = payload + stored_size
+            at += (ALIGNMENT - at % ALIGNMENT) % ALIGNMENT
+            if tag == b"MATX":
+                frames.append((first[0], len(pending), first[1], 0, first[2]))
+                chunks.extend(pending)
+                pending = []
+        self.frames = np.array(frames, FRAME_ENTRY)
+        self.chunks = np.array(chunks, CHUNK_ENTRY)
+
+    def channel(self, index, tag):
+        """
+        读取第 index 帧的一个通道，返回 (宽, 高, 元素字节数, uint8 数组)。未压缩时数组直接引用映射的文件。
+        """
+        frame = self.frames[index]
+        first = int(frame["first_chunk"])
+        for chunk in self.chunks[first:first + int(frame["chunk_count"])]:
+            if chunk["tag"] != tag.encode():
+                continue
+            offset, stored = int(chunk["offset"]), int(chunk["stored_size"])
+            elem_size, raw_size = int(chunk["elem_size"]), int(chunk["raw_size"])
+            if chunk["codec"] == CODEC_RAW:
+                data = np.frombuffer(self._buf, np.uint8, raw_size, offset)
+            elif chunk["codec"] == CODEC_RLE:
+                data = decode_rle(self._buf[offset:offset + stored], elem_size, raw_size)
+            else:
+                raise ValueError(f"未知编码 {int(chunk['codec'])}")
+            return int(chunk["width"]), int(chunk["height"]), elem_size, data
+        raise KeyError(f"第 {index} 帧没有 {tag} 通道")
+
+    def frame(self, index):
+        """
+        读取第 index 帧，返回字典：META（dict）、RGBA（H×W×4 uint8）、DPTH（H×W float32，反向 z 原始值）、
+        STCL（H×W uint8）、MATX（M/MV/MVP/Vinv 四个 4×4 矩阵）。
+        """
+        result = {}
+        _, _, _, meta = self.channel(index, "META")
+        result["META"] = json.loads(meta.tobytes().decode("utf-8"))
+        width, height, _, rgba = self.channel(index, "RGBA")
+        result["RGBA"] = rgba.reshape(height, width, 4)
+        width, height, _, depth = self.channel(index, "DPTH")
+        result["DPTH"] = depth.view("<f4").reshape(height, width)
+        width, height, _, stencil = self.channel(index, "STCL")
+        result["STCL"] = stencil.reshape(height, width)
+        _, _, _, matrices = self.channel(index, "MATX")
+        # Eigen 矩阵按列存储
+        m = matrices.view("<f4").reshape(4, 4, 4).transpose(0, 2, 1)
+        result["MATX"] = {"M": m[0], "MV": m[1], "MVP": m[2], "Vinv": m[3]}
+        return result
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self.frame(i)
@@ -0,0 +1,168 @@
+#include "commands.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A camera held in software that logs what the drain did to it.
+class CommandDrain : public ::testing::Test {
+protected:
+	CommandDrain()
+	{
+		camera_ = { 10.0f, 20.0f, 30.0f, 0.0f, 0.0f, 0.0f, 50.0f };
+		sink_.readPose = [this]() {
+			log_.push_back("read");
+			return camera_;
+		};
+		sink_.writePose = [this](const CameraPose& pose) {
+			log_.push_back("write");
+			camera_ = pose;
+			writes_.push_back(pose);
+		};
+		sink_.barrier = [this](const std::string& cmd) {
+			log_.push_back("barrier " + cmd);
+			return cmd != "RIG_CAPTURE" || rigReady_;
+		};
+		sink_.run = [this](const std::string& cmd) { log_.push_back("run " + cmd); };
+		sink_.malformed = [this](const std::string& cmd) { log_.push_back("malformed " + cmd); };
+	}
+
+	CommandTick drain(std::deque<std::string>& pending,
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10))
+	{
+		CommandTick tick;
+		drainCommandQueue(pending, sink_, deadline, tick);
+		return tick;
+	}
+
+	CameraPose camera_;
+	CommandSink sink_;
+	std::vector<std::string> log_;
+	std::vector<CameraPose> writes_;
+	bool rigReady_ = true;
+};
+
+// A run of moves reads the pose once and writes the net transform once.
+TEST_F(CommandDrain, FoldsMovesIntoOneWrite)
+{
+	std::deque<std::string> pending = { "FORWARD", "FORWARD", "UP", "LEFTROTATE", "FORWARD", "RIGHT" };
+	CommandTick tick = drain(pending);
+	EXPECT_TRUE(pending.empty());
+	EXPECT_EQ(tick.commands, 6u);
+	EXPECT_EQ(tick.poseCommands, 6u);
+	EXPECT_EQ(tick.poseWrites, 1u);
+	EXPECT_FALSE(tick.barrier);
+	EXPECT_EQ(log_, std::vector<std::string>({ "read", "write" }));
+
+	// yaw 0 faces +y; after LEFTROTATE yaw 45 faces (-sin 45, cos 45) and
+	// its right-hand side is (cos 45, sin 45)
+	const float s = std::sqrt(0.5f) * 5.0f;
+	ASSERT_EQ(writes_.size(), 1u);
+	EXPECT_NEAR(writes_[0].x, 10.0f - s + s, 1e-4f);
+	EXPECT_NEAR(writes_[0].y, 20.0f + 10.0f + s + s, 1e-4f);
+	EXPECT_NEAR(writes_[0].z, 35.0f, 1e-4f);
+	EXPECT_NEAR(writes_[0].yaw, 45.0f, 1e-4f);
+	EXPECT_EQ(writes_[0].fov, 50.0f);
+}
+
+// SET_POSE replaces whatever the moves before it did; moves after it apply
+// on top of it.
+TEST_F(CommandDrain, SetPoseOverridesEarlierMoves)
+{
+	std::deque<std::string> pending = { "FORWARD", "UP", "SET_POSE 1 2 3 0 0 90", "DOWN" };
+	CommandTick tick = drain(pending);
+	EXPECT_EQ(tick.poseCommands, 4u);
+	EXPECT_EQ(tick.poseWrites, 1u);
+	ASSERT_EQ(writes_.size(), 1u);
+	EXPECT_EQ(writes_[0].x, 1.0f);
+	EXPECT_EQ(writes_[0].y, 2.0f);
+	EXPECT_EQ(writes_[0].z, -2.0f);
+	EXPECT_EQ(writes_[0].yaw, 90.0f);
+	EXPECT_EQ(writes_[0].fov, 50.0f);	// not given: kept
+
+	pending = { "SET_POSE 1 2", "FORWARD" };
+	tick = drain(pending);
+	EXPECT_EQ(tick.commands, 2u);
+	EXPECT_EQ(tick.poseCommands, 1u);
+	EXPECT_EQ(log_.back(), "write");
+	EXPECT_NE(std::find(log_.begin(), log_.end(), "malformed SET_POSE 1 2"), log_.end());
+}
+
+// Other commands see the pose written so far: the fold is flushed before
+// each of them.
+TEST_F(CommandDrain, FlushesBeforeOtherCommands)
+{
+	std::deque<std::string> pending = { "FORWARD", "CHECK", "UP", "UP", "GET_POSE" };
+	CommandTick tick = drain(pending);
+	EXPECT_EQ(tick.commands, 5u);
+	EXPECT_EQ(tick.poseWrites, 2u);
+	EXPECT_EQ(log_, std::vector<std::string>({ "read", "write", "run CHECK", "read", "write", "run GET_POSE" }));
+	EXPECT_NEAR(camera_.z, 40.0f, 1e-4f);
+}
+
+// REQUEST, STEP and RIG_CAPTURE stop the drain once they start a capture,
+// with the pose written first and the rest kept for later ticks.
+TEST_F(CommandDrain, BarriersStopTheDrain)
+{
+	for (const std::string barrier : { "REQUEST", "STEP 1 2 3 0 0 0", "RIG_CAPTURE" }) {
+		log_.clear();
+		std::deque<std::string> pending = { "FORWARD", barrier, "UP", "CHECK" };
+		CommandTick tick = drain(pending);
+		EXPECT_TRUE(tick.barrier) << barrier;
+		EXPECT_EQ(tick.commands, 2u) << barrier;
+		EXPECT_EQ(pending, std::deque<std::string>({ "UP", "CHECK" })) << barrier;
+		EXPECT_EQ(log_, std::vector<std::string>({ "read", "write", "barrier " + barrier })) << barrier;
+	}
+
+	// a barrier that did not start a capture lets the drain go on
+	rigReady_ = false;
+	log_.clear();
+	std::deque<std::string> pending = { "RIG_CAPTURE", "CHECK" };
+	CommandTick tick = drain(pending);
+	EXPECT_FALSE(tick.barrier);
+	EXPECT_TRUE(pending.empty());
+	EXPECT_EQ(log_, std::vector<std::string>({ "barrier RIG_CAPTURE", "run CHECK" }));
+}
+
+// Past the deadline nothing more is taken from the queue.
+TEST_F(CommandDrain, StopsAtTheDeadline)
+{
+	std::deque<std::string> pending = { "FORWARD", "CHECK" };
+	CommandTick tick = drain(pending, std::chrono::steady_clock::now() - std::chrono::milliseconds(1));
+	EXPECT_TRUE(tick.overBudget);
+	EXPECT_EQ(tick.commands, 0u);
+	EXPECT_EQ(pending.size(), 2u);
+	EXPECT_TRUE(log_.empty());
+}
+
+// CMD_STATS: ticks that ran commands are counted and averaged; idle ticks
+// only update the backlog.
+TEST(CommandStats, CountsTicks)
+{
+	const CommandStats before = commandStats();
+	CommandTick tick;
+	tick.commands = 7;
+	tick.poseCommands = 5;
+	tick.poseWrites = 2;
+	tick.barrier = true;
+	tick.backlog = 3;
+	tick.milliseconds = 1.5;
+	recordCommandTick(tick);
+	CommandTick idle;
+	idle.backlog = 4;
+	recordCommandTick(idle);
+
+	const CommandStats after = commandStats();
+	EXPECT_EQ(after.ticks, before.ticks + 1);
+	EXPECT_EQ(after.commands, before.commands + 7);
+	EXPECT_EQ(after.poseCommands, before.poseCommands + 5);
+	EXPECT_EQ(after.poseWrites, before.poseWrites + 2);
+	EXPECT_EQ(after.barriers, before.barriers + 1);
+	EXPECT_EQ(after.budgetStops, before.budgetStops);
+	EXPECT_EQ(after.lastPerTick, 7u);
+	EXPECT_GE(after.maxPerTick, 7u);
+	EXPECT_EQ(after.backlog, 4u);
+	const std::string json = commandStatsJson(after);
+	EXPECT_NE(json.find("\"last_per_tick\":7"), std::string::npos);
+	EXPECT_NE(json.find("\"backlog\":4"), std::string::npos);
+}
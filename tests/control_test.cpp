@@ -0,0 +1,162 @@
+#include "control.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static ControlSetpointMsg message(uint32_t sequence, float vx, float vy, float vz, float yawRate, uint8_t frame)
+{
+	ControlSetpointMsg msg = {};
+	memcpy(msg.magic, "CTRL", 4);
+	msg.sequence = sequence;
+	msg.velocity[0] = vx;
+	msg.velocity[1] = vy;
+	msg.velocity[2] = vz;
+	msg.yawRate = yawRate;
+	msg.frame = frame;
+	return msg;
+}
+
+static bool decode(const ControlSetpointMsg& msg, ControlSetpoint& setpoint)
+{
+	return decodeControlSetpoint(reinterpret_cast<const unsigned char*>(&msg), setpoint);
+}
+
+static ControlSetpoint setpoint(uint32_t sequence, float vx)
+{
+	ControlSetpoint s;
+	s.velocity = Eigen::Vector3f(vx, 0.0f, 0.0f);
+	s.sequence = sequence;
+	s.received = std::chrono::steady_clock::now();
+	return s;
+}
+
+TEST(ControlSetpoint, Decodes)
+{
+	ControlSetpoint s;
+	ASSERT_TRUE(decode(message(7, 1.0f, -2.0f, 0.5f, 30.0f, controlHeading), s));
+	EXPECT_EQ(s.sequence, 7u);
+	EXPECT_EQ(s.velocity, Eigen::Vector3f(1.0f, -2.0f, 0.5f));
+	EXPECT_EQ(s.yawRate, 30.0f);
+	EXPECT_EQ(s.frame, controlHeading);
+}
+
+TEST(ControlSetpoint, RejectsBadMessages)
+{
+	const float inf = std::numeric_limits<float>::infinity();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	ControlSetpoint s;
+	ControlSetpointMsg msg = message(1, 0.0f, 0.0f, 0.0f, 0.0f, controlWorld);
+	memcpy(msg.magic, "CTRX", 4);
+	EXPECT_FALSE(decode(msg, s));
+	EXPECT_FALSE(decode(message(1, 0.0f, 0.0f, 0.0f, 0.0f, 2), s));
+	EXPECT_FALSE(decode(message(1, nan, 0.0f, 0.0f, 0.0f, controlWorld), s));
+	EXPECT_FALSE(decode(message(1, 0.0f, inf, 0.0f, 0.0f, controlWorld), s));
+	EXPECT_FALSE(decode(message(1, 0.0f, 0.0f, -inf, 0.0f, controlWorld), s));
+	EXPECT_FALSE(decode(message(1, 0.0f, 0.0f, 0.0f, nan, controlWorld), s));
+}
+
+// Newer sequence numbers win, compared with wrap-around; older and repeated
+// ones are dropped.
+TEST(ControlSession, SequenceWraps)
+{
+	unsigned int session = beginControlSession();
+	ControlSetpoint current;
+	publishControlSetpoint(session, setpoint(0xFFFFFFFEu, 1.0f));
+	publishControlSetpoint(session, setpoint(0xFFFFFFFFu, 2.0f));
+	publishControlSetpoint(session, setpoint(0, 3.0f));
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.sequence, 0u);
+	EXPECT_EQ(current.velocity.x(), 3.0f);
+
+	publishControlSetpoint(session, setpoint(0xFFFFFFFFu, 4.0f));	// before 0
+	publishControlSetpoint(session, setpoint(0, 5.0f));				// repeated
+	publishControlSetpoint(session, setpoint(2, 6.0f));
+	publishControlSetpoint(session, setpoint(1, 7.0f));
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.sequence, 2u);
+	EXPECT_EQ(current.velocity.x(), 6.0f);
+
+	ControlStats stats = controlStats();
+	EXPECT_TRUE(stats.active);
+	EXPECT_EQ(stats.received, 7u);
+	EXPECT_EQ(stats.dropped, 3u);
+	endControlSession(session);
+	EXPECT_FALSE(currentControlSetpoint(current));
+	EXPECT_FALSE(controlStats().active);
+}
+
+// Opening a session supersedes the previous one: its setpoints and its end
+// no longer count.
+TEST(ControlSession, NewestSessionWins)
+{
+	unsigned int first = beginControlSession();
+	publishControlSetpoint(first, setpoint(1, 1.0f));
+	unsigned int second = beginControlSession();
+	EXPECT_NE(first, second);
+
+	ControlSetpoint current;
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.velocity, Eigen::Vector3f::Zero());
+
+	publishControlSetpoint(first, setpoint(5, 2.0f));
+	endControlSession(first);
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.velocity, Eigen::Vector3f::Zero());
+	EXPECT_EQ(controlStats().received, 0u);
+
+	publishControlSetpoint(second, setpoint(1, 3.0f));
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.velocity.x(), 3.0f);
+	endControlSession(second);
+	EXPECT_FALSE(currentControlSetpoint(current));
+}
+
+// A setpoint older than controlTimeout comes back with zero velocity and yaw
+// rate, keeping its sequence.
+TEST(ControlSession, StaleSetpointStops)
+{
+	unsigned int session = beginControlSession();
+	ControlSetpoint s = setpoint(1, 2.0f);
+	s.yawRate = 10.0f;
+	s.received -= std::chrono::milliseconds((int)(controlTimeout * 1000.0f) + 100);
+	publishControlSetpoint(session, s);
+	ControlSetpoint current;
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.sequence, 1u);
+	EXPECT_EQ(current.velocity, Eigen::Vector3f::Zero());
+	EXPECT_EQ(current.yawRate, 0.0f);
+
+	publishControlSetpoint(session, setpoint(2, 2.0f));
+	ASSERT_TRUE(currentControlSetpoint(current));
+	EXPECT_EQ(current.velocity.x(), 2.0f);
+
+	markControlApplied(current);
+	markControlApplied(current);
+	EXPECT_EQ(controlStats().applied, 1u);
+	endControlSession(session);
+}
+
+// Heading velocities are x right, y forward along the yaw; yaw 0 faces +y.
+TEST(ControlVelocity, RotatesHeadingFrame)
+{
+	ControlSetpoint s;
+	s.velocity = Eigen::Vector3f(0.0f, 1.0f, 0.5f);
+	EXPECT_EQ(controlWorldVelocity(s, 90.0f), s.velocity);	// world frame ignores yaw
+
+	s.frame = controlHeading;
+	EXPECT_TRUE(controlWorldVelocity(s, 0.0f).isApprox(Eigen::Vector3f(0.0f, 1.0f, 0.5f)));
+	// yaw 90 (turned left) faces -x
+	EXPECT_TRUE(controlWorldVelocity(s, 90.0f).isApprox(Eigen::Vector3f(-1.0f, 0.0f, 0.5f), 1e-5f));
+	s.velocity = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
+	EXPECT_TRUE(controlWorldVelocity(s, 90.0f).isApprox(Eigen::Vector3f(0.0f, 1.0f, 0.0f), 1e-5f));
+	EXPECT_TRUE(controlWorldVelocity(s, -90.0f).isApprox(Eigen::Vector3f(0.0f, -1.0f, 0.0f), 1e-5f));
+
+	// yaw wraps into [-180, 180)
+	Eigen::Vector3f position(0.0f, 0.0f, 0.0f);
+	float yaw = 170.0f;
+	s.yawRate = 40.0f;
+	integrateControl(s, 0.5f, position, yaw);
+	EXPECT_NEAR(yaw, -170.0f, 1e-4f);
+	EXPECT_NEAR(position.y(), 0.5f * std::sin(170.0f * 0.01745329f), 1e-5f);
+}
@@ -0,0 +1,72 @@
+"""
+Checks that python_client/dataset.py reads what the C++ writer writes.
+
+Records the same synthetic frames with dronesim_record twice, raw and rle, and
+compares every channel the Python reader decodes from the rle files with the
+raw ones, which it maps as they are. Exits 77 (skipped) without numpy.
+
+    python dataset_roundtrip.py --binary _build/bench/dronesim_record
+"""
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+try:
+    import numpy as np
+except ImportError:
+    print("numpy not available, skipping")
+    sys.exit(77)
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "python_client"))
+from dataset import CODEC_RLE, Dataset  # noqa: E402
+
+FRAMES = 4
+
+
+def record(binary, directory, codec):
+    subprocess.run([binary, "--frames", str(FRAMES), "--size", "200x120", "--writers", "1", "--queue", "4",
+                    "--policy", "block", "--codec", codec, "--dir", directory, "--keep"],
+                   check=True, stdout=subprocess.DEVNULL)
+    files = sorted(f for f in os.listdir(directory) if f.endswith(".dsq"))
+    if len(files) != 1:
+        raise SystemExit(f"{codec}: expected one file, found {files}")
+    return Dataset(os.path.join(directory, files[0]))
+
+
+def compare(raw, rle):
+    if len(raw) != FRAMES or len(rle) != FRAMES:
+        raise SystemExit(f"expected {FRAMES} frames, read {len(raw)} raw and {len(rle)} rle")
+    if not (rle.chunks["codec"] == CODEC_RLE).any():
+        raise SystemExit("the rle file holds no rle chunks")
+    for i in range(FRAMES):
+        a, b = raw.frame(i), rle.frame(i)
+        if a["STCL"].shape != (120, 200) or a["RGBA"].shape != (120, 200, 4):
+            raise SystemExit(f"frame {i}: unexpected shape {a['STCL'].shape}")
+        for tag in ("RGBA", "DPTH", "STCL"):
+            if a[tag].shape != b[tag].shape or not np.array_equal(a[tag].view(np.uint8), b[tag].view(np.uint8)):
+                raise SystemExit(f"frame {i}: {tag} differs")
+        for name, m in a["MATX"].items():
+            if not np.array_equal(m, b["MATX"][name]):
+                raise SystemExit(f"frame {i}: {name} differs")
+        if a["META"] != b["META"]:
+            raise SystemExit(f"frame {i}: META differs")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--binary", required=True)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        raw = record(args.binary, os.path.join(tmp, "raw"), "raw")
+        rle = record(args.binary, os.path.join(tmp, "rle"), "rle")
+        compare(raw, rle)
+        raw.close()
+        rle.close()
+    print(f"{FRAMES} frames: rle decodes to the raw channels")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+#include "dataset.h"
+#include "synthetic.h"
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+
+static std::shared_ptr<CapturedFrame> testFrame(unsigned int id, int width, int height)
+{
+	auto frame = syntheticFrame(width, height);
+	frame->id = id;
+	frame->timestamp = 1000 + id;
+	frame->metadata = "\"pose\":" + std::to_string(id);
+	frame->matrices = syntheticViewMatrices(id, 100.0f);
+	return frame;
+}
+
+static void expectSameFrame(const CapturedFrame& a, const CapturedFrame& b)
+{
+	EXPECT_EQ(a.id, b.id);
+	EXPECT_EQ(a.timestamp, b.timestamp);
+	// b's metadata holds the whole META object: id, timestamp, then a's members
+	EXPECT_NE(b.metadata.find(a.metadata), std::string::npos) << b.metadata;
+	EXPECT_EQ(a.width, b.width);
+	EXPECT_EQ(a.height, b.height);
+	EXPECT_EQ(a.colorWidth, b.colorWidth);
+	EXPECT_EQ(a.colorHeight, b.colorHeight);
+	EXPECT_EQ(a.depth, b.depth);
+	EXPECT_EQ(a.stencil, b.stencil);
+	EXPECT_EQ(a.color, b.color);
+	EXPECT_EQ(a.matrices.M, b.matrices.M);
+	EXPECT_EQ(a.matrices.MV, b.matrices.MV);
+	EXPECT_EQ(a.matrices.MVP, b.matrices.MVP);
+	EXPECT_EQ(a.matrices.Vinv, b.matrices.Vinv);
+}
+
+class DatasetFile : public ::testing::TestWithParam<DatasetCodec> {
+protected:
+	void SetUp() override
+	{
+		path_ = (std::filesystem::temp_directory_path() / ("dronesim_test_" + std::to_string(GetParam()) + ".dsq")).string();
+		std::filesystem::remove(path_);
+	}
+	void TearDown() override { std::filesystem::remove(path_); }
+	std::string path_;
+};
+
+TEST_P(DatasetFile, RoundTrip)
+{
+	std::string error;
+	std::vector<std::shared_ptr<CapturedFrame>> frames;
+	for (unsigned int i = 0; i < 3; ++i) frames.push_back(testFrame(i + 1, 96, 54));
+	{
+		DatasetWriter writer;
+		writer.setCodec(GetParam());
+		ASSERT_TRUE(writer.open(path_, false, error)) << error;
+		for (const auto& f : frames) ASSERT_TRUE(writer.append(*f, error)) << error;
+		ASSERT_TRUE(writer.close(error)) << error;
+	}
+	DatasetReader reader;
+	ASSERT_TRUE(reader.open(path_, error)) << error;
+	EXPECT_FALSE(reader.recovered());
+	ASSERT_EQ(reader.frameCount(), frames.size());
+	for (size_t i = 0; i < frames.size(); ++i) {
+		CapturedFrame back;
+		ASSERT_TRUE(reader.readFrame(i, back, error)) << error;
+		expectSameFrame(*frames[i], back);
+	}
+}
+
+TEST_P(DatasetFile, AppendAndRecover)
+{
+	std::string error;
+	{
+		DatasetWriter writer;
+		writer.setCodec(GetParam());
+		ASSERT_TRUE(writer.open(path_, false, error)) << error;
+		ASSERT_TRUE(writer.append(*testFrame(1, 64, 36), error)) << error;
+	}
+	{
+		DatasetWriter writer;
+		writer.setCodec(GetParam());
+		ASSERT_TRUE(writer.open(path_, true, error)) << error;
+		ASSERT_TRUE(writer.append(*testFrame(2, 64, 36), error)) << error;
+	}
+	// a writer that died before its index: the chunks are scanned instead
+	std::filesystem::resize_file(path_, std::filesystem::file_size(path_) - 16);
+	DatasetReader reader;
+	ASSERT_TRUE(reader.open(path_, error)) << error;
+	EXPECT_TRUE(reader.recovered());
+	ASSERT_EQ(reader.frameCount(), 2u);
+	CapturedFrame back;
+	ASSERT_TRUE(reader.readFrame(1, back, error)) << error;
+	expectSameFrame(*testFrame(2, 64, 36), back);
+}
+
+INSTANTIATE_TEST_SUITE_P(Codecs, DatasetFile, ::testing::Values(datasetRaw, datasetRle));
+
+TEST(DatasetRle, RoundTrip)
+{
+	std::vector<unsigned char> data(4096 * 4);
+	for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)(i < 6000 ? 0 : (i / 7) ^ (benchHash((uint32_t)i) & 1));
+	for (int elemSize : { 1, 2, 4 }) {
+		std::vector<unsigned char> encoded, decoded(data.size());
+		encodeDatasetRle(data.data(), data.size(), elemSize, encoded);
+		ASSERT_TRUE(decodeDatasetRle(encoded.data(), encoded.size(), elemSize, decoded.data(), decoded.size()));
+		EXPECT_EQ(decoded, data) << "elemSize " << elemSize;
+		EXPECT_LT(encoded.size(), data.size());
+		// truncated input is rejected rather than read past
+		EXPECT_FALSE(decodeDatasetRle(encoded.data(), encoded.size() / 2, elemSize, decoded.data(), decoded.size()));
+	}
+}
+
+// A raw chunk is used in place for rawSize bytes, so rawSize must match the
+// stored size: a mismatched index entry makes the reader scan the chunk
+// headers instead, and a mismatched chunk header ends the scan.
+TEST(DatasetReader, RejectsRawSizeMismatch)
+{
+	std::string path = (std::filesystem::temp_directory_path() / "dronesim_test_raw_size.dsq").string();
+	std::string error;
+	{
+		DatasetWriter writer;
+		ASSERT_TRUE(writer.open(path, false, error)) << error;
+		ASSERT_TRUE(writer.append(*testFrame(1, 64, 36), error)) << error;
+		ASSERT_TRUE(writer.append(*testFrame(2, 64, 36), error)) << error;
+		ASSERT_TRUE(writer.close(error)) << error;
+	}
+	uint64_t indexOffset = 0, payload = 0;
+	size_t frames = 0, chunk = 0;
+	{
+		DatasetReader reader;
+		ASSERT_TRUE(reader.open(path, error)) << error;
+		indexOffset = reader.dataEnd();
+		frames = reader.frameCount();
+		// the RGBA chunk of the second frame
+		const DatasetFrameEntry& f = reader.frame(1);
+		for (chunk = f.firstChunk; chunk < f.firstChunk + f.chunkCount; ++chunk) {
+			if (memcmp(reader.chunks()[chunk].tag, "RGBA", 4) == 0) break;
+		}
+		ASSERT_LT(chunk, (size_t)(f.firstChunk + f.chunkCount));
+		payload = reader.chunks()[chunk].offset;
+	}
+	auto patch = [&](uint64_t at, uint64_t value) {
+		FILE* f = fopen(path.c_str(), "r+b");
+		ASSERT_NE(f, nullptr);
+		fseek(f, (long)at, SEEK_SET);
+		fwrite(&value, sizeof(value), 1, f);
+		fclose(f);
+	};
+	const uint64_t huge = 1ull << 40;
+
+	patch(indexOffset + 16 + frames * sizeof(DatasetFrameEntry) + chunk * sizeof(DatasetChunkEntry)
+		+ offsetof(DatasetChunkEntry, rawSize), huge);
+	{
+		DatasetReader reader;
+		ASSERT_TRUE(reader.open(path, error)) << error;
+		EXPECT_TRUE(reader.recovered());
+		ASSERT_EQ(reader.frameCount(), 2u);
+		CapturedFrame back;
+		ASSERT_TRUE(reader.readFrame(1, back, error)) << error;
+		expectSameFrame(*testFrame(2, 64, 36), back);
+	}
+
+	patch(payload - sizeof(DatasetChunkHeader) + offsetof(DatasetChunkHeader, rawSize), huge);
+	{
+		DatasetReader reader;
+		ASSERT_TRUE(reader.open(path, error)) << error;
+		EXPECT_TRUE(reader.recovered());
+		EXPECT_EQ(reader.frameCount(), 1u);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(DatasetReader, RejectsOtherFiles)
+{
+	std::string path = (std::filesystem::temp_directory_path() / "dronesim_test_not_a_dataset.dsq").string();
+	FILE* f = fopen(path.c_str(), "wb");
+	ASSERT_NE(f, nullptr);
+	fputs("this is not a dataset, just some text long enough for a header.......", f);
+	fclose(f);
+	DatasetReader reader;
+	std::string error;
+	EXPECT_FALSE(reader.open(path, error));
+	EXPECT_NE(error.find("not a DroneSim dataset"), std::string::npos);
+	std::filesystem::remove(path);
+}
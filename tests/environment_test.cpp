@@ -0,0 +1,128 @@
+#include "environment.h"
+#include <gtest/gtest.h>
+
+TEST(EnvironmentCommand, WeatherOutermost)
+{
+	bool enable = false;
+	EnvironmentSweepConfig cfg;
+	ASSERT_TRUE(parseEnvironmentCommand("ENV_SWEEP weather=CLEAR,RAIN time=6:00,18:30 settle=3 weather_settle=9", enable, cfg));
+	EXPECT_TRUE(enable);
+	EXPECT_EQ(cfg.settleFrames, 3);
+	EXPECT_EQ(cfg.weatherSettleFrames, 9);
+	ASSERT_EQ(cfg.settings.size(), 4u);
+	EXPECT_EQ(cfg.settings[0].weather, "CLEAR");
+	EXPECT_EQ(cfg.settings[0].hour, 6);
+	EXPECT_EQ(cfg.settings[1].weather, "CLEAR");
+	EXPECT_EQ(cfg.settings[1].hour, 18);
+	EXPECT_EQ(cfg.settings[1].minute, 30);
+	EXPECT_EQ(cfg.settings[2].weather, "RAIN");
+}
+
+TEST(EnvironmentCommand, Off)
+{
+	bool enable = true;
+	EnvironmentSweepConfig cfg;
+	ASSERT_TRUE(parseEnvironmentCommand("ENV_SWEEP OFF", enable, cfg));
+	EXPECT_FALSE(enable);
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP OFF weather=RAIN", enable, cfg));
+}
+
+TEST(EnvironmentCommand, Rejects)
+{
+	bool enable;
+	EnvironmentSweepConfig cfg;
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP weather=DRIZZLE", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP time=24:00", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP time=12:60", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP time=12-30", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP weather=RAIN settle=-1", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP weather=RAIN settle=x", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("ENV_SWEEP weather=RAIN fog=1", enable, cfg));
+	EXPECT_FALSE(parseEnvironmentCommand("LOCKSTEP weather=RAIN", enable, cfg));
+}
+
+TEST(EnvironmentMetadata, Members)
+{
+	EnvironmentSetting s;
+	EXPECT_EQ(environmentMetadata(s), "");
+	s.weather = "FOGGY";
+	EXPECT_EQ(environmentMetadata(s), "\"weather\":\"FOGGY\"");
+	s.hour = 7;
+	s.minute = 5;
+	EXPECT_EQ(environmentMetadata(s), "\"weather\":\"FOGGY\",\"clock\":\"07:05\"");
+}
+
+// Drives one round to the end, returning the settings captured in order.
+static std::vector<int> runRound(EnvironmentSweep& sweep, int& frame, int& applies)
+{
+	std::vector<int> captured;
+	EnvironmentSetting setting;
+	std::string metadata;
+	for (int guard = 0; guard < 1000; ++guard) {
+		switch (sweep.tick(frame++, true, setting, metadata)) {
+		case EnvironmentSweep::Apply:
+			++applies;
+			break;
+		case EnvironmentSweep::Capture: {
+			size_t at = metadata.find("\"env_index\":");
+			EXPECT_NE(at, std::string::npos);
+			captured.push_back(std::stoi(metadata.substr(at + 12)));
+			break;
+		}
+		case EnvironmentSweep::Finished:
+			return captured;
+		default:
+			break;
+		}
+	}
+	ADD_FAILURE() << "round did not finish";
+	return captured;
+}
+
+TEST(EnvironmentSweep, AlternatesDirection)
+{
+	bool enable;
+	EnvironmentSweepConfig cfg;
+	ASSERT_TRUE(parseEnvironmentCommand("ENV_SWEEP weather=CLEAR,RAIN,FOGGY settle=1 weather_settle=2", enable, cfg));
+	EnvironmentSweep sweep;
+	sweep.configure(cfg);
+	int frame = 0, applies = 0;
+	sweep.start("\"pose\":1", 0, 1, frame);
+	EXPECT_EQ(runRound(sweep, frame, applies), (std::vector<int>{ 0, 1, 2 }));
+	EXPECT_EQ(applies, 3);
+	// the world is left in the last setting, so the next pose starts there
+	applies = 0;
+	sweep.start("\"pose\":2", 0, 2, frame);
+	EXPECT_EQ(runRound(sweep, frame, applies), (std::vector<int>{ 2, 1, 0 }));
+	EXPECT_EQ(applies, 2);
+	// turned off and on again (the world changed meanwhile): every setting
+	// is applied again, from the first
+	applies = 0;
+	sweep.cancel();
+	sweep.configure(cfg);
+	sweep.start("\"pose\":3", 0, 3, frame);
+	EXPECT_EQ(runRound(sweep, frame, applies), (std::vector<int>{ 0, 1, 2 }));
+	EXPECT_EQ(applies, 3);
+}
+
+TEST(EnvironmentSweep, WaitsForSettleFrames)
+{
+	bool enable;
+	EnvironmentSweepConfig cfg;
+	ASSERT_TRUE(parseEnvironmentCommand("ENV_SWEEP weather=SNOW weather_settle=5", enable, cfg));
+	EnvironmentSweep sweep;
+	sweep.configure(cfg);
+	EnvironmentSetting setting;
+	std::string metadata;
+	sweep.start("", 0, 1, 100);
+	ASSERT_EQ(sweep.tick(100, true, setting, metadata), EnvironmentSweep::Apply);
+	EXPECT_EQ(setting.weather, "SNOW");
+	for (int f = 100; f < 105; ++f) EXPECT_EQ(sweep.tick(f, true, setting, metadata), EnvironmentSweep::Idle);
+	EXPECT_EQ(sweep.tick(105, false, setting, metadata), EnvironmentSweep::Idle);
+	ASSERT_EQ(sweep.tick(105, true, setting, metadata), EnvironmentSweep::Capture);
+	EXPECT_EQ(metadata, "\"env_round\":1,\"env_index\":0,\"env_count\":1,\"weather\":\"SNOW\"");
+	EXPECT_EQ(sweep.tick(106, false, setting, metadata), EnvironmentSweep::Idle);
+	EXPECT_EQ(sweep.tick(107, true, setting, metadata), EnvironmentSweep::Finished);
+	EXPECT_FALSE(sweep.active());
+}
@@ -0,0 +1,111 @@
+#include "flow.h"
+#include "scene.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+// A camera at the origin facing a wall at x = 20 (yaw -90 faces +x), and
+// the same wall seen after an ego-motion.
+class EgoFlow : public ::testing::Test {
+protected:
+	static const int width = 160, height = 90;
+
+	std::shared_ptr<CapturedFrame> wall(const Eigen::Vector3f& position, float yaw = -90.0f, float distance = 20.0f)
+	{
+		return planeFrame(sceneMatrices(position, yaw, 0.0f, width, height), width, height, Eigen::Vector3f::UnitX(),
+			distance);
+	}
+	float fx() const { return base_->P(0, 0); }
+
+	std::shared_ptr<CapturedFrame> base_ = wall(Eigen::Vector3f::Zero());
+	std::vector<float> flow_;
+	std::vector<unsigned char> valid_;
+};
+
+TEST_F(EgoFlow, StaticCameraHasNoFlow)
+{
+	computeEgoFlow(*base_, *base_, flow_, valid_);
+	ASSERT_EQ(flow_.size(), (size_t)width * height * 2);
+	for (float f : flow_) ASSERT_NEAR(f, 0.0f, 1e-3f);
+	for (unsigned char v : valid_) ASSERT_EQ(v, 1);
+}
+
+// Moving 1 m to the right (-y when facing +x) shifts the whole wall left by
+// fx / 20 in normalized coordinates.
+TEST_F(EgoFlow, SidewaysTranslation)
+{
+	auto moved = wall(Eigen::Vector3f(0.0f, -1.0f, 0.0f));
+	computeEgoFlow(*base_, *moved, flow_, valid_);
+	const float dx = -fx() / 20.0f * 0.5f * width;
+	size_t validCount = 0;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t i = (size_t)y * width + x;
+			ASSERT_NEAR(flow_[i * 2], dx, 1e-2f) << x << "," << y;
+			ASSERT_NEAR(flow_[i * 2 + 1], 0.0f, 1e-2f) << x << "," << y;
+			// valid exactly where the point stays inside the image
+			bool inside = x + 0.5f + dx >= 0.0f;
+			if (std::abs(x + 0.5f + dx) > 0.01f) {
+				EXPECT_EQ(valid_[i], inside ? 1 : 0) << x << "," << y;
+			}
+			validCount += valid_[i];
+		}
+	}
+	EXPECT_GT(validCount, (size_t)width * height / 2);
+}
+
+// Moving 2 m towards the wall scales image positions about the centre by
+// 20 / 18.
+TEST_F(EgoFlow, ForwardTranslation)
+{
+	auto moved = wall(Eigen::Vector3f(2.0f, 0.0f, 0.0f));
+	computeEgoFlow(*base_, *moved, flow_, valid_);
+	const float scale = 20.0f / 18.0f;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t i = (size_t)y * width + x;
+			float ox = x + 0.5f - 0.5f * width, oy = y + 0.5f - 0.5f * height;
+			ASSERT_NEAR(flow_[i * 2], ox * (scale - 1.0f), 1e-2f) << x << "," << y;
+			ASSERT_NEAR(flow_[i * 2 + 1], oy * (scale - 1.0f), 1e-2f) << x << "," << y;
+			float u = 0.5f * width + ox * scale, v = 0.5f * height + oy * scale;
+			bool inside = u >= 0.0f && u < width && v >= 0.0f && v < height;
+			if (std::abs(std::abs(ox * scale) - 0.5f * width) > 0.01f && std::abs(std::abs(oy * scale) - 0.5f * height) > 0.01f) {
+				EXPECT_EQ(valid_[i], inside ? 1 : 0) << x << "," << y;
+			}
+		}
+	}
+}
+
+// Yawing in place moves every pixel of a row by the same amount whatever
+// its depth: tan(angle) of the rotation at the image centre.
+TEST_F(EgoFlow, YawAtCentre)
+{
+	auto turned = wall(Eigen::Vector3f::Zero(), -85.0f);
+	computeEgoFlow(*base_, *turned, flow_, valid_);
+	size_t centre = (size_t)(height / 2) * width + width / 2;
+	float ox = width / 2 + 0.5f - 0.5f * width;
+	float angle = std::atan(ox / (0.5f * width) / fx()) + 5.0f * 0.01745329f;
+	float expected = std::tan(angle) * fx() * 0.5f * width - ox;
+	EXPECT_NEAR(flow_[centre * 2], expected, 1e-2f);
+	EXPECT_GT(flow_[centre * 2], 0.0f);
+	EXPECT_EQ(valid_[centre], 1);
+}
+
+// Where `to` sees something else in front of the reprojected point, the
+// flow is flagged as occluded.
+TEST_F(EgoFlow, Occlusion)
+{
+	auto blocked = wall(Eigen::Vector3f::Zero(), -90.0f, 10.0f);
+	computeEgoFlow(*base_, *blocked, flow_, valid_);
+	for (unsigned char v : valid_) ASSERT_EQ(v, 0);
+}
+
+TEST_F(EgoFlow, SkyHasNoFlow)
+{
+	auto sky = wall(Eigen::Vector3f::Zero());
+	std::fill(sky->depth.begin(), sky->depth.begin() + width * 10, 0.0f);
+	computeEgoFlow(*sky, *wall(Eigen::Vector3f(2.0f, 0.0f, 0.0f)), flow_, valid_);
+	for (int i = 0; i < width * 10; ++i) {
+		EXPECT_EQ(valid_[i], 0);
+		EXPECT_EQ(flow_[i * 2], 0.0f);
+	}
+}
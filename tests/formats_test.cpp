@@ -0,0 +1,188 @@
+#include "formats.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <cstring>
+#include <filesystem>
+
+static uint32_t get32be(const unsigned char* p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint32_t get32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get16(const unsigned char* p)
+{
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+// The check value of the CRC catalogue and the iSCSI vectors of RFC 3720,
+// B.4.
+TEST(Crc32c, KnownVectors)
+{
+	EXPECT_EQ(crc32c("123456789", 9), 0xE3069283u);
+	unsigned char block[32];
+	memset(block, 0, sizeof(block));
+	EXPECT_EQ(crc32c(block, sizeof(block)), 0x8A9136AAu);
+	memset(block, 0xFF, sizeof(block));
+	EXPECT_EQ(crc32c(block, sizeof(block)), 0x62A8AB43u);
+	for (int i = 0; i < 32; ++i) block[i] = (unsigned char)i;
+	EXPECT_EQ(crc32c(block, sizeof(block)), 0x46DD794Eu);
+	EXPECT_EQ(crc32c(block, 0), 0u);
+}
+
+// Any split into chained calls and any alignment give the same checksum.
+TEST(Crc32c, ChainsAndIgnoresAlignment)
+{
+	std::vector<unsigned char> data(1000);
+	for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)(i * 131 + 7);
+	const uint32_t whole = crc32c(data.data() + 3, 900);
+	for (size_t split : { 0, 1, 7, 8, 9, 450, 899, 900 }) {
+		EXPECT_EQ(crc32c(data.data() + 3 + split, 900 - split, crc32c(data.data() + 3, split)), whole) << split;
+	}
+	std::vector<unsigned char> moved(data.begin() + 3, data.begin() + 903);
+	EXPECT_EQ(crc32c(moved.data(), moved.size()), whole);
+}
+
+TEST(TfRecord, Framing)
+{
+	const std::string text = "hello tfrecord";
+	std::vector<unsigned char> record(text.begin(), text.end());
+	unsigned char header[12], footer[4];
+	frameTfRecord(record, header, footer);
+	uint64_t length = 0;
+	memcpy(&length, header, 8);
+	EXPECT_EQ(length, record.size());
+	EXPECT_EQ(get32(header + 8), 0x3F69E5C5u);
+	EXPECT_EQ(get32(footer), 0x22765B9Fu);
+}
+
+// Chunk lengths and CRCs, IHDR, and the IDAT that inflates back to the
+// Up-filtered rows of the image.
+TEST(PngGray16, ChunksAndPixels)
+{
+	const int width = 37, height = 11;
+	std::vector<uint16_t> pixels((size_t)width * height);
+	for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (uint16_t)(i * 2654435761u >> 7);
+	std::vector<unsigned char> png, scratch;
+	ASSERT_TRUE(encodePngGray16(pixels.data(), width, height, 6, png, scratch));
+
+	ASSERT_GE(png.size(), 8u);
+	EXPECT_EQ(memcmp(png.data(), "\x89PNG\r\n\x1A\n", 8), 0);
+	std::vector<std::string> types;
+	std::vector<unsigned char> idat;
+	size_t at = 8;
+	while (at + 12 <= png.size()) {
+		const uint32_t length = get32be(&png[at]);
+		ASSERT_LE(at + 12 + length, png.size());
+		const std::string type((const char*)&png[at + 4], 4);
+		types.push_back(type);
+		EXPECT_EQ(get32be(&png[at + 8 + length]), (uint32_t)crc32(0, &png[at + 4], 4 + length)) << type;
+		if (type == "IHDR") {
+			ASSERT_EQ(length, 13u);
+			EXPECT_EQ(get32be(&png[at + 8]), (uint32_t)width);
+			EXPECT_EQ(get32be(&png[at + 12]), (uint32_t)height);
+			EXPECT_EQ(png[at + 16], 16);	// bit depth
+			EXPECT_EQ(png[at + 17], 0);		// gray
+		}
+		if (type == "IDAT") idat.insert(idat.end(), &png[at + 8], &png[at + 8] + length);
+		at += 12 + length;
+	}
+	EXPECT_EQ(at, png.size());
+	EXPECT_EQ(types, std::vector<std::string>({ "IHDR", "IDAT", "IEND" }));
+
+	const size_t rowBytes = (size_t)width * 2 + 1;
+	std::vector<unsigned char> rows(rowBytes * height);
+	uLongf size = (uLongf)rows.size();
+	ASSERT_EQ(uncompress(rows.data(), &size, idat.data(), (uLong)idat.size()), Z_OK);
+	ASSERT_EQ(size, rows.size());
+	std::vector<unsigned char> above(rowBytes - 1, 0);
+	for (int y = 0; y < height; ++y) {
+		const unsigned char* row = &rows[rowBytes * y];
+		ASSERT_EQ(row[0], 2) << y;	// Up
+		for (int x = 0; x < width; ++x) {
+			unsigned char hi = (unsigned char)(row[1 + 2 * x] + above[2 * x]);
+			unsigned char lo = (unsigned char)(row[2 + 2 * x] + above[2 * x + 1]);
+			ASSERT_EQ((uint16_t)(hi << 8 | lo), pixels[(size_t)y * width + x]) << x << "," << y;
+			above[2 * x] = hi;
+			above[2 * x + 1] = lo;
+		}
+	}
+}
+
+// The zip local header, the .npy header numpy.load expects (version 1.0,
+// 64-byte aligned data) and the central directory.
+TEST(Npz, Headers)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "dronesim_test.npz").string();
+	const float depth[6] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+	const unsigned char label[3] = { 7, 8, 9 };
+	std::string error;
+	{
+		NpzWriter npz;
+		ASSERT_TRUE(npz.open(path, error)) << error;
+		ASSERT_TRUE(npz.add("depth", "<f4", { 2, 3 }, depth, sizeof(depth), error)) << error;
+		ASSERT_TRUE(npz.add("label", "|u1", { 3 }, label, sizeof(label), error)) << error;
+		ASSERT_TRUE(npz.close(error)) << error;
+	}
+	std::vector<unsigned char> file;
+	ASSERT_TRUE(readWholeFile(path, file, error)) << error;
+	std::filesystem::remove(path);
+
+	struct Expected {
+		std::string name, dict;
+		const void* data;
+		size_t bytes;
+	};
+	const Expected members[2] = {
+		{ "depth.npy", "{'descr': '<f4', 'fortran_order': False, 'shape': (2,3), }", depth, sizeof(depth) },
+		{ "label.npy", "{'descr': '|u1', 'fortran_order': False, 'shape': (3,), }", label, sizeof(label) },
+	};
+	size_t at = 0;
+	std::vector<size_t> offsets;
+	for (const Expected& m : members) {
+		ASSERT_LE(at + 30, file.size());
+		offsets.push_back(at);
+		const unsigned char* local = &file[at];
+		EXPECT_EQ(get32(local), 0x04034B50u);
+		EXPECT_EQ(get16(local + 8), 0);	// stored
+		const uint32_t size = get32(local + 18);
+		EXPECT_EQ(get32(local + 22), size);
+		ASSERT_EQ(get16(local + 26), m.name.size());
+		EXPECT_EQ(std::string((const char*)local + 30, m.name.size()), m.name);
+
+		const size_t npyAt = at + 30 + m.name.size();
+		ASSERT_LE(npyAt + size, file.size());
+		const unsigned char* npy = &file[npyAt];
+		EXPECT_EQ(get32(local + 14), (uint32_t)crc32(0, npy, size));
+		EXPECT_EQ(memcmp(npy, "\x93NUMPY\x01\x00", 8), 0);
+		const uint16_t headerBytes = get16(npy + 8);
+		EXPECT_EQ((10 + headerBytes) % 64, 0);
+		const std::string header((const char*)npy + 10, headerBytes);
+		EXPECT_EQ(header.compare(0, m.dict.size(), m.dict), 0) << header;
+		EXPECT_EQ(header.find_first_not_of(' ', m.dict.size()), headerBytes - 1u);
+		EXPECT_EQ(header.back(), '\n');
+		ASSERT_EQ(size, 10 + headerBytes + m.bytes);
+		EXPECT_EQ(memcmp(npy + 10 + headerBytes, m.data, m.bytes), 0);
+		at = npyAt + size;
+	}
+
+	const size_t directory = at;
+	for (size_t i = 0; i < 2; ++i) {
+		ASSERT_LE(at + 46, file.size());
+		const unsigned char* central = &file[at];
+		EXPECT_EQ(get32(central), 0x02014B50u);
+		EXPECT_EQ(get32(central + 16), get32(&file[offsets[i] + 14]));
+		EXPECT_EQ(get32(central + 42), offsets[i]);
+		EXPECT_EQ(std::string((const char*)central + 46, get16(central + 28)), members[i].name);
+		at += 46 + get16(central + 28);
+	}
+	ASSERT_EQ(at + 22, file.size());
+	EXPECT_EQ(get32(&file[at]), 0x06054B50u);
+	EXPECT_EQ(get16(&file[at + 10]), 2);
+	EXPECT_EQ(get32(&file[at + 12]), at - directory);
+	EXPECT_EQ(get32(&file[at + 16]), directory);
+}
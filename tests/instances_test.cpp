@@ -0,0 +1,144 @@
+#include "instances.h"
+#include "synthetic.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+struct LabelImage {
+	int width, height;
+	std::vector<unsigned char> labels;
+	std::vector<float> depth;
+
+	LabelImage(int w, int h) : width(w), height(h), labels((size_t)w * h, 0), depth((size_t)w * h, 10.0f) {}
+	void fill(int x0, int y0, int x1, int y1, unsigned char label, float z)
+	{
+		for (int y = y0; y <= y1; ++y) {
+			for (int x = x0; x <= x1; ++x) {
+				labels[(size_t)y * width + x] = label;
+				depth[(size_t)y * width + x] = z;
+			}
+		}
+	}
+};
+
+TEST(Instances, SeparateBlocks)
+{
+	LabelImage img(64, 48);
+	img.fill(40, 2, 49, 11, 3, 12.0f);	// first in raster order
+	img.fill(5, 20, 14, 29, 3, 30.0f);
+	img.fill(30, 30, 33, 33, 5, 8.0f);
+	std::vector<InstanceRecord> instances;
+	std::vector<uint32_t> ids;
+	labelInstances(img.labels, img.depth, img.width, img.height, instances, &ids);
+	ASSERT_EQ(instances.size(), 3u);
+	const InstanceRecord& a = instances[0];
+	EXPECT_EQ(a.id, 1u);
+	EXPECT_EQ(a.classId, 3);
+	EXPECT_EQ(a.x0, 40);
+	EXPECT_EQ(a.y0, 2);
+	EXPECT_EQ(a.x1, 49);
+	EXPECT_EQ(a.y1, 11);
+	EXPECT_EQ(a.area, 100u);
+	EXPECT_FLOAT_EQ(a.medianDepth, 12.0f);
+	EXPECT_EQ(instances[1].x0, 5);
+	EXPECT_FLOAT_EQ(instances[1].medianDepth, 30.0f);
+	EXPECT_EQ(instances[2].classId, 5);
+	EXPECT_EQ(instances[2].area, 16u);
+	EXPECT_EQ(ids[2 * 64 + 40], 1u);
+	EXPECT_EQ(ids[25 * 64 + 10], 2u);
+	EXPECT_EQ(ids[0], 0u);
+}
+
+TEST(Instances, DepthJumpSplits)
+{
+	LabelImage img(40, 20);
+	img.fill(0, 0, 19, 9, 2, 10.0f);
+	img.fill(20, 0, 39, 9, 2, 10.4f);	// within 5 %: same object
+	img.fill(0, 10, 39, 19, 2, 20.0f);	// 100 % further: a new one
+	std::vector<InstanceRecord> instances;
+	labelInstances(img.labels, img.depth, img.width, img.height, instances);
+	ASSERT_EQ(instances.size(), 2u);
+	EXPECT_EQ(instances[0].area, 400u);
+	EXPECT_EQ(instances[1].area, 400u);
+	EXPECT_EQ(instances[1].y0, 10);
+	labelInstances(img.labels, img.depth, img.width, img.height, instances, nullptr, 0.01f);
+	EXPECT_EQ(instances.size(), 3u);
+}
+
+TEST(Instances, SmallAndSkyDropped)
+{
+	LabelImage img(32, 32);
+	img.fill(0, 0, 2, 2, 4, 5.0f);		// 9 pixels < minArea
+	img.fill(10, 10, 20, 20, 4, 5.0f);
+	img.fill(10, 10, 20, 12, 4, 0.0f);	// sky rows cut off the top
+	std::vector<InstanceRecord> instances;
+	std::vector<uint32_t> ids;
+	labelInstances(img.labels, img.depth, img.width, img.height, instances, &ids);
+	ASSERT_EQ(instances.size(), 1u);
+	EXPECT_EQ(instances[0].y0, 13);
+	EXPECT_EQ(instances[0].area, 11u * 8u);
+	EXPECT_EQ(ids[0], 0u);
+	EXPECT_EQ(ids[10 * 32 + 10], 0u);
+	labelInstances(img.labels, img.depth, img.width, img.height, instances, nullptr, 0.05f, 1);
+	EXPECT_EQ(instances.size(), 2u);
+}
+
+// A tall U: its arms only meet at the bottom, so it must be joined across
+// every strip border.
+TEST(Instances, JoinsAcrossRows)
+{
+	LabelImage img(16, 400);
+	img.fill(1, 0, 3, 399, 6, 10.0f);
+	img.fill(12, 0, 14, 399, 6, 10.0f);
+	img.fill(1, 397, 14, 399, 6, 10.0f);
+	std::vector<InstanceRecord> instances;
+	labelInstances(img.labels, img.depth, img.width, img.height, instances);
+	ASSERT_EQ(instances.size(), 1u);
+	EXPECT_EQ(instances[0].x1, 14);
+	EXPECT_EQ(instances[0].y1, 399);
+}
+
+// Against a flood fill over a noisy image: the same partition of pixels.
+TEST(Instances, MatchesFloodFill)
+{
+	const int width = 200, height = 150;
+	std::vector<unsigned char> labels((size_t)width * height);
+	std::vector<float> depth((size_t)width * height);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t i = (size_t)y * width + x;
+			labels[i] = (unsigned char)(benchHash((uint32_t)((x / 7) * 131 + (y / 5))) % 4);
+			depth[i] = benchHash((uint32_t)i) % 50 == 0 ? 0.0f : 10.0f + (float)((x / 11 + y / 13) % 3) * 2.0f;
+		}
+	}
+	std::vector<InstanceRecord> instances;
+	std::vector<uint32_t> ids;
+	labelInstances(labels, depth, width, height, instances, &ids, 0.05f, 1);
+
+	std::vector<int> component((size_t)width * height, -1);
+	int components = 0;
+	for (size_t seed = 0; seed < component.size(); ++seed) {
+		if (labels[seed] == 0 || !(depth[seed] > 0.0f) || component[seed] >= 0) continue;
+		std::vector<size_t> stack{ seed };
+		component[seed] = components;
+		while (!stack.empty()) {
+			size_t i = stack.back();
+			stack.pop_back();
+			int x = (int)(i % width), y = (int)(i / width);
+			const int dx[4] = { -1, 1, 0, 0 }, dy[4] = { 0, 0, -1, 1 };
+			for (int k = 0; k < 4; ++k) {
+				int nx = x + dx[k], ny = y + dy[k];
+				if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+				size_t j = (size_t)ny * width + nx;
+				if (component[j] >= 0 || labels[j] != labels[i] || !(depth[j] > 0.0f)) continue;
+				if (std::fabs(depth[i] - depth[j]) > 0.05f * std::min(depth[i], depth[j])) continue;
+				component[j] = components;
+				stack.push_back(j);
+			}
+		}
+		++components;
+	}
+	ASSERT_EQ(instances.size(), (size_t)components);
+	// ids are numbered in raster order of first pixels, as flood fill seeds are
+	for (size_t i = 0; i < component.size(); ++i) ASSERT_EQ((int)ids[i] - 1, component[i]) << i;
+}
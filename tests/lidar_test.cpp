@@ -0,0 +1,180 @@
+#include "lidar.h"
+#include "scene.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+static const float DEG2RAD = 0.01745329f;
+
+TEST(LidarCommand, Parses)
+{
+	LidarConfig cfg;
+	ASSERT_TRUE(parseLidarCommand("LIDAR 64 10 -30 0.5 0.02 120 4", cfg));
+	EXPECT_EQ(cfg.channels, 64);
+	EXPECT_EQ(cfg.verticalFovUp, 10.0f);
+	EXPECT_EQ(cfg.verticalFovDown, -30.0f);
+	EXPECT_EQ(cfg.azimuthResolution, 0.5f);
+	EXPECT_EQ(cfg.rangeNoise, 0.02f);
+	EXPECT_EQ(cfg.maxRange, 120.0f);
+	EXPECT_EQ(cfg.frames, 4);
+	LidarConfig defaults;
+	ASSERT_TRUE(parseLidarCommand("LIDAR 16", defaults));
+	EXPECT_EQ(defaults.channels, 16);
+	EXPECT_EQ(defaults.maxRange, LidarConfig().maxRange);
+}
+
+TEST(LidarCommand, Rejects)
+{
+	LidarConfig cfg;
+	EXPECT_FALSE(parseLidarCommand("RADAR 32", cfg));
+	EXPECT_FALSE(parseLidarCommand("LIDAR x", cfg));
+	EXPECT_FALSE(parseLidarCommand("LIDAR 0", cfg));
+	EXPECT_FALSE(parseLidarCommand("LIDAR 32 -10 10", cfg));
+	EXPECT_FALSE(parseLidarCommand("LIDAR 32 15 -25 0", cfg));
+	EXPECT_FALSE(parseLidarCommand("LIDAR 32 15 -25 0.001", cfg));
+	EXPECT_FALSE(parseLidarCommand("LIDAR 32 15 -25 0.2 -1", cfg));
+}
+
+// A wall at x = 20 seen by a camera at the origin facing +x: every return
+// lies on the wall, at the beam's elevation and azimuth.
+TEST(LidarScan, WallRangeAndAngle)
+{
+	const int width = 320, height = 180;
+	auto frame = planeFrame(sceneMatrices(Eigen::Vector3f::Zero(), -90.0f, 0.0f, width, height), width, height,
+		Eigen::Vector3f::UnitX(), 20.0f);
+	LidarConfig cfg;
+	cfg.channels = 16;
+	cfg.azimuthResolution = 1.0f;
+	LidarScan scan = simulateLidarScan({ frame }, cfg);
+	EXPECT_EQ(scan.azimuthSteps, 360);
+	ASSERT_FALSE(scan.points.empty());
+
+	// 60 degrees vertically at 16:9 is about 92 degrees across
+	const float halfFovH = std::atan(std::tan(30.0f * DEG2RAD) * width / height) / DEG2RAD;
+	const float elevStep = (cfg.verticalFovUp - cfg.verticalFovDown) / (cfg.channels - 1);
+	std::vector<int> perAzimuth(scan.azimuthSteps, 0);
+	for (const LidarPoint& p : scan.points) {
+		float az = p.azimuth * cfg.azimuthResolution;
+		if (az > 180.0f) az -= 360.0f;
+		float elev = cfg.verticalFovDown + p.ring * elevStep;
+		float range = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+		EXPECT_NEAR(p.x, 20.0f, 0.3f) << "ring " << p.ring << " azimuth " << az;
+		EXPECT_NEAR(range, 20.0f / (std::cos(elev * DEG2RAD) * std::cos(az * DEG2RAD)), 0.5f);
+		EXPECT_NEAR(std::atan2(p.y, p.x) / DEG2RAD, az, 1e-3f);
+		EXPECT_NEAR(std::asin(p.z / range) / DEG2RAD, elev, 1e-3f);
+		EXPECT_LT(std::abs(az), halfFovH);
+		perAzimuth[p.azimuth]++;
+	}
+	// the lower beams see the wall across the whole image width
+	for (int az = -40; az <= 40; ++az) EXPECT_GT(perAzimuth[(az + 360) % 360], 0) << "azimuth " << az;
+}
+
+// Four captures from one spot, yawed 90 degrees apart, each facing a wall of
+// a 40 m square room: stitched, they cover every azimuth once, each beam
+// taken from the capture that sees it nearest the image centre.
+TEST(LidarScan, StitchesYawedCaptures)
+{
+	const int width = 320, height = 180;
+	const Eigen::Vector3f facing[4] = { Eigen::Vector3f::UnitX(), Eigen::Vector3f::UnitY(), -Eigen::Vector3f::UnitX(),
+		-Eigen::Vector3f::UnitY() };
+	std::vector<std::shared_ptr<const CapturedFrame>> frames;
+	for (int k = 0; k < 4; ++k) {
+		frames.push_back(planeFrame(sceneMatrices(Eigen::Vector3f::Zero(), -90.0f + 90.0f * k, 0.0f, width, height),
+			width, height, facing[k], 20.0f, 4 - k));
+	}
+	LidarConfig cfg;
+	cfg.channels = 16;
+	cfg.azimuthResolution = 1.0f;
+	LidarScan scan = simulateLidarScan(frames, cfg);
+	EXPECT_EQ(scan.frameId, 4u);
+	ASSERT_EQ(scan.azimuthSteps, 360);
+
+	const float elevStep = (cfg.verticalFovUp - cfg.verticalFovDown) / (cfg.channels - 1);
+	std::vector<std::vector<int>> hits(cfg.channels, std::vector<int>(scan.azimuthSteps, 0));
+	for (const LidarPoint& p : scan.points) {
+		ASSERT_LT(p.ring, cfg.channels);
+		ASSERT_LT(p.azimuth, scan.azimuthSteps);
+		hits[p.ring][p.azimuth]++;
+		// on the wall facing the beam's quadrant
+		float az = p.azimuth * cfg.azimuthResolution;
+		EXPECT_NEAR(std::max(std::abs(p.x), std::abs(p.y)), 20.0f, 0.3f) << "ring " << p.ring << " azimuth " << az;
+		EXPECT_NEAR(std::remainder(std::atan2(p.y, p.x) / DEG2RAD - az, 360.0f), 0.0f, 1e-3f);
+	}
+	for (int ring = 0; ring < cfg.channels; ++ring) {
+		// beams within 15 degrees of the horizon stay inside the image even at
+		// the corners between two captures
+		const bool level = std::abs(cfg.verticalFovDown + ring * elevStep) <= 15.0f;
+		for (int az = 0; az < scan.azimuthSteps; ++az) {
+			EXPECT_LE(hits[ring][az], 1) << "ring " << ring << " azimuth " << az;
+			if (level) {
+				EXPECT_EQ(hits[ring][az], 1) << "ring " << ring << " azimuth " << az;
+			}
+		}
+	}
+
+	// one capture alone covers only its own quarter or so
+	LidarScan single = simulateLidarScan({ frames[0] }, cfg);
+	EXPECT_LT(single.points.size() * 3, scan.points.size());
+}
+
+TEST(LidarScan, MaxRangeDropsReturns)
+{
+	const int width = 160, height = 90;
+	auto frame = planeFrame(sceneMatrices(Eigen::Vector3f::Zero(), -90.0f, 0.0f, width, height), width, height,
+		Eigen::Vector3f::UnitX(), 50.0f);
+	LidarConfig cfg;
+	cfg.maxRange = 40.0f;
+	EXPECT_TRUE(simulateLidarScan({ frame }, cfg).points.empty());
+}
+
+TEST(LidarScan, NoisePerCapture)
+{
+	const int width = 160, height = 90;
+	const rage_matrices m = sceneMatrices(Eigen::Vector3f::Zero(), -90.0f, 0.0f, width, height);
+	auto first = planeFrame(m, width, height, Eigen::Vector3f::UnitX(), 20.0f, 1);
+	auto second = planeFrame(m, width, height, Eigen::Vector3f::UnitX(), 20.0f, 2);
+	LidarConfig exact, noisy;
+	exact.azimuthResolution = noisy.azimuthResolution = 0.5f;
+	noisy.rangeNoise = 0.1f;
+	noisy.seed = 7;
+	LidarScan truth = simulateLidarScan({ first }, exact);
+	LidarScan a = simulateLidarScan({ first }, noisy);
+	LidarScan again = simulateLidarScan({ first }, noisy);
+	LidarScan b = simulateLidarScan({ second }, noisy);
+	ASSERT_EQ(a.points.size(), truth.points.size());
+	ASSERT_EQ(b.points.size(), truth.points.size());
+
+	double sum = 0.0, sum2 = 0.0;
+	size_t same = 0;
+	for (size_t i = 0; i < truth.points.size(); ++i) {
+		auto range = [](const LidarPoint& p) { return std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z); };
+		double e = range(a.points[i]) - range(truth.points[i]);
+		sum += e;
+		sum2 += e * e;
+		EXPECT_EQ(a.points[i].x, again.points[i].x);
+		same += a.points[i].x == b.points[i].x;
+	}
+	double n = (double)truth.points.size(), mean = sum / n;
+	EXPECT_NEAR(mean, 0.0, 0.01);
+	EXPECT_NEAR(std::sqrt(sum2 / n - mean * mean), 0.1, 0.01);
+	// a later capture does not replay the same noise
+	EXPECT_LT(same, truth.points.size() / 100);
+}
+
+TEST(LidarScan, SerializedHeader)
+{
+	LidarScan scan;
+	scan.frameId = 42;
+	scan.azimuthSteps = 1800;
+	scan.points.push_back(LidarPoint{ 1.0f, 2.0f, 3.0f, 4, 5 });
+	LidarConfig cfg;
+	std::vector<unsigned char> out = serializeLidarScan(scan, cfg);
+	ASSERT_EQ(out.size(), sizeof(LidarScanHeader) + sizeof(LidarPoint));
+	LidarScanHeader header;
+	memcpy(&header, out.data(), sizeof(header));
+	EXPECT_EQ(memcmp(header.magic, "LIDR", 4), 0);
+	EXPECT_EQ(header.pointCount, 1u);
+	EXPECT_EQ(header.channels, 32);
+	EXPECT_EQ(header.azimuthSteps, 1800);
+	EXPECT_EQ(header.frameId, 42u);
+}
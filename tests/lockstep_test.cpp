@@ -0,0 +1,62 @@
+#include "lockstep.h"
+#include <gtest/gtest.h>
+
+TEST(LockstepCommand, Parses)
+{
+	bool enable = false;
+	LockstepConfig cfg;
+	ASSERT_TRUE(parseLockstepCommand("LOCKSTEP ON settle=5 advance=2", enable, cfg));
+	EXPECT_TRUE(enable);
+	EXPECT_EQ(cfg.settleFrames, 5);
+	EXPECT_EQ(cfg.advanceFrames, 2);
+	ASSERT_TRUE(parseLockstepCommand("LOCKSTEP OFF", enable, cfg));
+	EXPECT_FALSE(enable);
+}
+
+TEST(LockstepCommand, Rejects)
+{
+	bool enable;
+	LockstepConfig cfg;
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP", enable, cfg));
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP MAYBE", enable, cfg));
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP OFF now", enable, cfg));
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP ON settle", enable, cfg));
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP ON settle=x", enable, cfg));
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP ON settle=-2", enable, cfg));
+	EXPECT_FALSE(parseLockstepCommand("LOCKSTEP ON speed=2", enable, cfg));
+}
+
+TEST(LockstepRunner, FrozenStep)
+{
+	LockstepConfig cfg;
+	cfg.settleFrames = 3;
+	LockstepRunner runner;
+	runner.configure(cfg);
+	EXPECT_EQ(runner.tick(0, true), LockstepRunner::Idle);
+	runner.begin(10);
+	EXPECT_TRUE(runner.busy());
+	EXPECT_EQ(runner.step(), 1u);
+	EXPECT_EQ(runner.tick(12, true), LockstepRunner::Idle);
+	EXPECT_EQ(runner.tick(13, false), LockstepRunner::Idle);
+	EXPECT_EQ(runner.tick(13, true), LockstepRunner::Capture);
+	EXPECT_EQ(runner.tick(14, false), LockstepRunner::Idle);
+	EXPECT_EQ(runner.tick(15, true), LockstepRunner::StepDone);
+	EXPECT_FALSE(runner.busy());
+}
+
+TEST(LockstepRunner, AdvancesThenFreezes)
+{
+	LockstepConfig cfg;
+	cfg.settleFrames = 0;
+	cfg.advanceFrames = 4;
+	LockstepRunner runner;
+	runner.configure(cfg);
+	unsigned long long steps = lockstepStats().steps;
+	runner.begin(0);
+	EXPECT_EQ(runner.tick(0, true), LockstepRunner::Capture);
+	EXPECT_EQ(runner.tick(1, true), LockstepRunner::Unfreeze);
+	EXPECT_EQ(runner.tick(4, true), LockstepRunner::Idle);
+	EXPECT_EQ(runner.tick(5, true), LockstepRunner::Freeze);
+	EXPECT_FALSE(runner.busy());
+	EXPECT_EQ(lockstepStats().steps, steps + 1);
+}
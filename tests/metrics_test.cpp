@@ -0,0 +1,207 @@
+#include "metrics.h"
+#include "latency.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Every value maps to the bucket whose range holds it, buckets are
+// contiguous, and their width stays within 1 / 2^subBits of their values.
+TEST(MetricHistogram, BucketRoundTrip)
+{
+	const int sub = 1 << MetricHistogram::subBits;
+	for (int b = 0; b + 1 < MetricHistogram::bucketCount; ++b) {
+		const int64_t lo = MetricHistogram::bucketLow(b), hi = MetricHistogram::bucketLow(b + 1);
+		ASSERT_LT(lo, hi) << b;
+		EXPECT_EQ(MetricHistogram::bucketOf(lo), b);
+		EXPECT_EQ(MetricHistogram::bucketOf(hi - 1), b);
+		EXPECT_EQ(MetricHistogram::bucketOf(hi), b + 1);
+		if (lo >= sub) {
+			EXPECT_LE((hi - lo) * sub, lo) << b;
+		}
+		else {
+			EXPECT_EQ(hi - lo, 1);
+		}
+	}
+	for (int64_t v = 0; v < 4096; ++v) {
+		const int b = MetricHistogram::bucketOf(v);
+		EXPECT_LE(MetricHistogram::bucketLow(b), v);
+		EXPECT_GT(MetricHistogram::bucketLow(b + 1), v);
+	}
+}
+
+TEST(MetricHistogram, ClampsOutOfRange)
+{
+	EXPECT_EQ(MetricHistogram::bucketOf(-5), 0);
+	const int last = MetricHistogram::bucketCount - 1;
+	EXPECT_EQ(MetricHistogram::bucketOf((int64_t)1 << MetricHistogram::maxExponent), last - (1 << MetricHistogram::subBits) + 1);
+	EXPECT_EQ(MetricHistogram::bucketOf(((int64_t)2 << MetricHistogram::maxExponent) - 1), last);
+	EXPECT_EQ(MetricHistogram::bucketOf((int64_t)1 << 60), last);
+	EXPECT_EQ(MetricHistogram::bucketOf(INT64_MAX), last);
+
+	MetricHistogram h;
+	h.record(-10);
+	EXPECT_EQ(h.count(), 1u);
+	EXPECT_EQ(h.max(), 0);
+	EXPECT_EQ(h.quantile(0.5), 0.0);
+}
+
+// Values on either side of a bucket edge come back on their own side.
+TEST(MetricHistogram, QuantileAtBucketEdges)
+{
+	for (int64_t edge : { (int64_t)8, (int64_t)16, (int64_t)1024, (int64_t)1 << 20, (int64_t)1 << 33 }) {
+		MetricHistogram h;
+		for (int i = 0; i < 50; ++i) h.record(edge - 1);
+		for (int i = 0; i < 50; ++i) h.record(edge);
+		EXPECT_LT(h.quantile(0.25), (double)edge) << edge;
+		EXPECT_GE(h.quantile(0.25), (double)MetricHistogram::bucketLow(MetricHistogram::bucketOf(edge - 1))) << edge;
+		EXPECT_GE(h.quantile(0.75), (double)edge) << edge;
+		EXPECT_LE(h.quantile(0.75), (double)edge) << edge;	// capped at the max seen
+		EXPECT_EQ(h.quantile(1.0), (double)edge);
+		EXPECT_EQ(h.max(), edge);
+	}
+	// exact below 2^subBits
+	MetricHistogram h;
+	for (int v = 0; v < 8; ++v) h.record(v);
+	for (int v = 0; v < 8; ++v) EXPECT_EQ(h.quantile((v + 0.5) / 8.0), (double)v);
+}
+
+// Against the exact order statistics of a long-tailed sample.
+TEST(MetricHistogram, QuantileAccuracy)
+{
+	std::mt19937 rng(5);
+	std::lognormal_distribution<double> latency(7.0, 1.2);
+	std::vector<int64_t> values;
+	MetricHistogram h;
+	double sum = 0.0;
+	for (int i = 0; i < 100000; ++i) {
+		int64_t v = (int64_t)latency(rng);
+		values.push_back(v);
+		h.record(v);
+		sum += v;
+	}
+	std::sort(values.begin(), values.end());
+	EXPECT_EQ(h.count(), values.size());
+	EXPECT_EQ(h.max(), values.back());
+	EXPECT_NEAR(h.mean(), sum / values.size(), 1e-6 * sum / values.size());
+	const double resolution = 1.0 / (1 << MetricHistogram::subBits);
+	for (double q : { 0.01, 0.1, 0.5, 0.9, 0.99, 0.999 }) {
+		const double exact = (double)values[(size_t)(q * values.size())];
+		EXPECT_NEAR(h.quantile(q), exact, exact * resolution) << q;
+	}
+}
+
+TEST(MetricHistogram, ConcurrentRecords)
+{
+	MetricHistogram h;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&h, t] {
+			for (int i = 0; i < 20000; ++i) h.record(t * 1000 + i % 100);
+		});
+	}
+	for (auto& t : threads) t.join();
+	EXPECT_EQ(h.count(), 80000u);
+	EXPECT_EQ(h.max(), 3099);
+	EXPECT_NEAR(h.mean(), 1549.5, 1e-9);
+}
+
+TEST(Metrics, RegistryAndJson)
+{
+	MetricCounter& c = metricCounter("test.b_counter");
+	EXPECT_EQ(&c, &metricCounter("test.b_counter"));
+	c.add();
+	c.add(4);
+	metricCounter("test.a_counter").add(2);
+	MetricGauge& g = metricGauge("test.gauge");
+	g.set(7);
+	g.add(-5);
+	EXPECT_EQ(g.value(), 2);
+	EXPECT_EQ(g.max(), 7);
+	metricHistogram("test.histogram").record(100);
+
+	const std::string json = metricsJson();
+	EXPECT_EQ(json.compare(0, 12, "{\"uptime_s\":"), 0);
+	EXPECT_NE(json.find("\"test.b_counter\":5"), std::string::npos);
+	EXPECT_LT(json.find("\"test.a_counter\":2"), json.find("\"test.b_counter\""));
+	EXPECT_NE(json.find("\"test.gauge\":{\"value\":2,\"max\":7}"), std::string::npos);
+	// 100 falls in [96, 104): quantiles report the bucket's middle
+	EXPECT_NE(json.find("\"test.histogram\":{\"count\":1,\"mean\":100.0,\"p50\":99.5,\"p90\":99.5"), std::string::npos);
+}
+
+// Concurrent adds are not lost, and the maximum is one the gauge held.
+TEST(Metrics, ConcurrentGaugeAdds)
+{
+	MetricGauge g;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&g] {
+			for (int i = 0; i < 20000; ++i) {
+				g.add(3);
+				g.add(-1);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+	EXPECT_EQ(g.value(), 4 * 20000 * 2);
+	EXPECT_GE(g.max(), g.value());
+	EXPECT_LE(g.max(), g.value() + 4 * 3);
+}
+
+// LATENCY_STATS reads the same registry histograms that STATS reports.
+TEST(Metrics, LatencyStagesInRegistry)
+{
+	CaptureTimeline timeline;
+	timeline.us[stageCommandReceived] = 1000;
+	timeline.us[stageDequeued] = 1100;
+	timeline.us[stageCaptureArmed] = 1300;
+	const uint64_t before = metricHistogram("latency.dequeued_us").count();
+	recordCaptureStages(timeline);
+	EXPECT_EQ(metricHistogram("latency.dequeued_us").count(), before + 1);
+	EXPECT_GE(metricHistogram("latency.capture_armed_us").count(), 1u);
+
+	auto member = [](const std::string& json, const std::string& key) {
+		size_t at = json.find("\"" + key + "\":{");
+		if (at == std::string::npos) return std::string();
+		at = json.find('{', at);
+		return json.substr(at, json.find('}', at) + 1 - at);
+	};
+	const std::string stats = metricsJson(), latency = latencyStatsJson();
+	ASSERT_FALSE(member(latency, "dequeued").empty());
+	EXPECT_EQ(member(latency, "dequeued"), member(stats, "latency.dequeued_us"));
+	EXPECT_EQ(member(latency, "capture_armed"), member(stats, "latency.capture_armed_us"));
+}
+
+TEST(StatsLogCommand, Parses)
+{
+	std::string path;
+	double interval = 0.0;
+	ASSERT_TRUE(parseStatsLogCommand("STATS_LOG /tmp/stats.jsonl", path, interval));
+	EXPECT_EQ(path, "/tmp/stats.jsonl");
+	EXPECT_EQ(interval, 10.0);
+	ASSERT_TRUE(parseStatsLogCommand("STATS_LOG stats.jsonl interval=0.5", path, interval));
+	EXPECT_EQ(path, "stats.jsonl");
+	EXPECT_EQ(interval, 0.5);
+	ASSERT_TRUE(parseStatsLogCommand("STATS_LOG OFF", path, interval));
+	EXPECT_TRUE(path.empty());
+}
+
+TEST(StatsLogCommand, Rejects)
+{
+	std::string path;
+	double interval = 0.0;
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOGS a.jsonl", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG OFF now", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl period=5", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=soon", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=5s", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=0", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=-1", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=inf", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=nan", path, interval));
+	EXPECT_FALSE(parseStatsLogCommand("STATS_LOG a.jsonl interval=1e999", path, interval));
+}
@@ -0,0 +1,62 @@
+#include "pose.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(SetPose, Parses)
+{
+	CameraPose pose = {};
+	pose.fov = 50.0f;
+	bool hasFov = true;
+	ASSERT_TRUE(parseSetPose("SET_POSE 1.5 -2 300 -30 0 270.25", pose, hasFov));
+	EXPECT_FALSE(hasFov);
+	EXPECT_EQ(pose.x, 1.5f);
+	EXPECT_EQ(pose.y, -2.0f);
+	EXPECT_EQ(pose.z, 300.0f);
+	EXPECT_EQ(pose.pitch, -30.0f);
+	EXPECT_EQ(pose.yaw, 270.25f);
+	EXPECT_EQ(pose.fov, 50.0f);
+	ASSERT_TRUE(parseSetPose("SET_POSE 0 0 0 0 0 0 90", pose, hasFov));
+	EXPECT_TRUE(hasFov);
+	EXPECT_EQ(pose.fov, 90.0f);
+	EXPECT_EQ(formatCameraPose(pose), "0.0000 0.0000 0.0000 0.0000 0.0000 0.0000 90.0000");
+}
+
+TEST(SetPose, Rejects)
+{
+	CameraPose pose = {};
+	bool hasFov = false;
+	EXPECT_FALSE(parseSetPose("SET_POSE", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1 2 3 4 5", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1 2 3 4 5 6 7 8", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1 2 x 4 5 6", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1 2 3m 4 5 6", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE nan 2 3 4 5 6", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1 2 3 4 5 inf", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1 2 3 4 5 6 -INF", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("SET_POSE 1e39 2 3 4 5 6", pose, hasFov));
+	EXPECT_FALSE(parseSetPose("GET_POSE 1 2 3 4 5 6", pose, hasFov));
+}
+
+// Tickets are answered in order; a zero timeout only checks.
+TEST(CameraPoseHandOff, PublishesInTicketOrder)
+{
+	const unsigned int first = requestCameraPoseTicket();
+	const unsigned int second = requestCameraPoseTicket();
+	CameraPose pose = {};
+	EXPECT_FALSE(waitCameraPose(first, pose, 0));
+	pose.x = 1.0f;
+	publishCameraPose(pose);
+	CameraPose out = {};
+	ASSERT_TRUE(waitCameraPose(first, out, 0));
+	EXPECT_EQ(out.x, 1.0f);
+	EXPECT_FALSE(waitCameraPose(second, out, 0));
+	std::thread script([] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		CameraPose p = {};
+		p.x = 2.0f;
+		publishCameraPose(p);
+	});
+	EXPECT_TRUE(waitCameraPose(second, out, 2000));
+	EXPECT_EQ(out.x, 2.0f);
+	script.join();
+}
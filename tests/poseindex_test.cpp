@@ -0,0 +1,183 @@
+#include "poseindex.h"
+#include "dataset.h"
+#include "synthetic.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+
+// The index against brute force over the same entries.
+class PoseIndexQueries : public ::testing::Test {
+protected:
+	static void SetUpTestSuite()
+	{
+		for (uint32_t i = 0; i < 5000; ++i) {
+			entries_.push_back(makePoseEntry(syntheticViewMatrices(i, 200.0f), far_));
+			entries_.back().frame = i;
+		}
+		index_.build(entries_, far_, 2, 8);
+	}
+	static Eigen::Vector3f position(const PoseEntry& e) { return Eigen::Vector3f(e.position[0], e.position[1], e.position[2]); }
+	static std::vector<uint32_t> frameIds(const std::vector<uint32_t>& hits)
+	{
+		std::vector<uint32_t> ids;
+		for (uint32_t i : hits) ids.push_back(index_.entries()[i].frame);
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	static const float far_;
+	static std::vector<PoseEntry> entries_;
+	static PoseIndex index_;
+};
+
+const float PoseIndexQueries::far_ = 150.0f;
+std::vector<PoseEntry> PoseIndexQueries::entries_;
+PoseIndex PoseIndexQueries::index_;
+
+TEST(PoseEntry, FollowsSetPoseAngles)
+{
+	PoseEntry e = makePoseEntry(syntheticViewMatrices(2, 100.0f), 100.0f);
+	EXPECT_NEAR(e.yaw, 90.0f, 1.5f);
+	EXPECT_NEAR(e.pitch, -30.0f, 1e-3f);
+	Eigen::Vector3f forward = -Eigen::Vector3f(e.rotation[6], e.rotation[7], e.rotation[8]);
+	EXPECT_GT(forward.dot(poseForward(e.yaw, e.pitch)), 0.9999f);
+}
+
+TEST_F(PoseIndexQueries, KeepsEveryEntry)
+{
+	ASSERT_EQ(index_.entries().size(), entries_.size());
+	std::vector<uint32_t> all(entries_.size());
+	for (size_t i = 0; i < all.size(); ++i) all[i] = (uint32_t)i;
+	std::vector<uint32_t> ids = frameIds(all);
+	for (size_t i = 0; i < ids.size(); ++i) ASSERT_EQ(ids[i], i);
+}
+
+TEST_F(PoseIndexQueries, Radius)
+{
+	const Eigen::Vector3f centre(55.0f, 72.0f, 60.0f);
+	for (float r : { 5.0f, 20.0f, 45.0f }) {
+		std::vector<uint32_t> hits, expected;
+		index_.radius(centre, r, hits, 90.0f, 30.0f);
+		for (const PoseEntry& e : index_.entries()) {
+			float diff = std::fmod(std::abs(e.yaw - 90.0f), 360.0f);
+			if ((position(e) - centre).norm() <= r && std::min(diff, 360.0f - diff) <= 30.0f) expected.push_back(e.frame);
+		}
+		std::sort(expected.begin(), expected.end());
+		EXPECT_EQ(frameIds(hits), expected) << "radius " << r;
+	}
+}
+
+TEST_F(PoseIndexQueries, Nearest)
+{
+	const Eigen::Vector3f at(93.0f, 18.0f, 80.0f), forward = poseForward(135.0f, -30.0f);
+	std::vector<std::pair<float, uint32_t>> nearest;
+	index_.nearest(at, forward, 16, 10.0f, nearest);
+	std::vector<float> expected;
+	for (const PoseEntry& e : index_.entries()) {
+		Eigen::Vector3f f = -Eigen::Vector3f(e.rotation[6], e.rotation[7], e.rotation[8]).normalized();
+		float angle = std::acos(std::max(-1.0f, std::min(1.0f, f.dot(forward))));
+		expected.push_back(std::sqrt((position(e) - at).squaredNorm() + 100.0f * angle * angle));
+	}
+	std::sort(expected.begin(), expected.end());
+	ASSERT_EQ(nearest.size(), 16u);
+	for (size_t i = 0; i < nearest.size(); ++i) EXPECT_NEAR(nearest[i].first, expected[i], 1e-3f);
+}
+
+TEST_F(PoseIndexQueries, Seeing)
+{
+	const Eigen::Vector3f point(100.0f, 100.0f, 0.0f);
+	std::vector<uint32_t> hits, expected;
+	index_.seeing(point, hits);
+	for (const PoseEntry& e : index_.entries()) {
+		Eigen::Map<const Eigen::Matrix3f> R(e.rotation);
+		Eigen::Vector3f c = R.transpose() * (point - position(e));
+		float depth = -c.z();
+		if (depth <= 0.0f || depth > far_) continue;
+		float nx = (e.projection[0] * c.x() + e.projection[1] * c.z()) / depth;
+		float ny = (e.projection[2] * c.y() + e.projection[3] * c.z()) / depth;
+		if (std::abs(nx) <= 1.0f && std::abs(ny) <= 1.0f) expected.push_back(e.frame);
+	}
+	std::sort(expected.begin(), expected.end());
+	EXPECT_FALSE(expected.empty());
+	EXPECT_EQ(frameIds(hits), expected);
+}
+
+TEST_F(PoseIndexQueries, SaveLoad)
+{
+	std::string path = (std::filesystem::temp_directory_path() / "dronesim_test.poses").string(), error;
+	ASSERT_TRUE(index_.save(path, error)) << error;
+	PoseIndex loaded;
+	ASSERT_TRUE(loaded.load(path, error)) << error;
+	std::filesystem::remove(path);
+	ASSERT_EQ(loaded.entries().size(), index_.entries().size());
+	ASSERT_EQ(loaded.nodes().size(), index_.nodes().size());
+	EXPECT_EQ(memcmp(loaded.entries().data(), index_.entries().data(), index_.entries().size() * sizeof(PoseEntry)), 0);
+	EXPECT_EQ(loaded.farDistance(), far_);
+}
+
+// Damaged node links or counts are rejected at load rather than looping or
+// overrunning the traversal stack in a query.
+TEST_F(PoseIndexQueries, LoadRejectsDamagedTree)
+{
+	std::string path = (std::filesystem::temp_directory_path() / "dronesim_test_damaged.poses").string(), error;
+	ASSERT_TRUE(index_.save(path, error)) << error;
+	std::vector<char> bytes(std::filesystem::file_size(path));
+	FILE* f = fopen(path.c_str(), "rb");
+	ASSERT_NE(f, nullptr);
+	ASSERT_EQ(fread(bytes.data(), 1, bytes.size(), f), bytes.size());
+	fclose(f);
+	const size_t nodesAt = bytes.size() - index_.nodes().size() * sizeof(PoseNode);
+	ASSERT_NE(index_.nodes()[0].right, 0u);
+
+	auto loads = [&](const std::function<void(std::vector<char>&)>& damage) {
+		std::vector<char> copy = bytes;
+		damage(copy);
+		FILE* out = fopen(path.c_str(), "wb");
+		fwrite(copy.data(), 1, copy.size(), out);
+		fclose(out);
+		PoseIndex loaded;
+		return loaded.load(path, error);
+	};
+	auto node = [&](std::vector<char>& b, size_t i) { return reinterpret_cast<PoseNode*>(&b[nodesAt + i * sizeof(PoseNode)]); };
+	EXPECT_TRUE(loads([](std::vector<char>&) {}));
+	EXPECT_FALSE(loads([&](std::vector<char>& b) { node(b, 0)->right = 0 + 1; }));		// right child on top of the left
+	EXPECT_FALSE(loads([&](std::vector<char>& b) { node(b, 1)->right = 1; }));			// links back to itself
+	EXPECT_FALSE(loads([&](std::vector<char>& b) { node(b, 1)->count += 1; }));		// children overlap
+	EXPECT_FALSE(loads([&](std::vector<char>& b) {
+		uint32_t entries = 0x7fffffff;		// far more entries than the file holds
+		memcpy(&b[8 + 2 * sizeof(uint32_t)], &entries, sizeof(entries));
+	}));
+	std::filesystem::remove(path);
+}
+
+// Built from a recorded dataset, the entries match those made from the
+// matrices that were recorded.
+TEST(PoseIndexBuild, FromDataset)
+{
+	std::string path = (std::filesystem::temp_directory_path() / "dronesim_test_poses.dsq").string(), error;
+	std::filesystem::remove(path);
+	DatasetWriter writer;
+	ASSERT_TRUE(writer.open(path, false, error)) << error;
+	for (unsigned int i = 0; i < 20; ++i) {
+		auto frame = syntheticFrame(32, 16);
+		frame->id = 100 + i;
+		frame->timestamp = 5000 + i;
+		frame->matrices = syntheticViewMatrices(i, 200.0f);
+		ASSERT_TRUE(writer.append(*frame, error)) << error;
+	}
+	ASSERT_TRUE(writer.close(error)) << error;
+
+	PoseIndex index;
+	ASSERT_TRUE(index.build({ path }, 150.0f, error, 2)) << error;
+	std::filesystem::remove(path);
+	ASSERT_EQ(index.entries().size(), 20u);
+	for (const PoseEntry& e : index.entries()) {
+		PoseEntry expected = makePoseEntry(syntheticViewMatrices(e.frame, 200.0f), 150.0f);
+		EXPECT_EQ(e.frameId, 100 + e.frame);
+		EXPECT_EQ(e.timestamp, 5000 + e.frame);
+		EXPECT_EQ(memcmp(e.position, expected.position, sizeof(e.position)), 0);
+		EXPECT_EQ(memcmp(e.rotation, expected.rotation, sizeof(e.rotation)), 0);
+		EXPECT_EQ(memcmp(e.projection, expected.projection, sizeof(e.projection)), 0);
+	}
+}
@@ -0,0 +1,172 @@
+#include "quadrotor.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using Eigen::Vector3f;
+
+// Largest angle between the body z axis and world up seen over a flight.
+static float tiltDegrees(const QuadrotorState& s)
+{
+	const float c = (s.attitude * Vector3f::UnitZ()).z();
+	return std::acos(std::max(-1.0f, std::min(1.0f, c))) * 57.2957795f;
+}
+
+TEST(DroneGoto, Parses)
+{
+	QuadrotorSetpoint sp;
+	sp.yaw = 45.0f;
+	sp.velocity = Vector3f(1.0f, 2.0f, 3.0f);
+	sp.yawRate = 10.0f;
+	sp.holdPosition = false;
+	ASSERT_TRUE(parseDroneGoto("DRONE_GOTO 1 2 3", sp));
+	EXPECT_EQ(sp.position, Vector3f(1.0f, 2.0f, 3.0f));
+	EXPECT_EQ(sp.yaw, 45.0f);	// kept
+	EXPECT_EQ(sp.velocity, Vector3f::Zero());
+	EXPECT_EQ(sp.yawRate, 0.0f);
+	EXPECT_TRUE(sp.holdPosition);
+	ASSERT_TRUE(parseDroneGoto("DRONE_GOTO -10.5 0 80 -90", sp));
+	EXPECT_EQ(sp.position, Vector3f(-10.5f, 0.0f, 80.0f));
+	EXPECT_EQ(sp.yaw, -90.0f);
+}
+
+TEST(DroneGoto, Rejects)
+{
+	QuadrotorSetpoint sp;
+	EXPECT_FALSE(parseDroneGoto("DRONE_GOTO", sp));
+	EXPECT_FALSE(parseDroneGoto("DRONE_GOTO 1 2", sp));
+	EXPECT_FALSE(parseDroneGoto("DRONE_GOTO 1 2 x", sp));
+	EXPECT_FALSE(parseDroneGoto("DRONE_GOTO 1 2 3 north", sp));
+	EXPECT_FALSE(parseDroneGoto("DRONE 1 2 3", sp));
+	EXPECT_EQ(sp.position, Vector3f::Zero());
+}
+
+TEST(QuadrotorEuler, MatchesYawAndGimbal)
+{
+	Vector3f e = quadrotorEuler(Eigen::Quaternionf::Identity());
+	EXPECT_NEAR(e.norm(), 0.0f, 1e-4f);
+	e = quadrotorEuler(Eigen::Quaternionf(Eigen::AngleAxisf(0.5f * 3.14159265f, Vector3f::UnitZ())), -30.0f);
+	EXPECT_NEAR(e[0], -30.0f, 1e-3f);
+	EXPECT_NEAR(e[1], 0.0f, 1e-3f);
+	EXPECT_NEAR(e[2], 90.0f, 1e-3f);
+}
+
+// Reset seeds the motors at hover thrust: nothing moves.
+TEST(Quadrotor, HoversInPlace)
+{
+	QuadrotorParams params;
+	QuadrotorSim sim(params);
+	sim.reset(Vector3f(5.0f, -3.0f, 40.0f), 30.0f);
+	for (int i = 0; i < 300; ++i) sim.advance(1.0f / 60.0f);
+	const QuadrotorState& s = sim.state();
+	EXPECT_LT((s.position - Vector3f(5.0f, -3.0f, 40.0f)).norm(), 1e-3f);
+	EXPECT_LT(s.velocity.norm(), 1e-3f);
+	EXPECT_NEAR(quadrotorEuler(s.attitude)[2], 30.0f, 0.01f);
+	for (int m = 0; m < 4; ++m) EXPECT_NEAR(s.motorThrust[m], 0.25f * params.mass * params.gravity, 1e-3f);
+}
+
+TEST(Quadrotor, FliesToSetpointWithinTiltLimit)
+{
+	QuadrotorParams params;
+	QuadrotorSim sim(params);
+	sim.reset(Vector3f::Zero(), 0.0f);
+	QuadrotorSetpoint sp;
+	ASSERT_TRUE(parseDroneGoto("DRONE_GOTO 20 -10 5 120", sp));
+	sim.setSetpoint(sp);
+	float maxTilt = 0.0f;
+	for (int i = 0; i < 10 * 60; ++i) {
+		sim.advance(1.0f / 60.0f);
+		maxTilt = std::max(maxTilt, tiltDegrees(sim.state()));
+		ASSERT_TRUE(sim.state().position.allFinite());
+	}
+	const QuadrotorState& s = sim.state();
+	EXPECT_LT((s.position - sp.position).norm(), 0.05f);
+	EXPECT_LT(s.velocity.norm(), 0.05f);
+	EXPECT_NEAR(quadrotorEuler(s.attitude)[2], 120.0f, 0.5f);
+	// the limit holds on the commanded tilt; the attitude loop overshoots it a little
+	EXPECT_GT(maxTilt, 10.0f);
+	EXPECT_LT(maxTilt, params.maxTilt + 8.0f);
+	for (int m = 0; m < 4; ++m) {
+		EXPECT_GE(s.motorThrust[m], 0.0f);
+		EXPECT_LE(s.motorThrust[m], params.maxMotorThrust);
+	}
+}
+
+// Velocity mode: the heading turns at yawRate and the drone tracks the
+// velocity; switching back to a hold stops where it is.
+TEST(Quadrotor, TracksVelocityAndYawRate)
+{
+	QuadrotorSim sim;
+	sim.reset(Vector3f::Zero(), 0.0f);
+	QuadrotorSetpoint sp = sim.setpoint();
+	sp.holdPosition = false;
+	sp.velocity = Vector3f(0.0f, 3.0f, 0.0f);
+	sp.yawRate = 20.0f;
+	sim.setSetpoint(sp);
+	for (int i = 0; i < 4 * 60; ++i) sim.advance(1.0f / 60.0f);
+	EXPECT_NEAR(sim.setpoint().yaw, 80.0f, 0.1f);
+	// no feed-forward: the heading lags by yawRate * kRate / kAttitude and
+	// drag takes a little off the speed
+	EXPECT_NEAR(quadrotorEuler(sim.state().attitude)[2], 80.0f - 20.0f * 14.0f / 80.0f, 0.5f);
+	EXPECT_NEAR(sim.state().velocity.y(), 3.0f, 0.2f);
+	EXPECT_NEAR(sim.state().velocity.x(), 0.0f, 0.1f);
+
+	sp = sim.setpoint();
+	sp.holdPosition = true;
+	sp.velocity.setZero();
+	sp.yawRate = 0.0f;
+	sim.setSetpoint(sp);
+	for (int i = 0; i < 5 * 60; ++i) sim.advance(1.0f / 60.0f);
+	EXPECT_LT(sim.state().velocity.norm(), 0.05f);
+	EXPECT_LT((sim.state().position - sp.position).norm(), 0.05f);
+}
+
+TEST(QuadrotorSim, FixedStepsAndStallClamp)
+{
+	QuadrotorSim sim(QuadrotorParams(), 500.0f);
+	sim.reset(Vector3f::Zero(), 0.0f);
+	int steps = 0;
+	for (int i = 0; i < 60; ++i) steps += sim.advance(1.0f / 60.0f);
+	EXPECT_NEAR(steps, 500, 1);
+	EXPECT_EQ(sim.advance(0.0f), 0);
+	EXPECT_EQ(sim.advance(-1.0f), 0);
+	// a 10 s hitch replays at most maxFrameTime
+	EXPECT_NEAR(sim.advance(10.0f), (int)(QuadrotorSim::maxFrameTime * 500.0f), 1);
+}
+
+// 64 Hz and power-of-two ticks keep the accumulator exact.
+TEST(QuadrotorSim, InterpolatesBetweenSteps)
+{
+	QuadrotorSim sim(QuadrotorParams(), 64.0f);
+	sim.reset(Vector3f::Zero(), 0.0f);
+	QuadrotorSetpoint sp = sim.setpoint();
+	sp.position = Vector3f(10.0f, 0.0f, 0.0f);
+	sim.setSetpoint(sp);
+	ASSERT_EQ(sim.advance(0.25f), 16);
+	const QuadrotorState before = sim.state();
+	ASSERT_EQ(sim.advance(1.0f / 64.0f), 1);
+	const QuadrotorState after = sim.state();
+	// rendering runs one step behind the physics
+	EXPECT_EQ(sim.interpolated().position, before.position);
+	// half a step into the next one: halfway between the last two states
+	ASSERT_EQ(sim.advance(1.0f / 128.0f), 0);
+	EXPECT_GT(after.position.x(), before.position.x());
+	EXPECT_NEAR(sim.interpolated().position.x(), 0.5f * (before.position.x() + after.position.x()), 1e-5f);
+}
+
+// The step is deterministic: two runs agree bit for bit.
+TEST(Quadrotor, Deterministic)
+{
+	QuadrotorParams params;
+	QuadrotorSetpoint sp;
+	sp.position = Vector3f(3.0f, 4.0f, 5.0f);
+	sp.yaw = -60.0f;
+	QuadrotorState a, b;
+	a.motorThrust.setConstant(0.25f * params.mass * params.gravity);
+	b = a;
+	for (int i = 0; i < 2000; ++i) {
+		stepQuadrotor(params, sp, a, 0.002f);
+		stepQuadrotor(params, sp, b, 0.002f);
+	}
+	EXPECT_EQ(a.position, b.position);
+	EXPECT_EQ(a.attitude.coeffs(), b.attitude.coeffs());
+}
@@ -0,0 +1,178 @@
+#include "recorder.h"
+#include "synthetic.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <set>
+
+TEST(RecordCommand, Parses)
+{
+	bool start = false;
+	RecorderConfig cfg;
+	ASSERT_TRUE(parseRecordCommand("RECORD START dir=/tmp/r writers=3 queue=8 policy=block codec=rle segment_mb=2", start, cfg));
+	EXPECT_TRUE(start);
+	EXPECT_EQ(cfg.directory, "/tmp/r");
+	EXPECT_EQ(cfg.writers, 3);
+	EXPECT_EQ(cfg.queueFrames, 8u);
+	EXPECT_EQ(cfg.policy, recordBlock);
+	EXPECT_EQ(cfg.codec, datasetRle);
+	EXPECT_EQ(cfg.segmentBytes, 2ull << 20);
+	ASSERT_TRUE(parseRecordCommand("RECORD STOP", start, cfg));
+	EXPECT_FALSE(start);
+
+	EXPECT_FALSE(parseRecordCommand("RECORD STOP now", start, cfg));
+	EXPECT_FALSE(parseRecordCommand("RECORD START writers=0", start, cfg));
+	EXPECT_FALSE(parseRecordCommand("RECORD START policy=fifo", start, cfg));
+	EXPECT_FALSE(parseRecordCommand("RECORD START queue", start, cfg));
+}
+
+static const unsigned int frameCount = 48;
+// payload of a 256x144 frame: RGBA, depth and stencil
+static const uint64_t frameBytes = 256 * 144 * 9;
+
+// Records synthetic frames into a scratch directory through recordFrame, as
+// publishCapturedFrame does, with one writer, a one-frame queue and segments
+// of a few frames.
+class Recorder : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		dir_ = std::filesystem::temp_directory_path() / "dronesim_recorder_test";
+		std::filesystem::remove_all(dir_);
+		cfg_.directory = dir_.string();
+		cfg_.writers = 1;
+		cfg_.queueFrames = 1;
+		cfg_.segmentBytes = 3 * frameBytes;
+		cfg_.reserveBytes = 1 << 20;
+		cfg_.bufferBytes = 64 << 10;
+		auto base = syntheticFrame(256, 144);
+		for (unsigned int id = 1; id <= frameCount; ++id) {
+			auto frame = std::make_shared<CapturedFrame>(*base);
+			frame->id = id;
+			frame->timestamp = 1000 + id;
+			frames_.push_back(frame);
+		}
+	}
+	void TearDown() override
+	{
+		stopRecording();
+		std::filesystem::remove_all(dir_);
+	}
+
+	RecorderStats record(RecordDropPolicy policy)
+	{
+		cfg_.policy = policy;
+		std::string error;
+		EXPECT_TRUE(startRecording(cfg_, error)) << error;
+		for (const auto& frame : frames_) recordFrame(frame);
+		return stopRecording();
+	}
+
+	// Every frame id in the .dsq files, checking each file reads back whole.
+	std::vector<unsigned int> readBack(size_t& files)
+	{
+		std::vector<unsigned int> ids;
+		files = 0;
+		for (const auto& entry : std::filesystem::directory_iterator(dir_)) {
+			if (entry.path().extension() != ".dsq") continue;
+			files++;
+			std::string error;
+			DatasetReader reader;
+			EXPECT_TRUE(reader.open(entry.path().string(), error)) << entry.path() << ": " << error;
+			EXPECT_FALSE(reader.recovered()) << entry.path();
+			EXPECT_GE(reader.frameCount(), 1u) << entry.path();
+			for (size_t i = 0; i < reader.frameCount(); ++i) {
+				CapturedFrame back;
+				EXPECT_TRUE(reader.readFrame(i, back, error)) << entry.path() << ": " << error;
+				EXPECT_EQ(back.stencil, frames_[back.id - 1]->stencil);
+				ids.push_back(back.id);
+			}
+		}
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	std::filesystem::path dir_;
+	RecorderConfig cfg_;
+	std::vector<std::shared_ptr<CapturedFrame>> frames_;
+};
+
+// Blocking keeps every frame, at the cost of capture time; segments roll
+// over past segmentBytes.
+TEST_F(Recorder, BlockWritesEveryFrame)
+{
+	RecorderStats stats = record(recordBlock);
+	EXPECT_FALSE(stats.active);
+	EXPECT_EQ(stats.offered, frameCount);
+	EXPECT_EQ(stats.written, frameCount);
+	EXPECT_EQ(stats.dropped, 0u);
+	EXPECT_EQ(stats.failed, 0u);
+	EXPECT_LE(stats.maxQueueDepth, 1u);
+	EXPECT_GT(stats.bytes, frameCount * frameBytes);
+
+	size_t files = 0;
+	std::vector<unsigned int> ids = readBack(files);
+	EXPECT_EQ(files, stats.files);
+	// a segment takes frames until it passes 3 frames' worth, so 3 or 4 each
+	EXPECT_GE(files, (size_t)frameCount / 4);
+	EXPECT_LE(files, (size_t)frameCount / 3);
+	ASSERT_EQ(ids.size(), frameCount);
+	for (unsigned int i = 0; i < frameCount; ++i) EXPECT_EQ(ids[i], i + 1);
+}
+
+// A burst into a one-frame queue overruns the writer. Dropping the newest
+// always keeps the first frame; dropping the oldest always keeps the last.
+TEST_F(Recorder, DropPoliciesAccountForEveryFrame)
+{
+	for (RecordDropPolicy policy : { recordDropNewest, recordDropOldest }) {
+		std::filesystem::remove_all(dir_);
+		RecorderStats stats = record(policy);
+		EXPECT_EQ(stats.offered, frameCount) << policy;
+		EXPECT_EQ(stats.failed, 0u) << policy;
+		EXPECT_GT(stats.dropped, 0u) << policy;
+		EXPECT_EQ(stats.written + stats.dropped, stats.offered) << policy;
+		EXPECT_EQ(stats.blockedMs, 0.0) << policy;
+
+		size_t files = 0;
+		std::vector<unsigned int> ids = readBack(files);
+		EXPECT_EQ(files, stats.files) << policy;
+		EXPECT_EQ(ids.size(), stats.written) << policy;
+		EXPECT_EQ(std::set<unsigned int>(ids.begin(), ids.end()).size(), ids.size()) << policy;
+		const unsigned int kept = policy == recordDropNewest ? 1 : frameCount;
+		EXPECT_TRUE(std::binary_search(ids.begin(), ids.end(), kept)) << policy;
+	}
+}
+
+// Frames the writer could not write are counted as failed, not written or
+// dropped, and the error is kept.
+TEST_F(Recorder, WriteErrorsCountAsFailed)
+{
+	cfg_.policy = recordBlock;
+	std::string error;
+	ASSERT_TRUE(startRecording(cfg_, error)) << error;
+	// the writer opens its first file on the first frame
+	std::filesystem::remove_all(dir_);
+	for (unsigned int i = 0; i < 5; ++i) recordFrame(frames_[i]);
+	RecorderStats stats = stopRecording();
+	EXPECT_EQ(stats.offered, 5u);
+	EXPECT_EQ(stats.written, 0u);
+	EXPECT_EQ(stats.dropped, 0u);
+	EXPECT_EQ(stats.failed, 5u);
+	EXPECT_EQ(stats.files, 0u);
+	EXPECT_FALSE(stats.lastError.empty());
+	EXPECT_NE(recorderStatsJson(stats).find("\"failed\":5"), std::string::npos);
+}
+
+TEST_F(Recorder, IgnoresFramesWhenStopped)
+{
+	const RecorderStats before = recorderStats();
+	recordFrame(frames_[0]);
+	const RecorderStats after = recorderStats();
+	EXPECT_FALSE(after.active);
+	EXPECT_EQ(after.offered, before.offered);
+
+	std::string error;
+	ASSERT_TRUE(startRecording(cfg_, error)) << error;
+	EXPECT_FALSE(startRecording(cfg_, error));
+	EXPECT_NE(error.find("already recording"), std::string::npos);
+}
@@ -0,0 +1,132 @@
+#include "rig.h"
+#include <gtest/gtest.h>
+#include <Eigen/Geometry>
+
+using Eigen::Vector3f;
+
+static RigPose bodyAt(const Vector3f& position, const Vector3f& rotation, float fov = 60.0f)
+{
+	RigPose body;
+	body.position = position;
+	body.rotation = rotation;
+	body.fov = fov;
+	return body;
+}
+
+TEST(RigCommand, Presets)
+{
+	std::vector<RigCamera> rig;
+	ASSERT_TRUE(parseRigCommand("RIG stereo", rig));
+	ASSERT_EQ(rig.size(), 2u);
+	EXPECT_EQ(rig[0].name, "left");
+	EXPECT_EQ(rig[0].offset, Vector3f(-0.25f, 0.0f, 0.0f));
+	EXPECT_EQ(rig[1].offset, Vector3f(0.25f, 0.0f, 0.0f));
+	ASSERT_TRUE(parseRigCommand("RIG stereo=0.12 multiview", rig));
+	ASSERT_EQ(rig.size(), 6u);
+	EXPECT_FLOAT_EQ(rig[1].offset.x() - rig[0].offset.x(), 0.12f);
+	EXPECT_EQ(rig[3].name, "down");
+	EXPECT_EQ(rig[3].rotation, Vector3f(-90.0f, 0.0f, 0.0f));
+}
+
+TEST(RigCommand, Cameras)
+{
+	std::vector<RigCamera> rig;
+	ASSERT_TRUE(parseRigCommand("RIG cam=nose,0,0.3,-0.1,-20,0,0 cam=tail,0,-0.3,0,0,0,180,90", rig));
+	ASSERT_EQ(rig.size(), 2u);
+	EXPECT_EQ(rig[0].name, "nose");
+	EXPECT_EQ(rig[0].offset, Vector3f(0.0f, 0.3f, -0.1f));
+	EXPECT_EQ(rig[0].rotation, Vector3f(-20.0f, 0.0f, 0.0f));
+	EXPECT_EQ(rig[0].fov, 0.0f);
+	EXPECT_EQ(rig[1].fov, 90.0f);
+}
+
+TEST(RigCommand, Rejects)
+{
+	std::vector<RigCamera> rig;
+	EXPECT_FALSE(parseRigCommand("RIG", rig));
+	EXPECT_FALSE(parseRigCommand("RIG stereo=wide", rig));
+	EXPECT_FALSE(parseRigCommand("RIG cam=a,0,0,0,0,0", rig));			// too few fields
+	EXPECT_FALSE(parseRigCommand("RIG cam=a,0,0,0,0,0,0,60,1", rig));	// too many
+	EXPECT_FALSE(parseRigCommand("RIG cam=a,0,0,x,0,0,0", rig));
+	EXPECT_FALSE(parseRigCommand("RIG cam=,0,0,0,0,0,0", rig));
+	EXPECT_FALSE(parseRigCommand("RIG cam=a,0,0,0,0,0,0,180", rig));
+	EXPECT_FALSE(parseRigCommand("RIG fisheye", rig));
+	EXPECT_FALSE(parseRigCommand("RIGS stereo", rig));
+}
+
+TEST(RigPose, EulerRoundTrip)
+{
+	const float angles[][3] = { { 0, 0, 0 }, { -30, 0, 90 }, { 20, 15, -135 }, { -89, 0, 10 }, { 45, -60, 170 } };
+	for (const auto& a : angles) {
+		const Vector3f r(a[0], a[1], a[2]);
+		const Vector3f back = rigEuler(rigRotation(r));
+		EXPECT_TRUE((rigRotation(back) - rigRotation(r)).norm() < 1e-5f) << r.transpose() << " -> " << back.transpose();
+		EXPECT_TRUE((back - r).norm() < 1e-2f) << r.transpose() << " -> " << back.transpose();
+	}
+}
+
+// Yaw 0 looks along +y; 90 along -x.
+TEST(RigPose, CameraPoseFollowsBody)
+{
+	RigCamera right;
+	right.offset = Vector3f(0.5f, 0.0f, 0.0f);
+	RigPose pose = rigCameraPose(bodyAt(Vector3f(10.0f, 20.0f, 30.0f), Vector3f(0.0f, 0.0f, 90.0f)), right);
+	EXPECT_TRUE((pose.position - Vector3f(10.0f, 20.5f, 30.0f)).norm() < 1e-5f);
+	EXPECT_NEAR(pose.rotation.z(), 90.0f, 1e-3f);
+	EXPECT_EQ(pose.fov, 60.0f);
+
+	RigCamera down;
+	down.rotation = Vector3f(-90.0f, 0.0f, 0.0f);
+	down.fov = 100.0f;
+	pose = rigCameraPose(bodyAt(Vector3f::Zero(), Vector3f(10.0f, 0.0f, 45.0f)), down);
+	const Vector3f forward = rigRotation(pose.rotation) * Vector3f::UnitY();
+	const Vector3f expected = rigRotation(Vector3f(10.0f, 0.0f, 45.0f)) * rigRotation(Vector3f(-90.0f, 0.0f, 0.0f)) * Vector3f::UnitY();
+	EXPECT_TRUE((forward - expected).norm() < 1e-4f);
+	EXPECT_EQ(pose.fov, 100.0f);
+}
+
+// Move, settle one tick, capture, wait for the capture, next; the body pose
+// is restored at the end.
+TEST(RigScheduler, VisitsEachCamera)
+{
+	std::vector<RigCamera> rig;
+	ASSERT_TRUE(parseRigCommand("RIG stereo=1", rig));
+	const RigPose body = bodyAt(Vector3f(1.0f, 2.0f, 3.0f), Vector3f(0.0f, 0.0f, 0.0f));
+	RigScheduler s;
+	const unsigned int id = nextRigId();
+	s.start(rig, body, id, 1234);
+	ASSERT_TRUE(s.active());
+	RigPose pose;
+	for (size_t cam = 0; cam < rig.size(); ++cam) {
+		ASSERT_EQ(s.tick(true, pose), RigScheduler::MoveTo);
+		EXPECT_NEAR(pose.position.x(), cam == 0 ? 0.5f : 1.5f, 1e-5f);
+		EXPECT_EQ(s.tick(true, pose), RigScheduler::Idle);		// settling
+		ASSERT_EQ(s.tick(true, pose), RigScheduler::Capture);
+		EXPECT_NE(s.metadata().find("\"rig_camera\":" + std::to_string(cam)), std::string::npos);
+		EXPECT_EQ(s.tick(false, pose), RigScheduler::Idle);	// capture in flight
+	}
+	EXPECT_NE(lastFinishedRig(), id);
+	ASSERT_EQ(s.tick(true, pose), RigScheduler::Finished);
+	EXPECT_EQ(pose.position, body.position);
+	EXPECT_FALSE(s.active());
+	EXPECT_EQ(lastFinishedRig(), id);
+	EXPECT_EQ(s.tick(true, pose), RigScheduler::Idle);
+}
+
+TEST(RigScheduler, EmptyRigIsInactive)
+{
+	RigScheduler s;
+	s.start(std::vector<RigCamera>(), bodyAt(Vector3f::Zero(), Vector3f::Zero()), nextRigId(), 0);
+	EXPECT_FALSE(s.active());
+	RigPose pose;
+	EXPECT_EQ(s.tick(true, pose), RigScheduler::Idle);
+}
+
+TEST(RigScheduler, MetadataEscapesName)
+{
+	std::vector<RigCamera> rig;
+	ASSERT_TRUE(parseRigCommand("RIG cam=a\"b\\c,0,0,0,0,0,0", rig));
+	RigScheduler s;
+	s.start(rig, bodyAt(Vector3f::Zero(), Vector3f::Zero()), 7, 99);
+	EXPECT_EQ(s.metadata(), "\"rig\":7,\"rig_camera\":0,\"rig_cameras\":1,\"rig_name\":\"a\\\"b\\\\c\",\"rig_timestamp\":99");
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "frame.h"
+#include <cmath>
+#include <memory>
+
+// Analytic scenes for the tests: a camera posed as SET_POSE poses it and
+// the exact depth it would see of a plane.
+
+const float sceneNear = 0.15f;
+
+// Yaw 0 faces +y, 90 faces -x, pitch up positive; 60 degree vertical field
+// of view, reversed z like the game's projection.
+inline rage_matrices sceneMatrices(const Eigen::Vector3f& position, float yaw, float pitch, int width, int height)
+{
+	const float rad = 3.14159265f / 180.0f;
+	Eigen::Vector3f forward(-std::sin(yaw * rad) * std::cos(pitch * rad), std::cos(yaw * rad) * std::cos(pitch * rad),
+		std::sin(pitch * rad));
+	Eigen::Vector3f right = forward.cross(Eigen::Vector3f::UnitZ()).normalized();
+	Eigen::Vector3f up = right.cross(forward);
+	rage_matrices m;
+	m.Vinv = Eigen::Matrix4f::Identity();
+	m.Vinv.block<3, 1>(0, 0) = right;
+	m.Vinv.block<3, 1>(0, 1) = up;
+	m.Vinv.block<3, 1>(0, 2) = -forward;
+	m.Vinv.block<3, 1>(0, 3) = position;
+	m.M = Eigen::Matrix4f::Identity();
+	m.MV = m.Vinv.inverse();
+	const float f = 1.0f / std::tan(30.0f * rad);
+	Eigen::Matrix4f P = Eigen::Matrix4f::Zero();
+	P(0, 0) = f * height / width;
+	P(1, 1) = f;
+	P(2, 3) = sceneNear;
+	P(3, 2) = -1.0f;
+	m.MVP = P * m.MV;
+	return m;
+}
+
+// The plane normal . x = offset seen through m; pixels whose ray misses it
+// are left at the far plane (0), as sky is.
+inline std::shared_ptr<CapturedFrame> planeFrame(const rage_matrices& m, int width, int height,
+	const Eigen::Vector3f& normal, float offset, unsigned int id = 1)
+{
+	auto frame = std::make_shared<CapturedFrame>();
+	frame->id = id;
+	frame->width = frame->colorWidth = width;
+	frame->height = frame->colorHeight = height;
+	frame->matrices = m;
+	frame->P = projectionFromMatrices(m);
+	frame->V = viewFromMatrices(m);
+	frame->depth.assign((size_t)width * height, 0.0f);
+	frame->stencil.assign((size_t)width * height, 0);
+	frame->color.assign((size_t)width * height * 4, 128);
+	const Eigen::Matrix3f R = m.Vinv.topLeftCorner<3, 3>();
+	const Eigen::Vector3f position = m.Vinv.block<3, 1>(0, 3);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			// camera-space ray through the pixel centre, one metre deep
+			Eigen::Vector3f ray(((x + 0.5f) * 2.0f / width - 1.0f) / frame->P(0, 0),
+				(1.0f - (y + 0.5f) * 2.0f / height) / frame->P(1, 1), -1.0f);
+			float along = normal.dot(R * ray);
+			if (std::abs(along) < 1e-9f) continue;
+			float t = (offset - normal.dot(position)) / along;
+			if (t > 0.0f) frame->depth[(size_t)y * width + x] = sceneNear / t;
+		}
+	}
+	return frame;
+}
@@ -0,0 +1,135 @@
+#include "semantic.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+
+// 40x30 stencil: diagonal stripes of 0x12 and a block of 0x05 in the top
+// right, the rest 0.
+static std::vector<unsigned char> stripedStencil(int width, int height)
+{
+	std::vector<unsigned char> stencil((size_t)width * height, 0);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			if ((x * 7 + y * 3) % 11 < 4) stencil[(size_t)y * width + x] = 0x12;
+			else if (x > 20 && y < 10) stencil[(size_t)y * width + x] = 0x05;
+		}
+	}
+	return stencil;
+}
+
+static const SemanticClassStats* findClass(const std::vector<SemanticClassStats>& classes, int id)
+{
+	for (const auto& c : classes) {
+		if (c.classId == id) return &c;
+	}
+	return nullptr;
+}
+
+TEST(SemanticLut, DefaultIsEntityBits)
+{
+	SemanticLut lut = buildSemanticLut({});
+	for (int s = 0; s < 256; ++s) EXPECT_EQ(lut[s], s & 0x07) << s;
+}
+
+// The first rule whose masked bits match wins; nothing matched is class 0.
+TEST(SemanticLut, FirstMatchingRule)
+{
+	std::vector<SemanticRule> rules;
+	ASSERT_TRUE(parseSemanticRules("SEMANTIC_MAP 0x10:0x10:7 0x07:0x05:3 255:0x40:9", rules));
+	ASSERT_EQ(rules.size(), 3u);
+	EXPECT_EQ(rules[1].mask, 0x07);
+	EXPECT_EQ(rules[1].value, 0x05);
+	EXPECT_EQ(rules[1].classId, 3);
+	SemanticLut lut = buildSemanticLut(rules);
+	EXPECT_EQ(lut[0x12], 7);
+	EXPECT_EQ(lut[0x15], 7);	// both rules match; the first wins
+	EXPECT_EQ(lut[0x05], 3);
+	EXPECT_EQ(lut[0x85], 3);
+	EXPECT_EQ(lut[0x40], 9);
+	EXPECT_EQ(lut[0x41], 0);
+	EXPECT_EQ(lut[0x00], 0);
+
+	EXPECT_FALSE(parseSemanticRules("SEMANTIC_MAP 0x10:0x10", rules));
+	EXPECT_FALSE(parseSemanticRules("SEMANTIC_MAP 1:2:256", rules));
+	EXPECT_FALSE(parseSemanticRules("SEMANTIC_MAP 1:2:3:4", rules));
+	ASSERT_TRUE(parseSemanticRules("SEMANTIC_MAP", rules));
+	EXPECT_TRUE(rules.empty());
+}
+
+TEST(SemanticLabels, CountsAndLabels)
+{
+	const int width = 40, height = 30;
+	const std::vector<unsigned char> stencil = stripedStencil(width, height);
+	std::vector<unsigned char> labels, applied;
+	std::vector<SemanticClassStats> classes;
+	labelStencil(stencil, width, height, buildSemanticLut({}), labels, classes);
+	applySemanticLut(stencil, buildSemanticLut({}), applied);
+	EXPECT_EQ(labels, applied);
+	for (size_t i = 0; i < stencil.size(); ++i) ASSERT_EQ(labels[i], stencil[i] & 0x07) << i;
+
+	ASSERT_EQ(classes.size(), 3u);
+	EXPECT_EQ(classes[0].classId, 0);
+	EXPECT_EQ(classes[0].pixels, 643u);
+	EXPECT_EQ(classes[1].classId, 2);
+	EXPECT_EQ(classes[1].pixels, 436u);
+	EXPECT_EQ(classes[2].classId, 5);
+	EXPECT_EQ(classes[2].pixels, 121u);
+
+	// runs alternate absent/present, column-major, and cover the image
+	for (const auto& c : classes) {
+		uint64_t total = 0, present = 0;
+		for (size_t i = 0; i < c.counts.size(); ++i) {
+			total += c.counts[i];
+			if (i % 2 == 1) present += c.counts[i];
+		}
+		EXPECT_EQ(total, (uint64_t)width * height) << c.classId;
+		EXPECT_EQ(present, c.pixels) << c.classId;
+	}
+}
+
+// Expected strings are pycocotools' mask.encode() of the same masks
+// (Fortran-ordered uint8), its "counts" member.
+TEST(SemanticLabels, CocoRleMatchesPycocotools)
+{
+	std::vector<unsigned char> labels;
+	std::vector<SemanticClassStats> classes;
+	const SemanticLut lut = buildSemanticLut({});
+
+	// 4x5 mask, rows 1-2 and columns 1-3 set
+	std::vector<unsigned char> small(4 * 5, 0);
+	for (int y = 1; y < 3; ++y) {
+		for (int x = 1; x < 4; ++x) small[y * 5 + x] = 1;
+	}
+	labelStencil(small, 5, 4, lut, labels, classes);
+	ASSERT_NE(findClass(classes, 1), nullptr);
+	EXPECT_EQ(findClass(classes, 1)->counts, std::vector<uint32_t>({ 5, 2, 2, 2, 2, 2, 5 }));
+	EXPECT_EQ(encodeCocoRle(findClass(classes, 1)->counts), "5220003");
+
+	// long runs, several characters per count and negative differences
+	std::vector<unsigned char> big(300 * 200, 0);
+	for (int y = 100; y < 250; ++y) {
+		for (int x = 50; x < 60; ++x) big[y * 200 + x] = 1;
+	}
+	for (int y = 0; y < 5; ++y) {
+		for (int x = 150; x < 200; ++x) big[y * 200 + x] = 1;
+	}
+	labelStencil(big, 200, 300, lut, labels, classes);
+	ASSERT_NE(findClass(classes, 1), nullptr);
+	// the 49 equal-length column pairs of the top-right block encode as "00"
+	EXPECT_EQ(encodeCocoRle(findClass(classes, 1)->counts), "lg>f4f400000000000000000dXj0_KmkUO" + std::string(98, '0'));
+
+	const std::vector<unsigned char> stencil = stripedStencil(40, 30);
+	labelStencil(stencil, 40, 30, lut, labels, classes);
+	ASSERT_NE(findClass(classes, 5), nullptr);
+	const std::string rle = encodeCocoRle(findClass(classes, 5)->counts);
+	EXPECT_EQ(rle, "fc031O10d00[O10Nc01]O010d00[O10Oc0O]O110OOc01]O10Oe00\\O0O0c0O]O20Oe00\\O0O1d00\\OO1Ob00^O1O1d00\\OO10d00"
+		"[O10Nc01]O010d00[O10Oc0O]O110OOc01]O10Oe00\\O0O0c0O]O20Oe0");
+
+	// the JSON escapes the backslashes the alphabet contains
+	std::string escaped;
+	for (char c : rle) {
+		if (c == '\\') escaped += '\\';
+		escaped += c;
+	}
+	const std::string json = semanticClassesJson(classes, 40, 30);
+	EXPECT_NE(json.find("{\"id\":5,\"pixels\":121,\"rle\":{\"size\":[30,40],\"counts\":\"" + escaped + "\"}}"), std::string::npos);
+}
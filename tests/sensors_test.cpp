@@ -0,0 +1,272 @@
+#include "sensors.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+using Eigen::Quaternionf;
+using Eigen::Vector3f;
+
+static const int64_t start = 1700000000000000LL;
+
+// Feeds poses for the given seconds at uneven ticks of one or two 64ths of a
+// second, so that a path with binary-fraction coefficients is exact in float.
+static SensorBatch fly(const SensorConfig& cfg, double seconds,
+	const std::function<void(double, Vector3f&, Quaternionf&)>& path)
+{
+	SensorSimulator sim(cfg);
+	SensorBatch out;
+	static const int ticks[] = { 1, 2, 1, 1, 2, 1, 2 };
+	int64_t t = start;
+	for (int i = 0; t < start + (int64_t)(seconds * 1e6); ++i) {
+		Vector3f p;
+		Quaternionf q;
+		path((t - start) * 1e-6, p, q);
+		sim.addPose(t, p, q);
+		t += 15625 * ticks[i % 7];
+	}
+	sim.drain(out);
+	return out;
+}
+
+static SensorConfig noiseless()
+{
+	SensorConfig cfg;
+	cfg.gyroNoise = cfg.gyroBiasWalk = cfg.accelNoise = cfg.accelBiasWalk = 0.0f;
+	cfg.gnssHorizontal = cfg.gnssVertical = cfg.gnssVelocity = 0.0f;
+	cfg.baroNoise = cfg.baroBiasWalk = 0.0f;
+	return cfg;
+}
+
+static double stddev(const std::vector<double>& v)
+{
+	double mean = 0.0, sq = 0.0;
+	for (double x : v) mean += x;
+	mean /= v.size();
+	for (double x : v) sq += (x - mean) * (x - mean);
+	return std::sqrt(sq / (v.size() - 1));
+}
+
+TEST(SensorCommand, Parses)
+{
+	SensorConfig cfg;
+	ASSERT_TRUE(parseSensorCommand("SENSORS", cfg));
+	EXPECT_EQ(cfg.imuRate, 200.0f);
+	ASSERT_TRUE(parseSensorCommand("SENSORS imu=400 gnss=5 baro=50 seed=7 gyro_noise=0 accel_noise=0.01 gnss_h=2.5 baro_noise=0.1", cfg));
+	EXPECT_EQ(cfg.imuRate, 400.0f);
+	EXPECT_EQ(cfg.gnssRate, 5.0f);
+	EXPECT_EQ(cfg.baroRate, 50.0f);
+	EXPECT_EQ(cfg.seed, 7u);
+	EXPECT_EQ(cfg.gyroNoise, 0.0f);
+	EXPECT_EQ(cfg.accelNoise, 0.01f);
+	EXPECT_EQ(cfg.gnssHorizontal, 2.5f);
+	EXPECT_EQ(cfg.baroNoise, 0.1f);
+	// seeds are integers, exact beyond a float's 24 bits
+	ASSERT_TRUE(parseSensorCommand("SENSORS seed=4294967295", cfg));
+	EXPECT_EQ(cfg.seed, 4294967295u);
+	ASSERT_TRUE(parseSensorCommand("SENSORS seed=16777217", cfg));
+	EXPECT_EQ(cfg.seed, 16777217u);
+}
+
+TEST(SensorCommand, Rejects)
+{
+	SensorConfig cfg;
+	EXPECT_FALSE(parseSensorCommand("SENSOR", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS imu", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS imu=fast", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS imu=0", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS imu=20000", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS gnss_h=-1", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS lidar=10", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS seed=1.5", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS seed=-1", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS seed=4294967296", cfg));
+	EXPECT_FALSE(parseSensorCommand("SENSORS seed=", cfg));
+}
+
+// Samples sit on the rate's grid, one period apart, at the configured rates.
+TEST(SensorSimulator, RatesAndTimestamps)
+{
+	SensorBatch b = fly(noiseless(), 10.0, [](double, Vector3f& p, Quaternionf& q) {
+		p.setZero();
+		q.setIdentity();
+	});
+	ASSERT_GT(b.imu.size(), 1900u);
+	EXPECT_LE(b.imu.size(), 2000u);
+	for (size_t i = 0; i < b.imu.size(); ++i) {
+		EXPECT_EQ(b.imu[i].timeUs % 5000, 0);
+		if (i) {
+			EXPECT_EQ(b.imu[i].timeUs - b.imu[i - 1].timeUs, 5000);
+		}
+	}
+	EXPECT_NEAR((double)b.gnss.size(), 100.0, 2.0);
+	EXPECT_NEAR((double)b.baro.size(), 250.0, 3.0);
+	EXPECT_EQ(b.gnss.front().timeUs % 100000, 0);
+	EXPECT_EQ(b.baro.front().timeUs % 40000, 0);
+}
+
+// Constant velocity and a constant yaw rate: the noiseless gyro reads the
+// rate and the accelerometer only gravity, whatever the tick jitter.
+TEST(SensorSimulator, ConstantVelocityAndRateGiveExactReadings)
+{
+	const Vector3f velocity(3.0f, -1.5f, 0.5f);
+	const float rate = 0.4f;	// rad/s about z
+	SensorBatch b = fly(noiseless(), 5.0, [&](double t, Vector3f& p, Quaternionf& q) {
+		p = Vector3f(10.0f, 20.0f, 30.0f) + velocity * (float)t;
+		q = Quaternionf(Eigen::AngleAxisf(rate * (float)t, Vector3f::UnitZ()));
+	});
+	ASSERT_GT(b.imu.size(), 900u);
+	for (const ImuSample& s : b.imu) {
+		EXPECT_NEAR(s.gyro[0], 0.0f, 1e-4f);
+		EXPECT_NEAR(s.gyro[1], 0.0f, 1e-4f);
+		EXPECT_NEAR(s.gyro[2], rate, 1e-4f);
+		EXPECT_NEAR(s.accel[0], 0.0f, 1e-4f);
+		EXPECT_NEAR(s.accel[1], 0.0f, 1e-4f);
+		EXPECT_NEAR(s.accel[2], 9.81f, 1e-4f);
+	}
+	for (const GnssSample& s : b.gnss) {
+		for (int k = 0; k < 3; ++k) EXPECT_NEAR(s.velocity[k], velocity[k], 1e-3f);
+	}
+}
+
+// A constant acceleration in a rolled body shows up rotated into body axes.
+TEST(SensorSimulator, ConstantAccelerationInBodyAxes)
+{
+	const Vector3f accel(0.0f, 2.0f, 0.0f);
+	const Quaternionf attitude(Eigen::AngleAxisf(0.3f, Vector3f::UnitY()));
+	SensorBatch b = fly(noiseless(), 3.0, [&](double t, Vector3f& p, Quaternionf& q) {
+		p = 0.5f * accel * (float)(t * t);
+		q = attitude;
+	});
+	const Vector3f expected = attitude.conjugate() * (accel + Vector3f(0.0f, 0.0f, 9.81f));
+	ASSERT_GT(b.imu.size(), 500u);
+	for (const ImuSample& s : b.imu) {
+		for (int k = 0; k < 3; ++k) {
+			EXPECT_NEAR(s.accel[k], expected[k], 1e-3f);
+			EXPECT_NEAR(s.gyro[k], 0.0f, 1e-5f);
+		}
+	}
+}
+
+// At rest the spread of each sensor matches the configured noise: the IMU
+// densities scale by sqrt(rate), GNSS and baro sigmas apply per sample.
+TEST(SensorSimulator, NoiseMatchesConfig)
+{
+	SensorConfig cfg;
+	cfg.seed = 42;
+	cfg.gyroBiasWalk = cfg.accelBiasWalk = cfg.baroBiasWalk = 0.0f;
+	cfg.gyroNoise = 1e-3f;
+	cfg.accelNoise = 2e-2f;
+	SensorBatch b = fly(cfg, 300.0, [](double, Vector3f& p, Quaternionf& q) {
+		p = Vector3f(0.0f, 0.0f, 100.0f);
+		q.setIdentity();
+	});
+	const double sqrtRate = std::sqrt(cfg.imuRate);
+	for (int k = 0; k < 3; ++k) {
+		std::vector<double> gyro, accel;
+		for (const ImuSample& s : b.imu) {
+			gyro.push_back(s.gyro[k]);
+			accel.push_back(s.accel[k]);
+		}
+		EXPECT_NEAR(stddev(gyro), cfg.gyroNoise * sqrtRate, 0.03 * cfg.gyroNoise * sqrtRate);
+		EXPECT_NEAR(stddev(accel), cfg.accelNoise * sqrtRate, 0.03 * cfg.accelNoise * sqrtRate);
+	}
+	std::vector<double> east, north, up, velocity, baro;
+	for (const GnssSample& s : b.gnss) {
+		east.push_back(s.position[0]);
+		north.push_back(s.position[1]);
+		up.push_back(s.position[2]);
+		velocity.push_back(s.velocity[0]);
+	}
+	for (const BaroSample& s : b.baro) baro.push_back(s.altitude);
+	ASSERT_GT(b.gnss.size(), 2900u);
+	EXPECT_NEAR(stddev(east), cfg.gnssHorizontal, 0.06 * cfg.gnssHorizontal);
+	EXPECT_NEAR(stddev(north), cfg.gnssHorizontal, 0.06 * cfg.gnssHorizontal);
+	EXPECT_NEAR(stddev(up), cfg.gnssVertical, 0.06 * cfg.gnssVertical);
+	EXPECT_NEAR(stddev(velocity), cfg.gnssVelocity, 0.06 * cfg.gnssVelocity);
+	EXPECT_NEAR(stddev(baro), cfg.baroNoise, 0.04 * cfg.baroNoise);
+}
+
+// Without white noise, the step between consecutive gyro readings is the
+// bias random walk: walk * sqrt(period).
+TEST(SensorSimulator, BiasWalkMatchesConfig)
+{
+	SensorConfig cfg = noiseless();
+	cfg.seed = 3;
+	cfg.gyroBiasWalk = 1e-3f;
+	SensorBatch b = fly(cfg, 60.0, [](double, Vector3f& p, Quaternionf& q) {
+		p.setZero();
+		q.setIdentity();
+	});
+	std::vector<double> steps;
+	for (size_t i = 1; i < b.imu.size(); ++i) steps.push_back(b.imu[i].gyro[0] - b.imu[i - 1].gyro[0]);
+	const double expected = cfg.gyroBiasWalk * std::sqrt(1.0 / cfg.imuRate);
+	EXPECT_NEAR(stddev(steps), expected, 0.03 * expected);
+}
+
+TEST(SensorSimulator, GeodeticAroundOrigin)
+{
+	SensorConfig cfg = noiseless();
+	SensorBatch b = fly(cfg, 1.0, [](double, Vector3f& p, Quaternionf& q) {
+		p = Vector3f(1000.0f, 2000.0f, 50.0f);
+		q.setIdentity();
+	});
+	ASSERT_FALSE(b.gnss.empty());
+	const GnssSample& s = b.gnss.front();
+	EXPECT_NEAR(s.latitude, cfg.originLatitude + 2000.0 / 6378137.0 * 57.29577951308232, 1e-7);
+	EXPECT_NEAR(s.longitude, cfg.originLongitude + 1000.0 / (6378137.0 * std::cos(cfg.originLatitude / 57.29577951308232)) * 57.29577951308232, 1e-7);
+	EXPECT_NEAR(s.altitude, 50.0f, 1e-3f);
+	ASSERT_FALSE(b.baro.empty());
+	EXPECT_NEAR(b.baro.front().pressure, 101325.0f * std::pow(1.0f - 2.25577e-5f * 50.0f, 5.25588f), 0.5f);
+}
+
+TEST(SensorSimulator, DeterministicForSeed)
+{
+	SensorConfig cfg;
+	cfg.seed = 11;
+	auto path = [](double t, Vector3f& p, Quaternionf& q) {
+		p = Vector3f((float)std::sin(t), (float)t, 5.0f);
+		q = Quaternionf(Eigen::AngleAxisf((float)t * 0.2f, Vector3f::UnitZ()));
+	};
+	SensorBatch a = fly(cfg, 2.0, path), b = fly(cfg, 2.0, path);
+	EXPECT_EQ(serializeSensorBatch(a), serializeSensorBatch(b));
+	cfg.seed = 12;
+	EXPECT_NE(serializeSensorBatch(fly(cfg, 2.0, path)), serializeSensorBatch(a));
+}
+
+// No samples are made up across a pause longer than maxGapUs.
+TEST(SensorSimulator, DoesNotInterpolateAcrossGaps)
+{
+	SensorSimulator sim(noiseless());
+	for (int i = 0; i < 10; ++i) sim.addPose(start + i * 16667, Vector3f::Zero(), Quaternionf::Identity());
+	const int64_t resume = start + 9 * 16667 + SensorSimulator::maxGapUs + 100000;
+	for (int i = 0; i < 10; ++i) sim.addPose(resume + i * 16667, Vector3f::Zero(), Quaternionf::Identity());
+	SensorBatch b;
+	sim.drain(b);
+	for (const ImuSample& s : b.imu) EXPECT_TRUE(s.timeUs < start + 9 * 16667 || s.timeUs >= resume);
+	EXPECT_FALSE(b.imu.empty());
+}
+
+TEST(SensorBatch, Serializes)
+{
+	SensorBatch b;
+	b.imu.resize(2);
+	b.gnss.resize(1);
+	b.baro.resize(3);
+	b.imu[1].timeUs = 77;
+	b.baro[2].pressure = 1000.0f;
+	std::vector<unsigned char> out = serializeSensorBatch(b);
+	ASSERT_EQ(out.size(), 16 + 2 * sizeof(ImuSample) + sizeof(GnssSample) + 3 * sizeof(BaroSample));
+	EXPECT_EQ(memcmp(out.data(), "SENS", 4), 0);
+	uint32_t counts[3];
+	memcpy(counts, &out[4], sizeof(counts));
+	EXPECT_EQ(counts[0], 2u);
+	EXPECT_EQ(counts[1], 1u);
+	EXPECT_EQ(counts[2], 3u);
+	int64_t t;
+	memcpy(&t, &out[16 + sizeof(ImuSample)], sizeof(t));
+	EXPECT_EQ(t, 77);
+	BaroSample last;
+	memcpy(&last, &out[out.size() - sizeof(BaroSample)], sizeof(last));
+	EXPECT_EQ(last.pressure, 1000.0f);
+}
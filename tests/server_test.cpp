@@ -0,0 +1,327 @@
+#include "synthetic.h"
+#include "commands.h"
+#include "derived.h"
+#include "environment.h"
+#include "pose.h"
+#include "rig.h"
+#include "server.h"
+#include "sharedreply.h"
+#include <gtest/gtest.h>
+#include <deque>
+#include <sstream>
+#include <thread>
+
+using boost::asio::ip::tcp;
+
+// The ModServer on port 12345, as the plugin and the harness run it.
+class ServerCommands : public ::testing::Test {
+protected:
+	static void SetUpTestSuite() { InitializeModServer(); }
+	static void TearDownTestSuite() { ShutdownModServer(); }
+
+	void SetUp() override
+	{
+		std::deque<std::string> stale;
+		g_cmdQueue.drain(stale);
+	}
+
+	tcp::socket connect()
+	{
+		tcp::socket socket(io_);
+		for (int attempt = 0; attempt < 100; ++attempt) {
+			boost::system::error_code error;
+			socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), 12345), error);
+			if (!error) break;
+			socket.close();
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		EXPECT_TRUE(socket.is_open());
+		return socket;
+	}
+
+	// The commands queued for the script thread within timeout.
+	std::deque<std::string> queued(size_t count, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+	{
+		std::deque<std::string> out;
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (out.size() < count && std::chrono::steady_clock::now() < deadline) {
+			g_cmdQueue.drain(out);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		return out;
+	}
+
+	// One length-prefixed reply.
+	static std::string reply(tcp::socket& socket)
+	{
+		uint32_t size = 0;
+		boost::asio::read(socket, boost::asio::buffer(&size, sizeof(size)));
+		std::string data(size, '\0');
+		boost::asio::read(socket, boost::asio::buffer(&data[0], size));
+		return data;
+	}
+
+	static std::string frame(const std::string& command)
+	{
+		uint32_t size = (uint32_t)command.size();
+		return std::string(reinterpret_cast<const char*>(&size), sizeof(size)) + command;
+	}
+
+	static void send(tcp::socket& socket, const std::string& command)
+	{
+		boost::asio::write(socket, boost::asio::buffer(frame(command)));
+	}
+
+	boost::asio::io_context io_;
+};
+
+// A survey too large to plan is answered with an error at once.
+TEST_F(ServerCommands, SurveyTooLargeIsRefused)
+{
+	tcp::socket socket = connect();
+	send(socket, "SURVEY area=0,0,100,100 alt=10,1000,0.001");
+	const std::string answer = reply(socket);
+	EXPECT_EQ(answer.compare(0, 6, "ERROR:"), 0) << answer;
+	EXPECT_NE(answer.find("too large"), std::string::npos) << answer;
+	EXPECT_TRUE(queued(1, std::chrono::milliseconds(100)).empty());
+}
+
+// A command frame split across segments that arrive well apart is read
+// whole: u32 length, then the text.
+TEST_F(ServerCommands, ReadsWholeFrame)
+{
+	std::ostringstream cmd;
+	cmd << "TRAJECTORY 600";
+	for (int i = 0; i < 4000; ++i) cmd << " " << i * 2.5 << " 0 60 -15 0 " << i % 360;
+	const std::string command = cmd.str();
+	ASSERT_GT(command.size(), 64u * 1024u);
+	uint32_t size = (uint32_t)command.size();
+	const std::string frame = std::string(reinterpret_cast<const char*>(&size), sizeof(size)) + command;
+
+	tcp::socket socket = connect();
+	const size_t third = frame.size() / 3;
+	for (int part = 0; part < 2; ++part) {
+		boost::asio::write(socket, boost::asio::buffer(frame.substr(part * third, third)));
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	EXPECT_TRUE(queued(1, std::chrono::milliseconds(100)).empty());
+	boost::asio::write(socket, boost::asio::buffer(frame.substr(2 * third)));
+	std::deque<std::string> commands = queued(1);
+	ASSERT_EQ(commands.size(), 1u);
+	EXPECT_EQ(commands[0], command);
+}
+
+// Clients that send bare text still work: up to a newline, or once the data
+// stops.
+TEST_F(ServerCommands, UnterminatedCommand)
+{
+	tcp::socket socket = connect();
+	boost::asio::write(socket, boost::asio::buffer(std::string("FORWARD")));
+	std::deque<std::string> commands = queued(1);
+	ASSERT_EQ(commands.size(), 1u);
+	EXPECT_EQ(commands[0], "FORWARD");
+}
+
+TEST_F(ServerCommands, CarriageReturnTrimmed)
+{
+	tcp::socket socket = connect();
+	boost::asio::write(socket, boost::asio::buffer(std::string("UP\r\n")));
+	std::deque<std::string> commands = queued(1);
+	ASSERT_EQ(commands.size(), 1u);
+	EXPECT_EQ(commands[0], "UP");
+}
+
+// GET_POSE is answered once the script thread publishes the pose.
+TEST_F(ServerCommands, GetPoseWaitsForScriptThread)
+{
+	tcp::socket socket = connect();
+	send(socket, "GET_POSE");
+	std::deque<std::string> commands = queued(1);
+	ASSERT_EQ(commands.size(), 1u);
+	EXPECT_EQ(commands[0], "GET_POSE");
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(socket.available(), 0u);
+	CameraPose pose = { 1.0f, 2.0f, 3.0f, -10.0f, 0.0f, 45.0f, 60.0f };
+	publishCameraPose(pose);
+	EXPECT_EQ(reply(socket), formatCameraPose(pose));
+}
+
+TEST_F(ServerCommands, GetPoseTimesOut)
+{
+	tcp::socket socket = connect();
+	send(socket, "GET_POSE");
+	ASSERT_EQ(queued(1).size(), 1u);
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(reply(socket), "ERROR: Camera pose not available.");
+	EXPECT_GT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1500));
+	// the timed-out ticket is answered by the script thread's late publish
+	publishCameraPose(CameraPose());
+}
+
+// The image, depth and derived channels of a CAPTURE reply all come from the
+// newest published frame.
+TEST_F(ServerCommands, CaptureRepliesFromOneFrame)
+{
+	for (char tag : { 'A', 'B' }) {
+		auto frame = syntheticFrame(64, 36);
+		frame->screen.assign(100, (unsigned char)tag);
+		if (tag == 'B') for (float& d : frame->depth) d *= 0.5f;
+		publishCapturedFrame(frame);
+	}
+	auto frame = lastCapturedFrame();
+	ASSERT_TRUE(frame);
+	ASSERT_EQ(frame->screen[0], 'B');
+
+	tcp::socket socket = connect();
+	send(socket, "CAPTURE NORMALS FLOW");
+	const std::string data = reply(socket);
+	uint32_t sizes[2] = { 0, 0 };
+	ASSERT_GE(data.size(), sizeof(sizes));
+	memcpy(sizes, data.data(), sizeof(sizes));
+	ASSERT_EQ(sizes[0], frame->screen.size());
+	ASSERT_EQ(sizes[1], frame->depth.size() * sizeof(float));
+	size_t at = sizeof(sizes);
+	EXPECT_EQ(data.substr(at, sizes[0]), std::string(100, 'B'));
+	at += sizes[0];
+	EXPECT_EQ(memcmp(data.data() + at, frame->depth.data(), sizes[1]), 0);
+	at += sizes[1];
+
+	PositionPlanes planes;
+	unprojectDepth(*frame, planes);
+	std::vector<float> normals;
+	computeNormals(planes, normals);
+	uint32_t fields[3] = { 0, 0, 0 };
+	ASSERT_GE(data.size(), at + 16);
+	EXPECT_EQ(data.substr(at, 4), "NRML");
+	memcpy(fields, data.data() + at + 4, sizeof(fields));
+	EXPECT_EQ(fields[0], 64u);
+	EXPECT_EQ(fields[1], 36u);
+	ASSERT_EQ(fields[2], normals.size() * sizeof(float));
+	EXPECT_EQ(memcmp(data.data() + at + 16, normals.data(), fields[2]), 0);
+	at += 16 + fields[2];
+	ASSERT_GE(data.size(), at + 4);
+	EXPECT_EQ(data.substr(at, 4), "FLOW");
+}
+
+// After PIPELINE the connection stays open: commands sent back to back in one
+// write are answered in order, and later ones keep being read.
+TEST_F(ServerCommands, PipelinedRequestsAnswerInOrder)
+{
+	tcp::socket socket = connect();
+	boost::asio::write(socket, boost::asio::buffer(frame("PIPELINE") + frame("ENV_STATS") + frame("FORWARD")
+		+ frame("LOCKSTEP_STATS") + frame("ENV_STATS")));
+	EXPECT_EQ(reply(socket), "OK");
+	EXPECT_EQ(reply(socket).compare(0, 11, "{\"enabled\":"), 0);
+	const std::string lockstep = reply(socket);
+	EXPECT_EQ(lockstep.front(), '{');
+	EXPECT_EQ(lockstep.find("\"settle_frames\""), std::string::npos);
+	EXPECT_EQ(reply(socket).compare(0, 11, "{\"enabled\":"), 0);
+	std::deque<std::string> commands = queued(1);
+	ASSERT_EQ(commands.size(), 1u);
+	EXPECT_EQ(commands[0], "FORWARD");
+
+	// a frame split across writes, after a pause
+	const std::string late = frame("ENV_STATS");
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	boost::asio::write(socket, boost::asio::buffer(late.substr(0, 2)));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	boost::asio::write(socket, boost::asio::buffer(late.substr(2)));
+	EXPECT_EQ(reply(socket).compare(0, 11, "{\"enabled\":"), 0);
+}
+
+// The frame ids in a RIG_FRAMES / ENV_FRAMES reply, from each frame's META.
+static std::vector<unsigned int> taggedFrameIds(const std::string& data)
+{
+	std::vector<unsigned int> ids;
+	uint32_t count = 0;
+	if (data.size() < 4) return ids;
+	memcpy(&count, data.data(), 4);
+	size_t at = 4;
+	for (uint32_t i = 0; i < count && at + 20 <= data.size(); ++i) {
+		uint32_t block = 0, meta[3];
+		memcpy(&block, data.data() + at, 4);
+		memcpy(meta, data.data() + at + 8, sizeof(meta));
+		std::string json = data.substr(at + 20, meta[2]);
+		ids.push_back((unsigned int)std::stoul(json.substr(json.find("\"id\":") + 5)));
+		at += 4 + block;
+	}
+	return ids;
+}
+
+// RIG_FRAMES and ENV_FRAMES pick frames by their rig id and environment
+// round, not by what their metadata text happens to contain.
+TEST_F(ServerCommands, TaggedFramesSelectByRound)
+{
+	const unsigned int rig = nextRigId();
+	const unsigned int round = nextEnvironmentRound();
+	std::vector<unsigned int> ids;
+	auto publish = [&](const std::string& metadata, unsigned int rigId, unsigned int envRound) {
+		setNextCaptureMetadata(metadata, rigId, envRound);
+		publishCapturedFrame(syntheticFrame(16, 9));
+		ids.push_back(lastCapturedFrame()->id);
+		EXPECT_EQ(lastCapturedFrame()->rigId, rigId);
+		EXPECT_EQ(lastCapturedFrame()->envRound, envRound);
+	};
+	publish("\"camera\":\"a\"", rig, 0);
+	publish("\"rig\":" + std::to_string(rig) + ",\"env_round\":" + std::to_string(round) + ",\"x\":1", 0, 0);
+	publish("\"camera\":\"b\"", rig, round);
+	publish("", 0, round);
+	finishRig(rig);
+	finishEnvironmentRound(round, 1.0);
+
+	// the pending tags are used up by one publish
+	publishCapturedFrame(syntheticFrame(16, 9));
+	EXPECT_EQ(lastCapturedFrame()->rigId, 0u);
+	EXPECT_EQ(lastCapturedFrame()->envRound, 0u);
+
+	tcp::socket socket = connect();
+	send(socket, "PIPELINE");
+	ASSERT_EQ(reply(socket), "OK");
+	send(socket, "RIG_FRAMES");
+	EXPECT_EQ(taggedFrameIds(reply(socket)), std::vector<unsigned int>({ ids[0], ids[2] }));
+	send(socket, "ENV_FRAMES");
+	EXPECT_EQ(taggedFrameIds(reply(socket)), std::vector<unsigned int>({ ids[2], ids[3] }));
+}
+
+static uint64_t jsonNumber(const std::string& json, const std::string& key)
+{
+	size_t at = json.find("\"" + key + "\":");
+	return at == std::string::npos ? 0 : std::stoull(json.substr(at + key.size() + 3));
+}
+
+// CAPTURE_SHM puts the CAPTURE payload in shared memory and replies with
+// where to find it.
+TEST_F(ServerCommands, CaptureThroughSharedMemory)
+{
+	auto published = syntheticFrame(64, 36);
+	published->screen.assign(100, 'S');
+	publishCapturedFrame(published);
+
+	tcp::socket socket = connect();
+	send(socket, "PIPELINE");
+	ASSERT_EQ(reply(socket), "OK");
+	send(socket, "CAPTURE EDGES");
+	const std::string direct = reply(socket);
+	std::vector<SharedReplyRef> refs;
+	for (uint32_t i = 0; i <= sharedReplySlots; ++i) {
+		send(socket, "CAPTURE_SHM EDGES");
+		const std::string json = reply(socket);
+		ASSERT_EQ(json.compare(0, 8, "{\"shm\":\""), 0) << json;
+		SharedReplyRef ref;
+		ref.name = json.substr(8, json.find('"', 8) - 8);
+		ref.segmentBytes = jsonNumber(json, "bytes");
+		ref.offset = jsonNumber(json, "offset");
+		ref.size = jsonNumber(json, "size");
+		ref.sequence = jsonNumber(json, "sequence");
+		refs.push_back(ref);
+	}
+	std::vector<unsigned char> payload;
+	std::string error;
+	ASSERT_TRUE(readSharedReply(refs.back(), payload, error)) << error;
+	EXPECT_EQ(std::string(payload.begin(), payload.end()), direct);
+	// the ring has wrapped around onto the first slot
+	EXPECT_EQ(refs.front().offset, refs.back().offset);
+	EXPECT_FALSE(readSharedReply(refs.front(), payload, error));
+	EXPECT_EQ(error, "reply overwritten");
+	closeSharedReplies();
+}
@@ -0,0 +1,146 @@
+#include "survey.h"
+#include "frame.h"
+#include <gtest/gtest.h>
+
+static std::shared_ptr<const CapturedFrame> surveyFrame(unsigned int generation, unsigned int id)
+{
+	auto frame = std::make_shared<CapturedFrame>();
+	frame->id = id;
+	frame->metadata = "\"survey\":" + std::to_string(generation) + ",\"index\":" + std::to_string(id);
+	return frame;
+}
+
+TEST(SurveyCommand, Parses)
+{
+	SurveyPlanConfig cfg;
+	ASSERT_TRUE(parseSurveyCommand("SURVEY area=0,0,40,20 alt=30,50,10 overlap=0.5 yaw=0,90 order=tsp settle=3 gen=7", cfg));
+	EXPECT_EQ(cfg.x1, 40.0f);
+	EXPECT_EQ(cfg.zMax, 50.0f);
+	EXPECT_EQ(cfg.zStep, 10.0f);
+	EXPECT_EQ(cfg.overlap, 0.5f);
+	EXPECT_EQ(cfg.yaws, std::vector<float>({ 0.0f, 90.0f }));
+	EXPECT_TRUE(cfg.tspOrder);
+	EXPECT_EQ(cfg.settleTicks, 3);
+	EXPECT_EQ(cfg.generation, 7u);
+	EXPECT_FALSE(parseSurveyCommand("SURVEY alt=30,50", cfg));
+	EXPECT_FALSE(parseSurveyCommand("SURVEY area=0,0,40 alt=30,50", cfg));
+}
+
+// Oversized plans are refused before anything is planned, and the count
+// agrees with the plan for one that fits.
+TEST(SurveyCommand, RejectsOversizedPlans)
+{
+	SurveyPlanConfig cfg;
+	std::string error;
+	EXPECT_FALSE(parseSurveyCommand("SURVEY area=0,0,100,100 alt=10,1000,0.001", cfg, error));
+	EXPECT_NE(error.find("too large"), std::string::npos);
+	EXPECT_FALSE(parseSurveyCommand("SURVEY area=-1e7,-1e7,1e7,1e7 alt=30,30", cfg, error));
+	EXPECT_FALSE(parseSurveyCommand("SURVEY area=0,0,1e4,1e4 alt=1e6,1e6,1e-9", cfg, error));
+	EXPECT_FALSE(parseSurveyCommand("SURVEY area=0,0,nan,10 alt=30,30", cfg, error));
+	EXPECT_FALSE(parseSurveyCommand("SURVEY area=0,0,10,10 alt=30,inf", cfg, error));
+
+	ASSERT_TRUE(parseSurveyCommand("SURVEY area=0,0,400,200 alt=30,50,10 yaw=0,90,180", cfg, error)) << error;
+	EXPECT_TRUE(error.empty());
+	size_t stations = 0, waypoints = 0;
+	surveyPlanSize(cfg, stations, waypoints);
+	const std::vector<SurveyWaypoint> plan = planSurvey(cfg);
+	EXPECT_EQ(waypoints, plan.size());
+	EXPECT_EQ(stations * 3, plan.size());
+}
+
+// Every station is visited once per yaw, inside the area and altitude band.
+TEST(SurveyPlan, CoversStationsAtEveryYaw)
+{
+	SurveyPlanConfig cfg;
+	ASSERT_TRUE(parseSurveyCommand("SURVEY area=0,0,40,20 alt=30,40,10 yaw=0,180", cfg));
+	const std::vector<SurveyWaypoint> plan = planSurvey(cfg);
+	ASSERT_FALSE(plan.empty());
+	EXPECT_EQ(plan.size() % 2, 0u);
+	for (size_t i = 0; i < plan.size(); ++i) {
+		const SurveyWaypoint& w = plan[i];
+		EXPECT_GE(w.position.x(), 0.0f);
+		EXPECT_LE(w.position.x(), 40.0f);
+		EXPECT_GE(w.position.y(), 0.0f);
+		EXPECT_LE(w.position.y(), 20.0f);
+		EXPECT_GE(w.position.z(), 30.0f);
+		EXPECT_LE(w.position.z(), 40.0f);
+		if (i % 2 == 1) {
+			EXPECT_EQ(w.station, plan[i - 1].station);
+			EXPECT_EQ(w.position, plan[i - 1].position);
+		}
+	}
+	EXPECT_GT(surveyPathLength(plan), 0.0f);
+}
+
+// The plan is handed over once, and only to its own generation.
+TEST(SurveyPlan, HandOffByGeneration)
+{
+	SurveyPlanConfig cfg;
+	ASSERT_TRUE(parseSurveyCommand("SURVEY area=0,0,10,10 alt=20,20", cfg));
+	const std::vector<SurveyWaypoint> plan = planSurvey(cfg);
+	submitSurveyPlan(101, plan);
+	std::vector<SurveyWaypoint> taken;
+	EXPECT_FALSE(takeSurveyPlan(100, taken));
+	ASSERT_TRUE(takeSurveyPlan(101, taken));
+	EXPECT_EQ(taken.size(), plan.size());
+	EXPECT_FALSE(takeSurveyPlan(101, taken));
+
+	// a newer plan replaces an untaken one; an older one does not
+	submitSurveyPlan(102, plan);
+	submitSurveyPlan(103, std::vector<SurveyWaypoint>());
+	submitSurveyPlan(102, plan);
+	EXPECT_FALSE(takeSurveyPlan(102, taken));
+	ASSERT_TRUE(takeSurveyPlan(103, taken));
+	EXPECT_TRUE(taken.empty());
+}
+
+TEST(SurveyStream, QueuesItsOwnFramesInOrder)
+{
+	openSurveyStream(11);
+	offerSurveyFrame(surveyFrame(11, 1));
+	offerSurveyFrame(surveyFrame(1, 2));		// "survey":1, is not "survey":11,
+	offerSurveyFrame(surveyFrame(12, 3));
+	auto other = std::make_shared<CapturedFrame>();
+	other->metadata = "\"rig\":11";
+	offerSurveyFrame(other);
+	offerSurveyFrame(surveyFrame(11, 4));
+
+	std::shared_ptr<const CapturedFrame> frame;
+	size_t dropped = 99;
+	EXPECT_FALSE(takeSurveyFrame(12, frame, dropped));
+	ASSERT_TRUE(takeSurveyFrame(11, frame, dropped));
+	EXPECT_EQ(frame->id, 1u);
+	ASSERT_TRUE(takeSurveyFrame(11, frame, dropped));
+	EXPECT_EQ(frame->id, 4u);
+	EXPECT_FALSE(takeSurveyFrame(11, frame, dropped));
+	EXPECT_EQ(dropped, 0u);
+	closeSurveyStream(11);
+}
+
+// A full queue drops and counts instead of growing; closing stops queueing.
+TEST(SurveyStream, CountsDropsAndCloses)
+{
+	openSurveyStream(21);
+	for (unsigned int i = 0; i < surveyQueueLimit + 5; ++i) offerSurveyFrame(surveyFrame(21, i));
+	std::shared_ptr<const CapturedFrame> frame;
+	size_t dropped = 0;
+	for (unsigned int i = 0; i < surveyQueueLimit; ++i) {
+		ASSERT_TRUE(takeSurveyFrame(21, frame, dropped));
+		EXPECT_EQ(frame->id, i);
+	}
+	EXPECT_FALSE(takeSurveyFrame(21, frame, dropped));
+	EXPECT_EQ(dropped, 5u);
+
+	// a new stream starts empty
+	offerSurveyFrame(surveyFrame(21, 100));
+	openSurveyStream(22);
+	EXPECT_FALSE(takeSurveyFrame(21, frame, dropped));
+	EXPECT_FALSE(takeSurveyFrame(22, frame, dropped));
+	EXPECT_EQ(dropped, 0u);
+
+	closeSurveyStream(21);	// not the open one: no effect
+	offerSurveyFrame(surveyFrame(22, 1));
+	closeSurveyStream(22);
+	offerSurveyFrame(surveyFrame(22, 2));
+	EXPECT_FALSE(takeSurveyFrame(22, frame, dropped));
+}
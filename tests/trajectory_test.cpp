@@ -0,0 +1,119 @@
+#include "trajectory.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+
+static TrajectoryKey key(float x, float y, float z, float pitch, float roll, float yaw)
+{
+	TrajectoryKey k;
+	k.position = Eigen::Vector3f(x, y, z);
+	k.rotation = Eigen::Vector3f(pitch, roll, yaw);
+	return k;
+}
+
+TEST(TrajectoryCommand, Parses)
+{
+	Trajectory t;
+	ASSERT_TRUE(parseTrajectoryCommand("TRAJECTORY 10 0 0 50 -10 0 0 100 0 50 -10 0 90 CAPTURE 0.5 0 1", t));
+	EXPECT_EQ(t.duration(), 10.0f);
+	EXPECT_EQ(t.captures(), (std::vector<float>{ 0.0f, 0.5f, 1.0f }));
+	EXPECT_NEAR(t.length(), 100.0f, 1e-3f);
+	EXPECT_TRUE((t.evaluate(1.0f).position - Eigen::Vector3f(100.0f, 0.0f, 50.0f)).norm() < 1e-3f);
+}
+
+TEST(TrajectoryCommand, Rejects)
+{
+	Trajectory t;
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0", t));		// one key
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0", t));	// partial key
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 0 0 0 0 0 0 0 1 1 1 0 0 0", t));	// no duration
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0 x", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0 5x", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 nan 1 0 0 0", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY inf 0 0 0 0 0 0 1 1 1 0 0 0", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0 -inf", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0 0 CAPTURE nan", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0 0 CAPTURE 1.5", t));
+	EXPECT_FALSE(parseTrajectoryCommand("TRAJECTORY 10 0 0 0 0 0 0 1 1 1 0 0 0 CAPTURE 0.5 CAPTURE 0.6", t));
+	EXPECT_FALSE(parseTrajectoryCommand("PATH 10 0 0 0 0 0 0 1 1 1 0 0 0", t));
+}
+
+// Far longer than one socket read: every key must survive.
+TEST(TrajectoryCommand, LongPath)
+{
+	std::ostringstream cmd;
+	cmd << "TRAJECTORY 600";
+	const int keys = 3000;
+	for (int i = 0; i < keys; ++i) cmd << " " << i * 2.5 << " " << std::sin(i * 0.01) * 40.0 << " 60.125 -15 0 " << i % 360;
+	cmd << " CAPTURE";
+	for (int i = 0; i <= 100; ++i) cmd << " " << i / 100.0;
+	ASSERT_GT(cmd.str().size(), 64u * 1024u);
+	Trajectory t;
+	ASSERT_TRUE(parseTrajectoryCommand(cmd.str(), t));
+	EXPECT_EQ(t.captures().size(), 101u);
+	TrajectoryKey end = t.evaluate(1.0f);
+	EXPECT_NEAR(end.position.x(), (keys - 1) * 2.5f, 1e-2f);
+	EXPECT_NEAR(end.position.z(), 60.125f, 1e-3f);
+}
+
+TEST(Trajectory, PassesThroughKeys)
+{
+	Trajectory t;
+	std::vector<TrajectoryKey> keys = { key(0, 0, 10, 0, 0, 0), key(30, 10, 20, -20, 0, 45), key(50, 40, 20, 0, 0, 90) };
+	ASSERT_TRUE(t.build(keys, 5.0f, {}));
+	TrajectoryKey a = t.evaluate(0.0f), b = t.evaluate(1.0f);
+	EXPECT_LT((a.position - keys[0].position).norm(), 1e-4f);
+	EXPECT_LT((a.rotation - keys[0].rotation).norm(), 1e-4f);
+	EXPECT_LT((b.position - keys[2].position).norm(), 1e-3f);
+	EXPECT_LT((b.rotation - keys[2].rotation).norm(), 1e-3f);
+}
+
+// Equal steps of s cover equal distances along the curve.
+TEST(Trajectory, ConstantSpeed)
+{
+	Trajectory t;
+	std::vector<TrajectoryKey> keys = { key(0, 0, 0, 0, 0, 0), key(40, 10, 0, 0, 0, 0), key(100, 60, 0, 0, 0, 0),
+		key(110, 200, 30, 0, 0, 0) };
+	ASSERT_TRUE(t.build(keys, 20.0f, {}));
+	const int steps = 200;
+	const float expected = t.length() / steps;
+	Eigen::Vector3f prev = t.evaluate(0.0f).position;
+	for (int i = 1; i <= steps; ++i) {
+		Eigen::Vector3f p = t.evaluate((float)i / steps).position;
+		EXPECT_NEAR((p - prev).norm(), expected, expected * 0.02f) << "step " << i;
+		prev = p;
+	}
+}
+
+TEST(Trajectory, YawTakesShortWay)
+{
+	Trajectory t;
+	ASSERT_TRUE(t.build({ key(0, 0, 0, 0, 0, 170), key(10, 0, 0, 0, 0, -170) }, 1.0f, {}));
+	EXPECT_NEAR(t.evaluate(0.5f).rotation.z(), 180.0f, 0.5f);
+	EXPECT_NEAR(t.evaluate(1.0f).rotation.z(), 190.0f, 1e-3f);
+}
+
+TEST(TrajectoryPlayer, StopsOnCaptures)
+{
+	Trajectory t;
+	ASSERT_TRUE(t.build({ key(0, 0, 0, 0, 0, 0), key(100, 0, 0, 0, 0, 0) }, 10.0f, { 0.25f, 0.26f, 0.9f }));
+	TrajectoryPlayer player;
+	player.start(t);
+	std::vector<float> captured;
+	TrajectoryKey pose;
+	bool capture;
+	int steps = 0;
+	while (player.step(1.0f, pose, capture)) {
+		if (capture) {
+			captured.push_back(player.progress());
+			EXPECT_NEAR(pose.position.x(), 100.0f * player.progress(), 1e-2f);
+		}
+		ASSERT_LT(++steps, 100);
+		if (!player.active()) break;
+	}
+	EXPECT_EQ(captured, (std::vector<float>{ 0.25f, 0.26f, 0.9f }));
+	EXPECT_NEAR(pose.position.x(), 100.0f, 1e-3f);
+	EXPECT_FALSE(player.active());
+	EXPECT_FALSE(player.step(1.0f, pose, capture));
+}
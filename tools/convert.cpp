@@ -0,0 +1,448 @@
+// Converts raw captures to training formats on every core.
+//
+// Each directory under the input root that holds a depth.raw is one capture:
+// screen.bmp, depth.raw, matrix.txt and (optionally) stencil.raw, as the
+// plugin writes them to data\. Outputs, under the output root:
+//
+//   depth/<capture>.png    16-bit depth, round(metres * depth-scale), 0 for
+//                          sky and anything out of range
+//   npz/<capture>.npz      depth (float32 metres), rgb, stencil, P, M, MV,
+//                          MVP, Vinv, C order, matrices row-major
+//   shards/train-SSSSS-of-NNNNN.tfrecord
+//                          one tf.train.Example per capture: name, width,
+//                          height, depth/png16, depth/scale, rgb/raw,
+//                          rgb/width, rgb/height, stencil/raw and the
+//                          matrices as 16 row-major floats
+//   progress.log           one line per finished capture
+//
+// Captures are spread over a work-stealing pool, each worker reading and
+// converting one capture at a time through its own reusable buffers. A rerun
+// with the same settings skips the captures progress.log lists and cuts the
+// shards back to the last logged record, so an interrupted run resumes where
+// it stopped.
+//
+//   dronesim_convert <input> <output> [--threads N] [--formats png,npz,tfrecord]
+//                    [--shards N] [--depth-scale S] [--depth-size WxH] [--png-level L] [--restart]
+#include "formats.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct ConvertOptions {
+	fs::path input;
+	fs::path output;
+	int threads = 0;
+	bool png = true;
+	bool npz = true;
+	bool tfrecord = true;
+	int shards = 16;
+	float depthScale = 256.0f;	// KITTI's: 1/256 m steps up to 256 m
+	int depthWidth = 0;			// 0: the color size
+	int depthHeight = 0;
+	int pngLevel = 1;
+	bool restart = false;
+};
+
+struct Capture {
+	fs::path dir;
+	std::string name;
+};
+
+struct Shard {
+	std::mutex mtx;
+	FILE* file = nullptr;
+	uint64_t end = 0;
+};
+
+// Per-worker buffers, reused from one capture to the next.
+struct Scratch {
+	std::vector<unsigned char> depthFile, stencil, bmp, matrixFile, rgb;
+	std::vector<float> metres;
+	std::vector<uint16_t> depth16;
+	std::vector<unsigned char> png, pngRows, record;
+	TfExample example;
+};
+
+static std::atomic<uint64_t> capturesDone(0), capturesFailed(0), filesRead(0), filesWritten(0), bytesRead(0),
+	bytesWritten(0);
+
+static std::string settingsLine(const ConvertOptions& opt)
+{
+	std::ostringstream ss;
+	ss << "# dronesim_convert formats=" << (opt.png ? "png," : "") << (opt.npz ? "npz," : "")
+		<< (opt.tfrecord ? "tfrecord" : "") << " shards=" << opt.shards << " depth_scale=" << opt.depthScale
+		<< " depth_size=" << opt.depthWidth << "x" << opt.depthHeight;
+	return ss.str();
+}
+
+static std::string shardName(int shard, int shards)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "train-%05d-of-%05d.tfrecord", shard, shards);
+	return name;
+}
+
+static bool readInput(const fs::path& path, std::vector<unsigned char>& out, std::string& error)
+{
+	if (!readWholeFile(path.string(), out, error)) return false;
+	filesRead++;
+	bytesRead += out.size();
+	return true;
+}
+
+// Written beside the target and renamed over it, so a crash never leaves a
+// truncated output behind.
+static bool writeOutput(const fs::path& path, const void* data, size_t bytes, std::string& error)
+{
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+	fs::path tmp = path.string() + ".tmp";
+	FILE* f = fopen(tmp.string().c_str(), "wb");
+	if (f == nullptr) {
+		error = "cannot create " + tmp.string();
+		return false;
+	}
+	bool ok = fwrite(data, 1, bytes, f) == bytes;
+	ok = fclose(f) == 0 && ok;
+	if (ok) fs::rename(tmp, path, ec);
+	if (!ok || ec) {
+		error = "cannot write " + path.string();
+		return false;
+	}
+	filesWritten++;
+	bytesWritten += bytes;
+	return true;
+}
+
+static bool writeNpz(const fs::path& path, const Scratch& s, int width, int height, int colorWidth, int colorHeight,
+	const Eigen::Matrix4f& P, const rage_matrices& m, std::string& error)
+{
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+	fs::path tmp = path.string() + ".tmp";
+	NpzWriter npz;
+	const size_t w = width, h = height;
+	bool ok = npz.open(tmp.string(), error)
+		&& npz.add("depth", "<f4", { h, w }, s.metres.data(), w * h * sizeof(float), error)
+		&& npz.add("rgb", "|u1", { (size_t)colorHeight, (size_t)colorWidth, 3 }, s.rgb.data(), s.rgb.size(), error);
+	if (ok && !s.stencil.empty()) ok = npz.add("stencil", "|u1", { h, w }, s.stencil.data(), s.stencil.size(), error);
+	const std::pair<const char*, const Eigen::Matrix4f*> matrices[] = {
+		{ "P", &P }, { "M", &m.M }, { "MV", &m.MV }, { "MVP", &m.MVP }, { "Vinv", &m.Vinv } };
+	for (const auto& named : matrices) {
+		Eigen::Matrix<float, 4, 4, Eigen::RowMajor> rows = *named.second;
+		ok = ok && npz.add(named.first, "<f4", { 4, 4 }, rows.data(), sizeof(float) * 16, error);
+	}
+	ok = npz.close(error) && ok;
+	if (ok) fs::rename(tmp, path, ec);
+	if (!ok || ec) {
+		if (ec) error = "cannot write " + path.string();
+		return false;
+	}
+	filesWritten++;
+	bytesWritten += fs::file_size(path, ec);
+	return true;
+}
+
+static void addMatrix(TfExample& example, const char* key, const Eigen::Matrix4f& m)
+{
+	Eigen::Matrix<float, 4, 4, Eigen::RowMajor> rows = m;
+	example.addFloats(key, rows.data(), 16);
+}
+
+class Converter {
+public:
+	Converter(const ConvertOptions& opt, const std::vector<Capture>& captures)
+		: opt_(opt), captures_(captures), shards_(opt.tfrecord ? opt.shards : 0)
+	{
+	}
+
+	~Converter()
+	{
+		for (Shard& s : shards_) {
+			if (s.file != nullptr) fclose(s.file);
+		}
+		if (log_ != nullptr) fclose(log_);
+	}
+
+	// Reads progress.log and reopens the shards where it left them. Fills
+	// pending with the captures still to convert.
+	bool resume(std::vector<int>& pending, std::string& error)
+	{
+		std::error_code ec;
+		fs::create_directories(opt_.output, ec);
+		if (opt_.tfrecord) fs::create_directories(opt_.output / "shards", ec);
+		fs::path logPath = opt_.output / "progress.log";
+		std::string settings = settingsLine(opt_);
+		std::set<std::string> done;
+		std::vector<uint64_t> ends(shards_.size(), 0);
+		bool existing = !opt_.restart && fs::exists(logPath);
+		if (existing) {
+			std::ifstream in(logPath);
+			std::string line;
+			if (!std::getline(in, line) || line != settings) {
+				error = "progress.log was written with other settings (" + line + "); rerun with --restart";
+				return false;
+			}
+			while (std::getline(in, line)) {
+				std::istringstream ss(line);
+				int shard;
+				uint64_t end;
+				std::string name;
+				if (!(ss >> shard >> end) || !std::getline(ss >> std::ws, name)) continue;
+				done.insert(name);
+				if (shard >= 0 && shard < (int)ends.size()) ends[shard] = std::max(ends[shard], end);
+			}
+		}
+		log_ = fopen(logPath.string().c_str(), existing ? "ab" : "wb");
+		if (log_ == nullptr) {
+			error = "cannot open " + logPath.string();
+			return false;
+		}
+		if (!existing) {
+			fprintf(log_, "%s\n", settings.c_str());
+			fflush(log_);
+		}
+		for (size_t s = 0; s < shards_.size(); ++s) {
+			// records past the last logged one belong to captures that will be redone
+			fs::path path = opt_.output / "shards" / shardName((int)s, opt_.shards);
+			if (existing && fs::exists(path)) fs::resize_file(path, ends[s], ec);
+			else ends[s] = 0;
+			shards_[s].file = fopen(path.string().c_str(), existing ? "ab" : "wb");
+			shards_[s].end = ends[s];
+			if (shards_[s].file == nullptr || ec) {
+				error = "cannot open " + path.string();
+				return false;
+			}
+		}
+		for (int i = 0; i < (int)captures_.size(); ++i) {
+			if (!done.count(captures_[i].name)) pending.push_back(i);
+		}
+		return true;
+	}
+
+	void convert(int index, Scratch& s)
+	{
+		std::string error;
+		if (!convertCapture(index, s, error)) {
+			capturesFailed++;
+			std::lock_guard<std::mutex> lk(log_mtx_);
+			fprintf(stderr, "%s: %s\n", captures_[index].name.c_str(), error.c_str());
+			return;
+		}
+		capturesDone++;
+	}
+
+private:
+	bool convertCapture(int index, Scratch& s, std::string& error)
+	{
+		const Capture& c = captures_[index];
+		int colorWidth, colorHeight;
+		Eigen::Matrix4f P;
+		rage_matrices m;
+		if (!readInput(c.dir / "depth.raw", s.depthFile, error)) return false;
+		if (!readInput(c.dir / "screen.bmp", s.bmp, error) || !decodeBmpRgb(s.bmp, s.rgb, colorWidth, colorHeight, error)) return false;
+		if (!readInput(c.dir / "matrix.txt", s.matrixFile, error) || !parseMatrixFile(s.matrixFile, P, m, error)) return false;
+		s.stencil.clear();
+		std::error_code ec;
+		if (fs::exists(c.dir / "stencil.raw", ec) && !readInput(c.dir / "stencil.raw", s.stencil, error)) return false;
+
+		size_t count = s.depthFile.size() / sizeof(float);
+		int width = opt_.depthWidth > 0 ? opt_.depthWidth : colorWidth;
+		int height = opt_.depthWidth > 0 ? opt_.depthHeight : colorHeight;
+		if (s.depthFile.size() % sizeof(float) != 0 || count != (size_t)width * height) {
+			error = "depth.raw holds " + std::to_string(count) + " values, not " + std::to_string(width) + "x"
+				+ std::to_string(height) + (opt_.depthWidth > 0 ? "" : "; pass --depth-size");
+			return false;
+		}
+		if (!s.stencil.empty() && s.stencil.size() != count) {
+			error = "stencil.raw is " + std::to_string(s.stencil.size()) + " bytes, not " + std::to_string(count);
+			return false;
+		}
+
+		s.metres.resize(count);
+		linearizeDepth((const float*)s.depthFile.data(), count, P, s.metres.data());
+		if (opt_.png || opt_.tfrecord) {
+			s.depth16.resize(count);
+			quantizeDepth(s.metres.data(), count, opt_.depthScale, s.depth16.data());
+			if (!encodePngGray16(s.depth16.data(), width, height, opt_.pngLevel, s.png, s.pngRows)) {
+				error = "PNG encoding failed";
+				return false;
+			}
+		}
+		if (opt_.png && !writeOutput(opt_.output / "depth" / (c.name + ".png"), s.png.data(), s.png.size(), error)) return false;
+		if (opt_.npz && !writeNpz(opt_.output / "npz" / (c.name + ".npz"), s, width, height, colorWidth, colorHeight, P, m, error)) return false;
+		if (!opt_.tfrecord) {
+			logDone(c.name, -1, 0);
+			return true;
+		}
+
+		s.example.clear();
+		s.example.addBytes("name", c.name.data(), c.name.size());
+		s.example.addInt64("width", width);
+		s.example.addInt64("height", height);
+		s.example.addBytes("depth/png16", s.png.data(), s.png.size());
+		s.example.addFloats("depth/scale", &opt_.depthScale, 1);
+		s.example.addBytes("rgb/raw", s.rgb.data(), s.rgb.size());
+		s.example.addInt64("rgb/width", colorWidth);
+		s.example.addInt64("rgb/height", colorHeight);
+		if (!s.stencil.empty()) s.example.addBytes("stencil/raw", s.stencil.data(), s.stencil.size());
+		addMatrix(s.example, "P", P);
+		addMatrix(s.example, "M", m.M);
+		addMatrix(s.example, "MV", m.MV);
+		addMatrix(s.example, "MVP", m.MVP);
+		addMatrix(s.example, "Vinv", m.Vinv);
+		s.example.serialize(s.record);
+		unsigned char header[12], footer[4];
+		frameTfRecord(s.record, header, footer);
+
+		int shardIndex = index % opt_.shards;
+		Shard& shard = shards_[shardIndex];
+		std::lock_guard<std::mutex> lk(shard.mtx);
+		bool ok = fwrite(header, 1, sizeof(header), shard.file) == sizeof(header)
+			&& fwrite(s.record.data(), 1, s.record.size(), shard.file) == s.record.size()
+			&& fwrite(footer, 1, sizeof(footer), shard.file) == sizeof(footer)
+			&& fflush(shard.file) == 0;
+		if (!ok) {
+			error = "cannot write shard " + std::to_string(shardIndex);
+			return false;
+		}
+		uint64_t bytes = sizeof(header) + s.record.size() + sizeof(footer);
+		shard.end += bytes;
+		bytesWritten += bytes;
+		// logged under the shard's lock, so the logged ends only ever grow
+		logDone(c.name, shardIndex, shard.end);
+		return true;
+	}
+
+	void logDone(const std::string& name, int shard, uint64_t end)
+	{
+		std::lock_guard<std::mutex> lk(log_mtx_);
+		fprintf(log_, "%d %llu %s\n", shard, (unsigned long long)end, name.c_str());
+		fflush(log_);
+	}
+
+	const ConvertOptions& opt_;
+	const std::vector<Capture>& captures_;
+	std::vector<Shard> shards_;
+	std::mutex log_mtx_;
+	FILE* log_ = nullptr;
+};
+
+static std::vector<Capture> findCaptures(const fs::path& root)
+{
+	std::vector<Capture> captures;
+	auto add = [&](const fs::path& dir) {
+		fs::path rel = dir.lexically_relative(root);
+		std::string name = rel.empty() || rel == "." ? root.filename().string() : rel.generic_string();
+		captures.push_back({ dir, name.empty() ? "capture" : name });
+	};
+	std::error_code ec;
+	if (fs::exists(root / "depth.raw", ec)) add(root);
+	for (fs::recursive_directory_iterator it(root, ec), end; it != end; it.increment(ec)) {
+		if (ec) break;
+		if (it->is_directory(ec) && fs::exists(it->path() / "depth.raw", ec)) add(it->path());
+	}
+	std::sort(captures.begin(), captures.end(), [](const Capture& a, const Capture& b) { return a.name < b.name; });
+	return captures;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: dronesim_convert <input> <output> [--threads N] [--formats png,npz,tfrecord] [--shards N]\n"
+		"                        [--depth-scale S] [--depth-size WxH] [--png-level L] [--restart]\n");
+}
+
+int main(int argc, char** argv)
+{
+	ConvertOptions opt;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--threads" && hasValue) opt.threads = std::max(1, atoi(argv[++i]));
+		else if (arg == "--shards" && hasValue) opt.shards = std::max(1, atoi(argv[++i]));
+		else if (arg == "--depth-scale" && hasValue) opt.depthScale = (float)atof(argv[++i]);
+		else if (arg == "--png-level" && hasValue) opt.pngLevel = std::min(9, std::max(0, atoi(argv[++i])));
+		else if (arg == "--restart") opt.restart = true;
+		else if (arg == "--formats" && hasValue) {
+			std::string formats = std::string(",") + argv[++i] + ",";
+			opt.png = formats.find(",png,") != std::string::npos;
+			opt.npz = formats.find(",npz,") != std::string::npos;
+			opt.tfrecord = formats.find(",tfrecord,") != std::string::npos;
+		}
+		else if (arg == "--depth-size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &opt.depthWidth, &opt.depthHeight) != 2 || opt.depthWidth <= 0 || opt.depthHeight <= 0) {
+				usage();
+				return 2;
+			}
+		}
+		else if (arg.rfind("--", 0) == 0) {
+			usage();
+			return 2;
+		}
+		else paths.push_back(arg);
+	}
+	if (paths.size() != 2 || !(opt.png || opt.npz || opt.tfrecord) || !(opt.depthScale > 0.0f)) {
+		usage();
+		return 2;
+	}
+	opt.input = paths[0];
+	opt.output = paths[1];
+	if (opt.threads <= 0) opt.threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<Capture> captures = findCaptures(opt.input);
+	if (captures.empty()) {
+		fprintf(stderr, "no captures (directories with a depth.raw) under %s\n", opt.input.string().c_str());
+		return 1;
+	}
+	Converter converter(opt, captures);
+	std::vector<int> pending;
+	std::string error;
+	if (!converter.resume(pending, error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	printf("%zu capture(s), %zu already converted, %d thread(s)\n", captures.size(), captures.size() - pending.size(),
+		opt.threads);
+	fflush(stdout);
+
+	std::vector<Scratch> scratch(opt.threads);
+	std::atomic<bool> finished(false);
+	auto start = Clock::now();
+	std::thread progress([&] {
+		while (!finished) {
+			for (int i = 0; i < 20 && !finished; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			fprintf(stderr, "  %llu/%zu captures, %.1f files/s\n", (unsigned long long)(capturesDone + capturesFailed),
+				pending.size(), filesRead / seconds);
+		}
+	});
+	parallelForStealing(0, (int)pending.size(), [&](int item, int worker) { converter.convert(pending[item], scratch[worker]); },
+		opt.threads);
+	finished = true;
+	progress.join();
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	printf("converted %llu capture(s), %llu failed, in %.2f s: %.1f captures/s, %.1f files/s\n",
+		(unsigned long long)capturesDone, (unsigned long long)capturesFailed, seconds, capturesDone / seconds,
+		filesRead / seconds);
+	printf("read %llu file(s) %.1f MB (%.1f MB/s), wrote %llu file(s) + shards %.1f MB (%.1f MB/s)\n",
+		(unsigned long long)filesRead, bytesRead / 1048576.0, bytesRead / 1048576.0 / seconds,
+		(unsigned long long)filesWritten, bytesWritten / 1048576.0, bytesWritten / 1048576.0 / seconds);
+	return capturesFailed == 0 ? 0 : 1;
+}
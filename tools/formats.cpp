@@ -0,0 +1,426 @@
+#include "formats.h"
+#include <zlib.h>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define FORMATS_USE_SSE42 1
+#endif
+
+using Eigen::Matrix4f;
+
+bool readWholeFile(const std::string& path, std::vector<unsigned char>& out, std::string& error)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == nullptr) {
+		error = "cannot open " + path;
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	out.resize(size > 0 ? (size_t)size : 0);
+	bool ok = size >= 0 && fread(out.data(), 1, out.size(), f) == out.size();
+	fclose(f);
+	if (!ok) error = "cannot read " + path;
+	return ok;
+}
+
+static uint32_t get32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool decodeBmpRgb(const std::vector<unsigned char>& file, std::vector<unsigned char>& rgb, int& width, int& height,
+	std::string& error)
+{
+	if (file.size() < 54 || file[0] != 'B' || file[1] != 'M') {
+		error = "not a BMP file";
+		return false;
+	}
+	uint32_t offset = get32(&file[10]);
+	int32_t w = (int32_t)get32(&file[18]);
+	int32_t h = (int32_t)get32(&file[22]);
+	int bpp = file[28] | file[29] << 8;
+	uint32_t compression = get32(&file[30]);
+	if (w <= 0 || h == 0 || (bpp != 24 && bpp != 32) || (compression != 0 && !(compression == 3 && bpp == 32))) {
+		error = "unsupported BMP (" + std::to_string(bpp) + " bpp, compression " + std::to_string(compression) + ")";
+		return false;
+	}
+	bool bottomUp = h > 0;
+	h = std::abs(h);
+	size_t rowBytes = ((size_t)w * bpp + 31) / 32 * 4;
+	if (offset + rowBytes * h > file.size()) {
+		error = "BMP pixel data is truncated";
+		return false;
+	}
+	width = w;
+	height = h;
+	rgb.resize((size_t)w * h * 3);
+	int step = bpp / 8;
+	for (int y = 0; y < h; ++y) {
+		const unsigned char* src = &file[offset + rowBytes * (bottomUp ? h - 1 - y : y)];
+		unsigned char* dst = &rgb[(size_t)y * w * 3];
+		for (int x = 0; x < w; ++x, src += step, dst += 3) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+		}
+	}
+	return true;
+}
+
+bool parseMatrixFile(const std::vector<unsigned char>& file, Matrix4f& P, rage_matrices& matrices, std::string& error)
+{
+	std::istringstream ss(std::string(file.begin(), file.end()));
+	matrices.M = matrices.MV = matrices.MVP = matrices.Vinv = Matrix4f::Identity();
+	bool haveP = false, haveMV = false, haveMVP = false;
+	for (std::string tok; ss >> tok;) {
+		Matrix4f* target = nullptr;
+		if (tok == "P") target = &P;
+		else if (tok == "M") target = &matrices.M;
+		else if (tok == "MV") target = &matrices.MV;
+		else if (tok == "MVP") target = &matrices.MVP;
+		else if (tok == "Vinv") target = &matrices.Vinv;
+		else continue;
+		for (int i = 0; i < 16; ++i) {
+			if (!(ss >> (*target)(i / 4, i % 4))) {
+				error = "matrix " + tok + " is truncated";
+				return false;
+			}
+		}
+		haveP |= tok == "P";
+		haveMV |= tok == "MV";
+		haveMVP |= tok == "MVP";
+	}
+	if (!haveP && haveMV && haveMVP) {
+		P = projectionFromMatrices(matrices);
+		haveP = true;
+	}
+	if (!haveP) error = "no projection matrix";
+	return haveP;
+}
+
+void linearizeDepth(const float* raw, size_t count, const Matrix4f& P, float* metres)
+{
+	// d = (P22 z + P23) / (P32 z) for view z, looking down -z
+	const float p22 = P(2, 2), p23 = P(2, 3), p32 = P(3, 2);
+	for (size_t i = 0; i < count; ++i) {
+		float d = raw[i];
+		float m = d > 0.0f ? -p23 / (p32 * d - p22) : 0.0f;
+		metres[i] = m > 0.0f ? m : 0.0f;
+	}
+}
+
+void quantizeDepth(const float* metres, size_t count, float scale, uint16_t* out)
+{
+	for (size_t i = 0; i < count; ++i) {
+		float v = metres[i] * scale + 0.5f;
+		out[i] = v >= 1.0f && v < 65535.5f ? (uint16_t)v : 0;
+	}
+}
+
+static void put32be(unsigned char* p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static void appendPngChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t bytes)
+{
+	size_t at = out.size();
+	out.resize(at + 12 + bytes);
+	put32be(&out[at], (uint32_t)bytes);
+	memcpy(&out[at + 4], type, 4);
+	if (bytes > 0) memcpy(&out[at + 8], data, bytes);
+	put32be(&out[at + 8 + bytes], (uint32_t)crc32(0, &out[at + 4], (uInt)(4 + bytes)));
+}
+
+bool encodePngGray16(const uint16_t* pixels, int width, int height, int level, std::vector<unsigned char>& out,
+	std::vector<unsigned char>& scratch)
+{
+	// every row filtered Up: depth changes little from one row to the next
+	const size_t rowBytes = (size_t)width * 2;
+	scratch.resize((rowBytes + 1) * height);
+	for (int y = 0; y < height; ++y) {
+		const uint16_t* row = pixels + (size_t)y * width;
+		const uint16_t* above = y > 0 ? row - width : nullptr;
+		unsigned char* dst = &scratch[(rowBytes + 1) * y];
+		*dst++ = 2;
+		for (int x = 0; x < width; ++x) {
+			uint16_t v = row[x], a = above ? above[x] : 0;
+			dst[2 * x] = (unsigned char)((v >> 8) - (a >> 8));
+			dst[2 * x + 1] = (unsigned char)((v & 0xFF) - (a & 0xFF));
+		}
+	}
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	unsigned char ihdr[13] = { 0 };
+	put32be(ihdr, (uint32_t)width);
+	put32be(ihdr + 4, (uint32_t)height);
+	ihdr[8] = 16;	// bit depth; color type 0 (gray), no interlace
+	out.assign(signature, signature + 8);
+	appendPngChunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+	// deflate straight into the IDAT chunk's place
+	uLongf idatBytes = compressBound((uLong)scratch.size());
+	size_t at = out.size();
+	out.resize(at + 8 + idatBytes + 4);
+	if (compress2(&out[at + 8], &idatBytes, scratch.data(), (uLong)scratch.size(), level) != Z_OK) return false;
+	out.resize(at + 8 + idatBytes + 4);
+	put32be(&out[at], (uint32_t)idatBytes);
+	memcpy(&out[at + 4], "IDAT", 4);
+	put32be(&out[at + 8 + idatBytes], (uint32_t)crc32(0, &out[at + 4], (uInt)(4 + idatBytes)));
+	appendPngChunk(out, "IEND", nullptr, 0);
+	return true;
+}
+
+static void put16(unsigned char* p, uint16_t v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char* p, uint32_t v)
+{
+	for (int k = 0; k < 4; ++k) p[k] = (unsigned char)(v >> (8 * k));
+}
+
+// DOS date of 1980-01-01; the members carry no real time
+static const uint16_t zipDate = (1 << 5) | 1;
+
+NpzWriter::~NpzWriter()
+{
+	if (file_ != nullptr) fclose(file_);
+}
+
+bool NpzWriter::open(const std::string& path, std::string& error)
+{
+	file_ = fopen(path.c_str(), "wb");
+	if (file_ == nullptr) {
+		error = "cannot create " + path;
+		return false;
+	}
+	offset_ = 0;
+	members_.clear();
+	return true;
+}
+
+bool NpzWriter::add(const std::string& name, const char* dtype, const std::vector<size_t>& shape, const void* data,
+	size_t bytes, std::string& error)
+{
+	std::ostringstream dict;
+	dict << "{'descr': '" << dtype << "', 'fortran_order': False, 'shape': (";
+	for (size_t i = 0; i < shape.size(); ++i) dict << shape[i] << (shape.size() == 1 || i + 1 < shape.size() ? "," : "");
+	dict << "), }";
+	std::string header = dict.str();
+	// magic, version and length take 10 bytes; pad so the data is 64-byte aligned
+	header.append(63 - (10 + header.size()) % 64, ' ');
+	header += '\n';
+	std::vector<unsigned char> npy(10 + header.size());
+	memcpy(npy.data(), "\x93NUMPY\x01\x00", 8);
+	put16(&npy[8], (uint16_t)header.size());
+	memcpy(&npy[10], header.data(), header.size());
+
+	std::string member = name + ".npy";
+	uint64_t size = npy.size() + (uint64_t)bytes;
+	if (offset_ + 30 + member.size() + size > 0xFFFFFFFFull) {
+		error = "npz larger than 4 GB";
+		return false;
+	}
+	uint32_t crc = (uint32_t)crc32(0, npy.data(), (uInt)npy.size());
+	for (size_t done = 0; done < bytes;) {
+		size_t n = std::min<size_t>(bytes - done, 1u << 30);
+		crc = (uint32_t)crc32(crc, (const unsigned char*)data + done, (uInt)n);
+		done += n;
+	}
+
+	unsigned char local[30] = { 0 };
+	put32(local, 0x04034b50);
+	put16(local + 4, 20);
+	put16(local + 12, zipDate);
+	put32(local + 14, crc);
+	put32(local + 18, (uint32_t)size);
+	put32(local + 22, (uint32_t)size);
+	put16(local + 26, (uint16_t)member.size());
+	bool ok = fwrite(local, 1, sizeof(local), file_) == sizeof(local)
+		&& fwrite(member.data(), 1, member.size(), file_) == member.size()
+		&& fwrite(npy.data(), 1, npy.size(), file_) == npy.size()
+		&& fwrite(data, 1, bytes, file_) == bytes;
+	if (!ok) {
+		error = "write failed";
+		return false;
+	}
+	members_.push_back({ member, crc, (uint32_t)size, offset_ });
+	offset_ += (uint32_t)(sizeof(local) + member.size() + size);
+	return true;
+}
+
+bool NpzWriter::close(std::string& error)
+{
+	if (file_ == nullptr) return true;
+	uint32_t directory = 0;
+	bool ok = true;
+	for (const Member& m : members_) {
+		unsigned char central[46] = { 0 };
+		put32(central, 0x02014b50);
+		put16(central + 4, 20);
+		put16(central + 6, 20);
+		put16(central + 14, zipDate);
+		put32(central + 16, m.crc);
+		put32(central + 20, m.size);
+		put32(central + 24, m.size);
+		put16(central + 28, (uint16_t)m.name.size());
+		put32(central + 42, m.offset);
+		ok = ok && fwrite(central, 1, sizeof(central), file_) == sizeof(central)
+			&& fwrite(m.name.data(), 1, m.name.size(), file_) == m.name.size();
+		directory += (uint32_t)(sizeof(central) + m.name.size());
+	}
+	unsigned char end[22] = { 0 };
+	put32(end, 0x06054b50);
+	put16(end + 8, (uint16_t)members_.size());
+	put16(end + 10, (uint16_t)members_.size());
+	put32(end + 12, directory);
+	put32(end + 16, offset_);
+	ok = ok && fwrite(end, 1, sizeof(end), file_) == sizeof(end);
+	ok = fclose(file_) == 0 && ok;
+	file_ = nullptr;
+	if (!ok) error = "write failed";
+	return ok;
+}
+
+static void appendVarint(std::vector<unsigned char>& out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((unsigned char)v);
+}
+
+static size_t varintSize(uint64_t v)
+{
+	size_t n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		++n;
+	}
+	return n;
+}
+
+void TfExample::addBytes(const std::string& key, const void* data, size_t bytes)
+{
+	features_.push_back({ key, 1, (const unsigned char*)data, bytes, {} });
+}
+
+void TfExample::addInt64(const std::string& key, int64_t value)
+{
+	Feature f{ key, 3, nullptr, 0, {} };
+	appendVarint(f.packed, (uint64_t)value);
+	features_.push_back(std::move(f));
+}
+
+void TfExample::addFloats(const std::string& key, const float* values, size_t count)
+{
+	Feature f{ key, 2, nullptr, 0, {} };
+	f.packed.resize(count * sizeof(float));
+	memcpy(f.packed.data(), values, f.packed.size());
+	features_.push_back(std::move(f));
+}
+
+void TfExample::serialize(std::vector<unsigned char>& out) const
+{
+	// Example { Features features = 1 } ; Features { map<string, Feature> feature = 1 }
+	// Feature { BytesList bytes_list = 1; FloatList float_list = 2; Int64List int64_list = 3 }
+	// each list holds field 1: the bytes, or the packed values
+	auto payload = [](const Feature& f) { return f.kind == 1 ? f.bytes : f.packed.size(); };
+	auto listSize = [&](const Feature& f) { return 1 + varintSize(payload(f)) + payload(f); };
+	auto featureSize = [&](const Feature& f) { return 1 + varintSize(listSize(f)) + listSize(f); };
+	auto entrySize = [&](const Feature& f) {
+		return 1 + varintSize(f.key.size()) + f.key.size() + 1 + varintSize(featureSize(f)) + featureSize(f);
+	};
+	size_t features = 0;
+	for (const Feature& f : features_) features += 1 + varintSize(entrySize(f)) + entrySize(f);
+
+	out.clear();
+	out.reserve(1 + varintSize(features) + features);
+	out.push_back(0x0A);
+	appendVarint(out, features);
+	for (const Feature& f : features_) {
+		out.push_back(0x0A);
+		appendVarint(out, entrySize(f));
+		out.push_back(0x0A);
+		appendVarint(out, f.key.size());
+		out.insert(out.end(), f.key.begin(), f.key.end());
+		out.push_back(0x12);
+		appendVarint(out, featureSize(f));
+		out.push_back((unsigned char)(f.kind << 3 | 2));
+		appendVarint(out, listSize(f));
+		out.push_back(0x0A);
+		appendVarint(out, payload(f));
+		if (f.kind == 1) out.insert(out.end(), f.data, f.data + f.bytes);
+		else out.insert(out.end(), f.packed.begin(), f.packed.end());
+	}
+}
+
+namespace {
+struct Crc32cTables {
+	uint32_t t[8][256];
+	Crc32cTables()
+	{
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) c = c & 1 ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+			t[0][i] = c;
+		}
+		for (uint32_t i = 0; i < 256; ++i) {
+			for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+		}
+	}
+};
+}
+
+uint32_t crc32c(const void* data, size_t bytes, uint32_t crc)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	crc = ~crc;
+#ifdef FORMATS_USE_SSE42
+	uint64_t c = crc;
+	for (; bytes >= 8; bytes -= 8, p += 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		c = _mm_crc32_u64(c, v);
+	}
+	crc = (uint32_t)c;
+	for (; bytes > 0; --bytes) crc = _mm_crc32_u8(crc, *p++);
+#else
+	// slicing by 8
+	static const Crc32cTables tables;
+	const auto& t = tables.t;
+	for (; bytes >= 8; bytes -= 8, p += 8) {
+		uint32_t lo = crc ^ get32(p);
+		uint32_t hi = get32(p + 4);
+		crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+			^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+	}
+	for (; bytes > 0; --bytes) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+#endif
+	return ~crc;
+}
+
+static uint32_t maskedCrc(const void* data, size_t bytes)
+{
+	uint32_t crc = crc32c(data, bytes);
+	return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
+}
+
+void frameTfRecord(const std::vector<unsigned char>& record, unsigned char header[12], unsigned char footer[4])
+{
+	uint64_t length = record.size();
+	for (int k = 0; k < 8; ++k) header[k] = (unsigned char)(length >> (8 * k));
+	put32(header + 8, maskedCrc(header, 8));
+	put32(footer, maskedCrc(record.data(), record.size()));
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "frame.h"
+#include <Eigen/Core>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Readers for the raw capture files the plugin leaves in data\ and writers
+// for the training formats dronesim_convert produces.
+
+bool readWholeFile(const std::string& path, std::vector<unsigned char>& out, std::string& error);
+
+// screen.bmp: uncompressed 24 or 32 bpp, either row order, to tightly packed
+// RGB8 rows, top first.
+bool decodeBmpRgb(const std::vector<unsigned char>& file, std::vector<unsigned char>& rgb, int& width, int& height,
+	std::string& error);
+
+// matrix.txt as the draw hook writes it: labelled 4x4 blocks P, M, MV, MVP
+// and Vinv. P is recomputed from MVP and MV when the file lacks it.
+bool parseMatrixFile(const std::vector<unsigned char>& file, Eigen::Matrix4f& P, rage_matrices& matrices,
+	std::string& error);
+
+// Reversed-z depth.raw values to view depth in metres through P; sky (0) and
+// anything behind the camera become 0.
+void linearizeDepth(const float* raw, size_t count, const Eigen::Matrix4f& P, float* metres);
+// Metres to KITTI-style u16: round(metres * scale), 0 where out of range.
+void quantizeDepth(const float* metres, size_t count, float scale, uint16_t* out);
+
+// 16-bit grayscale PNG, deflated at level (0-9). scratch holds the filtered
+// rows between calls.
+bool encodePngGray16(const uint16_t* pixels, int width, int height, int level, std::vector<unsigned char>& out,
+	std::vector<unsigned char>& scratch);
+
+// Uncompressed .npz, as numpy.savez writes: one .npy member per array.
+// Members are streamed straight to the file.
+class NpzWriter {
+public:
+	~NpzWriter();
+	bool open(const std::string& path, std::string& error);
+	// dtype is a numpy descr such as "<f4" or "|u1"; data is C order.
+	bool add(const std::string& name, const char* dtype, const std::vector<size_t>& shape, const void* data,
+		size_t bytes, std::string& error);
+	bool close(std::string& error);
+
+private:
+	struct Member {
+		std::string name;
+		uint32_t crc;
+		uint32_t size;
+		uint32_t offset;
+	};
+	FILE* file_ = nullptr;
+	uint32_t offset_ = 0;
+	std::vector<Member> members_;
+};
+
+// A tf.train.Example, serialized by hand so shards load with
+// tf.data.TFRecordDataset without linking protobuf. Bytes features keep a
+// pointer to the caller's data until serialize.
+class TfExample {
+public:
+	void addBytes(const std::string& key, const void* data, size_t bytes);
+	void addInt64(const std::string& key, int64_t value);
+	void addFloats(const std::string& key, const float* values, size_t count);
+	void clear() { features_.clear(); }
+	void serialize(std::vector<unsigned char>& out) const;
+
+private:
+	struct Feature {
+		std::string key;
+		int kind;	// 1 bytes, 2 float, 3 int64
+		const unsigned char* data;
+		size_t bytes;
+		std::vector<unsigned char> packed;
+	};
+	std::vector<Feature> features_;
+};
+
+// CRC-32C (Castagnoli), the checksum TFRecord framing uses.
+uint32_t crc32c(const void* data, size_t bytes, uint32_t crc = 0);
+// TFRecord framing around record: header is the u64 length and the masked
+// crc of the length, footer the masked crc of the data.
+void frameTfRecord(const std::vector<unsigned char>& record, unsigned char header[12], unsigned char footer[4]);
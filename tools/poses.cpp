@@ -0,0 +1,110 @@
+// Builds and queries the pose index of recorded datasets (poseindex.h).
+//
+//   dronesim_poses build <dataset.dsq>... [--out index] [--far m] [--threads N]
+//   dronesim_poses radius <index> x y z r [yaw tolerance]
+//   dronesim_poses nearest <index> x y z yaw pitch [k] [--metres-per-radian w]
+//   dronesim_poses seeing <index> x y z
+//
+// build writes <dataset>.poses next to a single dataset unless --out is
+// given. Queries print one line per frame: dataset, frame position, frame
+// id, timestamp, camera position, yaw and pitch (and distance for nearest).
+#include "poseindex.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static void usage()
+{
+	fprintf(stderr, "usage: dronesim_poses build <dataset.dsq>... [--out index] [--far m] [--threads N]\n"
+		"       dronesim_poses radius <index> x y z r [yaw tolerance]\n"
+		"       dronesim_poses nearest <index> x y z yaw pitch [k] [--metres-per-radian w]\n"
+		"       dronesim_poses seeing <index> x y z\n");
+}
+
+static void printEntry(const PoseIndex& index, uint32_t i, const float* distance = nullptr)
+{
+	const PoseEntry& e = index.entries()[i];
+	printf("%s %u %u %lld %.2f %.2f %.2f %.1f %.1f", index.datasets()[e.dataset].c_str(), e.frame, e.frameId,
+		(long long)e.timestamp, e.position[0], e.position[1], e.position[2], e.yaw, e.pitch);
+	if (distance != nullptr) printf(" %.3f", *distance);
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> args;
+	std::string out;
+	float far = 200.0f, metresPerRadian = 10.0f;
+	int threads = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--out" && hasValue) out = argv[++i];
+		else if (arg == "--far" && hasValue) far = (float)atof(argv[++i]);
+		else if (arg == "--threads" && hasValue) threads = atoi(argv[++i]);
+		else if (arg == "--metres-per-radian" && hasValue) metresPerRadian = (float)atof(argv[++i]);
+		else args.push_back(arg);
+	}
+	if (args.size() < 2) {
+		usage();
+		return 2;
+	}
+	const std::string mode = args[0];
+	std::string error;
+	PoseIndex index;
+
+	if (mode == "build") {
+		std::vector<std::string> datasets(args.begin() + 1, args.end());
+		if (out.empty()) {
+			if (datasets.size() != 1) {
+				fprintf(stderr, "--out is needed for more than one dataset\n");
+				return 2;
+			}
+			out = posesPathFor(datasets[0]);
+		}
+		auto start = Clock::now();
+		if (!index.build(datasets, far, error, threads) || !index.save(out, error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		printf("%zu frame(s) from %zu dataset(s) in %.3f s, %zu nodes -> %s\n", index.entries().size(), datasets.size(),
+			seconds, index.nodes().size(), out.c_str());
+		return 0;
+	}
+
+	if (mode != "radius" && mode != "nearest" && mode != "seeing") {
+		usage();
+		return 2;
+	}
+	std::vector<float> v;
+	for (size_t i = 2; i < args.size(); ++i) v.push_back((float)atof(args[i].c_str()));
+	if (!index.load(args[1], error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	std::vector<uint32_t> hits;
+	if (mode == "radius" && (v.size() == 4 || v.size() == 6)) {
+		index.radius(Eigen::Vector3f(v[0], v[1], v[2]), v[3], hits, v.size() == 6 ? v[4] : 0.0f, v.size() == 6 ? v[5] : 180.0f);
+		for (uint32_t i : hits) printEntry(index, i);
+	}
+	else if (mode == "nearest" && (v.size() == 5 || v.size() == 6)) {
+		std::vector<std::pair<float, uint32_t>> nearest;
+		index.nearest(Eigen::Vector3f(v[0], v[1], v[2]), poseForward(v[3], v[4]), v.size() == 6 ? (size_t)v[5] : 10,
+			metresPerRadian, nearest);
+		for (const auto& n : nearest) printEntry(index, n.second, &n.first);
+	}
+	else if (mode == "seeing" && v.size() == 3) {
+		index.seeing(Eigen::Vector3f(v[0], v[1], v[2]), hits);
+		for (uint32_t i : hits) printEntry(index, i);
+	}
+	else {
+		usage();
+		return 2;
+	}
+	return 0;
+}